@@ -97,6 +97,7 @@ unix: OTHER_FILES += $${MANPAGESOURCES}
 macx: OTHER_FILES += Info.plist.in
 
 QT += \
+    concurrent \
     opengl \
     qml \
     quick \
@@ -249,7 +250,7 @@ macx: isEmpty(NOAPPBUNDLE) {
 }
 
 android {
-    QT += concurrent xml androidextras
+    QT += xml androidextras
 
     DISTFILES += \
         share/android/AndroidManifest.xml \
@@ -708,6 +708,7 @@ AkPacket AudioLayer::iStream(const AkPacket &packet)
     if (packet.caps().mimeType() != "audio/x-raw")
         return AkPacket();
 
+    auto enterTime = this->statsEnter(packet);
     this->d->m_mutex.lock();
 
     if (this->d->m_audioOut)
@@ -719,6 +720,7 @@ AkPacket AudioLayer::iStream(const AkPacket &packet)
     }
 
     this->d->m_mutex.unlock();
+    this->statsLeave(enterTime);
 
     return AkPacket();
 }
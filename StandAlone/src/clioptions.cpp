@@ -32,6 +32,7 @@ class CliOptionsPrivate
         QCommandLineOption m_pluginPathsOpt {{"p", "paths"}};
         QCommandLineOption m_blackListOpt {{"b", "no-load"}};
         QCommandLineOption m_vcamPathOpt {"vcam"};
+        QCommandLineOption m_statsOpt {"stats"};
 
         QString convertToAbsolute(const QString &path) const;
 };
@@ -76,6 +77,12 @@ CliOptions::CliOptions()
     this->d->m_vcamPathOpt.setValueName(QObject::tr("PATH1;PATH2;PATH3;..."));
     this->addOption(this->d->m_vcamPathOpt);
 
+    this->d->m_statsOpt.setDescription(
+                QObject::tr("Collect processing statistics of the elements and "
+                            "save them to FILE when closing."));
+    this->d->m_statsOpt.setValueName(QObject::tr("FILE"));
+    this->addOption(this->d->m_statsOpt);
+
     this->process(*QCoreApplication::instance());
 
     // Set path for loading user settings.
@@ -124,6 +131,11 @@ QCommandLineOption CliOptions::vcamPathOpt() const
     return this->d->m_vcamPathOpt;
 }
 
+QCommandLineOption CliOptions::statsOpt() const
+{
+    return this->d->m_statsOpt;
+}
+
 QString CliOptionsPrivate::convertToAbsolute(const QString &path) const
 {
     if (!QDir::isRelativePath(path))
@@ -35,6 +35,7 @@ class CliOptions: public QCommandLineParser
         QCommandLineOption pluginPathsOpt() const;
         QCommandLineOption blackListOpt() const;
         QCommandLineOption vcamPathOpt() const;
+        QCommandLineOption statsOpt() const;
 
     private:
         CliOptionsPrivate *d;
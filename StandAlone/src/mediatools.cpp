@@ -19,8 +19,11 @@
 
 #include <QApplication>
 #include <QDateTime>
+#include <QDebug>
 #include <QDir>
+#include <QFile>
 #include <QFileInfo>
+#include <QJsonDocument>
 #include <QQmlApplicationEngine>
 #include <QQmlContext>
 #include <QSettings>
@@ -60,6 +63,8 @@ class MediaToolsPrivate
         CliOptions m_cliOptions;
         int m_windowWidth {0};
         int m_windowHeight {0};
+
+        void saveStats();
 };
 
 MediaTools::MediaTools(QObject *parent):
@@ -68,6 +73,9 @@ MediaTools::MediaTools(QObject *parent):
     this->d = new MediaToolsPrivate;
     Ak::registerTypes();
 
+    if (this->d->m_cliOptions.isSet(this->d->m_cliOptions.statsOpt()))
+        AkElement::setStatsEnabled(true);
+
     // Initialize environment.
     this->d->m_engine = new QQmlApplicationEngine();
     this->d->m_engine->addImageProvider(QLatin1String("icons"),
@@ -173,6 +181,7 @@ MediaTools::MediaTools(QObject *parent):
 MediaTools::~MediaTools()
 {
     this->saveConfigs();
+    this->d->saveStats();
     delete this->d->m_engine;
     delete this->d;
 }
@@ -376,4 +385,21 @@ void MediaTools::makedirs(const QString &path)
     QDir().mkpath(path);
 }
 
+void MediaToolsPrivate::saveStats()
+{
+    if (!this->m_cliOptions.isSet(this->m_cliOptions.statsOpt()))
+        return;
+
+    auto fileName = this->m_cliOptions.value(this->m_cliOptions.statsOpt());
+    QFile file(fileName);
+
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qWarning() << "Can't write the statistics to" << fileName;
+
+        return;
+    }
+
+    file.write(QJsonDocument::fromVariant(AkElement::allStats()).toJson());
+}
+
 #include "moc_mediatools.cpp"
@@ -27,6 +27,8 @@
 #include <QSettings>
 #include <QStandardPaths>
 #include <QThread>
+#include <QThreadPool>
+#include <QtConcurrent>
 #include <QQmlContext>
 #include <QQuickItem>
 #include <QQmlProperty>
@@ -85,7 +87,11 @@ class RecordingPrivate
         };
         QMutex m_mutex;
         AkVideoPacket m_curPacket;
-        QImage m_photo;
+        AkVideoPacket m_photo;
+        QList<AkVideoPacket> m_burst;
+        QString m_burstFileName;
+        int m_burstSize {0};
+        QThreadPool m_photoPool;
         QImage m_thumbnail;
         QMap<QString, QString> m_imageFormats;
         AkElement::ElementState m_state {AkElement::ElementStateNull};
@@ -129,6 +135,10 @@ class RecordingPrivate
         void saveAudioCodecOptions(const QVariantMap &audioCodecOptions);
         void saveRecordAudio(bool recordAudio);
         QString readThumbnail(const QString &videoFile);
+        void savePhotoAsync(const AkVideoPacket &photo, const QString &path);
+        static bool saveImage(const AkVideoPacket &photo,
+                              const QString &path,
+                              int quality);
 };
 
 Recording::Recording(QQmlApplicationEngine *engine, QObject *parent):
@@ -144,6 +154,13 @@ Recording::Recording(QQmlApplicationEngine *engine, QObject *parent):
                          SLOT(codecLibChanged(const QString &)));
     }
 
+    // Notify the frame rate changes of the video encoder.
+    if (this->d->m_record)
+        QObject::connect(this->d->m_record.data(),
+                         SIGNAL(encoderAdapted(int, const QVariantMap &)),
+                         this,
+                         SLOT(encoderAdapted(int, const QVariantMap &)));
+
     if (this->d->m_thumbnailer) {
         QObject::connect(this->d->m_thumbnailer.data(),
                          SIGNAL(oStream(const AkPacket &)),
@@ -161,6 +178,7 @@ Recording::Recording(QQmlApplicationEngine *engine, QObject *parent):
 Recording::~Recording()
 {
     this->setState(AkElement::ElementStateNull);
+    this->d->m_photoPool.waitForDone();
     delete this->d;
 }
 
@@ -744,8 +762,9 @@ void Recording::resetImageSaveQuality()
 
 void Recording::takePhoto()
 {
+    // The packet data is shared, the frame is converted when saved.
     this->d->m_mutex.lock();
-    this->d->m_photo = this->d->m_curPacket.toImage().copy();
+    this->d->m_photo = this->d->m_curPacket;
     this->d->m_mutex.unlock();
 }
 
@@ -757,24 +776,73 @@ void Recording::savePhoto(const QString &fileName)
     if (path.isEmpty())
         return;
 
-    if (QDir().mkpath(this->d->m_imagesDirectory)) {
-        this->d->m_photo.save(path, nullptr, this->d->m_imageSaveQuality);
-        this->d->m_lastPhotoPreview = path;
-        emit this->lastPhotoPreviewChanged(path);
-    }
+    this->d->m_mutex.lock();
+    auto photo = this->d->m_photo;
+    this->d->m_mutex.unlock();
+
+    if (photo && QDir().mkpath(this->d->m_imagesDirectory))
+        this->d->savePhotoAsync(photo, path);
+}
+
+void Recording::takePhotos(const QString &fileName, int count)
+{
+    QString path = fileName;
+    path.replace("file://", "");
+
+    if (path.isEmpty()
+        || count < 1
+        || !QDir().mkpath(this->d->m_imagesDirectory))
+        return;
+
+    // Collect the next frames, they are saved once the burst is complete.
+    this->d->m_mutex.lock();
+    this->d->m_burst.clear();
+    this->d->m_burstFileName = path;
+    this->d->m_burstSize = count;
+    this->d->m_mutex.unlock();
 }
 
 AkPacket Recording::iStream(const AkPacket &packet)
 {
+    auto enterTime = this->statsEnter(packet);
+
     if (packet.caps().mimeType() == "video/x-raw") {
         this->d->m_mutex.lock();
         this->d->m_curPacket = packet;
+        QList<AkVideoPacket> burst;
+        QString burstFileName;
+
+        if (this->d->m_burstSize > 0) {
+            this->d->m_burst << this->d->m_curPacket;
+
+            if (this->d->m_burst.size() >= this->d->m_burstSize) {
+                burst = this->d->m_burst;
+                burstFileName = this->d->m_burstFileName;
+                this->d->m_burst.clear();
+                this->d->m_burstSize = 0;
+            }
+        }
+
         this->d->m_mutex.unlock();
+
+        // Number the photos before the file extension.
+        auto dot = burstFileName.lastIndexOf('.');
+
+        if (dot <= burstFileName.lastIndexOf('/') + 1)
+            dot = burstFileName.size();
+
+        for (int i = 0; i < burst.size(); i++)
+            this->d->savePhotoAsync(burst[i],
+                                    burstFileName.left(dot)
+                                    + QString("-%1").arg(i + 1, 3, 10, QChar('0'))
+                                    + burstFileName.mid(dot));
     }
 
     if (this->d->m_state == AkElement::ElementStatePlaying)
         (*this->d->m_record)(packet);
 
+    this->statsLeave(enterTime);
+
     return AkPacket();
 }
 
@@ -806,6 +874,19 @@ void Recording::thumbnailUpdated(const AkPacket &packet)
     this->d->m_thumbnail = thumbnail;
 }
 
+void Recording::encoderAdapted(int index, const QVariantMap &adaptation)
+{
+    // The video is always the first stream.
+    if (index == 0)
+        emit this->videoEncoderAdapted(adaptation);
+}
+
+void Recording::photoSaved(const QString &path)
+{
+    this->d->m_lastPhotoPreview = path;
+    emit this->lastPhotoPreviewChanged(path);
+}
+
 RecordingPrivate::RecordingPrivate(Recording *self):
     self(self)
 {
@@ -1687,4 +1768,39 @@ QString RecordingPrivate::readThumbnail(const QString &videoFile)
     return thumnailPath;
 }
 
+void RecordingPrivate::savePhotoAsync(const AkVideoPacket &photo,
+                                      const QString &path)
+{
+    // Encoding big images takes a while, don't block the UI.
+    auto quality = this->m_imageSaveQuality;
+
+    QtConcurrent::run(&this->m_photoPool, [this, photo, path, quality] () {
+        if (RecordingPrivate::saveImage(photo, path, quality))
+            QMetaObject::invokeMethod(self,
+                                      "photoSaved",
+                                      Qt::QueuedConnection,
+                                      Q_ARG(QString, path));
+    });
+}
+
+bool RecordingPrivate::saveImage(const AkVideoPacket &photo,
+                                 const QString &path,
+                                 int quality)
+{
+    auto image = photo.toImage();
+
+    // The YUV frames are converted to RGB in a single pass, which is also
+    // the format used internally by the JPEG writer.
+    if (image.isNull())
+        image = photo.convert(AkVideoCaps::Format_rgb24).toImage();
+
+    if (image.isNull())
+        image = photo.convert(AkVideoCaps::Format_argb).toImage();
+
+    if (image.isNull())
+        return false;
+
+    return image.save(path, nullptr, quality);
+}
+
 #include "moc_recording.cpp"
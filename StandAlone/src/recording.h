@@ -225,6 +225,7 @@ class Recording: public QObject
         void imageFormatChanged(const QString &imageFormat);
         void lastPhotoPreviewChanged(const QString &lastPhotoPreview);
         void imageSaveQualityChanged(int imageSaveQuality);
+        void videoEncoderAdapted(const QVariantMap &adaptation);
 
     public slots:
         void setAudioCaps(const AkAudioCaps &audioCaps);
@@ -263,12 +264,15 @@ class Recording: public QObject
         void resetImageSaveQuality();
         void takePhoto();
         void savePhoto(const QString &fileName);
+        void takePhotos(const QString &fileName, int count);
         AkPacket iStream(const AkPacket &packet);
         void setQmlEngine(QQmlApplicationEngine *engine=nullptr);
 
     private slots:
         void codecLibChanged(const QString &codecLib);
         void thumbnailUpdated(const AkPacket &packet);
+        void encoderAdapted(int index, const QVariantMap &adaptation);
+        void photoSaved(const QString &path);
 };
 
 #endif // RECORDING_H
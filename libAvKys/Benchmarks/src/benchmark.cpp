@@ -0,0 +1,339 @@
+/* Webcamoid, webcam capture application.
+ * Copyright (C) 2020  Gonzalo Exequiel Pedone
+ *
+ * Webcamoid is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Webcamoid is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Webcamoid. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Web-Site: http://webcamoid.github.io/
+ */
+
+#include <QElapsedTimer>
+#include <QImage>
+#include <QRandomGenerator>
+#include <QVariant>
+#include <akelement.h>
+#include <akfrac.h>
+#include <akpacket.h>
+#include <akvideopacket.h>
+
+#ifdef Q_OS_UNIX
+#include <sys/resource.h>
+#endif
+
+#include "benchmark.h"
+
+// Number of distinct frames fed in a loop, so temporal effects have
+// something to work with.
+#define N_SOURCE_FRAMES 8
+
+static QBasicAtomicInteger<quint64> allocations = Q_BASIC_ATOMIC_INITIALIZER(0);
+
+#if defined(Q_OS_LINUX) && defined(__GLIBC__)
+#include <cerrno>
+
+// Count every heap allocation made by the process, including the ones made
+// from inside the plugins.
+extern "C" {
+    void *__libc_malloc(size_t size);
+    void *__libc_calloc(size_t nmemb, size_t size);
+    void *__libc_realloc(void *ptr, size_t size);
+    void *__libc_memalign(size_t alignment, size_t size);
+
+    void *malloc(size_t size)
+    {
+        allocations.fetchAndAddRelaxed(1);
+
+        return __libc_malloc(size);
+    }
+
+    void *calloc(size_t nmemb, size_t size)
+    {
+        allocations.fetchAndAddRelaxed(1);
+
+        return __libc_calloc(nmemb, size);
+    }
+
+    void *realloc(void *ptr, size_t size)
+    {
+        if (!ptr)
+            allocations.fetchAndAddRelaxed(1);
+
+        return __libc_realloc(ptr, size);
+    }
+
+    void *memalign(size_t alignment, size_t size)
+    {
+        allocations.fetchAndAddRelaxed(1);
+
+        return __libc_memalign(alignment, size);
+    }
+
+    void *aligned_alloc(size_t alignment, size_t size)
+    {
+        allocations.fetchAndAddRelaxed(1);
+
+        return __libc_memalign(alignment, size);
+    }
+
+    int posix_memalign(void **memptr, size_t alignment, size_t size)
+    {
+        if (alignment < sizeof(void *) || alignment & (alignment - 1))
+            return EINVAL;
+
+        allocations.fetchAndAddRelaxed(1);
+        auto ptr = __libc_memalign(alignment, size);
+
+        if (!ptr)
+            return ENOMEM;
+
+        *memptr = ptr;
+
+        return 0;
+    }
+}
+
+#define HAVE_ALLOCATIONS_COUNTER
+#endif
+
+class BenchmarkPrivate
+{
+    public:
+        QStringList m_plugins;
+        QList<QSize> m_sizes {{320, 240}, {640, 480}, {1280, 720}, {1920, 1080}};
+        AkVideoCaps::PixelFormatList m_formats {
+            AkVideoCaps::Format_argb,
+            AkVideoCaps::Format_0rgb,
+            AkVideoCaps::Format_rgb24,
+            AkVideoCaps::Format_gray
+        };
+        int m_frames {100};
+        int m_warmupFrames {10};
+
+        static QVector<AkVideoPacket> sourceFrames(const QSize &size,
+                                                   AkVideoCaps::PixelFormat format);
+        static qint64 peakRss();
+};
+
+Benchmark::Benchmark(QObject *parent):
+    QObject(parent)
+{
+    this->d = new BenchmarkPrivate;
+}
+
+Benchmark::~Benchmark()
+{
+    delete this->d;
+}
+
+QStringList Benchmark::plugins() const
+{
+    if (this->d->m_plugins.isEmpty())
+        return AkElement::listPlugins("VideoFilter");
+
+    return this->d->m_plugins;
+}
+
+QList<QSize> Benchmark::sizes() const
+{
+    return this->d->m_sizes;
+}
+
+AkVideoCaps::PixelFormatList Benchmark::formats() const
+{
+    return this->d->m_formats;
+}
+
+int Benchmark::frames() const
+{
+    return this->d->m_frames;
+}
+
+int Benchmark::warmupFrames() const
+{
+    return this->d->m_warmupFrames;
+}
+
+QVariantMap Benchmark::run(const QString &plugin,
+                           const QSize &size,
+                           AkVideoCaps::PixelFormat format) const
+{
+    QVariantMap result {
+        {"plugin", plugin                                 },
+        {"width" , size.width()                           },
+        {"height", size.height()                          },
+        {"format", AkVideoCaps::pixelFormatToString(format)},
+    };
+
+    auto frames = BenchmarkPrivate::sourceFrames(size, format);
+
+    if (frames.isEmpty()) {
+        result["error"] = "Unsupported format";
+
+        return result;
+    }
+
+    // The plugins take their random numbers from the global generator, seed
+    // it so every run produces the same output.
+    QRandomGenerator::global()->seed(1);
+    auto element = AkElement::create(plugin);
+
+    if (!element) {
+        result["error"] = "Can't load plugin";
+
+        return result;
+    }
+
+    element->setState(AkElement::ElementStatePlaying);
+    int totalFrames = this->d->m_warmupFrames + this->d->m_frames;
+    qint64 elapsed = 0;
+    quint64 allocated = 0;
+    QElapsedTimer timer;
+
+    // All frames belong to the same stream, otherwise the filters that keep
+    // state would reset on every frame.
+    for (auto &frame: frames)
+        frame.id() = 0;
+
+    for (int i = 0; i < totalFrames; i++) {
+        auto &frame = frames[i % frames.size()];
+        frame.pts() = i;
+        auto allocationsStart = allocations.loadAcquire();
+        timer.start();
+        element->iStream(frame);
+        auto frameTime = timer.nsecsElapsed();
+        auto frameAllocations = allocations.loadAcquire() - allocationsStart;
+
+        if (i >= this->d->m_warmupFrames) {
+            elapsed += frameTime;
+            allocated += frameAllocations;
+        }
+    }
+
+    element->setState(AkElement::ElementStateNull);
+    qreal pixels = qreal(size.width()) * size.height() * this->d->m_frames;
+
+    result["frames"] = this->d->m_frames;
+    result["nsPerPixel"] = pixels > 0? elapsed / pixels: 0.0;
+    result["fps"] = elapsed > 0? 1e9 * this->d->m_frames / elapsed: 0.0;
+#ifdef HAVE_ALLOCATIONS_COUNTER
+    result["allocationsPerFrame"] =
+            this->d->m_frames > 0? qreal(allocated) / this->d->m_frames: 0.0;
+#else
+    Q_UNUSED(allocated)
+#endif
+    result["peakRssKiB"] = BenchmarkPrivate::peakRss();
+
+    return result;
+}
+
+QVariantList Benchmark::runAll() const
+{
+    QVariantList results;
+
+    for (auto &plugin: this->plugins())
+        for (auto &size: this->d->m_sizes)
+            for (auto &format: this->d->m_formats)
+                results << this->run(plugin, size, format);
+
+    return results;
+}
+
+void Benchmark::setPlugins(const QStringList &plugins)
+{
+    this->d->m_plugins = plugins;
+}
+
+void Benchmark::setSizes(const QList<QSize> &sizes)
+{
+    this->d->m_sizes = sizes;
+}
+
+void Benchmark::setFormats(const AkVideoCaps::PixelFormatList &formats)
+{
+    this->d->m_formats = formats;
+}
+
+void Benchmark::setFrames(int frames)
+{
+    this->d->m_frames = qMax(frames, 1);
+}
+
+void Benchmark::setWarmupFrames(int warmupFrames)
+{
+    this->d->m_warmupFrames = qMax(warmupFrames, 0);
+}
+
+QVector<AkVideoPacket> BenchmarkPrivate::sourceFrames(const QSize &size,
+                                                      AkVideoCaps::PixelFormat format)
+{
+    if (!AkVideoPacket::canConvert(AkVideoCaps::Format_argb, format))
+        return {};
+
+    AkVideoCaps caps(AkVideoCaps::Format_argb, size, {30, 1});
+    AkVideoPacket defaultPacket(caps);
+    defaultPacket.timeBase() = {1, 30};
+    defaultPacket.index() = 0;
+    QVector<AkVideoPacket> frames;
+
+    // A moving gradient with some fixed seed noise on top, so the frames are
+    // the same on every run.
+    for (int i = 0; i < N_SOURCE_FRAMES; i++) {
+        QImage image(size, QImage::Format_ARGB32);
+        quint32 seed = 1;
+
+        for (int y = 0; y < image.height(); y++) {
+            auto line = reinterpret_cast<QRgb *>(image.scanLine(y));
+
+            for (int x = 0; x < image.width(); x++) {
+                seed = 1664525 * seed + 1013904223;
+                int noise = int(seed >> 27);
+                int r = (255 * x / qMax(image.width(), 1) + 8 * i) & 0xff;
+                int g = (255 * y / qMax(image.height(), 1) + 4 * i) & 0xff;
+                int b = ((x + y) / 4 + 16 * i) & 0xff;
+                line[x] = qRgb(qMin(r + noise, 255),
+                               qMin(g + noise, 255),
+                               qMin(b + noise, 255));
+            }
+        }
+
+        auto frame = AkVideoPacket::fromImage(image, defaultPacket);
+
+        if (format != AkVideoCaps::Format_argb)
+            frame = frame.convert(format);
+
+        if (!frame)
+            return {};
+
+        frames << frame;
+    }
+
+    return frames;
+}
+
+qint64 BenchmarkPrivate::peakRss()
+{
+#ifdef Q_OS_UNIX
+    struct rusage usage;
+
+    if (getrusage(RUSAGE_SELF, &usage) == 0)
+#ifdef Q_OS_OSX
+        return usage.ru_maxrss / 1024;
+#else
+        return usage.ru_maxrss;
+#endif
+#endif
+
+    return 0;
+}
+
+#include "moc_benchmark.cpp"
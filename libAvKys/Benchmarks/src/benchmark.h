@@ -0,0 +1,59 @@
+/* Webcamoid, webcam capture application.
+ * Copyright (C) 2020  Gonzalo Exequiel Pedone
+ *
+ * Webcamoid is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Webcamoid is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Webcamoid. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Web-Site: http://webcamoid.github.io/
+ */
+
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <QObject>
+#include <QSize>
+#include <QVariant>
+#include <akvideocaps.h>
+
+class BenchmarkPrivate;
+
+class Benchmark: public QObject
+{
+    Q_OBJECT
+
+    public:
+        Benchmark(QObject *parent=nullptr);
+        ~Benchmark();
+
+        Q_INVOKABLE QStringList plugins() const;
+        Q_INVOKABLE QList<QSize> sizes() const;
+        Q_INVOKABLE AkVideoCaps::PixelFormatList formats() const;
+        Q_INVOKABLE int frames() const;
+        Q_INVOKABLE int warmupFrames() const;
+        Q_INVOKABLE QVariantMap run(const QString &plugin,
+                                    const QSize &size,
+                                    AkVideoCaps::PixelFormat format) const;
+        Q_INVOKABLE QVariantList runAll() const;
+
+    private:
+        BenchmarkPrivate *d;
+
+    public slots:
+        void setPlugins(const QStringList &plugins);
+        void setSizes(const QList<QSize> &sizes);
+        void setFormats(const AkVideoCaps::PixelFormatList &formats);
+        void setFrames(int frames);
+        void setWarmupFrames(int warmupFrames);
+};
+
+#endif // BENCHMARK_H
@@ -0,0 +1,143 @@
+/* Webcamoid, webcam capture application.
+ * Copyright (C) 2020  Gonzalo Exequiel Pedone
+ *
+ * Webcamoid is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Webcamoid is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Webcamoid. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Web-Site: http://webcamoid.github.io/
+ */
+
+#include <QCommandLineParser>
+#include <QDebug>
+#include <QFile>
+#include <QGuiApplication>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <akelement.h>
+
+#include "benchmark.h"
+
+int main(int argc, char *argv[])
+{
+    // Run without a display by default.
+    if (qgetenv("QT_QPA_PLATFORM").isEmpty())
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+
+    QGuiApplication app(argc, argv);
+    QGuiApplication::setApplicationName("benchmarks");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Measure the performance of the video "
+                                     "filters.");
+    parser.addHelpOption();
+    QCommandLineOption pluginsPathOpt({"p", "plugins-path"},
+                                      "Search plugins in PATH.",
+                                      "PATH",
+                                      BENCHMARKS_PLUGINS_PATH);
+    parser.addOption(pluginsPathOpt);
+    QCommandLineOption pluginsOpt({"e", "plugins"},
+                                  "Comma separated list of plugins to test, "
+                                  "all video filters by default.",
+                                  "PLUGINS");
+    parser.addOption(pluginsOpt);
+    QCommandLineOption sizesOpt({"s", "sizes"},
+                                "Comma separated list of frame sizes "
+                                "(WIDTHxHEIGHT).",
+                                "SIZES");
+    parser.addOption(sizesOpt);
+    QCommandLineOption formatsOpt({"f", "formats"},
+                                  "Comma separated list of pixel formats.",
+                                  "FORMATS");
+    parser.addOption(formatsOpt);
+    QCommandLineOption framesOpt({"n", "frames"},
+                                 "Number of measured frames.",
+                                 "FRAMES");
+    parser.addOption(framesOpt);
+    QCommandLineOption warmupOpt({"w", "warmup"},
+                                 "Number of frames to process before "
+                                 "measuring.",
+                                 "FRAMES");
+    parser.addOption(warmupOpt);
+    QCommandLineOption outputOpt({"o", "output"},
+                                 "Write the results to FILE instead of the "
+                                 "standard output.",
+                                 "FILE");
+    parser.addOption(outputOpt);
+    parser.process(app);
+
+    AkElement::setRecursiveSearch(true);
+    AkElement::setSearchPaths({parser.value(pluginsPathOpt)});
+
+    Benchmark benchmark;
+
+    if (parser.isSet(pluginsOpt)) {
+        auto plugins = parser.value(pluginsOpt).split(',');
+        plugins.removeAll({});
+        benchmark.setPlugins(plugins);
+    }
+
+    if (parser.isSet(sizesOpt)) {
+        QList<QSize> sizes;
+
+        for (auto &size: parser.value(sizesOpt).split(',')) {
+            auto dimensions = size.split('x');
+
+            if (dimensions.size() == 2)
+                sizes << QSize(dimensions[0].toInt(), dimensions[1].toInt());
+        }
+
+        benchmark.setSizes(sizes);
+    }
+
+    if (parser.isSet(formatsOpt)) {
+        AkVideoCaps::PixelFormatList formats;
+
+        for (auto &format: parser.value(formatsOpt).split(','))
+            if (!format.trimmed().isEmpty())
+                formats << AkVideoCaps::pixelFormatFromString(format.trimmed());
+
+        benchmark.setFormats(formats);
+    }
+
+    if (parser.isSet(framesOpt))
+        benchmark.setFrames(parser.value(framesOpt).toInt());
+
+    if (parser.isSet(warmupOpt))
+        benchmark.setWarmupFrames(parser.value(warmupOpt).toInt());
+
+    QJsonObject report {
+        {"frames"      , benchmark.frames()                              },
+        {"warmupFrames", benchmark.warmupFrames()                        },
+        {"results"     , QJsonArray::fromVariantList(benchmark.runAll())},
+    };
+    auto json = QJsonDocument(report).toJson();
+
+    if (parser.isSet(outputOpt)) {
+        QFile file(parser.value(outputOpt));
+
+        if (!file.open(QIODevice::WriteOnly)) {
+            qCritical() << "Can't open" << file.fileName();
+
+            return -1;
+        }
+
+        file.write(json);
+    } else {
+        QFile file;
+        file.open(stdout, QIODevice::WriteOnly);
+        file.write(json);
+    }
+
+    return 0;
+}
@@ -43,11 +43,16 @@ DEFINES += \
 HEADERS = \
     src/ak.h \
     src/akaudiocaps.h \
+    src/akaudiofifo.h \
     src/akaudiopacket.h \
+    src/akaudioresampler.h \
+    src/akblocktransform.h \
     src/akcaps.h \
     src/akcommons.h \
     src/akelement.h \
     src/akfrac.h \
+    src/akframeutils.h \
+    src/akhistogramelement.h \
     src/akmultimediasourceelement.h \
     src/akpacket.h \
     src/akplugin.h \
@@ -59,15 +64,20 @@ HEADERS = \
     src/qml/akpalettegroup.h \
     src/qml/aktheme.h
 
-QT += gui qml quick widgets
+QT += concurrent gui qml quick widgets
 
 SOURCES = \
     src/ak.cpp \
     src/akaudiocaps.cpp \
+    src/akaudiofifo.cpp \
     src/akaudiopacket.cpp \
+    src/akaudioresampler.cpp \
+    src/akblocktransform.cpp \
     src/akcaps.cpp \
     src/akelement.cpp \
     src/akfrac.cpp \
+    src/akframeutils.cpp \
+    src/akhistogramelement.cpp \
     src/akmultimediasourceelement.cpp \
     src/akpacket.cpp \
     src/akunit.cpp \
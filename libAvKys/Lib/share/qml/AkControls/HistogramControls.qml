@@ -0,0 +1,110 @@
+/* Webcamoid, webcam capture application.
+ * Copyright (C) 2020  Gonzalo Exequiel Pedone
+ *
+ * Webcamoid is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Webcamoid is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Webcamoid. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Web-Site: http://webcamoid.github.io/
+ */
+
+import QtQuick 2.12
+import QtQuick.Controls 2.5
+import QtQuick.Layouts 1.3
+
+GridLayout {
+    columns: 3
+
+    property QtObject element: null
+
+    Connections {
+        target: element
+
+        onDecimationChanged: spbDecimation.value = decimation
+        onUpdateIntervalChanged: spbUpdateInterval.value = updateInterval
+
+        onSmoothingChanged: {
+            sldSmoothing.value = smoothing
+            spbSmoothing.value = spbSmoothing.multiplier * smoothing
+        }
+    }
+
+    Label {
+        id: lblDecimation
+        text: qsTr("Sampling step")
+    }
+    SpinBox {
+        id: spbDecimation
+        value: element.decimation
+        from: 1
+        to: 32
+        stepSize: 1
+        editable: true
+        Layout.columnSpan: 2
+        Layout.fillWidth: true
+
+        onValueModified: element.decimation = value
+    }
+
+    Label {
+        id: lblUpdateInterval
+        text: qsTr("Update interval")
+    }
+    SpinBox {
+        id: spbUpdateInterval
+        value: element.updateInterval
+        from: 1
+        to: 300
+        stepSize: 1
+        editable: true
+        Layout.columnSpan: 2
+        Layout.fillWidth: true
+
+        onValueModified: element.updateInterval = value
+    }
+
+    Label {
+        id: lblSmoothing
+        text: qsTr("Smoothing")
+    }
+    Slider {
+        id: sldSmoothing
+        value: element.smoothing
+        stepSize: 0.01
+        to: 0.99
+        Layout.fillWidth: true
+
+        onValueChanged: element.smoothing = value
+    }
+    SpinBox {
+        id: spbSmoothing
+        value: multiplier * element.smoothing
+        to: multiplier * sldSmoothing.to
+        stepSize: multiplier * sldSmoothing.stepSize
+        editable: true
+
+        readonly property int decimals: 2
+        readonly property int multiplier: Math.pow(10, decimals)
+
+        validator: DoubleValidator {
+            bottom: Math.min(spbSmoothing.from, spbSmoothing.to)
+            top:  Math.max(spbSmoothing.from, spbSmoothing.to)
+        }
+        textFromValue: function(value, locale) {
+            return Number(value / multiplier).toLocaleString(locale, 'f', decimals)
+        }
+        valueFromText: function(text, locale) {
+            return Number.fromLocaleString(locale, text) * multiplier
+        }
+        onValueModified: element.smoothing = value / multiplier
+    }
+}
@@ -0,0 +1,355 @@
+/* Webcamoid, webcam capture application.
+ * Copyright (C) 2020  Gonzalo Exequiel Pedone
+ *
+ * Webcamoid is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Webcamoid is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Webcamoid. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Web-Site: http://webcamoid.github.io/
+ */
+
+#include <QVector>
+
+#include "akaudiofifo.h"
+#include "akaudiocaps.h"
+#include "akaudiopacket.h"
+#include "akfrac.h"
+
+class AkAudioFifoPrivate
+{
+    public:
+        AkAudioCaps m_caps;
+        QVector<QByteArray> m_planes;
+        qint64 m_pts {-1};
+        qint64 m_id {-1};
+        int m_index {-1};
+        int m_sampleSize {0};
+        int m_capacity {0};
+        int m_readPos {0};
+        int m_samples {0};
+
+        // Number of samples and flags of the queued packets, consecutive
+        // packets with the same flags are merged.
+        QList<QPair<int, int>> m_flags;
+
+        void updatePlanes();
+        int write(const quint8 *const *data, int samples, int flags);
+        void pushFlags(int samples, int flags);
+        int flags(int samples) const;
+        void popFlags(int samples);
+        void grow(int samples);
+        void copyIn(const quint8 *const *data, int samples);
+        void copyOut(quint8 *const *data, int samples) const;
+};
+
+AkAudioFifo::AkAudioFifo()
+{
+    this->d = new AkAudioFifoPrivate();
+}
+
+AkAudioFifo::AkAudioFifo(const AkAudioCaps &caps, int samples)
+{
+    this->d = new AkAudioFifoPrivate();
+    this->d->m_caps = caps;
+    this->d->updatePlanes();
+    this->reserve(samples);
+}
+
+AkAudioFifo::~AkAudioFifo()
+{
+    delete this->d;
+}
+
+AkAudioCaps AkAudioFifo::caps() const
+{
+    return this->d->m_caps;
+}
+
+int AkAudioFifo::samples() const
+{
+    return this->d->m_samples;
+}
+
+int AkAudioFifo::capacity() const
+{
+    return this->d->m_capacity;
+}
+
+qint64 AkAudioFifo::pts() const
+{
+    return this->d->m_pts;
+}
+
+void AkAudioFifo::setCaps(const AkAudioCaps &caps)
+{
+    this->d->m_caps = caps;
+    this->d->m_planes.clear();
+    this->d->m_capacity = 0;
+    this->d->updatePlanes();
+    this->clear();
+}
+
+void AkAudioFifo::reserve(int samples)
+{
+    if (samples > this->d->m_capacity)
+        this->d->grow(samples);
+}
+
+void AkAudioFifo::clear()
+{
+    this->d->m_readPos = 0;
+    this->d->m_samples = 0;
+    this->d->m_pts = -1;
+    this->d->m_flags.clear();
+}
+
+bool AkAudioFifo::write(const AkAudioPacket &packet)
+{
+    if (!packet || this->d->m_sampleSize < 1)
+        return false;
+
+    if (packet.caps().rate() != this->d->m_caps.rate())
+        return false;
+
+    auto iPacket = packet;
+
+    if (packet.caps().format() != this->d->m_caps.format()
+        || packet.caps().layout() != this->d->m_caps.layout()
+        || packet.caps().planar() != this->d->m_caps.planar()) {
+        iPacket = packet.convert(this->d->m_caps);
+
+        if (!iPacket)
+            return false;
+    }
+
+    int planes = this->d->m_planes.size();
+    QVector<const quint8 *> data(planes);
+
+    for (int plane = 0; plane < planes; plane++)
+        data[plane] = iPacket.constPlaneData(plane);
+
+    if (this->d->m_samples < 1)
+        this->d->m_pts = qRound64(qreal(packet.pts())
+                                  * packet.timeBase().value()
+                                  * this->d->m_caps.rate());
+
+    this->d->m_id = packet.id();
+    this->d->m_index = packet.index();
+    this->d->write(data.constData(),
+                   iPacket.caps().samples(),
+                   packet.flags());
+
+    return true;
+}
+
+int AkAudioFifo::write(const quint8 *const *data, int samples)
+{
+    return this->d->write(data, samples, AkAudioPacket::PacketFlag_None);
+}
+
+AkAudioPacket AkAudioFifo::read(int samples)
+{
+    samples = qMin(samples, this->d->m_samples);
+
+    if (samples < 1)
+        return {};
+
+    auto caps = this->d->m_caps;
+    caps.setSamples(samples);
+    AkAudioPacket packet(caps);
+    packet.setPts(this->d->m_pts);
+    packet.setTimeBase({1, caps.rate()});
+    packet.setId(this->d->m_id);
+    packet.setIndex(this->d->m_index);
+    packet.setFlags(this->d->flags(samples));
+
+    int planes = this->d->m_planes.size();
+    QVector<quint8 *> data(planes);
+
+    for (int plane = 0; plane < planes; plane++)
+        data[plane] = packet.planeData(plane);
+
+    this->read(data.constData(), samples);
+
+    return packet;
+}
+
+int AkAudioFifo::read(quint8 *const *data, int samples)
+{
+    samples = qMin(samples, this->d->m_samples);
+
+    if (samples < 1)
+        return 0;
+
+    this->d->copyOut(data, samples);
+
+    return this->skip(samples);
+}
+
+int AkAudioFifo::skip(int samples)
+{
+    samples = qMin(samples, this->d->m_samples);
+
+    if (samples < 1)
+        return 0;
+
+    this->d->m_readPos = (this->d->m_readPos + samples) % this->d->m_capacity;
+    this->d->m_samples -= samples;
+    this->d->popFlags(samples);
+
+    if (this->d->m_pts >= 0)
+        this->d->m_pts += samples;
+
+    // Restart from the beginning of the buffers when empty, so the next
+    // reads and writes are done in a single copy.
+    if (this->d->m_samples < 1)
+        this->d->m_readPos = 0;
+
+    return samples;
+}
+
+void AkAudioFifoPrivate::updatePlanes()
+{
+    int channels = this->m_caps.channels();
+    int bps = this->m_caps.bps();
+
+    if (channels < 1 || bps < 1) {
+        this->m_sampleSize = 0;
+
+        return;
+    }
+
+    if (this->m_caps.planar()) {
+        this->m_planes.resize(channels);
+        this->m_sampleSize = bps / 8;
+    } else {
+        this->m_planes.resize(1);
+        this->m_sampleSize = channels * bps / 8;
+    }
+}
+
+int AkAudioFifoPrivate::write(const quint8 *const *data,
+                              int samples,
+                              int flags)
+{
+    if (samples < 1 || this->m_sampleSize < 1)
+        return 0;
+
+    if (this->m_samples + samples > this->m_capacity)
+        this->grow(this->m_samples + samples);
+
+    this->copyIn(data, samples);
+    this->m_samples += samples;
+    this->pushFlags(samples, flags);
+
+    return samples;
+}
+
+void AkAudioFifoPrivate::pushFlags(int samples, int flags)
+{
+    if (!this->m_flags.isEmpty() && this->m_flags.last().second == flags)
+        this->m_flags.last().first += samples;
+    else
+        this->m_flags << qMakePair(samples, flags);
+}
+
+int AkAudioFifoPrivate::flags(int samples) const
+{
+    // A flag is kept only if all the packets read have it, f.e. a packet is
+    // silent only if all of it's samples are silent.
+    int flags = ~0;
+
+    for (auto &packetFlags: this->m_flags) {
+        if (samples < 1)
+            break;
+
+        flags &= packetFlags.second;
+        samples -= packetFlags.first;
+    }
+
+    return flags == ~0? AkAudioPacket::PacketFlag_None: flags;
+}
+
+void AkAudioFifoPrivate::popFlags(int samples)
+{
+    while (samples > 0 && !this->m_flags.isEmpty()) {
+        auto &packetFlags = this->m_flags.first();
+
+        if (packetFlags.first > samples) {
+            packetFlags.first -= samples;
+
+            break;
+        }
+
+        samples -= packetFlags.first;
+        this->m_flags.removeFirst();
+    }
+}
+
+void AkAudioFifoPrivate::grow(int samples)
+{
+    int capacity = qMax(this->m_capacity, 1024);
+
+    while (capacity < samples)
+        capacity *= 2;
+
+    // Unwrap the queued samples at the start of the new buffers.
+    for (auto &plane: this->m_planes) {
+        QByteArray buffer(capacity * this->m_sampleSize, Qt::Uninitialized);
+
+        if (this->m_samples > 0) {
+            int first = qMin(this->m_samples, this->m_capacity - this->m_readPos);
+            memcpy(buffer.data(),
+                   plane.constData() + this->m_readPos * this->m_sampleSize,
+                   size_t(first * this->m_sampleSize));
+            memcpy(buffer.data() + first * this->m_sampleSize,
+                   plane.constData(),
+                   size_t((this->m_samples - first) * this->m_sampleSize));
+        }
+
+        plane = buffer;
+    }
+
+    this->m_capacity = capacity;
+    this->m_readPos = 0;
+}
+
+void AkAudioFifoPrivate::copyIn(const quint8 *const *data, int samples)
+{
+    int writePos = (this->m_readPos + this->m_samples) % this->m_capacity;
+    int first = qMin(samples, this->m_capacity - writePos);
+
+    for (int plane = 0; plane < this->m_planes.size(); plane++) {
+        auto buffer = this->m_planes[plane].data();
+        memcpy(buffer + writePos * this->m_sampleSize,
+               data[plane],
+               size_t(first * this->m_sampleSize));
+        memcpy(buffer,
+               data[plane] + first * this->m_sampleSize,
+               size_t((samples - first) * this->m_sampleSize));
+    }
+}
+
+void AkAudioFifoPrivate::copyOut(quint8 *const *data, int samples) const
+{
+    int first = qMin(samples, this->m_capacity - this->m_readPos);
+
+    for (int plane = 0; plane < this->m_planes.size(); plane++) {
+        auto buffer = this->m_planes[plane].constData();
+        memcpy(data[plane],
+               buffer + this->m_readPos * this->m_sampleSize,
+               size_t(first * this->m_sampleSize));
+        memcpy(data[plane] + first * this->m_sampleSize,
+               buffer,
+               size_t((samples - first) * this->m_sampleSize));
+    }
+}
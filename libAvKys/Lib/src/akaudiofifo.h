@@ -0,0 +1,85 @@
+/* Webcamoid, webcam capture application.
+ * Copyright (C) 2020  Gonzalo Exequiel Pedone
+ *
+ * Webcamoid is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Webcamoid is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Webcamoid. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Web-Site: http://webcamoid.github.io/
+ */
+
+#ifndef AKAUDIOFIFO_H
+#define AKAUDIOFIFO_H
+
+#include "akcommons.h"
+
+class AkAudioFifoPrivate;
+class AkAudioCaps;
+class AkAudioPacket;
+
+/// Audio samples queue.
+///
+/// The samples are stored in a ring buffer per plane that only grows when
+/// needed, so appending and removing samples does not reallocate nor moves
+/// the queued samples.
+class AKCOMMONS_EXPORT AkAudioFifo
+{
+    public:
+        AkAudioFifo();
+        AkAudioFifo(const AkAudioCaps &caps, int samples=0);
+        ~AkAudioFifo();
+
+        AkAudioCaps caps() const;
+
+        // Number of samples per channel queued.
+        int samples() const;
+
+        // Number of samples per channel that can be queued without growing
+        // the buffers.
+        int capacity() const;
+
+        // Time stamp of the first queued sample, in 1 / rate units, or -1 if
+        // it's unknown.
+        qint64 pts() const;
+
+        // Set the format of the stored samples and clear the queue.
+        void setCaps(const AkAudioCaps &caps);
+
+        void reserve(int samples);
+        void clear();
+
+        // Append the samples of the packet. The packet is converted to the
+        // queue format and layout if required, but not resampled.
+        bool write(const AkAudioPacket &packet);
+
+        // Append samples from raw buffers, one per plane.
+        int write(const quint8 *const *data, int samples);
+
+        // Remove up to samples from the queue and return them in a packet.
+        // The packet only keeps the flags set in all the packets the samples
+        // came from.
+        AkAudioPacket read(int samples);
+
+        // Remove up to samples from the queue and copy them to raw buffers,
+        // one per plane. Returns the number of samples copied.
+        int read(quint8 *const *data, int samples);
+
+        // Discard up to samples from the queue.
+        int skip(int samples);
+
+    private:
+        AkAudioFifoPrivate *d;
+
+        Q_DISABLE_COPY(AkAudioFifo)
+};
+
+#endif // AKAUDIOFIFO_H
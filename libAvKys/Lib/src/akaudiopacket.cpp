@@ -19,7 +19,9 @@
 
 #include <QDebug>
 #include <QGenericMatrix>
+#include <QMap>
 #include <QMetaEnum>
+#include <QMutex>
 #include <QVariant>
 #include <QtEndian>
 #include <QtMath>
@@ -42,6 +44,7 @@ class AkAudioPacketPrivate
         AkFrac m_timeBase;
         qint64 m_id {-1};
         int m_index {-1};
+        int m_flags {0};
 
         template<typename InputType, typename OutputType, typename OpType>
         inline static OutputType scaleValue(InputType value)
@@ -86,20 +89,6 @@ class AkAudioPacketPrivate
                               / (OpType(xmax) - OpType(xmin)));
         }
 
-        template<typename InputType, typename OutputType, typename OpType>
-        inline static OutputType scaleValue(InputType value,
-                                            InputType xmin,
-                                            InputType xmax,
-                                            OutputType ymin,
-                                            OutputType ymax)
-        {
-            return OutputType((OpType(value - xmin)
-                               * (OpType(ymax) - OpType(ymin))
-                               + OpType(ymin)
-                               * (OpType(xmax) - OpType(xmin)))
-                              / (OpType(xmax) - OpType(xmin)));
-        }
-
         template<typename T>
         inline static T from_(T value) {
             return value;
@@ -221,148 +210,127 @@ class AkAudioPacketPrivate
             return convert;
         }
 
-        template<typename SampleType,
-                 typename SumType,
-                 typename TransformFuncType>
-        inline static AkAudioPacket mixChannels(AkAudioCaps::SampleFormat sumFormat,
-                                                AkAudioCaps::ChannelLayout outputLayout,
-                                                const AkAudioPacket &src,
-                                                TransformFuncType transformFrom,
-                                                TransformFuncType transformTo)
+        // Mixing coefficients of each input channel for each output channel,
+        // stored by rows. We use inverse square law to sum the samples
+        // according to the speaker position in the sound dome.
+        //
+        // http://digitalsoundandmusic.com/4-3-4-the-mathematics-of-the-inverse-square-law-and-pag-equations/
+        //
+        // Each row is normalized so the output can't exceed the input range.
+        inline static QVector<float> mixMatrix(AkAudioCaps::ChannelLayout inputLayout,
+                                               AkAudioCaps::ChannelLayout outputLayout)
         {
-            // Create a summatory packet which type is big enough to contain
-            // the sum of all values.
-            auto caps = src.caps();
-            caps.setFormat(sumFormat);
-            caps.setLayout(outputLayout);
-            AkAudioPacket sumPacket(caps);
-            sumPacket.buffer().fill(0);
-
-            // Create output packet.
-            caps = src.caps();
-            caps.setLayout(outputLayout);
-            AkAudioPacket dst(caps);
-            dst.copyMetadata(src);
-
-            for (int ochannel = 0; ochannel < sumPacket.caps().channels(); ochannel++) {
-                auto oposition = sumPacket.caps().position(ochannel);
-
-                // Wave limits
-                auto xmin = std::numeric_limits<SumType>::max();
-                auto xmax = std::numeric_limits<SumType>::min();
-                auto ymin = std::numeric_limits<SampleType>::max();
-                auto ymax = std::numeric_limits<SampleType>::min();
-
-                for (int ichannel = 0; ichannel < src.caps().channels(); ichannel++) {
-                    /* We use inverse square law to sum the samples
-                     * according to the speaker position in the sound dome.
-                     *
-                     * http://digitalsoundandmusic.com/4-3-4-the-mathematics-of-the-inverse-square-law-and-pag-equations/
-                     */
-                    auto iposition = src.caps().position(ichannel);
+            static QMap<QPair<int, int>, QVector<float>> matrices;
+            static QMutex mutex;
+            QPair<int, int> key(inputLayout, outputLayout);
+            QMutexLocker mutexLocker(&mutex);
+            auto it = matrices.constFind(key);
+
+            if (it != matrices.constEnd())
+                return it.value();
+
+            auto iPositions = AkAudioCaps::positions(inputLayout);
+            auto oPositions = AkAudioCaps::positions(outputLayout);
+            QVector<float> matrix(iPositions.size() * oPositions.size(), 0.0f);
+
+            for (int ochannel = 0; ochannel < oPositions.size(); ochannel++) {
+                auto oposition = AkAudioCaps::position(oPositions[ochannel]);
+                auto row = matrix.data() + ochannel * iPositions.size();
+                qreal sum = 0.0;
+
+                for (int ichannel = 0; ichannel < iPositions.size(); ichannel++) {
+                    auto iposition = AkAudioCaps::position(iPositions[ichannel]);
                     auto d = 1.0 + (oposition - iposition);
-                    auto k = d * d;
-
-                    for (int sample = 0; sample < sumPacket.caps().samples(); sample++) {
-                        auto inSample =
-                                reinterpret_cast<const SampleType *>(src.constSample(ichannel,
-                                                                                     sample));
-                        auto outSample =
-                                reinterpret_cast<SumType *>(sumPacket.sample(ochannel,
-                                                                             sample));
-                        auto isample = SumType(qreal(transformFrom(*inSample)) / k);
-                        *outSample += isample;
-
-                        // Calculate minimum and maximum values of the wave.
-                        if (ichannel == src.caps().channels() - 1) {
-                            xmin = qMin(xmin, *outSample);
-                            xmax = qMax(xmax, *outSample);
-                        }
-
-                        ymin = qMin(ymin, *inSample);
-                        ymax = qMax(ymax, *inSample);
-                    }
+                    auto k = 1.0 / (d * d);
+                    row[ichannel] = float(k);
+                    sum += k;
                 }
 
-                // Recreate frame with the wave scaled to fit it.
-                for (int sample = 0; sample < dst.caps().samples(); sample++) {
-                    auto idata =
-                            reinterpret_cast<const SumType *>(sumPacket.constSample(ochannel,
-                                                                                    sample));
-                    auto odata =
-                            reinterpret_cast<SampleType *>(dst.sample(ochannel,
-                                                                      sample));
-
-                    *odata = transformTo(scaleValue<SumType,
-                                                    SampleType,
-                                                    SumType>(*idata,
-                                                             xmin,
-                                                             xmax,
-                                                             ymin,
-                                                             ymax));
-                }
+                if (sum > 0.0)
+                    for (int ichannel = 0; ichannel < iPositions.size(); ichannel++)
+                        row[ichannel] = float(row[ichannel] / sum);
             }
 
-            return dst;
-        }
+            matrices[key] = matrix;
 
-#define HANDLE_CASE_CONVERT_LAYOUT(olayout, \
-                                   src, \
-                                   format, \
-                                   sumFormat, \
-                                   sampleType, \
-                                   sumType, \
-                                   endian) \
-        case AkAudioCaps::SampleFormat_##format: \
-            return mixChannels<sampleType, sumType> \
-                    (AkAudioCaps::SampleFormat_##sumFormat, \
-                     olayout, \
-                     src, \
-                     from##endian<sampleType>, \
-                     to##endian<sampleType>);
+            return matrix;
+        }
 
+        // The samples are mixed in float and quantized once when converting
+        // back to the input format.
         inline static AkAudioPacket convertChannels(AkAudioCaps::ChannelLayout outputLayout,
                                                     const AkAudioPacket &src)
         {
-            switch (src.caps().format()) {
-            HANDLE_CASE_CONVERT_LAYOUT(outputLayout, src, s8   , dbl, qint8  , qreal,  _)
-            HANDLE_CASE_CONVERT_LAYOUT(outputLayout, src, u8   , dbl, quint8 , qreal,  _)
-            HANDLE_CASE_CONVERT_LAYOUT(outputLayout, src, s16le, dbl, qint16 , qreal, LE)
-            HANDLE_CASE_CONVERT_LAYOUT(outputLayout, src, s16be, dbl, qint16 , qreal, BE)
-            HANDLE_CASE_CONVERT_LAYOUT(outputLayout, src, u16le, dbl, quint16, qreal, LE)
-            HANDLE_CASE_CONVERT_LAYOUT(outputLayout, src, u16be, dbl, quint16, qreal, BE)
-            HANDLE_CASE_CONVERT_LAYOUT(outputLayout, src, s32le, dbl, qint32 , qreal, LE)
-            HANDLE_CASE_CONVERT_LAYOUT(outputLayout, src, s32be, dbl, qint32 , qreal, BE)
-            HANDLE_CASE_CONVERT_LAYOUT(outputLayout, src, u32le, dbl, quint32, qreal, LE)
-            HANDLE_CASE_CONVERT_LAYOUT(outputLayout, src, u32be, dbl, quint32, qreal, BE)
-            HANDLE_CASE_CONVERT_LAYOUT(outputLayout, src, s64le, dbl, qint64 , qreal, LE)
-            HANDLE_CASE_CONVERT_LAYOUT(outputLayout, src, s64be, dbl, qint64 , qreal, BE)
-            HANDLE_CASE_CONVERT_LAYOUT(outputLayout, src, u64le, dbl, quint64, qreal, LE)
-            HANDLE_CASE_CONVERT_LAYOUT(outputLayout, src, u64be, dbl, quint64, qreal, BE)
-            HANDLE_CASE_CONVERT_LAYOUT(outputLayout, src, fltle, dbl, float  , qreal, LE)
-            HANDLE_CASE_CONVERT_LAYOUT(outputLayout, src, fltbe, dbl, float  , qreal, BE)
-            HANDLE_CASE_CONVERT_LAYOUT(outputLayout, src, dblle, dbl, qreal  , qreal, LE)
-            HANDLE_CASE_CONVERT_LAYOUT(outputLayout, src, dblbe, dbl, qreal  , qreal, BE)
-            default:
+            auto matrix = mixMatrix(src.caps().layout(), outputLayout);
+
+            if (matrix.isEmpty())
+                return {};
+
+            auto format = src.caps().format();
+            auto fsrc = format == AkAudioCaps::SampleFormat_flt?
+                            src: src.convertFormat(AkAudioCaps::SampleFormat_flt);
+
+            if (!fsrc)
                 return {};
+
+            auto caps = fsrc.caps();
+            caps.setLayout(outputLayout);
+            AkAudioPacket dst(caps);
+            dst.copyMetadata(src);
+
+            int iChannels = fsrc.caps().channels();
+            int oChannels = dst.caps().channels();
+            int samples = dst.caps().samples();
+            bool planar = fsrc.caps().planar();
+            int iStep = planar? 1: iChannels;
+            int oStep = planar? 1: oChannels;
+
+            for (int ochannel = 0; ochannel < oChannels; ochannel++) {
+                auto out = planar?
+                               reinterpret_cast<float *>(dst.planeData(ochannel)):
+                               reinterpret_cast<float *>(dst.planeData(0)) + ochannel;
+                auto row = matrix.constData() + ochannel * iChannels;
+
+                for (int i = 0; i < samples; i++)
+                    out[i * oStep] = 0.0f;
+
+                for (int ichannel = 0; ichannel < iChannels; ichannel++) {
+                    auto k = row[ichannel];
+
+                    if (qFuzzyIsNull(k))
+                        continue;
+
+                    auto in = planar?
+                                  reinterpret_cast<const float *>(fsrc.constPlaneData(ichannel)):
+                                  reinterpret_cast<const float *>(fsrc.constPlaneData(0)) + ichannel;
+
+                    if (planar)
+                        for (int i = 0; i < samples; i++)
+                            out[i] += k * in[i];
+                    else
+                        for (int i = 0; i < samples; i++)
+                            out[i * oStep] += k * in[i * iStep];
+                }
             }
+
+            if (format == AkAudioCaps::SampleFormat_flt)
+                return dst;
+
+            return dst.convertFormat(format);
         }
 
         template<typename SampleType,
                  typename SumType,
                  typename TransformFuncType>
-        inline static SampleType interpolate(const AkAudioPacket &packet,
-                                             int channel,
+        inline static SampleType interpolate(const AkAudioSpan<const SampleType> &samples,
                                              qreal isample,
                                              int sample1,
                                              int sample2,
                                              TransformFuncType transformFrom,
                                              TransformFuncType transformTo)
         {
-            auto minValue = *reinterpret_cast<const SampleType *>(packet.constSample(channel, sample1));
-            auto maxValue = *reinterpret_cast<const SampleType *>(packet.constSample(channel, sample2));
-            minValue = transformFrom(minValue);
-            maxValue = transformFrom(maxValue);
+            auto minValue = transformFrom(samples[sample1]);
+            auto maxValue = transformFrom(samples[sample2]);
             auto value = (SumType(isample - sample1) * SumType(maxValue - minValue)
                           + SumType(minValue) * SumType(sample2 - sample1))
                          / (sample2 - sample1);
@@ -373,8 +341,7 @@ class AkAudioPacketPrivate
         template<typename SampleType,
                  typename SumType,
                  typename TransformFuncType>
-        inline static SampleType interpolate(const AkAudioPacket &packet,
-                                             int channel,
+        inline static SampleType interpolate(const AkAudioSpan<const SampleType> &samples,
                                              qreal isample,
                                              int sample1,
                                              int sample2,
@@ -382,12 +349,9 @@ class AkAudioPacketPrivate
                                              TransformFuncType transformFrom,
                                              TransformFuncType transformTo)
         {
-            auto minValue = *reinterpret_cast<const SampleType *>(packet.constSample(channel, sample1));
-            auto midValue = *reinterpret_cast<const SampleType *>(packet.constSample(channel, sample2));
-            auto maxValue = *reinterpret_cast<const SampleType *>(packet.constSample(channel, sample3));
-            minValue = transformFrom(minValue);
-            midValue = transformFrom(midValue);
-            maxValue = transformFrom(maxValue);
+            auto minValue = transformFrom(samples[sample1]);
+            auto midValue = transformFrom(samples[sample2]);
+            auto maxValue = transformFrom(samples[sample3]);
             auto sample21 = SumType(sample1);
             auto sample22 = SumType(sample2);
             auto sample23 = SumType(sample3);
@@ -419,106 +383,169 @@ class AkAudioPacketPrivate
             return transformTo(SampleType(value));
         }
 
-        using InterpolateLinearFunction =
-            std::function<void (const AkAudioPacket &packet,
-                                int channel,
-                                qreal isample,
-                                int sample1,
-                                int sample2,
-                                quint8 *osample)>;
-        using InterpolateQuadraticFunction =
-            std::function<void (const AkAudioPacket &packet,
-                                int channel,
-                                qreal isample,
-                                int sample1,
-                                int sample2,
-                                int sample3,
-                                quint8 *osample)>;
-
-#define DEFINE_SAMPLE_INTERPOLATION_FUNCTION(sitype, \
-                                             itype, \
-                                             optype, \
-                                             endian) \
+        template<typename SampleType,
+                 typename SumType,
+                 typename TransformFuncType>
+        inline static void scaleSamples(const AkAudioPacket &src,
+                                        AkAudioPacket &dst,
+                                        AkAudioPacket::ResampleMethod method,
+                                        TransformFuncType transformFrom,
+                                        TransformFuncType transformTo)
+        {
+            auto iSamples = src.caps().samples();
+            auto oSamples = dst.caps().samples();
+            auto lastSample = iSamples - 1;
+            auto k = oSamples > 1? qreal(lastSample) / (oSamples - 1): 0.0;
+
+            for (int channel = 0; channel < dst.caps().channels(); channel++) {
+                auto in = src.constPlaneSpan<SampleType>(channel);
+                auto out = dst.planeSpan<SampleType>(channel);
+
+                if (method == AkAudioPacket::ResampleMethod_Fast) {
+                    for (int sample = 0; sample < oSamples; sample++) {
+                        auto iSample = oSamples > 1?
+                                           qint64(sample) * lastSample / (oSamples - 1):
+                                           0;
+                        out[sample] = in[int(iSample)];
+                    }
+
+                    continue;
+                }
+
+                for (int sample = 0; sample < oSamples; sample++) {
+                    auto iSample = k * sample;
+                    auto minSample = qFloor(iSample);
+                    auto maxSample = qCeil(iSample);
+
+                    if (minSample == maxSample) {
+                        out[sample] = in[minSample];
+
+                        continue;
+                    }
+
+                    if (method == AkAudioPacket::ResampleMethod_Linear) {
+                        out[sample] =
+                                interpolate<SampleType, SumType>(in,
+                                                                 iSample,
+                                                                 minSample,
+                                                                 maxSample,
+                                                                 transformFrom,
+                                                                 transformTo);
+
+                        continue;
+                    }
+
+                    auto diffMinSample = minSample - iSample;
+                    auto diffMaxSample = maxSample - iSample;
+                    diffMinSample *= diffMinSample;
+                    diffMaxSample *= diffMaxSample;
+                    auto midSample = diffMinSample < diffMaxSample?
+                                         qMax(minSample - 1, 0):
+                                         qMin(maxSample + 1, lastSample);
+
+                    if (midSample < minSample)
+                        std::swap(midSample, minSample);
+
+                    if (midSample > maxSample)
+                        std::swap(midSample, maxSample);
+
+                    if (midSample == minSample || midSample == maxSample)
+                        out[sample] =
+                                interpolate<SampleType, SumType>(in,
+                                                                 iSample,
+                                                                 minSample,
+                                                                 maxSample,
+                                                                 transformFrom,
+                                                                 transformTo);
+                    else
+                        out[sample] =
+                                interpolate<SampleType, SumType>(in,
+                                                                 iSample,
+                                                                 minSample,
+                                                                 midSample,
+                                                                 maxSample,
+                                                                 transformFrom,
+                                                                 transformTo);
+                }
+            }
+        }
+
+        using ScaleSamplesFunction =
+            std::function<void (const AkAudioPacket &src,
+                                AkAudioPacket &dst,
+                                AkAudioPacket::ResampleMethod method)>;
+
+#define DEFINE_SAMPLE_SCALE_FUNCTION(sitype, \
+                                     itype, \
+                                     optype, \
+                                     endian) \
         {AkAudioCaps::SampleFormat_##sitype, \
-         [] (const AkAudioPacket &packet, \
-             int channel, \
-             int isample, \
-             int sample1, \
-             int sample2, \
-             quint8 *osample) { \
-            auto value = \
-                interpolate<itype, optype> \
-                    (packet, \
-                     channel, \
-                     isample, \
-                     sample1, \
-                     sample2, \
-                     from##endian<itype>, \
-                     to##endian<itype>); \
-            memcpy(osample, &value, sizeof(itype)); \
-         }, \
-         [] (const AkAudioPacket &packet, \
-             int channel, \
-             int isample, \
-             int sample1, \
-             int sample2, \
-             int sample3, \
-             quint8 *osample) { \
-            auto value = \
-                interpolate<itype, optype> \
-                    (packet, \
-                     channel, \
-                     isample, \
-                     sample1, \
-                     sample2, \
-                     sample3, \
-                     from##endian<itype>, \
-                     to##endian<itype>); \
-            memcpy(osample, &value, sizeof(itype)); \
+         [] (const AkAudioPacket &src, \
+             AkAudioPacket &dst, \
+             AkAudioPacket::ResampleMethod method) { \
+            scaleSamples<itype, optype>(src, \
+                                        dst, \
+                                        method, \
+                                        from##endian<itype>, \
+                                        to##endian<itype>); \
          }}
 
-        struct AudioSamplesInterpolation
+        struct AudioSamplesScale
         {
             AkAudioCaps::SampleFormat format;
-            InterpolateLinearFunction linear;
-            InterpolateQuadraticFunction quadratic;
+            ScaleSamplesFunction scale;
         };
 
-        using AudioSamplesInterpolationFuncs = QVector<AudioSamplesInterpolation>;
+        using AudioSamplesScaleFuncs = QVector<AudioSamplesScale>;
 
-        inline static const AudioSamplesInterpolationFuncs &samplesInterpolation()
+        inline static const AudioSamplesScaleFuncs &samplesScale()
         {
-            static const AudioSamplesInterpolationFuncs interpolation {
-                DEFINE_SAMPLE_INTERPOLATION_FUNCTION(s8   ,   qint8, qint64,  _),
-                DEFINE_SAMPLE_INTERPOLATION_FUNCTION(u8   ,  quint8, qint64,  _),
-                DEFINE_SAMPLE_INTERPOLATION_FUNCTION(s16le,  qint16, qint64, LE),
-                DEFINE_SAMPLE_INTERPOLATION_FUNCTION(s16be,  qint16, qint64, BE),
-                DEFINE_SAMPLE_INTERPOLATION_FUNCTION(u16le, quint16, qint64, LE),
-                DEFINE_SAMPLE_INTERPOLATION_FUNCTION(u16be, quint16, qint64, BE),
-                DEFINE_SAMPLE_INTERPOLATION_FUNCTION(s32le,  qint32, qint64, LE),
-                DEFINE_SAMPLE_INTERPOLATION_FUNCTION(s32be,  qint32, qint64, BE),
-                DEFINE_SAMPLE_INTERPOLATION_FUNCTION(u32le, quint32, qint64, LE),
-                DEFINE_SAMPLE_INTERPOLATION_FUNCTION(u32be, quint32, qint64, BE),
-                DEFINE_SAMPLE_INTERPOLATION_FUNCTION(s64le,  qint64,  qreal, LE),
-                DEFINE_SAMPLE_INTERPOLATION_FUNCTION(s64be,  qint64,  qreal, BE),
-                DEFINE_SAMPLE_INTERPOLATION_FUNCTION(u64le, quint64,  qreal, LE),
-                DEFINE_SAMPLE_INTERPOLATION_FUNCTION(u64be, quint64,  qreal, BE),
-                DEFINE_SAMPLE_INTERPOLATION_FUNCTION(fltle,   float,  qreal, LE),
-                DEFINE_SAMPLE_INTERPOLATION_FUNCTION(fltbe,   float,  qreal, BE),
-                DEFINE_SAMPLE_INTERPOLATION_FUNCTION(dblle,   qreal,  qreal, LE),
-                DEFINE_SAMPLE_INTERPOLATION_FUNCTION(dblbe,   qreal,  qreal, BE),
+            static const AudioSamplesScaleFuncs scale {
+                DEFINE_SAMPLE_SCALE_FUNCTION(s8   ,   qint8, qint64,  _),
+                DEFINE_SAMPLE_SCALE_FUNCTION(u8   ,  quint8, qint64,  _),
+                DEFINE_SAMPLE_SCALE_FUNCTION(s16le,  qint16, qint64, LE),
+                DEFINE_SAMPLE_SCALE_FUNCTION(s16be,  qint16, qint64, BE),
+                DEFINE_SAMPLE_SCALE_FUNCTION(u16le, quint16, qint64, LE),
+                DEFINE_SAMPLE_SCALE_FUNCTION(u16be, quint16, qint64, BE),
+                DEFINE_SAMPLE_SCALE_FUNCTION(s32le,  qint32, qint64, LE),
+                DEFINE_SAMPLE_SCALE_FUNCTION(s32be,  qint32, qint64, BE),
+                DEFINE_SAMPLE_SCALE_FUNCTION(u32le, quint32, qint64, LE),
+                DEFINE_SAMPLE_SCALE_FUNCTION(u32be, quint32, qint64, BE),
+                DEFINE_SAMPLE_SCALE_FUNCTION(s64le,  qint64,  qreal, LE),
+                DEFINE_SAMPLE_SCALE_FUNCTION(s64be,  qint64,  qreal, BE),
+                DEFINE_SAMPLE_SCALE_FUNCTION(u64le, quint64,  qreal, LE),
+                DEFINE_SAMPLE_SCALE_FUNCTION(u64be, quint64,  qreal, BE),
+                DEFINE_SAMPLE_SCALE_FUNCTION(fltle,   float,  qreal, LE),
+                DEFINE_SAMPLE_SCALE_FUNCTION(fltbe,   float,  qreal, BE),
+                DEFINE_SAMPLE_SCALE_FUNCTION(dblle,   qreal,  qreal, LE),
+                DEFINE_SAMPLE_SCALE_FUNCTION(dblbe,   qreal,  qreal, BE),
             };
 
-            return interpolation;
+            return scale;
+        }
+
+        inline static const AudioSamplesScale *bySamplesScaleFormat(AkAudioCaps::SampleFormat format)
+        {
+            for (auto &scale: samplesScale())
+                if (scale.format == format)
+                    return &scale;
+
+            return &samplesScale().front();
         }
 
-        inline static const AudioSamplesInterpolation *bySamplesInterpolationFormat(AkAudioCaps::SampleFormat format)
+        template<typename SampleType>
+        inline static void copyPlanar(const AkAudioPacket &src,
+                                      AkAudioPacket &dst)
         {
-            for (auto &interpolation: samplesInterpolation())
-                if (interpolation.format == format)
-                    return &interpolation;
+            auto samples = dst.caps().samples();
 
-            return &samplesInterpolation().front();
+            for (int channel = 0; channel < dst.caps().channels(); channel++) {
+                auto in = src.constPlaneSpan<SampleType>(channel);
+                auto out = dst.planeSpan<SampleType>(channel);
+
+                for (int sample = 0; sample < samples; sample++)
+                    out[sample] = in[sample];
+            }
         }
 };
 
@@ -544,6 +571,7 @@ AkAudioPacket::AkAudioPacket(const AkPacket &other)
     this->d->m_timeBase = other.timeBase();
     this->d->m_index = other.index();
     this->d->m_id = other.id();
+    this->d->m_flags = other.flags();
 }
 
 AkAudioPacket::AkAudioPacket(const AkAudioPacket &other):
@@ -556,6 +584,7 @@ AkAudioPacket::AkAudioPacket(const AkAudioPacket &other):
     this->d->m_timeBase = other.d->m_timeBase;
     this->d->m_index = other.d->m_index;
     this->d->m_id = other.d->m_id;
+    this->d->m_flags = other.d->m_flags;
 }
 
 AkAudioPacket::~AkAudioPacket()
@@ -571,6 +600,7 @@ AkAudioPacket &AkAudioPacket::operator =(const AkPacket &other)
     this->d->m_timeBase = other.timeBase();
     this->d->m_index = other.index();
     this->d->m_id = other.id();
+    this->d->m_flags = other.flags();
 
     return *this;
 }
@@ -584,6 +614,7 @@ AkAudioPacket &AkAudioPacket::operator =(const AkAudioPacket &other)
         this->d->m_timeBase = other.d->m_timeBase;
         this->d->m_index = other.d->m_index;
         this->d->m_id = other.d->m_id;
+        this->d->m_flags = other.d->m_flags;
     }
 
     return *this;
@@ -649,6 +680,7 @@ AkAudioPacket::operator AkPacket() const
     packet.timeBase() = this->d->m_timeBase;
     packet.index() = this->d->m_index;
     packet.id() = this->d->m_id;
+    packet.flags() = this->d->m_flags;
 
     return packet;
 }
@@ -718,12 +750,23 @@ int &AkAudioPacket::index()
     return this->d->m_index;
 }
 
+int AkAudioPacket::flags() const
+{
+    return this->d->m_flags;
+}
+
+int &AkAudioPacket::flags()
+{
+    return this->d->m_flags;
+}
+
 void AkAudioPacket::copyMetadata(const AkAudioPacket &other)
 {
     this->d->m_pts = other.d->m_pts;
     this->d->m_timeBase = other.d->m_timeBase;
     this->d->m_index = other.d->m_index;
     this->d->m_id = other.d->m_id;
+    this->d->m_flags = other.d->m_flags;
 }
 
 const quint8 *AkAudioPacket::constPlaneData(int plane) const
@@ -845,6 +888,12 @@ AkAudioPacket AkAudioPacket::convertLayout(AkAudioCaps::ChannelLayout layout) co
     return AkAudioPacketPrivate::convertChannels(layout, *this);
 }
 
+QVector<float> AkAudioPacket::mixMatrix(AkAudioCaps::ChannelLayout inputLayout,
+                                        AkAudioCaps::ChannelLayout outputLayout)
+{
+    return AkAudioPacketPrivate::mixMatrix(inputLayout, outputLayout);
+}
+
 AkAudioPacket AkAudioPacket::convertSampleRate(int rate,
                                                qreal &sampleCorrection,
                                                ResampleMethod method) const
@@ -861,6 +910,12 @@ AkAudioPacket AkAudioPacket::convertSampleRate(int rate,
     if (oSamples < 1)
         return {};
 
+    // The sinc filter needs its history between packets, which a single
+    // packet can't provide. Use AkAudioResampler for it, and quadratic
+    // interpolation here.
+    if (method == ResampleMethod_Sinc)
+        method = ResampleMethod_Quadratic;
+
     auto caps = this->d->m_caps;
     caps.setSamples(oSamples);
     caps.setRate(rate);
@@ -869,117 +924,8 @@ AkAudioPacket AkAudioPacket::convertSampleRate(int rate,
     if (oSamples <  this->d->m_caps.samples())
         method = ResampleMethod_Fast;
 
-    switch (method) {
-    case ResampleMethod_Fast:
-        for (int channel = 0; channel < packet.caps().channels(); channel++) {
-            for (int sample = 0; sample < packet.caps().samples(); sample++) {
-                auto iSample = sample
-                               * (this->d->m_caps.samples() - 1)
-                               / (oSamples - 1);
-                auto iValue = this->constSample(channel, iSample);
-                packet.setSample(channel, sample, iValue);
-            }
-        }
-
-        break;
-
-    case ResampleMethod_Linear: {
-        auto sif =
-                AkAudioPacketPrivate::bySamplesInterpolationFormat(caps.format());
-        auto interpolation = sif->linear;
-
-        for (int channel = 0; channel < packet.caps().channels(); channel++) {
-            for (int sample = 0; sample < packet.caps().samples(); sample++) {
-                auto iSample = qreal(sample)
-                               * (this->d->m_caps.samples() - 1)
-                               / (oSamples - 1);
-                auto minSample = qFloor(iSample);
-                auto maxSample = qCeil(iSample);
-
-                if (minSample == maxSample) {
-                    auto iValue = this->constSample(channel, minSample);
-                    packet.setSample(channel, sample, iValue);
-                } else {
-                    quint64 data;
-                    interpolation(*this,
-                                  channel,
-                                  iSample,
-                                  minSample,
-                                  maxSample,
-                                  reinterpret_cast<quint8 *>(&data));
-                    packet.setSample(channel,
-                                     sample,
-                                     reinterpret_cast<const quint8 *>(&data));
-                }
-            }
-        }
-
-        break;
-    }
-
-    case ResampleMethod_Quadratic:
-        auto sif =
-                AkAudioPacketPrivate::bySamplesInterpolationFormat(caps.format());
-        auto interpolationL = sif->linear;
-        auto interpolationQ = sif->quadratic;
-
-        for (int channel = 0; channel < packet.caps().channels(); channel++) {
-            for (int sample = 0; sample < packet.caps().samples(); sample++) {
-                auto iSample = qreal(sample)
-                               * (this->d->m_caps.samples() - 1)
-                               / (oSamples - 1);
-                auto minSample = qFloor(iSample);
-                auto maxSample = qCeil(iSample);
-
-                if (minSample == maxSample) {
-                    auto iValue = this->constSample(channel, minSample);
-                    packet.setSample(channel, sample, iValue);
-                } else {
-                    auto diffMinSample = minSample - iSample;
-                    auto diffMaxSample = maxSample - iSample;
-                    diffMinSample *= diffMinSample;
-                    diffMaxSample *= diffMaxSample;
-                    auto midSample = diffMinSample < diffMaxSample?
-                                         qMax(minSample - 1, 0):
-                                         qMin(maxSample + 1, this->d->m_caps.samples() - 1);
-
-                    if (midSample < minSample)
-                        std::swap(midSample, minSample);
-
-                    if (midSample > maxSample)
-                        std::swap(midSample, maxSample);
-
-                    if (midSample == minSample
-                        || midSample == maxSample) {
-                        quint64 data;
-                        interpolationL(*this,
-                                       channel,
-                                       iSample,
-                                       minSample,
-                                       maxSample,
-                                       reinterpret_cast<quint8 *>(&data));
-                        packet.setSample(channel,
-                                         sample,
-                                         reinterpret_cast<const quint8 *>(&data));
-                    } else {
-                        quint64 data;
-                        interpolationQ(*this,
-                                       channel,
-                                       iSample,
-                                       minSample,
-                                       midSample,
-                                       maxSample,
-                                       reinterpret_cast<quint8 *>(&data));
-                        packet.setSample(channel,
-                                         sample,
-                                         reinterpret_cast<const quint8 *>(&data));
-                    }
-                }
-            }
-        }
-
-        break;
-    }
+    auto scale = AkAudioPacketPrivate::bySamplesScaleFormat(caps.format());
+    scale->scale(*this, packet, method);
 
     sampleCorrection = rSamples - oSamples;
 
@@ -1002,117 +948,13 @@ AkAudioPacket AkAudioPacket::scale(int samples,
     if (samples <  this->d->m_caps.samples())
         method = ResampleMethod_Fast;
 
-    switch (method) {
-    case ResampleMethod_Fast:
-        for (int channel = 0; channel < packet.caps().channels(); channel++) {
-            for (int sample = 0; sample < packet.caps().samples(); sample++) {
-                auto iSample = sample
-                               * (this->d->m_caps.samples() - 1)
-                               / (samples - 1);
-                auto iValue = this->constSample(channel, iSample);
-                packet.setSample(channel, sample, iValue);
-            }
-        }
-
-        break;
-
-    case ResampleMethod_Linear: {
-        auto sif =
-                AkAudioPacketPrivate::bySamplesInterpolationFormat(caps.format());
-        auto interpolation = sif->linear;
-
-        for (int channel = 0; channel < packet.caps().channels(); channel++) {
-            for (int sample = 0; sample < packet.caps().samples(); sample++) {
-                auto iSample = qreal(sample)
-                               * (this->d->m_caps.samples() - 1)
-                               / (samples - 1);
-                auto minSample = qFloor(iSample);
-                auto maxSample = qCeil(iSample);
-
-                if (minSample == maxSample) {
-                    auto iValue = this->constSample(channel, minSample);
-                    packet.setSample(channel, sample, iValue);
-                } else {
-                    quint64 data;
-                    interpolation(*this,
-                                  channel,
-                                  iSample,
-                                  minSample,
-                                  maxSample,
-                                  reinterpret_cast<quint8 *>(&data));
-                    packet.setSample(channel,
-                                     sample,
-                                     reinterpret_cast<const quint8 *>(&data));
-                }
-            }
-        }
-
-        break;
-    }
-
-    case ResampleMethod_Quadratic:
-        auto sif =
-                AkAudioPacketPrivate::bySamplesInterpolationFormat(caps.format());
-        auto interpolationL = sif->linear;
-        auto interpolationQ = sif->quadratic;
-
-        for (int channel = 0; channel < packet.caps().channels(); channel++) {
-            for (int sample = 0; sample < packet.caps().samples(); sample++) {
-                auto iSample = qreal(sample)
-                               * (this->d->m_caps.samples() - 1)
-                               / (samples - 1);
-                auto minSample = qFloor(iSample);
-                auto maxSample = qCeil(iSample);
-
-                if (minSample == maxSample) {
-                    auto iValue = this->constSample(channel, minSample);
-                    packet.setSample(channel, sample, iValue);
-                } else {
-                    auto diffMinSample = minSample - iSample;
-                    auto diffMaxSample = maxSample - iSample;
-                    diffMinSample *= diffMinSample;
-                    diffMaxSample *= diffMaxSample;
-                    auto midSample = diffMinSample < diffMaxSample?
-                                         qMax(minSample - 1, 0):
-                                         qMin(maxSample + 1, this->d->m_caps.samples() - 1);
-
-                    if (midSample < minSample)
-                        std::swap(midSample, minSample);
-
-                    if (midSample > maxSample)
-                        std::swap(midSample, maxSample);
-
-                    if (midSample == minSample
-                        || midSample == maxSample) {
-                        quint64 data;
-                        interpolationL(*this,
-                                       channel,
-                                       iSample,
-                                       minSample,
-                                       maxSample,
-                                       reinterpret_cast<quint8 *>(&data));
-                        packet.setSample(channel,
-                                         sample,
-                                         reinterpret_cast<const quint8 *>(&data));
-                    } else {
-                        quint64 data;
-                        interpolationQ(*this,
-                                       channel,
-                                       iSample,
-                                       minSample,
-                                       midSample,
-                                       maxSample,
-                                       reinterpret_cast<quint8 *>(&data));
-                        packet.setSample(channel,
-                                         sample,
-                                         reinterpret_cast<const quint8 *>(&data));
-                    }
-                }
-            }
-        }
+    // The sinc filter can't warrant an exact number of output samples, use
+    // quadratic interpolation instead.
+    if (method == ResampleMethod_Sinc)
+        method = ResampleMethod_Quadratic;
 
-        break;
-    }
+    auto scale = AkAudioPacketPrivate::bySamplesScaleFormat(caps.format());
+    scale->scale(*this, packet, method);
 
     return packet;
 }
@@ -1126,31 +968,26 @@ AkAudioPacket AkAudioPacket::convertPlanar(bool planar) const
     caps.updatePlaneSize(planar);
     AkAudioPacket dst(caps);
     dst.copyMetadata(*this);
-    auto byps = caps.bps() / 8;
-    auto channels = caps.channels();
 
-    if (planar) {
-        auto src_line = this->constPlaneData(0);
+    switch (caps.bps()) {
+    case 8:
+        AkAudioPacketPrivate::copyPlanar<quint8>(*this, dst);
 
-        for (int plane = 0; plane < caps.planes(); plane++) {
-            auto dst_line = dst.planeData(plane);
+        break;
+    case 16:
+        AkAudioPacketPrivate::copyPlanar<quint16>(*this, dst);
 
-            for (int i = 0; i < caps.samples(); i++)
-                memcpy(dst_line + byps * i,
-                       src_line + byps * (i * channels + plane),
-                       size_t(byps));
-        }
-    } else {
-        auto dst_line = dst.planeData(0);
+        break;
+    case 32:
+        AkAudioPacketPrivate::copyPlanar<quint32>(*this, dst);
 
-        for (int plane = 0; plane < this->d->m_caps.planes(); plane++) {
-            auto src_line = this->constPlaneData(plane);
+        break;
+    case 64:
+        AkAudioPacketPrivate::copyPlanar<quint64>(*this, dst);
 
-            for (int i = 0; i < caps.samples(); i++)
-                memcpy(dst_line + byps * (i * channels + plane),
-                       src_line + byps * i,
-                       size_t(byps));
-        }
+        break;
+    default:
+        return {};
     }
 
     return dst;
@@ -1272,6 +1109,15 @@ void AkAudioPacket::setIndex(int index)
     emit this->indexChanged(index);
 }
 
+void AkAudioPacket::setFlags(int flags)
+{
+    if (this->d->m_flags == flags)
+        return;
+
+    this->d->m_flags = flags;
+    emit this->flagsChanged(flags);
+}
+
 void AkAudioPacket::resetCaps()
 {
     this->setCaps({});
@@ -1302,6 +1148,11 @@ void AkAudioPacket::resetIndex()
     this->setIndex(-1);
 }
 
+void AkAudioPacket::resetFlags()
+{
+    this->setFlags(0);
+}
+
 void AkAudioPacket::registerTypes()
 {
     qRegisterMetaType<AkAudioPacket>("AkAudioPacket");
@@ -1334,6 +1185,8 @@ QDebug operator <<(QDebug debug, const AkAudioPacket &packet)
                     << packet.timeBase()
                     << ",index="
                     << packet.index()
+                    << ",flags="
+                    << packet.flags()
                     << ")";
 
     return debug;
@@ -20,16 +20,58 @@
 #ifndef AKAUDIOPACKET_H
 #define AKAUDIOPACKET_H
 
+#include <QVector>
+
 #include "akaudiocaps.h"
 
 class AkAudioPacketPrivate;
 class AkPacket;
 class AkFrac;
 
+// Strided view of the samples of a channel, it works the same for planar and
+// interleaved packets.
+template<typename T>
+class AkAudioSpan
+{
+    public:
+        AkAudioSpan(T *data, int stride, int size):
+            m_data(data),
+            m_stride(stride),
+            m_size(size)
+        {
+        }
+
+        inline T *data() const
+        {
+            return this->m_data;
+        }
+
+        inline int stride() const
+        {
+            return this->m_stride;
+        }
+
+        inline int size() const
+        {
+            return this->m_size;
+        }
+
+        inline T &operator [](int i) const
+        {
+            return this->m_data[i * this->m_stride];
+        }
+
+    private:
+        T *m_data;
+        int m_stride;
+        int m_size;
+};
+
 class AKCOMMONS_EXPORT AkAudioPacket: public QObject
 {
     Q_OBJECT
     Q_ENUMS(ResampleMethod)
+    Q_ENUMS(PacketFlag)
     Q_PROPERTY(AkAudioCaps caps
                READ caps
                WRITE setCaps
@@ -60,13 +102,26 @@ class AKCOMMONS_EXPORT AkAudioPacket: public QObject
                WRITE setIndex
                RESET resetIndex
                NOTIFY indexChanged)
+    Q_PROPERTY(int flags
+               READ flags
+               WRITE setFlags
+               RESET resetFlags
+               NOTIFY flagsChanged)
 
     public:
         enum ResampleMethod
         {
             ResampleMethod_Fast,
             ResampleMethod_Linear,
-            ResampleMethod_Quadratic
+            ResampleMethod_Quadratic,
+            ResampleMethod_Sinc
+        };
+
+        enum PacketFlag
+        {
+            PacketFlag_None = 0x0,
+            // The packet only contains silence or background noise.
+            PacketFlag_Silence = 0x1
         };
 
         AkAudioPacket(QObject *parent=nullptr);
@@ -93,6 +148,8 @@ class AKCOMMONS_EXPORT AkAudioPacket: public QObject
         Q_INVOKABLE AkFrac &timeBase();
         Q_INVOKABLE int index() const;
         Q_INVOKABLE int &index();
+        Q_INVOKABLE int flags() const;
+        Q_INVOKABLE int &flags();
         Q_INVOKABLE void copyMetadata(const AkAudioPacket &other);
 
         Q_INVOKABLE const quint8 *constPlaneData(int plane) const;
@@ -100,12 +157,35 @@ class AKCOMMONS_EXPORT AkAudioPacket: public QObject
         Q_INVOKABLE const quint8 *constSample(int channel, int i) const;
         Q_INVOKABLE quint8 *sample(int channel, int i);
         Q_INVOKABLE void setSample(int channel, int i, const quint8 *sample);
+
+        template<typename T>
+        inline AkAudioSpan<const T> constPlaneSpan(int channel) const
+        {
+            auto caps = this->caps();
+
+            return {reinterpret_cast<const T *>(this->constSample(channel, 0)),
+                    caps.planar()? 1: caps.channels(),
+                    caps.samples()};
+        }
+
+        template<typename T>
+        inline AkAudioSpan<T> planeSpan(int channel)
+        {
+            auto &caps = this->caps();
+
+            return {reinterpret_cast<T *>(this->sample(channel, 0)),
+                    caps.planar()? 1: caps.channels(),
+                    caps.samples()};
+        }
+
         Q_INVOKABLE AkAudioPacket convert(const AkAudioCaps &caps) const;
         Q_INVOKABLE static bool canConvertFormat(AkAudioCaps::SampleFormat input,
                                            AkAudioCaps::SampleFormat output);
         Q_INVOKABLE bool canConvertFormat(AkAudioCaps::SampleFormat output) const;
         Q_INVOKABLE AkAudioPacket convertFormat(AkAudioCaps::SampleFormat format) const;
         Q_INVOKABLE AkAudioPacket convertLayout(AkAudioCaps::ChannelLayout layout) const;
+        static QVector<float> mixMatrix(AkAudioCaps::ChannelLayout inputLayout,
+                                        AkAudioCaps::ChannelLayout outputLayout);
         Q_INVOKABLE AkAudioPacket convertSampleRate(int rate,
                                                     qreal &sampleCorrection,
                                                     ResampleMethod method=ResampleMethod_Fast) const;
@@ -125,6 +205,7 @@ class AKCOMMONS_EXPORT AkAudioPacket: public QObject
         void ptsChanged(qint64 pts);
         void timeBaseChanged(const AkFrac &timeBase);
         void indexChanged(int index);
+        void flagsChanged(int flags);
 
     public Q_SLOTS:
         void setCaps(const AkAudioCaps &caps);
@@ -133,12 +214,14 @@ class AKCOMMONS_EXPORT AkAudioPacket: public QObject
         void setPts(qint64 pts);
         void setTimeBase(const AkFrac &timeBase);
         void setIndex(int index);
+        void setFlags(int flags);
         void resetCaps();
         void resetBuffer();
         void resetId();
         void resetPts();
         void resetTimeBase();
         void resetIndex();
+        void resetFlags();
         static void registerTypes();
 };
 
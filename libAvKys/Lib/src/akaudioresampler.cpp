@@ -0,0 +1,329 @@
+/* Webcamoid, webcam capture application.
+ * Copyright (C) 2020  Gonzalo Exequiel Pedone
+ *
+ * Webcamoid is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Webcamoid is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Webcamoid. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Web-Site: http://webcamoid.github.io/
+ */
+
+#include <QVector>
+#include <QtMath>
+
+#include "akaudioresampler.h"
+#include "akaudiopacket.h"
+
+// Filter length for the zero crossings at each side of the center when the
+// rate is increased. It grows when the rate is decreased, to keep the
+// transition band.
+#define BASE_HALF_TAPS 16
+#define MAX_HALF_TAPS  256
+
+// Above this number of phases the fractional position is rounded to the
+// nearest phase available.
+#define MAX_PHASES 256
+
+class AkAudioResamplerPrivate
+{
+    public:
+        int m_inputRate {0};
+        int m_outputRate {0};
+        int m_channels {0};
+        qint64 m_upFactor {1};
+        qint64 m_downFactor {1};
+        int m_phases {1};
+        int m_halfTaps {BASE_HALF_TAPS};
+        int m_taps {2 * BASE_HALF_TAPS};
+        QVector<qreal> m_coefficients;
+        QVector<qreal> m_history;
+        QVector<qreal> m_buffer;
+        QVector<qreal> m_planes;
+        qint64 m_index {0};
+        qint64 m_phase {0};
+
+        void updateCoefficients();
+        inline static qreal dot(const qreal *x, const qreal *h, int taps);
+};
+
+AkAudioResampler::AkAudioResampler()
+{
+    this->d = new AkAudioResamplerPrivate;
+}
+
+AkAudioResampler::AkAudioResampler(int inputRate, int outputRate, int channels)
+{
+    this->d = new AkAudioResamplerPrivate;
+    this->configure(inputRate, outputRate, channels);
+}
+
+AkAudioResampler::~AkAudioResampler()
+{
+    delete this->d;
+}
+
+int AkAudioResampler::inputRate() const
+{
+    return this->d->m_inputRate;
+}
+
+int AkAudioResampler::outputRate() const
+{
+    return this->d->m_outputRate;
+}
+
+int AkAudioResampler::channels() const
+{
+    return this->d->m_channels;
+}
+
+void AkAudioResampler::configure(int inputRate, int outputRate, int channels)
+{
+    if (inputRate < 1 || outputRate < 1 || channels < 1) {
+        this->d->m_inputRate = 0;
+        this->d->m_outputRate = 0;
+        this->d->m_channels = 0;
+        this->d->m_coefficients.clear();
+        this->d->m_history.clear();
+
+        return;
+    }
+
+    auto gcd = qint64(inputRate);
+
+    for (qint64 b = outputRate; b != 0;) {
+        auto t = gcd % b;
+        gcd = b;
+        b = t;
+    }
+
+    auto upFactor = outputRate / gcd;
+    auto downFactor = inputRate / gcd;
+    auto recalculate = this->d->m_coefficients.isEmpty()
+                       || upFactor != this->d->m_upFactor
+                       || downFactor != this->d->m_downFactor;
+    this->d->m_inputRate = inputRate;
+    this->d->m_outputRate = outputRate;
+    this->d->m_channels = channels;
+    this->d->m_upFactor = upFactor;
+    this->d->m_downFactor = downFactor;
+
+    if (recalculate)
+        this->d->updateCoefficients();
+
+    this->reset();
+}
+
+void AkAudioResampler::reset()
+{
+    // Start with a silent history, and the first output sample aligned to
+    // the first input sample.
+    this->d->m_history.fill(0.0, this->d->m_channels * (this->d->m_taps - 1));
+    this->d->m_index = this->d->m_taps - 1;
+    this->d->m_phase = 0;
+}
+
+int AkAudioResampler::maxOutputSamples(int inputSamples) const
+{
+    if (this->d->m_channels < 1)
+        return 0;
+
+    return int((qint64(inputSamples) + this->d->m_taps)
+               * this->d->m_upFactor
+               / this->d->m_downFactor) + 2;
+}
+
+int AkAudioResampler::resample(const qreal *const *src,
+                               int samples,
+                               qreal *const *dst,
+                               bool drain)
+{
+    if (this->d->m_channels < 1 || samples < 0)
+        return 0;
+
+    int historySize = this->d->m_taps - 1;
+    int halfTaps = this->d->m_halfTaps;
+    int extra = drain? halfTaps: 0;
+    int bufferSize = historySize + samples + extra;
+    this->d->m_buffer.resize(this->d->m_channels * bufferSize);
+
+    for (int channel = 0; channel < this->d->m_channels; channel++) {
+        auto buffer = this->d->m_buffer.data() + channel * bufferSize;
+        memcpy(buffer,
+               this->d->m_history.constData() + channel * historySize,
+               size_t(historySize) * sizeof(qreal));
+        memcpy(buffer + historySize,
+               src[channel],
+               size_t(samples) * sizeof(qreal));
+
+        for (int i = 0; i < extra; i++)
+            buffer[historySize + samples + i] = 0.0;
+    }
+
+    // Output samples are calculated while the whole filter fits inside the
+    // buffer.
+    auto lastIndex = qint64(historySize + samples - 1 + extra - halfTaps);
+    auto index = this->d->m_index;
+    auto phase = this->d->m_phase;
+    auto upFactor = this->d->m_upFactor;
+    auto downFactor = this->d->m_downFactor;
+    auto phases = this->d->m_phases;
+    auto taps = this->d->m_taps;
+    int oSamples = 0;
+
+    while (index <= lastIndex) {
+        auto coefficients =
+                this->d->m_coefficients.constData()
+                + taps * int(phase * phases / upFactor);
+        auto start = int(index) - halfTaps + 1;
+
+        for (int channel = 0; channel < this->d->m_channels; channel++) {
+            auto buffer = this->d->m_buffer.constData()
+                          + channel * bufferSize
+                          + start;
+            dst[channel][oSamples] =
+                    AkAudioResamplerPrivate::dot(buffer, coefficients, taps);
+        }
+
+        oSamples++;
+        phase += downFactor;
+        index += phase / upFactor;
+        phase %= upFactor;
+    }
+
+    if (drain) {
+        this->reset();
+
+        return oSamples;
+    }
+
+    // Keep the last samples for the next call.
+    for (int channel = 0; channel < this->d->m_channels; channel++)
+        memcpy(this->d->m_history.data() + channel * historySize,
+               this->d->m_buffer.constData()
+               + channel * bufferSize
+               + bufferSize - historySize,
+               size_t(historySize) * sizeof(qreal));
+
+    this->d->m_index = index - samples;
+    this->d->m_phase = phase;
+
+    return oSamples;
+}
+
+AkAudioPacket AkAudioResampler::resample(const AkAudioPacket &packet,
+                                         bool drain)
+{
+    auto icaps = packet.caps();
+
+    if (this->d->m_channels < 1
+        || icaps.channels() != this->d->m_channels
+        || icaps.rate() != this->d->m_inputRate)
+        return {};
+
+    auto src = packet.convertFormat(AkAudioCaps::SampleFormat_dbl)
+                     .convertPlanar(true);
+
+    if (!src)
+        return {};
+
+    int samples = icaps.samples();
+    int maxSamples = this->maxOutputSamples(samples);
+    this->d->m_planes.resize(this->d->m_channels * maxSamples);
+    QVector<const qreal *> srcPlanes(this->d->m_channels);
+    QVector<qreal *> dstPlanes(this->d->m_channels);
+
+    for (int channel = 0; channel < this->d->m_channels; channel++) {
+        srcPlanes[channel] =
+                reinterpret_cast<const qreal *>(src.constPlaneData(channel));
+        dstPlanes[channel] = this->d->m_planes.data() + channel * maxSamples;
+    }
+
+    int oSamples = this->resample(srcPlanes.constData(),
+                                  samples,
+                                  dstPlanes.constData(),
+                                  drain);
+
+    if (oSamples < 1)
+        return {};
+
+    auto caps = src.caps();
+    caps.setRate(this->d->m_outputRate);
+    caps.setSamples(oSamples);
+    AkAudioPacket dst(caps);
+    dst.copyMetadata(packet);
+
+    for (int channel = 0; channel < this->d->m_channels; channel++)
+        memcpy(dst.planeData(channel),
+               dstPlanes[channel],
+               size_t(oSamples) * sizeof(qreal));
+
+    return dst.convertPlanar(icaps.planar()).convertFormat(icaps.format());
+}
+
+void AkAudioResamplerPrivate::updateCoefficients()
+{
+    // Cutoff frequency relative to the input Nyquist frequency, a bit below
+    // the lowest of both rates.
+    auto ratio = qreal(this->m_upFactor) / this->m_downFactor;
+    auto cutoff = 0.95 * qMin(1.0, ratio);
+    this->m_halfTaps = qMin(qCeil(BASE_HALF_TAPS / qMin(1.0, ratio)),
+                            MAX_HALF_TAPS);
+    this->m_taps = 2 * this->m_halfTaps;
+    this->m_phases = int(qMin<qint64>(this->m_upFactor, MAX_PHASES));
+    this->m_coefficients.resize(this->m_phases * this->m_taps);
+
+    for (int phase = 0; phase < this->m_phases; phase++) {
+        auto coefficients = this->m_coefficients.data() + phase * this->m_taps;
+        auto offset = qreal(phase) / this->m_phases;
+        qreal sum = 0;
+
+        for (int tap = 0; tap < this->m_taps; tap++) {
+            // Distance from the output sample to the input sample.
+            auto u = offset + this->m_halfTaps - 1 - tap;
+            auto x = M_PI * cutoff * u;
+            auto sinc = qFuzzyIsNull(x)? 1.0: qSin(x) / x;
+            auto r = M_PI * u / this->m_halfTaps;
+            auto window = 0.42 + 0.5 * qCos(r) + 0.08 * qCos(2 * r);
+            coefficients[tap] = cutoff * sinc * window;
+            sum += coefficients[tap];
+        }
+
+        // Unity gain for DC.
+        if (!qFuzzyIsNull(sum))
+            for (int tap = 0; tap < this->m_taps; tap++)
+                coefficients[tap] /= sum;
+    }
+}
+
+qreal AkAudioResamplerPrivate::dot(const qreal *x, const qreal *h, int taps)
+{
+    // Independent accumulators let the compiler pipeline and vectorize the
+    // loop.
+    qreal sum0 = 0;
+    qreal sum1 = 0;
+    qreal sum2 = 0;
+    qreal sum3 = 0;
+    int i = 0;
+
+    for (; i + 3 < taps; i += 4) {
+        sum0 += x[i] * h[i];
+        sum1 += x[i + 1] * h[i + 1];
+        sum2 += x[i + 2] * h[i + 2];
+        sum3 += x[i + 3] * h[i + 3];
+    }
+
+    for (; i < taps; i++)
+        sum0 += x[i] * h[i];
+
+    return (sum0 + sum1) + (sum2 + sum3);
+}
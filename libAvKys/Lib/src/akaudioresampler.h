@@ -0,0 +1,74 @@
+/* Webcamoid, webcam capture application.
+ * Copyright (C) 2020  Gonzalo Exequiel Pedone
+ *
+ * Webcamoid is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Webcamoid is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Webcamoid. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Web-Site: http://webcamoid.github.io/
+ */
+
+#ifndef AKAUDIORESAMPLER_H
+#define AKAUDIORESAMPLER_H
+
+#include "akcommons.h"
+
+class AkAudioResamplerPrivate;
+class AkAudioPacket;
+
+/// Streaming band-limited sample rate converter.
+///
+/// Uses a polyphase windowed-sinc filter. The filter history is kept between
+/// calls, so consecutive packets of the same stream are converted without
+/// discontinuities.
+class AKCOMMONS_EXPORT AkAudioResampler
+{
+    public:
+        AkAudioResampler();
+        AkAudioResampler(int inputRate, int outputRate, int channels);
+        ~AkAudioResampler();
+
+        int inputRate() const;
+        int outputRate() const;
+        int channels() const;
+
+        // Set the conversion parameters and clear the filter history. The
+        // coefficients are only recalculated if the rates ratio changes.
+        void configure(int inputRate, int outputRate, int channels);
+
+        // Clear the filter history.
+        void reset();
+
+        // Maximum number of samples per channel that resample() will write
+        // for the given number of input samples.
+        int maxOutputSamples(int inputSamples) const;
+
+        // Resample planar buffers of real samples, one per channel. Returns
+        // the number of samples written to each dst buffer. If drain is true
+        // the remaining history is flushed and the state is reset.
+        int resample(const qreal *const *src,
+                     int samples,
+                     qreal *const *dst,
+                     bool drain=false);
+
+        // Resample a packet in any format, the output has the same format
+        // and layout than the input.
+        AkAudioPacket resample(const AkAudioPacket &packet,
+                               bool drain=false);
+
+    private:
+        AkAudioResamplerPrivate *d;
+
+        Q_DISABLE_COPY(AkAudioResampler)
+};
+
+#endif // AKAUDIORESAMPLER_H
@@ -0,0 +1,291 @@
+/* Webcamoid, webcam capture application.
+ * Copyright (C) 2020  Gonzalo Exequiel Pedone
+ *
+ * Webcamoid is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Webcamoid is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Webcamoid. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Web-Site: http://webcamoid.github.io/
+ */
+
+#include <QtConcurrent>
+
+#include "akblocktransform.h"
+
+// Don't spawn threads for frames smaller than this number of pixels, the
+// synchronization costs more than the work itself.
+#define PARALLEL_MIN_PIXELS (320 * 240)
+
+class AkBlockTransformPrivate
+{
+    public:
+        template<typename Function>
+        inline static void forEachRow(int rows, int pixels, Function function)
+        {
+            if (pixels < PARALLEL_MIN_PIXELS || rows < 2) {
+                for (int row = 0; row < rows; row++)
+                    function(row);
+
+                return;
+            }
+
+            QVector<int> rowList(rows);
+
+            for (int row = 0; row < rows; row++)
+                rowList[row] = row;
+
+            QtConcurrent::blockingMap(rowList, [&function] (int &row) {
+                function(row);
+            });
+        }
+
+        inline static quint32 *pixel(quint8 *data,
+                                     int lineSize,
+                                     int x,
+                                     int y)
+        {
+            return reinterpret_cast<quint32 *>(data + y * lineSize) + x;
+        }
+
+        inline static void rotate90(quint8 *data,
+                                    int lineSize,
+                                    int xp,
+                                    int yp,
+                                    int size);
+        inline static void rotate180(quint8 *data,
+                                     int lineSize,
+                                     int xp,
+                                     int yp,
+                                     int width,
+                                     int height);
+        inline static void rotate270(quint8 *data,
+                                     int lineSize,
+                                     int xp,
+                                     int yp,
+                                     int size);
+};
+
+void AkBlockTransform::blockMean(const quint8 *src,
+                                 int srcLineSize,
+                                 quint8 *dst,
+                                 int dstLineSize,
+                                 int width,
+                                 int height,
+                                 int blockWidth,
+                                 int blockHeight)
+{
+    if (!src || !dst || width < 1 || height < 1)
+        return;
+
+    blockWidth = qBound(1, blockWidth, width);
+    blockHeight = qBound(1, blockHeight, height);
+    int blockRows = (height + blockHeight - 1) / blockHeight;
+
+    AkBlockTransformPrivate::forEachRow(blockRows,
+                                        width * height,
+                                        [=] (int row) {
+        int yp = row * blockHeight;
+        int bh = qMin(blockHeight, height - yp);
+
+        for (int xp = 0; xp < width; xp += blockWidth) {
+            int bw = qMin(blockWidth, width - xp);
+            quint32 sum[4] = {0, 0, 0, 0};
+
+            for (int y = 0; y < bh; y++) {
+                auto line = src + (yp + y) * srcLineSize + 4 * xp;
+
+                for (int x = 0; x < 4 * bw; x += 4) {
+                    sum[0] += line[x];
+                    sum[1] += line[x + 1];
+                    sum[2] += line[x + 2];
+                    sum[3] += line[x + 3];
+                }
+            }
+
+            quint32 n = quint32(bw * bh);
+            quint8 mean[4] = {
+                quint8(sum[0] / n),
+                quint8(sum[1] / n),
+                quint8(sum[2] / n),
+                quint8(sum[3] / n)
+            };
+            quint32 color;
+            memcpy(&color, mean, sizeof(quint32));
+
+            for (int y = 0; y < bh; y++) {
+                auto line = reinterpret_cast<quint32 *>(dst + (yp + y) * dstLineSize) + xp;
+
+                for (int x = 0; x < bw; x++)
+                    line[x] = color;
+            }
+        }
+    });
+}
+
+void AkBlockTransform::rotateBlocks(quint8 *data,
+                                    int lineSize,
+                                    int width,
+                                    int height,
+                                    int blockSize,
+                                    const quint8 *rotations,
+                                    int rotationsLineSize)
+{
+    if (!data || !rotations || width < 1 || height < 1 || blockSize < 1)
+        return;
+
+    int blockRows = (height + blockSize - 1) / blockSize;
+    int blockCols = (width + blockSize - 1) / blockSize;
+
+    AkBlockTransformPrivate::forEachRow(blockRows,
+                                        width * height,
+                                        [=] (int row) {
+        auto rotationsLine = rotations + row * rotationsLineSize;
+        int yp = row * blockSize;
+        int bh = qMin(blockSize, height - yp);
+
+        for (int col = 0; col < blockCols; col++) {
+            int xp = col * blockSize;
+            int bw = qMin(blockSize, width - xp);
+            bool square = bw == blockSize && bh == blockSize;
+
+            switch (rotationsLine[col]) {
+            case Rotation90:
+                if (square)
+                    AkBlockTransformPrivate::rotate90(data,
+                                                      lineSize,
+                                                      xp,
+                                                      yp,
+                                                      blockSize);
+
+                break;
+            case Rotation180:
+                AkBlockTransformPrivate::rotate180(data,
+                                                   lineSize,
+                                                   xp,
+                                                   yp,
+                                                   bw,
+                                                   bh);
+
+                break;
+            case Rotation270:
+                if (square)
+                    AkBlockTransformPrivate::rotate270(data,
+                                                       lineSize,
+                                                       xp,
+                                                       yp,
+                                                       blockSize);
+
+                break;
+            default:
+                break;
+            }
+        }
+    });
+}
+
+void AkBlockTransform::gatherBlocks(const quint8 *const *frames,
+                                    int nFrames,
+                                    int srcLineSize,
+                                    quint8 *dst,
+                                    int dstLineSize,
+                                    int width,
+                                    int height,
+                                    int blockSize,
+                                    const int *frameMap)
+{
+    if (!frames || nFrames < 1 || !dst || !frameMap || blockSize < 1)
+        return;
+
+    int blockRows = height / blockSize;
+    int blockCols = width / blockSize;
+    auto blockLineSize = size_t(4 * blockSize);
+
+    AkBlockTransformPrivate::forEachRow(blockRows,
+                                        width * height,
+                                        [=] (int row) {
+        auto frameMapLine = frameMap + row * blockCols;
+        int yp = row * blockSize;
+
+        for (int col = 0; col < blockCols; col++) {
+            auto frame = frames[qBound(0, frameMapLine[col], nFrames - 1)];
+            size_t xoffset = 4 * size_t(col * blockSize);
+            auto srcLine = frame + yp * srcLineSize + xoffset;
+            auto dstLine = dst + yp * dstLineSize + xoffset;
+
+            for (int y = 0; y < blockSize; y++) {
+                memcpy(dstLine, srcLine, blockLineSize);
+                srcLine += srcLineSize;
+                dstLine += dstLineSize;
+            }
+        }
+    });
+}
+
+void AkBlockTransformPrivate::rotate90(quint8 *data,
+                                       int lineSize,
+                                       int xp,
+                                       int yp,
+                                       int size)
+{
+    // Rotate the square by cycling the pixels in groups of 4, layer by layer.
+    for (int i = 0; i < size / 2; i++)
+        for (int j = i; j < size - 1 - i; j++) {
+            auto a = pixel(data, lineSize, xp + j, yp + i);
+            auto b = pixel(data, lineSize, xp + i, yp + size - 1 - j);
+            auto c = pixel(data, lineSize, xp + size - 1 - j, yp + size - 1 - i);
+            auto d = pixel(data, lineSize, xp + size - 1 - i, yp + j);
+            auto tmp = *a;
+            *a = *b;
+            *b = *c;
+            *c = *d;
+            *d = tmp;
+        }
+}
+
+void AkBlockTransformPrivate::rotate180(quint8 *data,
+                                        int lineSize,
+                                        int xp,
+                                        int yp,
+                                        int width,
+                                        int height)
+{
+    for (int y = 0; y < (height + 1) / 2; y++) {
+        auto line = pixel(data, lineSize, xp, yp + y);
+        auto mirrorLine = pixel(data, lineSize, xp, yp + height - 1 - y);
+
+        // The central line of a block with an odd height is just reversed.
+        int xs = line == mirrorLine? width / 2: width;
+
+        for (int x = 0; x < xs; x++)
+            std::swap(line[x], mirrorLine[width - 1 - x]);
+    }
+}
+
+void AkBlockTransformPrivate::rotate270(quint8 *data,
+                                        int lineSize,
+                                        int xp,
+                                        int yp,
+                                        int size)
+{
+    for (int i = 0; i < size / 2; i++)
+        for (int j = i; j < size - 1 - i; j++) {
+            auto a = pixel(data, lineSize, xp + j, yp + i);
+            auto b = pixel(data, lineSize, xp + i, yp + size - 1 - j);
+            auto c = pixel(data, lineSize, xp + size - 1 - j, yp + size - 1 - i);
+            auto d = pixel(data, lineSize, xp + size - 1 - i, yp + j);
+            auto tmp = *a;
+            *a = *d;
+            *d = *c;
+            *c = *b;
+            *b = tmp;
+        }
+}
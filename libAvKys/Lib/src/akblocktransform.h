@@ -0,0 +1,79 @@
+/* Webcamoid, webcam capture application.
+ * Copyright (C) 2020  Gonzalo Exequiel Pedone
+ *
+ * Webcamoid is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Webcamoid is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Webcamoid. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Web-Site: http://webcamoid.github.io/
+ */
+
+#ifndef AKBLOCKTRANSFORM_H
+#define AKBLOCKTRANSFORM_H
+
+#include "akcommons.h"
+
+/// Block-wise operations over 32 bits per pixel frames.
+///
+/// All functions work directly over strided buffers, each line of the frame
+/// starts at lineSize bytes from the previous one, and the work is split by
+/// block rows over the global thread pool.
+class AKCOMMONS_EXPORT AkBlockTransform
+{
+    public:
+        enum Rotation
+        {
+            Rotation0,
+            Rotation90,
+            Rotation180,
+            Rotation270
+        };
+
+        // Replace each block of the frame by its mean color. Source and
+        // destination can be the same buffer.
+        static void blockMean(const quint8 *src,
+                              int srcLineSize,
+                              quint8 *dst,
+                              int dstLineSize,
+                              int width,
+                              int height,
+                              int blockWidth,
+                              int blockHeight);
+
+        // Rotate each square block of the frame clockwise in place.
+        // rotations is a map of ceil(width / blockSize) x
+        // ceil(height / blockSize) Rotation values, blocks that doesn't fit
+        // entirely in the frame are only rotated if the rotation is 180
+        // degrees.
+        static void rotateBlocks(quint8 *data,
+                                 int lineSize,
+                                 int width,
+                                 int height,
+                                 int blockSize,
+                                 const quint8 *rotations,
+                                 int rotationsLineSize);
+
+        // Build a frame copying each block from the frame of the history
+        // selected by frameMap. frameMap is a map of
+        // (width / blockSize) x (height / blockSize) indexes to frames.
+        static void gatherBlocks(const quint8 *const *frames,
+                                 int nFrames,
+                                 int srcLineSize,
+                                 quint8 *dst,
+                                 int dstLineSize,
+                                 int width,
+                                 int height,
+                                 int blockSize,
+                                 const int *frameMap);
+};
+
+#endif // AKBLOCKTRANSFORM_H
@@ -23,8 +23,10 @@
 #include <QDebug>
 #include <QDir>
 #include <QDirIterator>
+#include <QElapsedTimer>
 #include <QFileInfo>
 #include <QMetaMethod>
+#include <QMutex>
 #include <QPluginLoader>
 #include <QQmlComponent>
 #include <QQmlContext>
@@ -39,9 +41,13 @@
 #include "akpacket.h"
 #include "akaudiopacket.h"
 #include "akvideopacket.h"
+#include "akfrac.h"
 
 #define SUBMODULES_PATH "submodules"
 
+// Number of processing times kept for calculating the percentiles.
+#define STATS_RING_SIZE 256
+
 class AkPluginInfoPrivate
 {
     public:
@@ -51,6 +57,37 @@ class AkPluginInfoPrivate
         bool m_used;
 };
 
+// The counters are updated from the streaming threads without locks, and
+// read from any thread.
+class AkElementStats
+{
+    public:
+        QAtomicInteger<qint64> m_packets {0};
+        QAtomicInteger<qint64> m_drops {0};
+        QAtomicInteger<qint64> m_totalTime {0};
+        QAtomicInteger<qint64> m_maxTime {0};
+        QAtomicInteger<qint64> m_queueDepth {0};
+        QAtomicInteger<qint64> m_maxQueueDepth {0};
+        QAtomicInteger<qint64> m_audioPts {-1};
+        QAtomicInteger<qint64> m_videoPts {-1};
+        QAtomicInteger<qint64> m_times[STATS_RING_SIZE];
+        QAtomicInteger<quint32> m_timesIndex {0};
+        QAtomicInt m_hasInfo {0};
+        QString m_pluginId;
+        QString m_className;
+
+        void reset();
+        QVariantMap toMap(const QString &pluginId,
+                          const QString &className,
+                          const QString &objectName) const;
+        static void updateMax(QAtomicInteger<qint64> &max, qint64 value);
+        static QElapsedTimer &clock();
+        static QAtomicInt &enabled();
+        static QMutex &elementsMutex();
+        static QList<AkElement *> &elements();
+        static QVector<qint64> &nestedTimes();
+};
+
 class AkElementPrivate
 {
     public:
@@ -62,6 +99,7 @@ class AkElementPrivate
         QString m_subModulesPath;
         QDir m_applicationDir;
         AkElement::ElementState m_state;
+        AkElementStats m_stats;
         bool m_recursiveSearchPaths;
         bool m_pluginsScanned;
 
@@ -84,10 +122,18 @@ AkElement::AkElement(QObject *parent):
 {
     this->d = new AkElementPrivate();
     this->d->m_state = ElementStateNull;
+
+    AkElementStats::elementsMutex().lock();
+    AkElementStats::elements() << this;
+    AkElementStats::elementsMutex().unlock();
 }
 
 AkElement::~AkElement()
 {
+    AkElementStats::elementsMutex().lock();
+    AkElementStats::elements().removeAll(this);
+    AkElementStats::elementsMutex().unlock();
+
     this->setState(AkElement::ElementStateNull);
     delete this->d;
 }
@@ -645,6 +691,50 @@ void AkElement::clearCache()
     akElementGlobalStuff->m_pluginsScanned = false;
 }
 
+QVariantMap AkElement::stats() const
+{
+    return this->d->m_stats.toMap(this->pluginId(),
+                                  this->metaObject()->className(),
+                                  this->objectName());
+}
+
+void AkElement::resetStats()
+{
+    this->d->m_stats.reset();
+}
+
+QVariantList AkElement::allStats()
+{
+    QVariantList stats;
+
+    AkElementStats::elementsMutex().lock();
+
+    // Elements are only unregistered in ~AkElement, after the derived
+    // destructors already run, so don't make virtual calls here.
+    for (auto &element: AkElementStats::elements()) {
+        auto &elementStats = element->d->m_stats;
+
+        if (elementStats.m_packets > 0)
+            stats << elementStats.toMap(elementStats.m_pluginId,
+                                        elementStats.m_className,
+                                        element->objectName());
+    }
+
+    AkElementStats::elementsMutex().unlock();
+
+    return stats;
+}
+
+bool AkElement::statsEnabled()
+{
+    return AkElementStats::enabled().load() != 0;
+}
+
+void AkElement::setStatsEnabled(bool enabled)
+{
+    AkElementStats::enabled().store(enabled);
+}
+
 AkPacket AkElement::operator ()(const AkPacket &packet)
 {
     return this->iStream(packet);
@@ -678,15 +768,87 @@ AkPacket AkElement::iVideoStream(const AkVideoPacket &packet)
     return AkPacket();
 }
 
+qint64 AkElement::statsEnter(const AkPacket &packet) const
+{
+    if (!AkElementStats::enabled().load())
+        return -1;
+
+    auto &stats = this->d->m_stats;
+
+    if (!stats.m_hasInfo.loadAcquire()) {
+        AkElementStats::elementsMutex().lock();
+        stats.m_pluginId = this->pluginId();
+        stats.m_className = this->metaObject()->className();
+        stats.m_hasInfo.storeRelease(1);
+        AkElementStats::elementsMutex().unlock();
+    }
+
+    if (packet.timeBase().den() != 0) {
+        auto pts = qint64(1e6 * packet.pts() * packet.timeBase().value());
+        auto mimeType = packet.caps().mimeType();
+
+        if (mimeType == "audio/x-raw")
+            stats.m_audioPts.store(pts);
+        else if (mimeType == "video/x-raw")
+            stats.m_videoPts.store(pts);
+    }
+
+    AkElementStats::nestedTimes() << 0;
+
+    return AkElementStats::clock().nsecsElapsed();
+}
+
+void AkElement::statsLeave(qint64 enterTime) const
+{
+    if (enterTime < 0)
+        return;
+
+    // The packets are sent downstream synchronously, subtract the time
+    // spent in the elements called from this one, so each element only
+    // reports it's own time.
+    auto &nestedTimes = AkElementStats::nestedTimes();
+    auto totalTime = AkElementStats::clock().nsecsElapsed() - enterTime;
+    auto time = totalTime - (nestedTimes.isEmpty()? 0: nestedTimes.takeLast());
+
+    if (!nestedTimes.isEmpty())
+        nestedTimes.last() += totalTime;
+
+    auto &stats = this->d->m_stats;
+    auto index = stats.m_timesIndex.fetchAndAddRelaxed(1) % STATS_RING_SIZE;
+    stats.m_times[index].store(time);
+    stats.m_totalTime.fetchAndAddRelaxed(time);
+    AkElementStats::updateMax(stats.m_maxTime, time);
+    stats.m_packets.fetchAndAddRelease(1);
+}
+
+void AkElement::statsDrop(int packets) const
+{
+    if (AkElementStats::enabled().load())
+        this->d->m_stats.m_drops.fetchAndAddRelaxed(packets);
+}
+
+void AkElement::statsQueueDepth(int depth) const
+{
+    if (!AkElementStats::enabled().load())
+        return;
+
+    this->d->m_stats.m_queueDepth.store(depth);
+    AkElementStats::updateMax(this->d->m_stats.m_maxQueueDepth, depth);
+}
+
 AkPacket AkElement::iStream(const AkPacket &packet)
 {
+    auto enterTime = this->statsEnter(packet);
+    AkPacket oPacket;
+
     if (packet.caps().mimeType() == "audio/x-raw")
-        return this->iAudioStream(packet);
+        oPacket = this->iAudioStream(packet);
+    else if (packet.caps().mimeType() == "video/x-raw")
+        oPacket = this->iVideoStream(packet);
 
-    if (packet.caps().mimeType() == "video/x-raw")
-        return this->iVideoStream(packet);
+    this->statsLeave(enterTime);
 
-    return AkPacket();
+    return oPacket;
 }
 
 bool AkElement::setState(AkElement::ElementState state)
@@ -720,6 +882,117 @@ void AkElement::registerTypes()
     });
 }
 
+void AkElementStats::reset()
+{
+    this->m_packets.store(0);
+    this->m_drops.store(0);
+    this->m_totalTime.store(0);
+    this->m_maxTime.store(0);
+    this->m_queueDepth.store(0);
+    this->m_maxQueueDepth.store(0);
+    this->m_audioPts.store(-1);
+    this->m_videoPts.store(-1);
+    this->m_timesIndex.store(0);
+}
+
+QVariantMap AkElementStats::toMap(const QString &pluginId,
+                                  const QString &className,
+                                  const QString &objectName) const
+{
+    qint64 packets = this->m_packets;
+    QVector<qint64> times;
+    int nTimes = int(qMin<qint64>(packets, STATS_RING_SIZE));
+
+    for (int i = 0; i < nTimes; i++)
+        times << this->m_times[i].load();
+
+    std::sort(times.begin(), times.end());
+    auto percentile = [&times] (int p) -> qreal {
+        if (times.isEmpty())
+            return 0.0;
+
+        return times[(times.size() - 1) * p / 100] / 1e3;
+    };
+
+    qint64 audioPts = this->m_audioPts;
+    qint64 videoPts = this->m_videoPts;
+    QVariantMap map {
+        {"pluginId"     , pluginId                                   },
+        {"className"    , className                                  },
+        {"objectName"   , objectName                                 },
+        {"packets"      , packets                                    },
+        {"drops"        , qint64(this->m_drops)                      },
+        {"avgTimeUs"    , packets > 0?
+                              qreal(this->m_totalTime) / packets / 1e3:
+                              0.0                                    },
+        {"maxTimeUs"    , qreal(this->m_maxTime) / 1e3               },
+        {"p50TimeUs"    , percentile(50)                             },
+        {"p95TimeUs"    , percentile(95)                             },
+        {"queueDepth"   , qint64(this->m_queueDepth)                 },
+        {"maxQueueDepth", qint64(this->m_maxQueueDepth)              },
+    };
+
+    // Time stamps are in microseconds.
+    if (audioPts >= 0)
+        map["audioPtsUs"] = audioPts;
+
+    if (videoPts >= 0)
+        map["videoPtsUs"] = videoPts;
+
+    if (audioPts >= 0 && videoPts >= 0)
+        map["avDriftUs"] = audioPts - videoPts;
+
+    return map;
+}
+
+void AkElementStats::updateMax(QAtomicInteger<qint64> &max, qint64 value)
+{
+    auto curMax = max.load();
+
+    while (value > curMax && !max.testAndSetRelaxed(curMax, value, curMax)) {
+    }
+}
+
+QElapsedTimer &AkElementStats::clock()
+{
+    static QElapsedTimer clock = [] () {
+        QElapsedTimer timer;
+        timer.start();
+
+        return timer;
+    } ();
+
+    return clock;
+}
+
+QAtomicInt &AkElementStats::enabled()
+{
+    static QAtomicInt enabled(qEnvironmentVariableIntValue("AK_ELEMENT_STATS"));
+
+    return enabled;
+}
+
+QMutex &AkElementStats::elementsMutex()
+{
+    static QMutex mutex;
+
+    return mutex;
+}
+
+QList<AkElement *> &AkElementStats::elements()
+{
+    static QList<AkElement *> elements;
+
+    return elements;
+}
+
+QVector<qint64> &AkElementStats::nestedTimes()
+{
+    static thread_local QVector<qint64> nestedTimes;
+
+    return nestedTimes;
+}
+
 AkElementPrivate::AkElementPrivate()
 {
     this->m_state = AkElement::ElementStateNull;
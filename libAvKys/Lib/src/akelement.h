@@ -143,6 +143,16 @@ class AKCOMMONS_EXPORT AkElement: public QObject
                                               const QVariantMap &metaData);
         Q_INVOKABLE static void clearCache();
 
+        // Instrumentation counters of the element: processed packets, time
+        // spent processing them (excluding the time spent in the elements
+        // downstream), queue depth, dropped packets and the last audio and
+        // video time stamps received.
+        Q_INVOKABLE QVariantMap stats() const;
+        Q_INVOKABLE void resetStats();
+        Q_INVOKABLE static QVariantList allStats();
+        Q_INVOKABLE static bool statsEnabled();
+        Q_INVOKABLE static void setStatsEnabled(bool enabled);
+
         virtual AkPacket operator ()(const AkPacket &packet);
 
     private:
@@ -155,6 +165,14 @@ class AKCOMMONS_EXPORT AkElement: public QObject
         virtual AkPacket iAudioStream(const AkAudioPacket &packet);
         virtual AkPacket iVideoStream(const AkVideoPacket &packet);
 
+        // Elements that reimplement iStream() or have internal queues can
+        // report to the instrumentation with these functions. They do
+        // nothing if the instrumentation is disabled.
+        qint64 statsEnter(const AkPacket &packet) const;
+        void statsLeave(qint64 enterTime) const;
+        void statsDrop(int packets=1) const;
+        void statsQueueDepth(int depth) const;
+
     Q_SIGNALS:
         void stateChanged(AkElement::ElementState state);
         void oStream(const AkPacket &packet);
@@ -0,0 +1,97 @@
+/* Webcamoid, webcam capture application.
+ * Copyright (C) 2020  Gonzalo Exequiel Pedone
+ *
+ * Webcamoid is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Webcamoid is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Webcamoid. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Web-Site: http://webcamoid.github.io/
+ */
+
+#include <QImage>
+
+#include "akframeutils.h"
+
+void AkFrameUtils::blurPlane(const quint8 *src,
+                             quint8 *dst,
+                             int width,
+                             int height,
+                             int radius,
+                             QVector<quint32> &sums,
+                             QVector<quint32> &column)
+{
+    radius = qMax(radius, 0);
+    sums.resize(width * height);
+    column.resize(width);
+    auto sumsData = sums.data();
+    auto columnData = column.data();
+
+    for (int y = 0; y < height; y++) {
+        auto srcLine = src + y * width;
+        auto sumsLine = sumsData + y * width;
+        quint32 sum = 0;
+
+        for (int x = 0; x < qMin(radius, width); x++)
+            sum += srcLine[x];
+
+        for (int x = 0; x < width; x++) {
+            if (x + radius < width)
+                sum += srcLine[x + radius];
+
+            if (x - radius - 1 >= 0)
+                sum -= srcLine[x - radius - 1];
+
+            sumsLine[x] = sum;
+        }
+    }
+
+    memset(columnData, 0, size_t(width) * sizeof(quint32));
+
+    for (int y = 0; y < qMin(radius, height); y++)
+        for (int x = 0; x < width; x++)
+            columnData[x] += sumsData[x + y * width];
+
+    for (int y = 0; y < height; y++) {
+        if (y + radius < height) {
+            auto sumsLine = sumsData + (y + radius) * width;
+
+            for (int x = 0; x < width; x++)
+                columnData[x] += sumsLine[x];
+        }
+
+        if (y - radius - 1 >= 0) {
+            auto sumsLine = sumsData + (y - radius - 1) * width;
+
+            for (int x = 0; x < width; x++)
+                columnData[x] -= sumsLine[x];
+        }
+
+        quint32 kh = quint32(qMin(y + radius, height - 1) - qMax(y - radius, 0) + 1);
+        auto dstLine = dst + y * width;
+
+        for (int x = 0; x < width; x++) {
+            quint32 kw = quint32(qMin(x + radius, width - 1) - qMax(x - radius, 0) + 1);
+            dstLine[x] = quint8(columnData[x] / (kw * kh));
+        }
+    }
+}
+
+void AkFrameUtils::storeFrame(const QImage &src, QVector<QRgb> &dst)
+{
+    int width = src.width();
+    dst.resize(width * src.height());
+
+    for (int y = 0; y < src.height(); y++)
+        memcpy(dst.data() + y * width,
+               src.constScanLine(y),
+               size_t(width) * sizeof(QRgb));
+}
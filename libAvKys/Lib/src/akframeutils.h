@@ -0,0 +1,49 @@
+/* Webcamoid, webcam capture application.
+ * Copyright (C) 2020  Gonzalo Exequiel Pedone
+ *
+ * Webcamoid is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Webcamoid is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Webcamoid. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Web-Site: http://webcamoid.github.io/
+ */
+
+#ifndef AKFRAMEUTILS_H
+#define AKFRAMEUTILS_H
+
+#include <QVector>
+#include <QRgb>
+
+#include "akcommons.h"
+
+class QImage;
+
+/// Helpers shared by the filters that keep per-pixel state between frames.
+class AKCOMMONS_EXPORT AkFrameUtils
+{
+    public:
+        // Box blur of a width x height 8 bits plane, splitted in an
+        // horizontal and a vertical pass with running sums. sums and column
+        // are scratch buffers reused between calls.
+        static void blurPlane(const quint8 *src,
+                              quint8 *dst,
+                              int width,
+                              int height,
+                              int radius,
+                              QVector<quint32> &sums,
+                              QVector<quint32> &column);
+
+        // Copy the pixels of a 32 bits per pixel image to a packed buffer.
+        static void storeFrame(const QImage &src, QVector<QRgb> &dst);
+};
+
+#endif // AKFRAMEUTILS_H
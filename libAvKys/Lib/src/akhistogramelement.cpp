@@ -0,0 +1,213 @@
+/* Webcamoid, webcam capture application.
+ * Copyright (C) 2020  Gonzalo Exequiel Pedone
+ *
+ * Webcamoid is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Webcamoid is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Webcamoid. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Web-Site: http://webcamoid.github.io/
+ */
+
+#include <QImage>
+#include <QThread>
+#include <QtConcurrent>
+
+#include "akhistogramelement.h"
+
+// A smoothing of 1 would keep the first table forever.
+#define MAX_SMOOTHING 0.99
+
+class AkHistogramElementPrivate
+{
+    public:
+        int m_decimation {1};
+        int m_updateInterval {1};
+        qreal m_smoothing {0.5};
+        QSize m_frameSize;
+        int m_frame {0};
+        QVector<quint64> m_histograms;
+        QVector<QVector<qreal>> m_tables;
+};
+
+AkHistogramElement::AkHistogramElement(QObject *parent):
+    AkElement(parent)
+{
+    this->d = new AkHistogramElementPrivate;
+}
+
+AkHistogramElement::~AkHistogramElement()
+{
+    delete this->d;
+}
+
+int AkHistogramElement::decimation() const
+{
+    return this->d->m_decimation;
+}
+
+int AkHistogramElement::updateInterval() const
+{
+    return this->d->m_updateInterval;
+}
+
+qreal AkHistogramElement::smoothing() const
+{
+    return this->d->m_smoothing;
+}
+
+bool AkHistogramElement::needsUpdate(const QImage &frame)
+{
+    if (frame.size() != this->d->m_frameSize) {
+        this->d->m_tables.clear();
+        this->d->m_frameSize = frame.size();
+    }
+
+    // The tables are calculated every updateInterval frames, and then
+    // they are reused for the frames in between.
+    int updateInterval = qMax(this->d->m_updateInterval, 1);
+    bool update = this->d->m_tables.isEmpty()
+                  || this->d->m_frame % updateInterval == 0;
+
+    if (update)
+        this->d->m_frame = 0;
+
+    this->d->m_frame++;
+
+    return update;
+}
+
+QVector<quint64> AkHistogramElement::histogram(const QImage &frame,
+                                               HistogramChannels channels)
+{
+    int decimation = qMax(this->d->m_decimation, 1);
+    int nChannels = channels == HistogramChannels_Gray? 1: 3;
+    int histogramSize = 256 * nChannels;
+
+    // Each thread fills it's own histogram from a band of the frame, and
+    // then all histograms are merged.
+    int height = (frame.height() + decimation - 1) / decimation;
+    int nBands = qBound(1, QThread::idealThreadCount(), height);
+    this->d->m_histograms.fill(0, histogramSize * nBands);
+    QVector<int> bands(nBands);
+
+    for (int i = 0; i < nBands; i++)
+        bands[i] = i;
+
+    auto histograms = this->d->m_histograms.data();
+
+    QtConcurrent::blockingMap(bands, [&] (int &band) {
+        auto bandHistogram = histograms + histogramSize * band;
+        int yStart = decimation * (band * height / nBands);
+        int yEnd = decimation * ((band + 1) * height / nBands);
+
+        for (int y = yStart; y < qMin(yEnd, frame.height()); y += decimation) {
+            auto srcLine = reinterpret_cast<const QRgb *>(frame.constScanLine(y));
+
+            if (channels == HistogramChannels_Gray) {
+                for (int x = 0; x < frame.width(); x += decimation)
+                    bandHistogram[qGray(srcLine[x])]++;
+            } else {
+                for (int x = 0; x < frame.width(); x += decimation) {
+                    auto pixel = srcLine[x];
+                    bandHistogram[qRed(pixel)]++;
+                    bandHistogram[256 + qGreen(pixel)]++;
+                    bandHistogram[512 + qBlue(pixel)]++;
+                }
+            }
+        }
+    });
+
+    QVector<quint64> histogram(histogramSize, 0);
+
+    for (int band = 0; band < nBands; band++)
+        for (int i = 0; i < histogramSize; i++)
+            histogram[i] += histograms[histogramSize * band + i];
+
+    return histogram;
+}
+
+QVector<qreal> AkHistogramElement::smoothTable(int index,
+                                               const QVector<qreal> &table)
+{
+    if (this->d->m_tables.size() <= index)
+        this->d->m_tables.resize(index + 1);
+
+    auto &prevTable = this->d->m_tables[index];
+    auto smoothing = qBound(0.0, this->d->m_smoothing, MAX_SMOOTHING);
+    auto smoothTable = table;
+
+    // Blend the new table with the previous one to avoid flickering.
+    if (prevTable.size() == table.size())
+        for (int i = 0; i < table.size(); i++)
+            smoothTable[i] = smoothing * prevTable[i]
+                             + (1.0 - smoothing) * table[i];
+
+    prevTable = smoothTable;
+
+    return smoothTable;
+}
+
+void AkHistogramElement::makeLut(const QVector<qreal> &table,
+                                 int shift,
+                                 QVector<quint32> &lut)
+{
+    lut.resize(table.size());
+
+    for (int i = 0; i < table.size(); i++) {
+        auto value = quint32(qBound(0, qRound(table[i]), 255));
+        lut[i] = value << shift;
+    }
+}
+
+void AkHistogramElement::setDecimation(int decimation)
+{
+    if (this->d->m_decimation == decimation)
+        return;
+
+    this->d->m_decimation = decimation;
+    emit this->decimationChanged(decimation);
+}
+
+void AkHistogramElement::setUpdateInterval(int updateInterval)
+{
+    if (this->d->m_updateInterval == updateInterval)
+        return;
+
+    this->d->m_updateInterval = updateInterval;
+    emit this->updateIntervalChanged(updateInterval);
+}
+
+void AkHistogramElement::setSmoothing(qreal smoothing)
+{
+    if (qFuzzyCompare(this->d->m_smoothing, smoothing))
+        return;
+
+    this->d->m_smoothing = smoothing;
+    emit this->smoothingChanged(smoothing);
+}
+
+void AkHistogramElement::resetDecimation()
+{
+    this->setDecimation(1);
+}
+
+void AkHistogramElement::resetUpdateInterval()
+{
+    this->setUpdateInterval(1);
+}
+
+void AkHistogramElement::resetSmoothing()
+{
+    this->setSmoothing(0.5);
+}
+
+#include "moc_akhistogramelement.cpp"
@@ -0,0 +1,106 @@
+/* Webcamoid, webcam capture application.
+ * Copyright (C) 2020  Gonzalo Exequiel Pedone
+ *
+ * Webcamoid is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Webcamoid is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Webcamoid. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Web-Site: http://webcamoid.github.io/
+ */
+
+#ifndef AKHISTOGRAMELEMENT_H
+#define AKHISTOGRAMELEMENT_H
+
+#include <QVector>
+
+#include "akelement.h"
+
+class AkHistogramElementPrivate;
+class QImage;
+
+/// Base class for the filters that map the pixels through look-up tables
+/// calculated from the histogram of the frames.
+///
+/// The histogram is taken every updateInterval frames, sampling one of each
+/// decimation pixels in both directions, and the new tables are blended with
+/// the previous ones, so they change smoothly between frames.
+class AKCOMMONS_EXPORT AkHistogramElement: public AkElement
+{
+    Q_OBJECT
+    Q_PROPERTY(int decimation
+               READ decimation
+               WRITE setDecimation
+               RESET resetDecimation
+               NOTIFY decimationChanged)
+    Q_PROPERTY(int updateInterval
+               READ updateInterval
+               WRITE setUpdateInterval
+               RESET resetUpdateInterval
+               NOTIFY updateIntervalChanged)
+    Q_PROPERTY(qreal smoothing
+               READ smoothing
+               WRITE setSmoothing
+               RESET resetSmoothing
+               NOTIFY smoothingChanged)
+
+    public:
+        enum HistogramChannels
+        {
+            HistogramChannels_Gray,
+            HistogramChannels_RGB
+        };
+
+        AkHistogramElement(QObject *parent=nullptr);
+        ~AkHistogramElement();
+
+        Q_INVOKABLE int decimation() const;
+        Q_INVOKABLE int updateInterval() const;
+        Q_INVOKABLE qreal smoothing() const;
+
+    private:
+        AkHistogramElementPrivate *d;
+
+    protected:
+        // Returns true if the tables must be recalculated for this frame.
+        // The tables are dropped if the frame size changes.
+        bool needsUpdate(const QImage &frame);
+
+        // 256 levels histograms of an ARGB32 frame, one after the other for
+        // each channel.
+        QVector<quint64> histogram(const QImage &frame,
+                                   HistogramChannels channels);
+
+        // Blend the table with the previous one with the same index and
+        // store the result.
+        QVector<qreal> smoothTable(int index, const QVector<qreal> &table);
+
+        // Look-up table with the table values already shifted to it's place
+        // in the pixel.
+        static void makeLut(const QVector<qreal> &table,
+                            int shift,
+                            QVector<quint32> &lut);
+
+    Q_SIGNALS:
+        void decimationChanged(int decimation);
+        void updateIntervalChanged(int updateInterval);
+        void smoothingChanged(qreal smoothing);
+
+    public Q_SLOTS:
+        void setDecimation(int decimation);
+        void setUpdateInterval(int updateInterval);
+        void setSmoothing(qreal smoothing);
+        void resetDecimation();
+        void resetUpdateInterval();
+        void resetSmoothing();
+};
+
+#endif // AKHISTOGRAMELEMENT_H
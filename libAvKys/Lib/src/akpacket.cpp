@@ -34,6 +34,7 @@ class AkPacketPrivate
         AkFrac m_timeBase;
         qint64 m_id {-1};
         int m_index {-1};
+        int m_flags {0};
 };
 
 AkPacket::AkPacket(QObject *parent):
@@ -58,6 +59,7 @@ AkPacket::AkPacket(const AkPacket &other):
     this->d->m_timeBase = other.d->m_timeBase;
     this->d->m_index = other.d->m_index;
     this->d->m_id = other.d->m_id;
+    this->d->m_flags = other.d->m_flags;
 }
 
 AkPacket::~AkPacket()
@@ -74,6 +76,7 @@ AkPacket &AkPacket::operator =(const AkPacket &other)
         this->d->m_timeBase = other.d->m_timeBase;
         this->d->m_index = other.d->m_index;
         this->d->m_id = other.d->m_id;
+        this->d->m_flags = other.d->m_flags;
     }
 
     return *this;
@@ -144,12 +147,23 @@ int &AkPacket::index()
     return this->d->m_index;
 }
 
+int AkPacket::flags() const
+{
+    return this->d->m_flags;
+}
+
+int &AkPacket::flags()
+{
+    return this->d->m_flags;
+}
+
 void AkPacket::copyMetadata(const AkPacket &other)
 {
     this->d->m_pts = other.d->m_pts;
     this->d->m_timeBase = other.d->m_timeBase;
     this->d->m_index = other.d->m_index;
     this->d->m_id = other.d->m_id;
+    this->d->m_flags = other.d->m_flags;
 }
 
 void AkPacket::setCaps(const AkCaps &caps)
@@ -206,6 +220,15 @@ void AkPacket::setIndex(int index)
     emit this->indexChanged(index);
 }
 
+void AkPacket::setFlags(int flags)
+{
+    if (this->d->m_flags == flags)
+        return;
+
+    this->d->m_flags = flags;
+    emit this->flagsChanged(flags);
+}
+
 void AkPacket::resetCaps()
 {
     this->setCaps(AkCaps());
@@ -236,6 +259,11 @@ void AkPacket::resetIndex()
     this->setIndex(-1);
 }
 
+void AkPacket::resetFlags()
+{
+    this->setFlags(0);
+}
+
 void AkPacket::registerTypes()
 {
     qRegisterMetaType<AkPacket>("AkPacket");
@@ -267,6 +295,8 @@ QDebug operator <<(QDebug debug, const AkPacket &packet)
                     << packet.timeBase()
                     << ",index="
                     << packet.index()
+                    << ",flags="
+                    << packet.flags()
                     << ")";
 
     return debug.space();
@@ -67,6 +67,11 @@ class AKCOMMONS_EXPORT AkPacket: public QObject
                WRITE setIndex
                RESET resetIndex
                NOTIFY indexChanged)
+    Q_PROPERTY(int flags
+               READ flags
+               WRITE setFlags
+               RESET resetFlags
+               NOTIFY flagsChanged)
 
     public:
         AkPacket(QObject *parent=nullptr);
@@ -88,6 +93,8 @@ class AKCOMMONS_EXPORT AkPacket: public QObject
         Q_INVOKABLE AkFrac &timeBase();
         Q_INVOKABLE int index() const;
         Q_INVOKABLE int &index();
+        Q_INVOKABLE int flags() const;
+        Q_INVOKABLE int &flags();
         Q_INVOKABLE void copyMetadata(const AkPacket &other);
 
     private:
@@ -100,6 +107,7 @@ class AKCOMMONS_EXPORT AkPacket: public QObject
         void ptsChanged(qint64 pts);
         void timeBaseChanged(const AkFrac &timeBase);
         void indexChanged(int index);
+        void flagsChanged(int flags);
 
     public Q_SLOTS:
         void setCaps(const AkCaps &caps);
@@ -108,12 +116,14 @@ class AKCOMMONS_EXPORT AkPacket: public QObject
         void setPts(qint64 pts);
         void setTimeBase(const AkFrac &timeBase);
         void setIndex(int index);
+        void setFlags(int flags);
         void resetCaps();
         void resetBuffer();
         void resetId();
         void resetPts();
         void resetTimeBase();
         void resetIndex();
+        void resetFlags();
         static void registerTypes();
 };
 
@@ -243,6 +243,7 @@ AkPacket ConvertAudioFFmpegSW::convert(const AkAudioPacket &packet)
     oAudioPacket.timeBase() = AkFrac(1, this->d->m_caps.rate());
     oAudioPacket.index() = packet.index();
     oAudioPacket.id() = packet.id();
+    oAudioPacket.flags() = packet.flags();
 
     return oAudioPacket;
 }
@@ -19,20 +19,196 @@
 
 #include <QMap>
 #include <QMutex>
+#include <QVector>
+#include <QtEndian>
 #include <akfrac.h>
 #include <akpacket.h>
 #include <akaudiocaps.h>
 #include <akaudiopacket.h>
+#include <akaudioresampler.h>
 
 #include "convertaudiogeneric.h"
 
+// Samples are decoded to a planar buffer of reals in the [-1, 1] range, mixed,
+// resampled and encoded directly to the output buffer.
+using ReadSamplesFunction = void (*)(const quint8 *src,
+                                     int step,
+                                     int samples,
+                                     qreal *dst);
+using WriteSamplesFunction = void (*)(const qreal *src,
+                                      int samples,
+                                      int step,
+                                      quint8 *dst);
+
 class ConvertAudioGenericPrivate
 {
     public:
         AkAudioCaps m_caps;
         AkAudioCaps m_previousCaps;
         QMutex m_mutex;
-        qreal m_sampleCorrection {0};
+
+        // Conversion plan, recreated each time the input caps changes.
+        ReadSamplesFunction m_readSamples {nullptr};
+        WriteSamplesFunction m_writeSamples {nullptr};
+        QVector<float> m_mixMatrix;
+        AkAudioResampler m_resampler;
+        QVector<qreal> m_inputBuffer;
+        QVector<qreal> m_mixBuffer;
+        QVector<qreal> m_resampleBuffer;
+        QVector<const qreal *> m_resampleSrc;
+        QVector<qreal *> m_resampleDst;
+        QByteArray m_outputBuffer;
+
+        template<typename T>
+        inline static T from_(T value) {
+            return value;
+        }
+
+        template<typename T>
+        inline static T fromLE(T value) {
+            return qFromLittleEndian(value);
+        }
+
+        template<typename T>
+        inline static T fromBE(T value) {
+            return qFromBigEndian(value);
+        }
+
+        template<typename T>
+        inline static T to_(T value) {
+            return value;
+        }
+
+        template<typename T>
+        inline static T toLE(T value) {
+            return qToLittleEndian(value);
+        }
+
+        template<typename T>
+        inline static T toBE(T value) {
+            return qToBigEndian(value);
+        }
+
+        template<typename SampleType, typename TransformFuncType>
+        inline static void readSamples(const quint8 *src,
+                                       int step,
+                                       int samples,
+                                       qreal *dst,
+                                       TransformFuncType transformFrom)
+        {
+            auto srcSamples = reinterpret_cast<const SampleType *>(src);
+
+            if (std::is_floating_point<SampleType>::value) {
+                for (int i = 0; i < samples; i++)
+                    dst[i] = qBound(-1.0,
+                                    qreal(transformFrom(srcSamples[i * step])),
+                                    1.0);
+            } else {
+                const qreal xmin = std::numeric_limits<SampleType>::min();
+                const qreal xmax = std::numeric_limits<SampleType>::max();
+                const qreal k = 2.0 / (xmax - xmin);
+
+                for (int i = 0; i < samples; i++)
+                    dst[i] = k * (qreal(transformFrom(srcSamples[i * step])) - xmin)
+                             - 1.0;
+            }
+        }
+
+        template<typename SampleType, typename TransformFuncType>
+        inline static void writeSamples(const qreal *src,
+                                        int samples,
+                                        int step,
+                                        quint8 *dst,
+                                        TransformFuncType transformTo)
+        {
+            auto dstSamples = reinterpret_cast<SampleType *>(dst);
+
+            if (std::is_floating_point<SampleType>::value) {
+                for (int i = 0; i < samples; i++)
+                    dstSamples[i * step] =
+                            transformTo(SampleType(qBound(-1.0, src[i], 1.0)));
+            } else {
+                const qreal ymin = std::numeric_limits<SampleType>::min();
+                const qreal ymax = std::numeric_limits<SampleType>::max();
+                const qreal k = (ymax - ymin) / 2.0;
+
+                for (int i = 0; i < samples; i++) {
+                    qreal sample = k * (qBound(-1.0, src[i], 1.0) + 1.0) + ymin;
+
+                    // For 64 bits integers ymax is rounded up to 2^63, so
+                    // clamp before casting.
+                    dstSamples[i * step] =
+                            transformTo(sample < ymax?
+                                            SampleType(sample):
+                                            std::numeric_limits<SampleType>::max());
+                }
+            }
+        }
+
+#define DEFINE_SAMPLE_READ_WRITE_FUNCTION(sitype, itype, endian) \
+        {AkAudioCaps::SampleFormat_##sitype, \
+         [] (const quint8 *src, int step, int samples, qreal *dst) { \
+            readSamples<itype>(src, step, samples, dst, from##endian<itype>); \
+         }, \
+         [] (const qreal *src, int samples, int step, quint8 *dst) { \
+            writeSamples<itype>(src, samples, step, dst, to##endian<itype>); \
+         }}
+
+        struct SampleReadWrite
+        {
+            AkAudioCaps::SampleFormat format;
+            ReadSamplesFunction read;
+            WriteSamplesFunction write;
+        };
+
+        using SampleReadWriteFuncs = QVector<SampleReadWrite>;
+
+        inline static const SampleReadWriteFuncs &sampleReadWrite()
+        {
+            static const SampleReadWriteFuncs readWrite {
+                DEFINE_SAMPLE_READ_WRITE_FUNCTION(s8   ,   qint8,  _),
+                DEFINE_SAMPLE_READ_WRITE_FUNCTION(u8   ,  quint8,  _),
+                DEFINE_SAMPLE_READ_WRITE_FUNCTION(s16le,  qint16, LE),
+                DEFINE_SAMPLE_READ_WRITE_FUNCTION(s16be,  qint16, BE),
+                DEFINE_SAMPLE_READ_WRITE_FUNCTION(u16le, quint16, LE),
+                DEFINE_SAMPLE_READ_WRITE_FUNCTION(u16be, quint16, BE),
+                DEFINE_SAMPLE_READ_WRITE_FUNCTION(s32le,  qint32, LE),
+                DEFINE_SAMPLE_READ_WRITE_FUNCTION(s32be,  qint32, BE),
+                DEFINE_SAMPLE_READ_WRITE_FUNCTION(u32le, quint32, LE),
+                DEFINE_SAMPLE_READ_WRITE_FUNCTION(u32be, quint32, BE),
+                DEFINE_SAMPLE_READ_WRITE_FUNCTION(s64le,  qint64, LE),
+                DEFINE_SAMPLE_READ_WRITE_FUNCTION(s64be,  qint64, BE),
+                DEFINE_SAMPLE_READ_WRITE_FUNCTION(u64le, quint64, LE),
+                DEFINE_SAMPLE_READ_WRITE_FUNCTION(u64be, quint64, BE),
+                DEFINE_SAMPLE_READ_WRITE_FUNCTION(fltle,   float, LE),
+                DEFINE_SAMPLE_READ_WRITE_FUNCTION(fltbe,   float, BE),
+                DEFINE_SAMPLE_READ_WRITE_FUNCTION(dblle,   qreal, LE),
+                DEFINE_SAMPLE_READ_WRITE_FUNCTION(dblbe,   qreal, BE),
+            };
+
+            return readWrite;
+        }
+
+        inline static const SampleReadWrite *byFormat(AkAudioCaps::SampleFormat format)
+        {
+            for (auto &readWrite: sampleReadWrite())
+                if (readWrite.format == format)
+                    return &readWrite;
+
+            return nullptr;
+        }
+
+        inline static bool sameStream(const AkAudioCaps &caps1,
+                                      const AkAudioCaps &caps2)
+        {
+            return caps1.format() == caps2.format()
+                   && caps1.layout() == caps2.layout()
+                   && caps1.planar() == caps2.planar()
+                   && caps1.rate() == caps2.rate();
+        }
+
+        bool makePlan(const AkAudioCaps &caps);
+        AkAudioPacket runPlan(const AkAudioPacket &packet);
 };
 
 ConvertAudioGeneric::ConvertAudioGeneric(QObject *parent):
@@ -52,7 +228,6 @@ bool ConvertAudioGeneric::init(const AkAudioCaps &caps)
     QMutexLocker mutexLocker(&this->d->m_mutex);
     this->d->m_caps = caps;
     this->d->m_previousCaps = AkAudioCaps();
-    this->d->m_sampleCorrection = 0;
 
     return true;
 }
@@ -64,22 +239,171 @@ AkPacket ConvertAudioGeneric::convert(const AkAudioPacket &packet)
     if (!this->d->m_caps || packet.buffer().size() < 1)
         return {};
 
-    if (packet.caps() != this->d->m_previousCaps) {
+    if (ConvertAudioGenericPrivate::sameStream(packet.caps(), this->d->m_caps))
+        return packet;
+
+    if (!ConvertAudioGenericPrivate::sameStream(packet.caps(),
+                                                this->d->m_previousCaps)) {
         this->d->m_previousCaps = packet.caps();
-        this->d->m_sampleCorrection = 0;
+
+        if (!this->d->makePlan(packet.caps()))
+            this->d->m_readSamples = nullptr;
     }
 
-    return packet.convertFormat(this->d->m_caps.format())
-                 .convertLayout(this->d->m_caps.layout())
-                 .convertPlanar(this->d->m_caps.planar())
-                 .convertSampleRate(this->d->m_caps.rate(),
-                                    this->d->m_sampleCorrection);
+    if (!this->d->m_readSamples)
+        return {};
+
+    return this->d->runPlan(packet);
 }
 
 void ConvertAudioGeneric::uninit()
 {
     QMutexLocker mutexLocker(&this->d->m_mutex);
     this->d->m_caps = AkAudioCaps();
+    this->d->m_readSamples = nullptr;
+    this->d->m_writeSamples = nullptr;
+    this->d->m_mixMatrix.clear();
+    this->d->m_resampler.configure(0, 0, 0);
+    this->d->m_inputBuffer.clear();
+    this->d->m_mixBuffer.clear();
+    this->d->m_resampleBuffer.clear();
+    this->d->m_outputBuffer.clear();
+}
+
+bool ConvertAudioGenericPrivate::makePlan(const AkAudioCaps &caps)
+{
+    auto iformat = byFormat(caps.format());
+    auto oformat = byFormat(this->m_caps.format());
+
+    if (!iformat || !oformat || caps.channels() < 1 || caps.rate() < 1)
+        return false;
+
+    this->m_readSamples = iformat->read;
+    this->m_writeSamples = oformat->write;
+    this->m_mixMatrix.clear();
+
+    if (caps.layout() != this->m_caps.layout()) {
+        // The matrix rows are normalized, so the gain is the same for all
+        // packets.
+        this->m_mixMatrix = AkAudioPacket::mixMatrix(caps.layout(),
+                                                     this->m_caps.layout());
+
+        if (this->m_mixMatrix.isEmpty())
+            return false;
+    }
+
+    // The filter history is kept between packets.
+    if (caps.rate() != this->m_caps.rate())
+        this->m_resampler.configure(caps.rate(),
+                                    this->m_caps.rate(),
+                                    this->m_caps.channels());
+
+    return true;
+}
+
+AkAudioPacket ConvertAudioGenericPrivate::runPlan(const AkAudioPacket &packet)
+{
+    auto icaps = packet.caps();
+    int iSamples = icaps.samples();
+    int ichannels = icaps.channels();
+
+    if (iSamples < 1)
+        return {};
+
+    // Decode the input samples.
+    this->m_inputBuffer.resize(ichannels * iSamples);
+    auto inputBuffer = this->m_inputBuffer.data();
+    int ibps = icaps.bps() / 8;
+
+    for (int channel = 0; channel < ichannels; channel++) {
+        auto src = icaps.planar()?
+                       packet.constPlaneData(channel):
+                       packet.constPlaneData(0) + channel * ibps;
+        this->m_readSamples(src,
+                            icaps.planar()? 1: ichannels,
+                            iSamples,
+                            inputBuffer + channel * iSamples);
+    }
+
+    // Mix the channels.
+    auto mixBuffer = inputBuffer;
+    int ochannels = this->m_caps.channels();
+
+    if (!this->m_mixMatrix.isEmpty()) {
+        this->m_mixBuffer.fill(0.0, ochannels * iSamples);
+        mixBuffer = this->m_mixBuffer.data();
+
+        for (int ochannel = 0; ochannel < ochannels; ochannel++) {
+            auto mixLine = mixBuffer + ochannel * iSamples;
+            auto mixRow = this->m_mixMatrix.constData() + ochannel * ichannels;
+
+            for (int ichannel = 0; ichannel < ichannels; ichannel++) {
+                auto inputLine = inputBuffer + ichannel * iSamples;
+                auto k = mixRow[ichannel];
+
+                for (int sample = 0; sample < iSamples; sample++)
+                    mixLine[sample] += k * inputLine[sample];
+            }
+        }
+    }
+
+    // Resample.
+    int oSamples = iSamples;
+    int oLineSize = iSamples;
+
+    if (icaps.rate() != this->m_caps.rate()) {
+        oLineSize = this->m_resampler.maxOutputSamples(iSamples);
+        this->m_resampleBuffer.resize(ochannels * oLineSize);
+        this->m_resampleSrc.resize(ochannels);
+        this->m_resampleDst.resize(ochannels);
+
+        for (int channel = 0; channel < ochannels; channel++) {
+            this->m_resampleSrc[channel] = mixBuffer + channel * iSamples;
+            this->m_resampleDst[channel] =
+                    this->m_resampleBuffer.data() + channel * oLineSize;
+        }
+
+        oSamples = this->m_resampler.resample(this->m_resampleSrc.constData(),
+                                              iSamples,
+                                              this->m_resampleDst.constData());
+
+        if (oSamples < 1)
+            return {};
+
+        mixBuffer = this->m_resampleBuffer.data();
+    }
+
+    // Encode the samples in the output format. The output buffer is reused
+    // if the previous packet was already released.
+    auto ocaps = this->m_caps;
+    ocaps.setSamples(oSamples);
+    auto frameSize = int(ocaps.frameSize());
+
+    if (!this->m_outputBuffer.isDetached()
+        || this->m_outputBuffer.size() != frameSize)
+        this->m_outputBuffer = QByteArray(frameSize, Qt::Uninitialized);
+
+    auto outputBuffer =
+            reinterpret_cast<quint8 *>(this->m_outputBuffer.data());
+    int obps = ocaps.bps() / 8;
+
+    for (int channel = 0; channel < ochannels; channel++) {
+        auto mixLine = mixBuffer + channel * oLineSize;
+        auto dst = ocaps.planar()?
+                       outputBuffer + ocaps.planeOffset(channel):
+                       outputBuffer + channel * obps;
+        this->m_writeSamples(mixLine,
+                             oSamples,
+                             ocaps.planar()? 1: ochannels,
+                             dst);
+    }
+
+    AkAudioPacket oPacket;
+    oPacket.caps() = ocaps;
+    oPacket.buffer() = this->m_outputBuffer;
+    oPacket.copyMetadata(packet);
+
+    return oPacket;
 }
 
 #include "moc_convertaudiogeneric.cpp"
@@ -194,7 +194,7 @@ bool AudioDevAlsa::init(const QString &device, const AkAudioCaps &caps)
     if (error < 0)
         goto init_fail;
 
-    this->d->m_samples = qMax(this->latency() * caps.rate() / 1000, 1);
+    this->d->m_samples = this->periodSamples(caps.rate());
 
     return true;
 
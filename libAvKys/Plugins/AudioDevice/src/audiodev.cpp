@@ -24,11 +24,16 @@
 
 #define MAX_SAMPLE_RATE 512e3
 
+// In low latency mode the data is exchanged with the device in periods of a
+// fraction of the latency.
+#define LOW_LATENCY_PERIODS 4
+
 class AudioDevPrivate
 {
     public:
         QVector<int> m_commonSampleRates;
         int m_latency {25};
+        bool m_lowLatency {false};
 };
 
 AudioDev::AudioDev(QObject *parent):
@@ -62,6 +67,21 @@ int AudioDev::latency() const
     return this->d->m_latency;
 }
 
+bool AudioDev::lowLatency() const
+{
+    return this->d->m_lowLatency;
+}
+
+int AudioDev::periodSamples(int rate) const
+{
+    int samples = this->d->m_latency * rate / 1000;
+
+    if (this->d->m_lowLatency)
+        samples /= LOW_LATENCY_PERIODS;
+
+    return qMax(samples, 1);
+}
+
 const QVector<int> &AudioDev::commonSampleRates() const
 {
     return this->d->m_commonSampleRates;
@@ -161,9 +181,23 @@ void AudioDev::setLatency(int latency)
     Q_EMIT this->latencyChanged(latency);
 }
 
+void AudioDev::setLowLatency(bool lowLatency)
+{
+    if (this->d->m_lowLatency == lowLatency)
+        return;
+
+    this->d->m_lowLatency = lowLatency;
+    Q_EMIT this->lowLatencyChanged(lowLatency);
+}
+
 void AudioDev::resetLatency()
 {
     this->setLatency(25);
 }
 
+void AudioDev::resetLowLatency()
+{
+    this->setLowLatency(false);
+}
+
 #include "moc_audiodev.cpp"
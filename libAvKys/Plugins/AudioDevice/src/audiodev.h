@@ -33,6 +33,11 @@ class AudioDev: public QObject
                WRITE setLatency
                RESET resetLatency
                NOTIFY latencyChanged)
+    Q_PROPERTY(bool lowLatency
+               READ lowLatency
+               WRITE setLowLatency
+               RESET resetLowLatency
+               NOTIFY lowLatencyChanged)
     Q_PROPERTY(QString error
                READ error
                NOTIFY errorChanged)
@@ -42,6 +47,8 @@ class AudioDev: public QObject
         virtual ~AudioDev();
 
         Q_INVOKABLE int latency() const;
+        Q_INVOKABLE bool lowLatency() const;
+        Q_INVOKABLE int periodSamples(int rate) const;
         Q_INVOKABLE const QVector<int> &commonSampleRates() const;
         Q_INVOKABLE virtual QString error() const;
         Q_INVOKABLE virtual QString defaultInput();
@@ -63,6 +70,7 @@ class AudioDev: public QObject
 
     Q_SIGNALS:
         void latencyChanged(int latency);
+        void lowLatencyChanged(bool lowLatency);
         void errorChanged(const QString &error);
         void defaultInputChanged(const QString &defaultInput);
         void defaultOutputChanged(const QString &defaultOutput);
@@ -71,7 +79,9 @@ class AudioDev: public QObject
 
     public Q_SLOTS:
         void setLatency(int latency);
+        void setLowLatency(bool lowLatency);
         void resetLatency();
+        void resetLowLatency();
 };
 
 #endif // AUDIODEV_H
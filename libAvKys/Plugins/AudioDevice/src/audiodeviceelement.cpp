@@ -21,7 +21,8 @@
 #include <QtConcurrent>
 #include <QThreadPool>
 #include <QFuture>
-#include <QTime>
+#include <QElapsedTimer>
+#include <QWaitCondition>
 #include <ak.h>
 #include <akfrac.h>
 #include <akpacket.h>
@@ -30,6 +31,8 @@
 #include "audiodeviceelement.h"
 #include "audiodeviceelementsettings.h"
 #include "audiodev.h"
+#include "audioringbuffer.h"
+#include "silencedetector.h"
 
 #define PAUSE_TIMEOUT 500
 #define DUMMY_OUTPUT_DEVICE ":dummyout:"
@@ -59,13 +62,28 @@ class AudioDeviceElementPrivate
         AkElementPtr m_convert {AkElement::create("ACapsConvert")};
         QThreadPool m_threadPool;
         QFuture<void> m_readFramesLoopResult;
+        QFuture<void> m_writeFramesLoopResult;
         QMutex m_mutex;
         QMutex m_mutexLib;
+        QMutex m_outputMutex;
+        QMutex m_enqueueMutex;
+        QWaitCondition m_outputNotEmpty;
+        QWaitCondition m_outputNotFull;
+        AudioRingBuffer m_outputBuffer;
+        SilenceDetector m_silenceDetector;
+        AkAudioCaps m_outputCaps;
+        int m_outputTimeout {1};
         bool m_readFramesLoop {false};
+        bool m_writeFramesLoop {false};
         bool m_pause {false};
+        bool m_silenceDetection {false};
+        bool m_dropSilence {false};
 
         explicit AudioDeviceElementPrivate(AudioDeviceElement *self);
         void readFramesLoop();
+        void writeFramesLoop();
+        bool startOutput();
+        void stopOutput();
         void setInputs(const QStringList &inputs);
         void setOutputs(const QStringList &outputs);
         void audioLibUpdated(const QString &audioLib);
@@ -158,11 +176,39 @@ int AudioDeviceElement::latency() const
     return 25;
 }
 
+bool AudioDeviceElement::lowLatency() const
+{
+    if (this->d->m_audioDevice)
+        return this->d->m_audioDevice->lowLatency();
+
+    return false;
+}
+
 AkAudioCaps AudioDeviceElement::caps() const
 {
     return this->d->m_caps;
 }
 
+bool AudioDeviceElement::silenceDetection() const
+{
+    return this->d->m_silenceDetection;
+}
+
+qreal AudioDeviceElement::silenceThreshold() const
+{
+    return this->d->m_silenceDetector.threshold();
+}
+
+int AudioDeviceElement::silenceHangover() const
+{
+    return this->d->m_silenceDetector.hangover();
+}
+
+bool AudioDeviceElement::dropSilence() const
+{
+    return this->d->m_dropSilence;
+}
+
 AkAudioCaps AudioDeviceElement::preferredFormat(const QString &device)
 {
     if (device == DUMMY_OUTPUT_DEVICE)
@@ -263,9 +309,23 @@ void AudioDeviceElementPrivate::readFramesLoop()
     AkFrac timeBase(1, caps.rate());
 
     if (this->m_audioDevice->init(device, caps)) {
+        // The pts is calculated from the number of captured samples, and it's
+        // anchored to the monotonic clock, so it does not jump when the wall
+        // clock changes.
+        QElapsedTimer timer;
+        timer.start();
+        qint64 clockOffset = timer.msecsSinceReference() * caps.rate() / 1000;
+        qint64 maxDrift =
+                qMax(2 * qint64(this->m_audioDevice->latency()) * caps.rate() / 1000,
+                     qint64(1));
+        qint64 ptsOffset = 0;
+        qint64 capturedSamples = -1;
+        this->m_silenceDetector.reset();
+
         while (this->m_readFramesLoop) {
             if (this->m_pause) {
                 QThread::msleep(PAUSE_TIMEOUT);
+                capturedSamples = -1;
 
                 continue;
             }
@@ -275,18 +335,37 @@ void AudioDeviceElementPrivate::readFramesLoop()
             if (buffer.isEmpty())
                 return;
 
-            QByteArray oBuffer(buffer.size(), 0);
-            memcpy(oBuffer.data(), buffer.constData(), size_t(buffer.size()));
-            auto pts = qint64(QTime::currentTime().msecsSinceStartOfDay()
-                              / timeBase.value() / 1e3);
-            caps.setSamples(8 * buffer.size() / (caps.channels() * caps.bps()));
+            int samples = 8 * buffer.size() / (caps.channels() * caps.bps());
+
+            // Time at which the first sample of the buffer was captured.
+            qint64 clockPts = clockOffset
+                            + timer.nsecsElapsed() / 1000 * caps.rate() / 1000000
+                            - samples;
+
+            if (capturedSamples < 0
+                || qAbs(clockPts - ptsOffset - capturedSamples) > maxDrift) {
+                ptsOffset = clockPts;
+                capturedSamples = 0;
+            }
+
+            caps.setSamples(samples);
             AkAudioPacket packet;
             packet.caps() = caps;
-            packet.buffer() = oBuffer;
-            packet.setPts(pts);
+            packet.buffer() = buffer;
+            packet.setPts(ptsOffset + capturedSamples);
             packet.setTimeBase(timeBase);
             packet.setIndex(0);
             packet.setId(streamId);
+            capturedSamples += samples;
+
+            if (this->m_silenceDetection
+                && this->m_silenceDetector.isSilence(packet)) {
+                if (this->m_dropSilence)
+                    continue;
+
+                packet.setFlags(packet.flags()
+                                | AkAudioPacket::PacketFlag_Silence);
+            }
 
             emit self->oStream(packet);
         }
@@ -300,6 +379,87 @@ void AudioDeviceElementPrivate::readFramesLoop()
 #endif
 }
 
+void AudioDeviceElementPrivate::writeFramesLoop()
+{
+    AkAudioCaps caps(this->m_outputCaps);
+    int frameSize = caps.channels() * caps.bps() / 8;
+    int periodSize = frameSize * this->m_audioDevice->periodSamples(caps.rate());
+    QByteArray period(periodSize, Qt::Uninitialized);
+
+    while (this->m_writeFramesLoop) {
+        int bytes = this->m_outputBuffer.read(period.data(), periodSize);
+
+        if (bytes < 1) {
+            this->m_outputMutex.lock();
+            this->m_outputNotEmpty.wait(&this->m_outputMutex,
+                                        ulong(this->m_outputTimeout));
+            this->m_outputMutex.unlock();
+
+            continue;
+        }
+
+        this->m_outputNotFull.wakeAll();
+        caps.setSamples(bytes / frameSize);
+        AkAudioPacket packet;
+        packet.caps() = caps;
+        packet.buffer() = QByteArray(period.constData(), bytes);
+
+        this->m_mutexLib.lock();
+        this->m_audioDevice->write(packet);
+        this->m_mutexLib.unlock();
+    }
+}
+
+bool AudioDeviceElementPrivate::startOutput()
+{
+    QString device = this->m_device;
+    AkAudioCaps caps(this->m_caps);
+
+    this->m_mutexLib.lock();
+    auto isInit = this->m_audioDevice->init(device, caps);
+    this->m_mutexLib.unlock();
+
+    if (!isInit)
+        return false;
+
+    // Keep up to twice the latency queued between the pipeline and the
+    // device.
+    int frameSize = caps.channels() * caps.bps() / 8;
+    int latencySamples = qMax(this->m_audioDevice->latency() * caps.rate() / 1000,
+                              1);
+    this->m_enqueueMutex.lock();
+    this->m_outputBuffer.resize(2 * frameSize * latencySamples);
+    this->m_enqueueMutex.unlock();
+    this->m_outputCaps = caps;
+    this->m_outputTimeout =
+            qMax(1000 * this->m_audioDevice->periodSamples(caps.rate())
+                 / caps.rate(), 1);
+    this->m_writeFramesLoop = true;
+    this->m_writeFramesLoopResult =
+            QtConcurrent::run(&this->m_threadPool,
+                              this,
+                              &AudioDeviceElementPrivate::writeFramesLoop);
+
+    return true;
+}
+
+void AudioDeviceElementPrivate::stopOutput()
+{
+    this->m_writeFramesLoop = false;
+    this->m_outputNotEmpty.wakeAll();
+    this->m_outputNotFull.wakeAll();
+    this->m_writeFramesLoopResult.waitForFinished();
+
+    this->m_mutexLib.lock();
+    this->m_audioDevice->uninit();
+    this->m_mutexLib.unlock();
+
+    // Wait until no one is writing to the buffer.
+    this->m_enqueueMutex.lock();
+    this->m_outputBuffer.clear();
+    this->m_enqueueMutex.unlock();
+}
+
 void AudioDeviceElementPrivate::setInputs(const QStringList &inputs)
 {
     if (this->m_inputs == inputs)
@@ -327,9 +487,12 @@ void AudioDeviceElementPrivate::audioLibUpdated(const QString &audioLib)
 
     this->m_mutexLib.lock();
     int latency = 25;
+    bool lowLatency = false;
 
-    if (this->m_audioDevice)
+    if (this->m_audioDevice) {
         latency = this->m_audioDevice->latency();
+        lowLatency = this->m_audioDevice->lowLatency();
+    }
 
     this->m_audioDevice =
             ptr_cast<AudioDev>(AudioDeviceElement::loadSubModule("AudioDevice",
@@ -355,6 +518,10 @@ void AudioDeviceElementPrivate::audioLibUpdated(const QString &audioLib)
                      &AudioDev::latencyChanged,
                      self,
                      &AudioDeviceElement::latencyChanged);
+    QObject::connect(this->m_audioDevice.data(),
+                     &AudioDev::lowLatencyChanged,
+                     self,
+                     &AudioDeviceElement::lowLatencyChanged);
     QObject::connect(this->m_audioDevice.data(),
                      &AudioDev::inputsChanged,
                      [this] (const QStringList &inputs) {
@@ -367,6 +534,7 @@ void AudioDeviceElementPrivate::audioLibUpdated(const QString &audioLib)
                      });
 
     this->m_audioDevice->setLatency(latency);
+    this->m_audioDevice->setLowLatency(lowLatency);
     this->setInputs(this->m_audioDevice->inputs());
     this->setOutputs(this->m_audioDevice->outputs());
     emit self->defaultInputChanged(this->m_audioDevice->defaultInput());
@@ -414,10 +582,37 @@ AkPacket AudioDeviceElement::iAudioStream(const AkAudioPacket &packet)
 
         this->d->m_mutex.unlock();
 
+        // Queue the samples, the writer thread will send them to the device.
+        auto data = iPacket.buffer().constData();
+        int size = iPacket? iPacket.buffer().size(): 0;
+        this->d->m_enqueueMutex.lock();
+
+        while (size > 0 && this->d->m_writeFramesLoop) {
+            int bytes = this->d->m_outputBuffer.write(data, size);
+
+            if (bytes > 0)
+                this->d->m_outputNotEmpty.wakeAll();
+
+            if (bytes < size) {
+                this->d->m_outputMutex.lock();
+                this->d->m_outputNotFull.wait(&this->d->m_outputMutex,
+                                              ulong(this->d->m_outputTimeout));
+                this->d->m_outputMutex.unlock();
+            }
+
+            data += bytes;
+            size -= bytes;
+        }
+
+        this->d->m_enqueueMutex.unlock();
+
         if (iPacket) {
-            this->d->m_mutexLib.lock();
-            this->d->m_audioDevice->write(iPacket);
-            this->d->m_mutexLib.unlock();
+            AkAudioCaps caps(iPacket.caps());
+            int frameSize = caps.channels() * caps.bps() / 8;
+
+            if (frameSize > 0)
+                this->statsQueueDepth(this->d->m_outputBuffer.available()
+                                      / frameSize);
         }
     }
 
@@ -439,6 +634,12 @@ void AudioDeviceElement::setLatency(int latency)
         this->d->m_audioDevice->setLatency(latency);
 }
 
+void AudioDeviceElement::setLowLatency(bool lowLatency)
+{
+    if (this->d->m_audioDevice)
+        this->d->m_audioDevice->setLowLatency(lowLatency);
+}
+
 void AudioDeviceElement::setCaps(const AkAudioCaps &caps)
 {
     if (this->d->m_caps == caps)
@@ -452,6 +653,42 @@ void AudioDeviceElement::setCaps(const AkAudioCaps &caps)
     emit this->capsChanged(caps);
 }
 
+void AudioDeviceElement::setSilenceDetection(bool silenceDetection)
+{
+    if (this->d->m_silenceDetection == silenceDetection)
+        return;
+
+    this->d->m_silenceDetection = silenceDetection;
+    emit this->silenceDetectionChanged(silenceDetection);
+}
+
+void AudioDeviceElement::setSilenceThreshold(qreal silenceThreshold)
+{
+    if (qFuzzyCompare(this->d->m_silenceDetector.threshold(), silenceThreshold))
+        return;
+
+    this->d->m_silenceDetector.setThreshold(silenceThreshold);
+    emit this->silenceThresholdChanged(silenceThreshold);
+}
+
+void AudioDeviceElement::setSilenceHangover(int silenceHangover)
+{
+    if (this->d->m_silenceDetector.hangover() == silenceHangover)
+        return;
+
+    this->d->m_silenceDetector.setHangover(silenceHangover);
+    emit this->silenceHangoverChanged(silenceHangover);
+}
+
+void AudioDeviceElement::setDropSilence(bool dropSilence)
+{
+    if (this->d->m_dropSilence == dropSilence)
+        return;
+
+    this->d->m_dropSilence = dropSilence;
+    emit this->dropSilenceChanged(dropSilence);
+}
+
 void AudioDeviceElement::resetDevice()
 {
     this->setDevice("");
@@ -463,6 +700,12 @@ void AudioDeviceElement::resetLatency()
         this->d->m_audioDevice->resetLatency();
 }
 
+void AudioDeviceElement::resetLowLatency()
+{
+    if (this->d->m_audioDevice)
+        this->d->m_audioDevice->resetLowLatency();
+}
+
 void AudioDeviceElement::resetCaps()
 {
     this->d->m_mutexLib.lock();
@@ -472,6 +715,26 @@ void AudioDeviceElement::resetCaps()
     this->setCaps(preferredFormat);
 }
 
+void AudioDeviceElement::resetSilenceDetection()
+{
+    this->setSilenceDetection(false);
+}
+
+void AudioDeviceElement::resetSilenceThreshold()
+{
+    this->setSilenceThreshold(-50.0);
+}
+
+void AudioDeviceElement::resetSilenceHangover()
+{
+    this->setSilenceHangover(500);
+}
+
+void AudioDeviceElement::resetDropSilence()
+{
+    this->setDropSilence(false);
+}
+
 bool AudioDeviceElement::setState(AkElement::ElementState state)
 {
     if (!this->d->m_audioDevice)
@@ -507,14 +770,8 @@ bool AudioDeviceElement::setState(AkElement::ElementState state)
             } else if (this->d->m_device != DUMMY_OUTPUT_DEVICE
                        && this->d->m_outputs.contains(this->d->m_device)) {
                 this->d->m_convert->setState(state);
-                QString device = this->d->m_device;
-                AkAudioCaps caps(this->d->m_caps);
-
-                this->d->m_mutexLib.lock();
-                auto isInit = this->d->m_audioDevice->init(device, caps);
-                this->d->m_mutexLib.unlock();
 
-                if (!isInit)
+                if (!this->d->startOutput())
                     return false;
             }
 
@@ -536,9 +793,7 @@ bool AudioDeviceElement::setState(AkElement::ElementState state)
                 this->d->m_convert->setState(state);
             } else if (this->d->m_device != DUMMY_OUTPUT_DEVICE
                        && this->d->m_outputs.contains(this->d->m_device)) {
-                this->d->m_mutexLib.lock();
-                this->d->m_audioDevice->uninit();
-                this->d->m_mutexLib.unlock();
+                this->d->stopOutput();
 
                 this->d->m_convert->setState(state);
             }
@@ -551,14 +806,8 @@ bool AudioDeviceElement::setState(AkElement::ElementState state)
             } else if (this->d->m_device != DUMMY_OUTPUT_DEVICE
                        && this->d->m_outputs.contains(this->d->m_device)) {
                 this->d->m_convert->setState(state);
-                QString device = this->d->m_device;
-                AkAudioCaps caps(this->d->m_caps);
-
-                this->d->m_mutexLib.lock();
-                auto isInit = this->d->m_audioDevice->init(device, caps);
-                this->d->m_mutexLib.unlock();
 
-                if (!isInit)
+                if (!this->d->startOutput())
                     return false;
             }
 
@@ -579,9 +828,7 @@ bool AudioDeviceElement::setState(AkElement::ElementState state)
                 this->d->m_convert->setState(state);
             } else if (this->d->m_device != DUMMY_OUTPUT_DEVICE
                        && this->d->m_outputs.contains(this->d->m_device)) {
-                this->d->m_mutexLib.lock();
-                this->d->m_audioDevice->uninit();
-                this->d->m_mutexLib.unlock();
+                this->d->stopOutput();
                 this->d->m_convert->setState(state);
             }
 
@@ -592,9 +839,7 @@ bool AudioDeviceElement::setState(AkElement::ElementState state)
                 this->d->m_convert->setState(state);
             } else if (this->d->m_device != DUMMY_OUTPUT_DEVICE
                        && this->d->m_outputs.contains(this->d->m_device)) {
-                this->d->m_mutexLib.lock();
-                this->d->m_audioDevice->uninit();
-                this->d->m_mutexLib.unlock();
+                this->d->stopOutput();
                 this->d->m_convert->setState(state);
             }
 
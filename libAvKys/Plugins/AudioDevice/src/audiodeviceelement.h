@@ -51,11 +51,40 @@ class AudioDeviceElement: public AkElement
                WRITE setLatency
                RESET resetLatency
                NOTIFY latencyChanged)
+    Q_PROPERTY(bool lowLatency
+               READ lowLatency
+               WRITE setLowLatency
+               RESET resetLowLatency
+               NOTIFY lowLatencyChanged)
     Q_PROPERTY(AkAudioCaps caps
                READ caps
                WRITE setCaps
                RESET resetCaps
                NOTIFY capsChanged)
+    // Mark the captured packets that only contain silence.
+    Q_PROPERTY(bool silenceDetection
+               READ silenceDetection
+               WRITE setSilenceDetection
+               RESET resetSilenceDetection
+               NOTIFY silenceDetectionChanged)
+    // In dBFS
+    Q_PROPERTY(qreal silenceThreshold
+               READ silenceThreshold
+               WRITE setSilenceThreshold
+               RESET resetSilenceThreshold
+               NOTIFY silenceThresholdChanged)
+    // In milliseconds
+    Q_PROPERTY(int silenceHangover
+               READ silenceHangover
+               WRITE setSilenceHangover
+               RESET resetSilenceHangover
+               NOTIFY silenceHangoverChanged)
+    // Discard the silent packets instead of marking them.
+    Q_PROPERTY(bool dropSilence
+               READ dropSilence
+               WRITE setDropSilence
+               RESET resetDropSilence
+               NOTIFY dropSilenceChanged)
 
     public:
         AudioDeviceElement();
@@ -68,7 +97,12 @@ class AudioDeviceElement: public AkElement
         Q_INVOKABLE QString description(const QString &device);
         Q_INVOKABLE QString device() const;
         Q_INVOKABLE int latency() const;
+        Q_INVOKABLE bool lowLatency() const;
         Q_INVOKABLE AkAudioCaps caps() const;
+        Q_INVOKABLE bool silenceDetection() const;
+        Q_INVOKABLE qreal silenceThreshold() const;
+        Q_INVOKABLE int silenceHangover() const;
+        Q_INVOKABLE bool dropSilence() const;
         Q_INVOKABLE AkAudioCaps preferredFormat(const QString &device);
         Q_INVOKABLE QList<AkAudioCaps::SampleFormat> supportedFormats(const QString &device);
         Q_INVOKABLE QList<AkAudioCaps::ChannelLayout> supportedChannelLayouts(const QString &device);
@@ -87,15 +121,30 @@ class AudioDeviceElement: public AkElement
         void outputsChanged(const QStringList &outputs);
         void deviceChanged(const QString &device);
         void latencyChanged(int latency);
+        void lowLatencyChanged(bool lowLatency);
         void capsChanged(const AkAudioCaps &caps);
+        void silenceDetectionChanged(bool silenceDetection);
+        void silenceThresholdChanged(qreal silenceThreshold);
+        void silenceHangoverChanged(int silenceHangover);
+        void dropSilenceChanged(bool dropSilence);
 
     public slots:
         void setDevice(const QString &device);
         void setLatency(int latency);
+        void setLowLatency(bool lowLatency);
         void setCaps(const AkAudioCaps &caps);
+        void setSilenceDetection(bool silenceDetection);
+        void setSilenceThreshold(qreal silenceThreshold);
+        void setSilenceHangover(int silenceHangover);
+        void setDropSilence(bool dropSilence);
         void resetDevice();
         void resetLatency();
+        void resetLowLatency();
         void resetCaps();
+        void resetSilenceDetection();
+        void resetSilenceThreshold();
+        void resetSilenceHangover();
+        void resetDropSilence();
         bool setState(AkElement::ElementState state);
 };
 
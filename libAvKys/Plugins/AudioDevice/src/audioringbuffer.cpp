@@ -0,0 +1,146 @@
+/* Webcamoid, webcam capture application.
+ * Copyright (C) 2020  Gonzalo Exequiel Pedone
+ *
+ * Webcamoid is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Webcamoid is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Webcamoid. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Web-Site: http://webcamoid.github.io/
+ */
+
+#include <QAtomicInteger>
+#include <QByteArray>
+
+#include "audioringbuffer.h"
+
+class AudioRingBufferPrivate
+{
+    public:
+        QByteArray m_buffer;
+        char *m_data {nullptr};
+        quint32 m_mask {0};
+
+        // Read and write positions only grow, the position in the buffer is
+        // obtained masking them, and the unsigned difference gives the
+        // number of bytes stored even after wrapping.
+        QAtomicInteger<quint32> m_readPos {0};
+        QAtomicInteger<quint32> m_writePos {0};
+};
+
+AudioRingBuffer::AudioRingBuffer(int size)
+{
+    this->d = new AudioRingBufferPrivate;
+    this->resize(size);
+}
+
+AudioRingBuffer::~AudioRingBuffer()
+{
+    delete this->d;
+}
+
+int AudioRingBuffer::size() const
+{
+    return this->d->m_buffer.size();
+}
+
+int AudioRingBuffer::available() const
+{
+    return int(this->d->m_writePos.loadAcquire()
+               - this->d->m_readPos.loadAcquire());
+}
+
+int AudioRingBuffer::free() const
+{
+    return this->d->m_buffer.size() - this->available();
+}
+
+void AudioRingBuffer::resize(int size)
+{
+    // Round up to a power of 2.
+    int bufferSize = 1;
+
+    while (bufferSize < size)
+        bufferSize <<= 1;
+
+    if (size < 1)
+        bufferSize = 0;
+
+    this->d->m_buffer = QByteArray(bufferSize, 0);
+    this->d->m_data = this->d->m_buffer.data();
+    this->d->m_mask = quint32(qMax(bufferSize - 1, 0));
+    this->clear();
+}
+
+void AudioRingBuffer::clear()
+{
+    this->d->m_readPos.storeRelease(0);
+    this->d->m_writePos.storeRelease(0);
+}
+
+int AudioRingBuffer::write(const char *data, int size)
+{
+    auto writePos = this->d->m_writePos.loadAcquire();
+    auto readPos = this->d->m_readPos.loadAcquire();
+    int bufferSize = this->d->m_buffer.size();
+    size = qMin(size, bufferSize - int(writePos - readPos));
+
+    if (size < 1)
+        return 0;
+
+    auto offset = int(writePos & this->d->m_mask);
+    auto buffer = this->d->m_data;
+    int first = qMin(size, bufferSize - offset);
+    memcpy(buffer + offset, data, size_t(first));
+
+    if (size > first)
+        memcpy(buffer, data + first, size_t(size - first));
+
+    this->d->m_writePos.storeRelease(writePos + quint32(size));
+
+    return size;
+}
+
+int AudioRingBuffer::read(char *data, int size)
+{
+    auto readPos = this->d->m_readPos.loadAcquire();
+    auto writePos = this->d->m_writePos.loadAcquire();
+    size = qMin(size, int(writePos - readPos));
+
+    if (size < 1)
+        return 0;
+
+    auto offset = int(readPos & this->d->m_mask);
+    auto buffer = this->d->m_data;
+    int first = qMin(size, this->d->m_buffer.size() - offset);
+    memcpy(data, buffer + offset, size_t(first));
+
+    if (size > first)
+        memcpy(data + first, buffer, size_t(size - first));
+
+    this->d->m_readPos.storeRelease(readPos + quint32(size));
+
+    return size;
+}
+
+int AudioRingBuffer::skip(int size)
+{
+    auto readPos = this->d->m_readPos.loadAcquire();
+    auto writePos = this->d->m_writePos.loadAcquire();
+    size = qMin(size, int(writePos - readPos));
+
+    if (size < 1)
+        return 0;
+
+    this->d->m_readPos.storeRelease(readPos + quint32(size));
+
+    return size;
+}
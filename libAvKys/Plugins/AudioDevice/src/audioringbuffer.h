@@ -0,0 +1,51 @@
+/* Webcamoid, webcam capture application.
+ * Copyright (C) 2020  Gonzalo Exequiel Pedone
+ *
+ * Webcamoid is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Webcamoid is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Webcamoid. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Web-Site: http://webcamoid.github.io/
+ */
+
+#ifndef AUDIORINGBUFFER_H
+#define AUDIORINGBUFFER_H
+
+#include <QtGlobal>
+
+class AudioRingBufferPrivate;
+
+// Lock-free single producer/single consumer ring buffer. write() must be
+// called always from the same thread, and read() and skip() from another
+// thread. resize() and clear() are not thread safe.
+class AudioRingBuffer
+{
+    public:
+        AudioRingBuffer(int size=0);
+        ~AudioRingBuffer();
+
+        int size() const;
+        int available() const;
+        int free() const;
+        void resize(int size);
+        void clear();
+        int write(const char *data, int size);
+        int read(char *data, int size);
+        int skip(int size);
+
+    private:
+        AudioRingBufferPrivate *d;
+
+        Q_DISABLE_COPY(AudioRingBuffer)
+};
+
+#endif // AUDIORINGBUFFER_H
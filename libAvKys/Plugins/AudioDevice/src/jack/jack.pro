@@ -32,6 +32,7 @@ HEADERS = \
     src/plugin.h \
     src/audiodevjack.h \
     ../audiodev.h \
+    ../audioringbuffer.h \
     src/jackserver.h \
     src/jackservertypedefs.h
 
@@ -53,6 +54,7 @@ SOURCES = \
     src/plugin.cpp \
     src/audiodevjack.cpp \
     ../audiodev.cpp \
+    ../audioringbuffer.cpp \
     src/jackserver.cpp
 
 akModule = AudioDevice
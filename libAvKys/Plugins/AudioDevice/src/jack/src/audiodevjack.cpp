@@ -17,6 +17,7 @@
  * Web-Site: http://webcamoid.github.io/
  */
 
+#include <QAtomicInt>
 #include <QCoreApplication>
 #include <QMap>
 #include <QVector>
@@ -28,6 +29,7 @@
 
 #include "audiodevjack.h"
 #include "jackserver.h"
+#include "audioringbuffer.h"
 
 using JackErrorCodes = QMap<jack_status_t, QString>;
 
@@ -63,15 +65,17 @@ class AudioDevJackPrivate
         QMap<QString, QStringList> m_devicePorts;
         QList<jack_port_t *> m_appPorts;
         QString m_curDevice;
-        QByteArray m_buffer;
+        AudioRingBuffer m_buffer;
+        QVector<jack_default_audio_sample_t> m_interleaved;
         jack_client_t *m_client {nullptr};
         QMutex m_mutex;
         QWaitCondition m_canWrite;
         QWaitCondition m_samplesAvailable;
         int m_samples {0};
         int m_sampleRate {0};
-        int m_curChannels {0};
+        QAtomicInt m_curChannels {0};
         int m_maxBufferSize {0};
+        int m_waitTimeout {1};
         bool m_isInput {false};
 
         static int onProcessCallback(jack_nframes_t nframes, void *userData);
@@ -232,8 +236,7 @@ bool AudioDevJack::init(const QString &device, const AkAudioCaps &caps)
         return false;
 
     this->d->m_appPorts.clear();
-    this->d->m_curChannels = 0;
-    this->d->m_buffer.clear();
+    this->d->m_curChannels.storeRelease(0);
 
     QString portName = device == ":jackinput:"?
                            "input": "output";
@@ -263,6 +266,21 @@ bool AudioDevJack::init(const QString &device, const AkAudioCaps &caps)
     }
 
     auto bufferSize = jack_get_buffer_size(this->d->m_client);
+    this->d->m_curDevice = device;
+    this->d->m_maxBufferSize = int((this->lowLatency()? 1: 2)
+                             * sizeof(jack_default_audio_sample_t)
+                             * uint(caps.channels())
+                             * bufferSize);
+    this->d->m_isInput = device == ":jackinput:";
+    this->d->m_samples = this->periodSamples(caps.rate());
+    this->d->m_waitTimeout = qMax(1000 * this->d->m_samples / caps.rate(), 1);
+
+    // The process callback runs in a real time thread, so it must not
+    // allocate memory nor block on a mutex. The buffers are ready before
+    // the callback can see the number of channels.
+    this->d->m_interleaved.resize(caps.channels() * int(bufferSize));
+    this->d->m_buffer.resize(2 * this->d->m_maxBufferSize);
+    this->d->m_curChannels.storeRelease(caps.channels());
 
     // Activate JACK client
 
@@ -302,53 +320,71 @@ bool AudioDevJack::init(const QString &device, const AkAudioCaps &caps)
         }
     }
 
-    this->d->m_curDevice = device;
-    this->d->m_curChannels = caps.channels();
-    this->d->m_maxBufferSize = int(2
-                             * sizeof(jack_default_audio_sample_t)
-                             * uint(caps.channels())
-                             * bufferSize);
-    this->d->m_isInput = device == ":jackinput:";
-    this->d->m_samples = qMax(this->latency() * caps.rate() / 1000, 1);
-
     return true;
 }
 
 QByteArray AudioDevJack::read()
 {
+    int channels = this->d->m_curChannels.loadAcquire();
     int bufferSize = 2
                      * int(sizeof(jack_default_audio_sample_t))
-                     * this->d->m_curChannels
+                     * channels
                      * this->d->m_samples;
 
-    QByteArray audioData;
+    QByteArray audioData(bufferSize, Qt::Uninitialized);
+    int k = int(sizeof(jack_default_audio_sample_t)) * channels;
+    int readBytes = 0;
+
+    while (readBytes < bufferSize && this->d->m_curChannels.loadAcquire() > 0) {
+        // Old samples are discarded if the reader can't keep up.
+        int excess = this->d->m_buffer.available() - this->d->m_maxBufferSize;
+
+        if (excess > 0)
+            this->d->m_buffer.skip(k * ((excess + k - 1) / k));
 
-    this->d->m_mutex.lock();
+        int bytes = this->d->m_buffer.read(audioData.data() + readBytes,
+                                           bufferSize - readBytes);
 
-    while (audioData.size() < bufferSize) {
-        if (this->d->m_buffer.size() < 1)
-            this->d->m_samplesAvailable.wait(&this->d->m_mutex);
+        if (bytes < 1) {
+            // The process callback does not hold the mutex when waking us,
+            // so wait with a timeout in case the notification was missed.
+            this->d->m_mutex.lock();
+            this->d->m_samplesAvailable.wait(&this->d->m_mutex,
+                                             ulong(this->d->m_waitTimeout));
+            this->d->m_mutex.unlock();
+        }
 
-        int copyBytes = qMin(this->d->m_buffer.size(),
-                             bufferSize - audioData.size());
-        audioData += this->d->m_buffer.mid(0, copyBytes);
-        this->d->m_buffer.remove(0, copyBytes);
+        readBytes += bytes;
     }
 
-    this->d->m_mutex.unlock();
+    audioData.resize(readBytes);
 
     return audioData;
 }
 
 bool AudioDevJack::write(const AkAudioPacket &packet)
 {
-    this->d->m_mutex.lock();
-
-    if (this->d->m_buffer.size() >= this->d->m_maxBufferSize)
-        this->d->m_canWrite.wait(&this->d->m_mutex);
+    auto data = packet.buffer().constData();
+    int size = packet.buffer().size();
+
+    while (size > 0 && this->d->m_curChannels.loadAcquire() > 0) {
+        int bytes = 0;
+
+        if (this->d->m_buffer.available() < this->d->m_maxBufferSize)
+            bytes = this->d->m_buffer.write(data,
+                                            qMin(size,
+                                                 this->d->m_buffer.free()));
+
+        if (bytes < 1) {
+            this->d->m_mutex.lock();
+            this->d->m_canWrite.wait(&this->d->m_mutex,
+                                     ulong(this->d->m_waitTimeout));
+            this->d->m_mutex.unlock();
+        }
 
-    this->d->m_buffer += packet.buffer();
-    this->d->m_mutex.unlock();
+        data += bytes;
+        size -= bytes;
+    }
 
     return true;
 }
@@ -361,8 +397,10 @@ bool AudioDevJack::uninit()
         jack_port_unregister(this->d->m_client, port);
 
     this->d->m_appPorts.clear();
-    this->d->m_curChannels = 0;
+    this->d->m_curChannels.storeRelease(0);
     this->d->m_buffer.clear();
+    this->d->m_samplesAvailable.wakeAll();
+    this->d->m_canWrite.wakeAll();
 
     return true;
 }
@@ -372,66 +410,64 @@ int AudioDevJackPrivate::onProcessCallback(jack_nframes_t nframes,
 {
     auto self = reinterpret_cast<AudioDevJack *>(userData);
 
+    int channels = self->d->m_curChannels.loadAcquire();
+
+    if (channels < 1 || self->d->m_appPorts.size() < channels)
+        return 0;
+
+    int k = int(sizeof(jack_default_audio_sample_t)) * channels;
+    auto interleaved = self->d->m_interleaved.data();
+    int maxFrames = self->d->m_interleaved.size() / channels;
+    jack_default_audio_sample_t *ports[2];
+
+    for (int c = 0; c < channels; c++)
+        ports[c] =
+                reinterpret_cast<jack_default_audio_sample_t *>(jack_port_get_buffer(self->d->m_appPorts[c],
+                                                                                      nframes));
+
     if (self->d->m_isInput) {
-        self->d->m_mutex.lock();
-        QVector<const jack_default_audio_sample_t *> ports;
-
-        for (auto &port: self->d->m_appPorts)
-            ports << reinterpret_cast<const jack_default_audio_sample_t *>(jack_port_get_buffer(port,
-                                                                                                nframes));
-
-        int samples = int(nframes) * self->d->m_curChannels;
-        auto oldLen = self->d->m_buffer.size();
-        self->d->m_buffer.resize(oldLen
-                                 + samples
-                                 * int(sizeof(jack_default_audio_sample_t)));
-        auto buffer = reinterpret_cast<jack_default_audio_sample_t *>(self->d->m_buffer.data())
-                      + oldLen;
-
-        // Copy samples
-        for (int i = 0; i < samples; i++)
-            buffer[i] = ports[i % self->d->m_curChannels][i / self->d->m_curChannels];
-
-        // We use a ring buffer and all old samples are discarded.
-        if (self->d->m_buffer.size() > self->d->m_maxBufferSize) {
-            int k = int(sizeof(jack_default_audio_sample_t))
-                    * self->d->m_curChannels;
-            int bufferSize = k * int(self->d->m_maxBufferSize / k);
-
-            self->d->m_buffer =
-                    self->d->m_buffer.mid(self->d->m_buffer.size() - bufferSize,
-                                          bufferSize);
+        // If the buffer is full the newest samples are dropped, the reader
+        // will discard the oldest ones when it falls behind.
+        for (int offset = 0; offset < int(nframes); offset += maxFrames) {
+            int frames = qMin(int(nframes) - offset, maxFrames);
+            frames = qMin(frames, self->d->m_buffer.free() / k);
+
+            if (frames < 1)
+                break;
+
+            for (int c = 0; c < channels; c++) {
+                auto port = ports[c] + offset;
+
+                for (int i = 0; i < frames; i++)
+                    interleaved[i * channels + c] = port[i];
+            }
+
+            self->d->m_buffer.write(reinterpret_cast<const char *>(interleaved),
+                                    frames * k);
         }
 
         self->d->m_samplesAvailable.wakeAll();
-        self->d->m_mutex.unlock();
     } else {
-        self->d->m_mutex.lock();
-        QVector<jack_default_audio_sample_t *> ports;
+        for (int c = 0; c < channels; c++)
+            std::fill_n(ports[c], nframes, 0.);
 
-        for (auto &port: self->d->m_appPorts) {
-            ports << reinterpret_cast<jack_default_audio_sample_t *>(jack_port_get_buffer(port,
-                                                                                          nframes));
-            std::fill_n(ports.last(), nframes, 0.);
-        }
-
-        auto buffer = reinterpret_cast<const jack_default_audio_sample_t *>(self->d->m_buffer.constData());
-        int samples = qMin(self->d->m_buffer.size() / int(sizeof(jack_default_audio_sample_t)),
-                           int(nframes) * self->d->m_curChannels);
+        for (int offset = 0; offset < int(nframes); offset += maxFrames) {
+            int frames = qMin(int(nframes) - offset, maxFrames);
+            frames = self->d->m_buffer.read(reinterpret_cast<char *>(interleaved),
+                                            frames * k) / k;
 
-        // Copy samples
-        for (int i = 0; i < samples; i++)
-            ports[i % self->d->m_curChannels][i / self->d->m_curChannels] = buffer[i];
+            if (frames < 1)
+                break;
 
-        if (samples > 0)
-            self->d->m_buffer.remove(0,
-                                     samples
-                                     * int(sizeof(jack_default_audio_sample_t)));
+            for (int c = 0; c < channels; c++) {
+                auto port = ports[c] + offset;
 
-        if (self->d->m_buffer.size() <= self->d->m_maxBufferSize)
-            self->d->m_canWrite.wakeAll();
+                for (int i = 0; i < frames; i++)
+                    port[i] = interleaved[i * channels + c];
+            }
+        }
 
-        self->d->m_mutex.unlock();
+        self->d->m_canWrite.wakeAll();
     }
 
     return 0;
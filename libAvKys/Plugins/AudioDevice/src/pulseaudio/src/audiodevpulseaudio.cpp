@@ -350,6 +350,19 @@ bool AudioDevPulseAudio::init(const QString &device, const AkAudioCaps &caps)
                              device) != this->d->m_sources.cend();
     this->d->m_mutex.unlock();
 
+    int periodSamples = this->periodSamples(caps.rate());
+    auto frameSize = uint32_t(this->d->m_curBps * this->d->m_curChannels);
+
+    // Ask the server for small fragments instead of letting it choose the
+    // buffering, which may be up to 2 seconds long.
+    pa_buffer_attr bufferAttr;
+    bufferAttr.maxlength = uint32_t(-1);
+    bufferAttr.tlength = frameSize
+                       * uint32_t(qMax(this->latency() * caps.rate() / 1000, 1));
+    bufferAttr.prebuf = uint32_t(-1);
+    bufferAttr.minreq = frameSize * uint32_t(periodSamples);
+    bufferAttr.fragsize = bufferAttr.minreq;
+
     this->d->m_paSimple =
             pa_simple_new(nullptr,
                           QCoreApplication::applicationName().toStdString().c_str(),
@@ -358,7 +371,7 @@ bool AudioDevPulseAudio::init(const QString &device, const AkAudioCaps &caps)
                           QCoreApplication::organizationName().toStdString().c_str(),
                           &ss,
                           nullptr,
-                          nullptr,
+                          this->lowLatency()? &bufferAttr: nullptr,
                           &error);
 
     if (!this->d->m_paSimple) {
@@ -368,7 +381,7 @@ bool AudioDevPulseAudio::init(const QString &device, const AkAudioCaps &caps)
         return false;
     }
 
-    this->d->m_samples = qMax(this->latency() * caps.rate() / 1000, 1);
+    this->d->m_samples = periodSamples;
 
     return true;
 }
@@ -0,0 +1,168 @@
+/* Webcamoid, webcam capture application.
+ * Copyright (C) 2020  Gonzalo Exequiel Pedone
+ *
+ * Webcamoid is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Webcamoid is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Webcamoid. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Web-Site: http://webcamoid.github.io/
+ */
+
+#include <QtMath>
+#include <akaudiocaps.h>
+#include <akaudiopacket.h>
+
+#include "silencedetector.h"
+
+// Weak blocks are only considered voice if they are at least this much
+// above the threshold, or if they don't look like broadband noise.
+#define NOISE_MARGIN 6.0
+
+// Voice rarely crosses zero more often than this, white noise does it about
+// half of the samples.
+#define MAX_VOICE_ZCR 0.35
+
+class SilenceDetectorPrivate
+{
+    public:
+        qreal m_threshold {-50.0};
+        int m_hangover {500};
+        qint64 m_silentSamples {0};
+
+        template<typename T>
+        inline static void analyze(const AkAudioPacket &packet,
+                                   qreal zero,
+                                   qreal scale,
+                                   qreal &power,
+                                   qreal &zcr)
+        {
+            auto caps = packet.caps();
+            int samples = caps.samples();
+            int channels = caps.channels();
+            qreal sum = 0.0;
+
+            for (int channel = 0; channel < channels; channel++) {
+                auto data = packet.constPlaneSpan<T>(channel);
+
+                for (int i = 0; i < samples; i++) {
+                    auto value = (qreal(data[i]) - zero) * scale;
+                    sum += value * value;
+                }
+            }
+
+            power = sum / (samples * channels);
+
+            // The zero crossings are counted in the first channel only.
+            auto data = packet.constPlaneSpan<T>(0);
+            int crossings = 0;
+            bool positive = qreal(data[0]) >= zero;
+
+            for (int i = 1; i < samples; i++) {
+                bool isPositive = qreal(data[i]) >= zero;
+                crossings += isPositive != positive;
+                positive = isPositive;
+            }
+
+            zcr = qreal(crossings) / samples;
+        }
+};
+
+SilenceDetector::SilenceDetector()
+{
+    this->d = new SilenceDetectorPrivate;
+}
+
+SilenceDetector::~SilenceDetector()
+{
+    delete this->d;
+}
+
+qreal SilenceDetector::threshold() const
+{
+    return this->d->m_threshold;
+}
+
+int SilenceDetector::hangover() const
+{
+    return this->d->m_hangover;
+}
+
+void SilenceDetector::setThreshold(qreal threshold)
+{
+    this->d->m_threshold = threshold;
+}
+
+void SilenceDetector::setHangover(int hangover)
+{
+    this->d->m_hangover = hangover;
+}
+
+void SilenceDetector::reset()
+{
+    this->d->m_silentSamples = 0;
+}
+
+bool SilenceDetector::isSilence(const AkAudioPacket &packet)
+{
+    auto caps = packet.caps();
+
+    if (caps.samples() < 1 || caps.channels() < 1 || caps.rate() < 1)
+        return false;
+
+    qreal power = 0.0;
+    qreal zcr = 0.0;
+
+    switch (caps.format()) {
+    case AkAudioCaps::SampleFormat_u8:
+        SilenceDetectorPrivate::analyze<quint8>(packet, 128.0, 1.0 / 128.0, power, zcr);
+
+        break;
+    case AkAudioCaps::SampleFormat_s16:
+        SilenceDetectorPrivate::analyze<qint16>(packet, 0.0, 1.0 / 32768.0, power, zcr);
+
+        break;
+    case AkAudioCaps::SampleFormat_s32:
+        SilenceDetectorPrivate::analyze<qint32>(packet, 0.0, 1.0 / 2147483648.0, power, zcr);
+
+        break;
+    case AkAudioCaps::SampleFormat_flt:
+        SilenceDetectorPrivate::analyze<float>(packet, 0.0, 1.0, power, zcr);
+
+        break;
+    default: {
+        auto fltPacket = packet.convertFormat(AkAudioCaps::SampleFormat_flt);
+
+        if (!fltPacket)
+            return false;
+
+        SilenceDetectorPrivate::analyze<float>(fltPacket, 0.0, 1.0, power, zcr);
+
+        break;
+    }
+    }
+
+    auto level = power > 0.0? 10.0 * log10(power): -200.0;
+    bool active = level > this->d->m_threshold
+                  && (level > this->d->m_threshold + NOISE_MARGIN
+                      || zcr < MAX_VOICE_ZCR);
+
+    if (active) {
+        this->d->m_silentSamples = 0;
+
+        return false;
+    }
+
+    this->d->m_silentSamples += caps.samples();
+
+    return 1000 * this->d->m_silentSamples
+           >= qint64(this->d->m_hangover) * caps.rate();
+}
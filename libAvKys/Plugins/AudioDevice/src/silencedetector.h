@@ -0,0 +1,54 @@
+/* Webcamoid, webcam capture application.
+ * Copyright (C) 2020  Gonzalo Exequiel Pedone
+ *
+ * Webcamoid is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Webcamoid is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Webcamoid. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Web-Site: http://webcamoid.github.io/
+ */
+
+#ifndef SILENCEDETECTOR_H
+#define SILENCEDETECTOR_H
+
+#include <QtGlobal>
+
+class SilenceDetectorPrivate;
+class AkAudioPacket;
+
+// Cheap voice activity detector, the blocks are classified using their
+// energy and zero crossing rate.
+class SilenceDetector
+{
+    public:
+        SilenceDetector();
+        ~SilenceDetector();
+
+        // Level in dBFS below which a block is considered silence.
+        qreal threshold() const;
+
+        // Time in milliseconds that the voice state is kept after the last
+        // active block, so short pauses are not cut.
+        int hangover() const;
+
+        void setThreshold(qreal threshold);
+        void setHangover(int hangover);
+        void reset();
+        bool isSilence(const AkAudioPacket &packet);
+
+    private:
+        SilenceDetectorPrivate *d;
+
+        Q_DISABLE_COPY(SilenceDetector)
+};
+
+#endif // SILENCEDETECTOR_H
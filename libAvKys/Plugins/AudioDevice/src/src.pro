@@ -33,7 +33,9 @@ HEADERS = \
     audiodeviceelement.h \
     audiodeviceelementsettings.h \
     audiodeviceglobals.h \
-    audiodev.h
+    audiodev.h \
+    audioringbuffer.h \
+    silencedetector.h
 
 INCLUDEPATH += \
     ../../../Lib/src
@@ -50,7 +52,9 @@ SOURCES = \
     audiodeviceelement.cpp \
     audiodeviceelementsettings.cpp \
     audiodeviceglobals.cpp \
-    audiodev.cpp
+    audiodev.cpp \
+    audioringbuffer.cpp \
+    silencedetector.cpp
 
 DESTDIR = $${OUT_PWD}/../$${BIN_DIR}
 TARGET = AudioDevice
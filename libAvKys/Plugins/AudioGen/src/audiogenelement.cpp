@@ -20,9 +20,9 @@
 #include <QFuture>
 #include <QMap>
 #include <QMutex>
-#include <QRandomGenerator>
 #include <QSharedPointer>
 #include <QThreadPool>
+#include <QVector>
 #include <QTime>
 #include <QtConcurrent>
 #include <QtMath>
@@ -47,6 +47,11 @@
 // We use about AUDIO_DIFF_AVG_NB A-V differences to make the average
 #define AUDIO_DIFF_AVG_NB 20
 
+#define WAVETABLE_BITS 11
+#define WAVETABLE_SIZE (1 << WAVETABLE_BITS)
+#define WAVETABLE_FRAC_BITS (32 - WAVETABLE_BITS)
+#define NOISE_SEED 0x12345678
+
 using WaveTypeMap = QMap<AudioGenElement::WaveType, QString>;
 
 inline WaveTypeMap initWaveTypeMap()
@@ -65,6 +70,29 @@ inline WaveTypeMap initWaveTypeMap()
 
 Q_GLOBAL_STATIC_WITH_ARGS(WaveTypeMap, waveTypeToStr, (initWaveTypeMap()))
 
+// Band-limited wavetable oscillator, the phase is kept between blocks.
+class AudioGenOscillator
+{
+    public:
+        void reset();
+        void generate(float *buffer,
+                      int samples,
+                      AudioGenElement::WaveType waveType,
+                      qreal frequency,
+                      qreal volume,
+                      int rate);
+
+    private:
+        QVector<float> m_table;
+        AudioGenElement::WaveType m_waveType {AudioGenElement::WaveTypeSilence};
+        int m_harmonics {0};
+        quint32 m_phase {0};
+        quint32 m_seed {NOISE_SEED};
+
+        void updateTable(AudioGenElement::WaveType waveType, int harmonics);
+        static const QVector<qreal> &sineTable();
+};
+
 class AudioGenElementPrivate
 {
     public:
@@ -74,6 +102,7 @@ class AudioGenElementPrivate
             44100
         };
         AkElementPtr m_audioConvert {AkElement::create("ACapsConvert")};
+        AudioGenOscillator m_oscillator;
         QThreadPool m_threadPool;
         QFuture<void> m_readFramesLoopResult;
         QMutex m_mutex;
@@ -131,6 +160,56 @@ qreal AudioGenElement::sampleDuration() const
     return this->d->m_sampleDuration;
 }
 
+qint64 AudioGenElement::render(qreal duration)
+{
+    if (!this->d->m_audioConvert
+        || duration <= 0
+        || this->state() != AkElement::ElementStateNull)
+        return 0;
+
+    this->d->m_mutex.lock();
+    int rate = this->d->m_caps.rate();
+    qreal sampleDuration = this->d->m_sampleDuration;
+    this->d->m_mutex.unlock();
+
+    if (rate < 1)
+        return 0;
+
+    AkAudioCaps audioCaps(AkAudioCaps::SampleFormat_flt,
+                          AkAudioCaps::Layout_mono,
+                          rate);
+    int blockSamples = qMax(qRound(rate * sampleDuration / 1.e3), 1);
+    auto totalSamples = qRound64(duration * rate);
+    auto id = Ak::id();
+
+    // Using a new oscillator makes the output the same on every call.
+    AudioGenOscillator oscillator;
+    this->d->m_audioConvert->setState(AkElement::ElementStatePlaying);
+    qint64 pts = 0;
+
+    while (pts < totalSamples) {
+        int nSamples = int(qMin(qint64(blockSamples), totalSamples - pts));
+        audioCaps.setSamples(nSamples);
+        AkAudioPacket packet(audioCaps);
+        oscillator.generate(reinterpret_cast<float *>(packet.planeData(0)),
+                            nSamples,
+                            this->d->m_waveType,
+                            this->d->m_frequency,
+                            this->d->m_volume,
+                            rate);
+        packet.setPts(pts);
+        packet.setTimeBase(AkFrac(1, rate));
+        packet.setIndex(0);
+        packet.setId(id);
+        (*this->d->m_audioConvert)(packet);
+        pts += nSamples;
+    }
+
+    this->d->m_audioConvert->setState(AkElement::ElementStateNull);
+
+    return pts;
+}
+
 void AudioGenElement::setCaps(const AkAudioCaps &caps)
 {
     if (this->d->m_caps == caps)
@@ -312,10 +391,11 @@ void AudioGenElementPrivate::readFramesLoop()
     this->m_mutex.lock();
     int rate = this->m_caps.rate();
     qreal sampleDuration = this->m_sampleDuration;
-    AkAudioCaps audioCaps(AkAudioCaps::SampleFormat_s32,
+    AkAudioCaps audioCaps(AkAudioCaps::SampleFormat_flt,
                           AkAudioCaps::Layout_mono,
                           rate);
     this->m_mutex.unlock();
+    this->m_oscillator.reset();
 
     while (this->m_readFramesLoop) {
         if (this->m_pause) {
@@ -361,51 +441,12 @@ void AudioGenElementPrivate::readFramesLoop()
 
         audioCaps.setSamples(nSamples);
         AkAudioPacket iPacket(audioCaps);
-        qreal time = QTime::currentTime().msecsSinceStartOfDay() / 1.e3;
-        qreal tdiff = 1. / audioCaps.rate();
-
-        if (this->m_waveType == AudioGenElement::WaveTypeSilence) {
-            iPacket.buffer().fill(0);
-        } else if (this->m_waveType == AudioGenElement::WaveTypeWhiteNoise) {
-            for (auto &c: iPacket.buffer())
-                c = char(QRandomGenerator::global()->bounded(-128, 127));
-        } else {
-            auto ampMax = qint32(this->m_volume * std::numeric_limits<qint32>::max());
-            auto ampMin = qint32(this->m_volume * std::numeric_limits<qint32>::min());
-            auto t = time;
-            auto buff = reinterpret_cast<qint32 *>(iPacket.buffer().data());
-
-            if (this->m_waveType == AudioGenElement::WaveTypeSine) {
-                for  (int i = 0; i < nSamples; i++, time += tdiff)
-                    buff[i] = qRound(ampMax * qSin(2 * M_PI * this->m_frequency * t));
-            } else if (this->m_waveType == AudioGenElement::WaveTypeSquare) {
-                for  (int i = 0; i < nSamples; i++, time += tdiff)
-                    buff[i] = (qRound(2 * this->m_frequency * t) & 0x1)?
-                                  ampMin: ampMax;
-            } else {
-                qint32 mod = qRound(audioCaps.rate() / this->m_frequency);
-
-                if (this->m_waveType == AudioGenElement::WaveTypeSawtooth) {
-                    qreal k = (qreal(ampMax) - ampMin) / (mod - 1);
-
-                    for  (int i = 0; i < nSamples; i++, time += tdiff) {
-                        qint32 nsample = qRound(t / tdiff);
-                        buff[i] = qRound(k * (nsample % mod) + ampMin);
-                    }
-                } else if (this->m_waveType == AudioGenElement::WaveTypeTriangle) {
-                    mod /= 2;
-                    qreal k = (qreal(ampMax) - ampMin) / (mod - 1);
-
-                    for  (int i = 0; i < nSamples; i++, time += tdiff) {
-                        qint32 nsample = qRound(t / tdiff);
-
-                        buff[i] = (qRound(2 * this->m_frequency * t) & 0x1)?
-                                      qRound(-k * (nsample % mod) + ampMax):
-                                      qRound( k * (nsample % mod) + ampMin);
-                    }
-                }
-            }
-        }
+        this->m_oscillator.generate(reinterpret_cast<float *>(iPacket.planeData(0)),
+                                    nSamples,
+                                    this->m_waveType,
+                                    this->m_frequency,
+                                    this->m_volume,
+                                    audioCaps.rate());
 
         iPacket.pts() = pts;
         iPacket.timeBase() = AkFrac(1, audioCaps.rate());
@@ -418,4 +459,146 @@ void AudioGenElementPrivate::readFramesLoop()
     }
 }
 
+void AudioGenOscillator::reset()
+{
+    this->m_phase = 0;
+    this->m_seed = NOISE_SEED;
+}
+
+void AudioGenOscillator::generate(float *buffer,
+                                  int samples,
+                                  AudioGenElement::WaveType waveType,
+                                  qreal frequency,
+                                  qreal volume,
+                                  int rate)
+{
+    auto amplitude = float(volume);
+
+    if (waveType == AudioGenElement::WaveTypeWhiteNoise) {
+        auto seed = this->m_seed;
+
+        // Xorshift generator, fast and reproducible.
+        for (int i = 0; i < samples; i++) {
+            seed ^= seed << 13;
+            seed ^= seed >> 17;
+            seed ^= seed << 5;
+            buffer[i] = amplitude * float(qint32(seed)) / 2147483648.0f;
+        }
+
+        this->m_seed = seed;
+
+        return;
+    }
+
+    if (waveType == AudioGenElement::WaveTypeSilence
+        || rate < 1
+        || frequency <= 0) {
+        std::fill_n(buffer, samples, 0.0f);
+
+        return;
+    }
+
+    frequency = qMin(frequency, rate / 2.0);
+
+    // Only the harmonics below the Nyquist frequency are added to the table.
+    int harmonics = waveType == AudioGenElement::WaveTypeSine?
+                        1:
+                        qBound(1,
+                               int(rate / (2 * frequency)),
+                               WAVETABLE_SIZE / 2 - 1);
+    this->updateTable(waveType, harmonics);
+
+    auto increment = quint32(qRound64(frequency * 4294967296.0 / rate));
+    auto table = this->m_table.constData();
+    auto phase = this->m_phase;
+    const quint32 fracMask = (1u << WAVETABLE_FRAC_BITS) - 1;
+    const float fracScale = 1.0f / float(1u << WAVETABLE_FRAC_BITS);
+
+    for (int i = 0; i < samples; i++) {
+        auto index = phase >> WAVETABLE_FRAC_BITS;
+        auto frac = float(phase & fracMask) * fracScale;
+        auto a = table[index];
+        auto b = table[index + 1];
+        buffer[i] = amplitude * (a + frac * (b - a));
+        phase += increment;
+    }
+
+    this->m_phase = phase;
+}
+
+void AudioGenOscillator::updateTable(AudioGenElement::WaveType waveType,
+                                     int harmonics)
+{
+    if (this->m_waveType == waveType
+        && this->m_harmonics == harmonics
+        && !this->m_table.isEmpty())
+        return;
+
+    auto &sine = sineTable();
+    QVector<qreal> wave(WAVETABLE_SIZE, 0.0);
+
+    // Fourier series of each wave, sin(k * x) is read from the sine table.
+    for (int k = 1; k <= harmonics; k++) {
+        qreal amp = 0.0;
+
+        switch (waveType) {
+        case AudioGenElement::WaveTypeSine:
+            amp = k == 1? 1.0: 0.0;
+
+            break;
+        case AudioGenElement::WaveTypeSquare:
+            amp = k & 0x1? 1.0 / k: 0.0;
+
+            break;
+        case AudioGenElement::WaveTypeTriangle:
+            amp = k & 0x1? (k & 0x2? -1.0: 1.0) / (k * k): 0.0;
+
+            break;
+        case AudioGenElement::WaveTypeSawtooth:
+            amp = (k & 0x1? 1.0: -1.0) / k;
+
+            break;
+        default:
+            break;
+        }
+
+        if (qFuzzyIsNull(amp))
+            continue;
+
+        for (int i = 0; i < WAVETABLE_SIZE; i++)
+            wave[i] += amp * sine[(k * i) & (WAVETABLE_SIZE - 1)];
+    }
+
+    qreal peak = 0.0;
+
+    for (auto &sample: wave)
+        peak = qMax(peak, qAbs(sample));
+
+    qreal k = qFuzzyIsNull(peak)? 0.0: 1.0 / peak;
+
+    // The extra sample avoids wrapping the index when interpolating.
+    this->m_table.resize(WAVETABLE_SIZE + 1);
+
+    for (int i = 0; i < WAVETABLE_SIZE; i++)
+        this->m_table[i] = float(k * wave[i]);
+
+    this->m_table[WAVETABLE_SIZE] = this->m_table[0];
+    this->m_waveType = waveType;
+    this->m_harmonics = harmonics;
+}
+
+const QVector<qreal> &AudioGenOscillator::sineTable()
+{
+    static const QVector<qreal> sine = [] () {
+        QVector<qreal> sine(WAVETABLE_SIZE);
+
+        for (int i = 0; i < WAVETABLE_SIZE; i++)
+            sine[i] = qSin(2 * M_PI * i / WAVETABLE_SIZE);
+
+        return sine;
+    } ();
+
+    return sine;
+}
+
 #include "moc_audiogenelement.cpp"
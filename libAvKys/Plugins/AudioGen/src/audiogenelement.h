@@ -75,6 +75,10 @@ class AudioGenElement: public AkElement
         Q_INVOKABLE qreal volume() const;
         Q_INVOKABLE qreal sampleDuration() const;
 
+        // Generate duration seconds of audio as fast as possible, the
+        // element must be stopped. Returns the number of samples sent.
+        Q_INVOKABLE qint64 render(qreal duration);
+
     private:
         AudioGenElementPrivate *d;
 
@@ -0,0 +1,455 @@
+/* Webcamoid, webcam capture application.
+ * Copyright (C) 2020  Gonzalo Exequiel Pedone
+ *
+ * Webcamoid is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Webcamoid is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Webcamoid. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Web-Site: http://webcamoid.github.io/
+ */
+
+#include <QElapsedTimer>
+#include <QMap>
+#include <QMutex>
+#include <QSharedPointer>
+#include <QVector>
+#include <ak.h>
+#include <akfrac.h>
+#include <akpacket.h>
+#include <akaudiocaps.h>
+#include <akaudiopacket.h>
+
+#include "audiomixerelement.h"
+
+class AudioMixerInput
+{
+    public:
+        AkElementPtr m_convert;
+        QVector<float> m_samples;
+        int m_head {0};
+        qint64 m_lastPacket {0};
+        qint64 m_ptsOffset {0};
+        bool m_hasPtsOffset {false};
+
+        inline int available(int channels) const
+        {
+            return (this->m_samples.size() - this->m_head) / channels;
+        }
+};
+
+class AudioMixerElementPrivate
+{
+    public:
+        AkAudioCaps m_caps {
+            AkAudioCaps::SampleFormat_s16,
+            AkAudioCaps::Layout_stereo,
+            44100
+        };
+        QMap<qint64, AudioMixerInput> m_inputs;
+        QMap<qint64, qreal> m_gains;
+        QVector<float> m_mix;
+        QElapsedTimer m_clock;
+        QMutex m_mutex;
+        qint64 m_id {Ak::id()};
+        qint64 m_mixPts {-1};
+        int m_latency {25};
+        int m_jitterBuffer {100};
+        qreal m_volume {1.0};
+
+        AkAudioCaps mixCaps() const;
+        void push(AudioMixerInput &input, const AkAudioPacket &packet);
+        bool removeStaleInputs();
+        QList<AkAudioPacket> mix();
+};
+
+AudioMixerElement::AudioMixerElement():
+    AkElement()
+{
+    this->d = new AudioMixerElementPrivate;
+    this->d->m_clock.start();
+}
+
+AudioMixerElement::~AudioMixerElement()
+{
+    this->setState(AkElement::ElementStateNull);
+    delete this->d;
+}
+
+AkAudioCaps AudioMixerElement::caps() const
+{
+    return this->d->m_caps;
+}
+
+QList<qint64> AudioMixerElement::inputs() const
+{
+    this->d->m_mutex.lock();
+    auto inputs = this->d->m_inputs.keys();
+    this->d->m_mutex.unlock();
+
+    return inputs;
+}
+
+int AudioMixerElement::latency() const
+{
+    return this->d->m_latency;
+}
+
+int AudioMixerElement::jitterBuffer() const
+{
+    return this->d->m_jitterBuffer;
+}
+
+qreal AudioMixerElement::volume() const
+{
+    this->d->m_mutex.lock();
+    auto volume = this->d->m_volume;
+    this->d->m_mutex.unlock();
+
+    return volume;
+}
+
+qreal AudioMixerElement::gain(qint64 input) const
+{
+    this->d->m_mutex.lock();
+    auto gain = this->d->m_gains.value(input, 1.0);
+    this->d->m_mutex.unlock();
+
+    return gain;
+}
+
+AkPacket AudioMixerElement::iAudioStream(const AkAudioPacket &packet)
+{
+    if (this->state() != AkElement::ElementStatePlaying)
+        return {};
+
+    this->d->m_mutex.lock();
+    auto it = this->d->m_inputs.find(packet.id());
+    bool inputsChanged = false;
+
+    if (it == this->d->m_inputs.end()) {
+        AudioMixerInput input;
+        input.m_convert = AkElement::create("ACapsConvert");
+
+        if (!input.m_convert) {
+            this->d->m_mutex.unlock();
+
+            return {};
+        }
+
+        input.m_convert->setProperty("caps",
+                                     QVariant::fromValue(this->d->mixCaps()));
+        input.m_convert->setState(AkElement::ElementStatePlaying);
+        it = this->d->m_inputs.insert(packet.id(), input);
+        inputsChanged = true;
+    }
+
+    AkAudioPacket iPacket = it->m_convert->iStream(packet);
+
+    if (iPacket)
+        this->d->push(*it, iPacket);
+
+    it->m_lastPacket = this->d->m_clock.elapsed();
+    inputsChanged |= this->d->removeStaleInputs();
+    auto packets = this->d->mix();
+    auto inputs = this->d->m_inputs.keys();
+    this->d->m_mutex.unlock();
+
+    if (inputsChanged)
+        emit this->inputsChanged(inputs);
+
+    for (auto &oPacket: packets)
+        emit this->oStream(oPacket);
+
+    return {};
+}
+
+void AudioMixerElement::setCaps(const AkAudioCaps &caps)
+{
+    if (this->d->m_caps == caps)
+        return;
+
+    // The inputs will be created again with the new format.
+    this->d->m_mutex.lock();
+    this->d->m_caps = caps;
+    bool inputsChanged = !this->d->m_inputs.isEmpty();
+    this->d->m_inputs.clear();
+    this->d->m_mixPts = -1;
+    this->d->m_mutex.unlock();
+
+    emit this->capsChanged(caps);
+
+    if (inputsChanged)
+        emit this->inputsChanged({});
+}
+
+void AudioMixerElement::setLatency(int latency)
+{
+    if (this->d->m_latency == latency)
+        return;
+
+    this->d->m_mutex.lock();
+    this->d->m_latency = latency;
+    this->d->m_mutex.unlock();
+    emit this->latencyChanged(latency);
+}
+
+void AudioMixerElement::setJitterBuffer(int jitterBuffer)
+{
+    if (this->d->m_jitterBuffer == jitterBuffer)
+        return;
+
+    this->d->m_mutex.lock();
+    this->d->m_jitterBuffer = jitterBuffer;
+    this->d->m_mutex.unlock();
+    emit this->jitterBufferChanged(jitterBuffer);
+}
+
+void AudioMixerElement::setVolume(qreal volume)
+{
+    this->d->m_mutex.lock();
+
+    if (qFuzzyCompare(this->d->m_volume, volume)) {
+        this->d->m_mutex.unlock();
+
+        return;
+    }
+
+    this->d->m_volume = volume;
+    this->d->m_mutex.unlock();
+    emit this->volumeChanged(volume);
+}
+
+void AudioMixerElement::setGain(qint64 input, qreal gain)
+{
+    this->d->m_mutex.lock();
+
+    if (qFuzzyCompare(this->d->m_gains.value(input, 1.0), gain)) {
+        this->d->m_mutex.unlock();
+
+        return;
+    }
+
+    this->d->m_gains[input] = gain;
+    this->d->m_mutex.unlock();
+    emit this->gainChanged(input, gain);
+}
+
+void AudioMixerElement::resetCaps()
+{
+    this->setCaps({AkAudioCaps::SampleFormat_s16,
+                   AkAudioCaps::Layout_stereo,
+                   44100});
+}
+
+void AudioMixerElement::resetLatency()
+{
+    this->setLatency(25);
+}
+
+void AudioMixerElement::resetJitterBuffer()
+{
+    this->setJitterBuffer(100);
+}
+
+void AudioMixerElement::resetVolume()
+{
+    this->setVolume(1.0);
+}
+
+void AudioMixerElement::resetGain(qint64 input)
+{
+    this->setGain(input, 1.0);
+}
+
+bool AudioMixerElement::setState(AkElement::ElementState state)
+{
+    if (state == AkElement::ElementStateNull) {
+        this->d->m_mutex.lock();
+        bool inputsChanged = !this->d->m_inputs.isEmpty();
+        this->d->m_inputs.clear();
+        this->d->m_mixPts = -1;
+        this->d->m_mutex.unlock();
+
+        if (inputsChanged)
+            emit this->inputsChanged({});
+    }
+
+    return AkElement::setState(state);
+}
+
+AkAudioCaps AudioMixerElementPrivate::mixCaps() const
+{
+    return {AkAudioCaps::SampleFormat_flt,
+            this->m_caps.layout(),
+            this->m_caps.rate()};
+}
+
+void AudioMixerElementPrivate::push(AudioMixerInput &input,
+                                    const AkAudioPacket &packet)
+{
+    int channels = this->m_caps.channels();
+    int rate = this->m_caps.rate();
+    int samples = packet.caps().samples();
+
+    if (channels < 1 || rate < 1 || samples < 1)
+        return;
+
+    auto data = reinterpret_cast<const float *>(packet.constPlaneData(0));
+    auto pts = qRound64(qreal(packet.pts())
+                        * packet.timeBase().value()
+                        * rate);
+
+    if (this->m_mixPts < 0)
+        this->m_mixPts = pts;
+
+    // Each input can count the time from a different origin, so its time
+    // stamps are moved to the mixing clock when its first packet arrives.
+    if (!input.m_hasPtsOffset) {
+        input.m_ptsOffset = this->m_mixPts + input.available(channels) - pts;
+        input.m_hasPtsOffset = true;
+    }
+
+    pts += input.m_ptsOffset;
+
+    // The jitter buffer of each input always starts at the current mixing
+    // position, so the samples are aligned by padding with silence or
+    // dropping them. Small deviations are ignored to keep the stream
+    // continuous.
+    auto diff = pts - (this->m_mixPts + input.available(channels));
+    int tolerance = qMax(rate * this->m_latency / 2000, 1);
+    int maxSamples = qMax(rate * this->m_jitterBuffer / 1000, 1);
+    int padding = 0;
+
+    if (diff > tolerance) {
+        padding = int(qMin(diff, qint64(maxSamples)));
+    } else if (diff < -tolerance) {
+        auto skip = int(qMin(-diff, qint64(samples)));
+        data += skip * channels;
+        samples -= skip;
+    }
+
+    if (input.m_head > 0 && 2 * input.m_head >= input.m_samples.size()) {
+        input.m_samples.remove(0, input.m_head);
+        input.m_head = 0;
+    }
+
+    auto oldSize = input.m_samples.size();
+    input.m_samples.resize(oldSize + (padding + samples) * channels);
+    auto buffer = input.m_samples.data() + oldSize;
+    std::fill_n(buffer, padding * channels, 0.0f);
+    memcpy(buffer + padding * channels,
+           data,
+           size_t(samples * channels) * sizeof(float));
+}
+
+bool AudioMixerElementPrivate::removeStaleInputs()
+{
+    auto now = this->m_clock.elapsed();
+    bool removed = false;
+
+    for (auto it = this->m_inputs.begin(); it != this->m_inputs.end();)
+        if (now - it->m_lastPacket > 2 * this->m_jitterBuffer) {
+            it = this->m_inputs.erase(it);
+            removed = true;
+        } else {
+            ++it;
+        }
+
+    if (this->m_inputs.isEmpty())
+        this->m_mixPts = -1;
+
+    return removed;
+}
+
+QList<AkAudioPacket> AudioMixerElementPrivate::mix()
+{
+    QList<AkAudioPacket> packets;
+    int channels = this->m_caps.channels();
+    int rate = this->m_caps.rate();
+
+    if (channels < 1 || rate < 1)
+        return packets;
+
+    int period = qMax(rate * this->m_latency / 1000, 1);
+    int maxSamples = qMax(rate * this->m_jitterBuffer / 1000, period);
+    AkFrac timeBase(1, rate);
+    auto mixCaps = this->mixCaps();
+    mixCaps.setSamples(period);
+    int mixSize = period * channels;
+
+    while (!this->m_inputs.isEmpty()) {
+        // Wait until all inputs have enough samples, unless one of them
+        // exceeds the jitter buffer, in that case the late inputs are
+        // filled with silence.
+        bool ready = true;
+        bool overflow = false;
+
+        for (auto &input: this->m_inputs) {
+            auto available = input.available(channels);
+
+            if (available < period)
+                ready = false;
+
+            if (available >= maxSamples)
+                overflow = true;
+        }
+
+        if (!ready && !overflow)
+            break;
+
+        // The mixing buffer is reused between calls.
+        this->m_mix.resize(mixSize);
+        auto mix = this->m_mix.data();
+        std::fill_n(mix, mixSize, 0.0f);
+
+        for (auto it = this->m_inputs.begin(); it != this->m_inputs.end(); it++) {
+            auto gain = float(this->m_gains.value(it.key(), 1.0)
+                              * this->m_volume);
+            int samples = qMin(it->available(channels), period) * channels;
+            auto in = it->m_samples.constData() + it->m_head;
+
+            for (int i = 0; i < samples; i++)
+                mix[i] += gain * in[i];
+
+            it->m_head += samples;
+
+            if (it->m_head >= it->m_samples.size()) {
+                it->m_samples.resize(0);
+                it->m_head = 0;
+            }
+        }
+
+        AkAudioPacket packet(mixCaps);
+        auto out = reinterpret_cast<float *>(packet.planeData(0));
+
+        for (int i = 0; i < mixSize; i++)
+            out[i] = qBound(-1.0f, mix[i], 1.0f);
+
+        if (this->m_caps.format() != AkAudioCaps::SampleFormat_flt
+            || this->m_caps.planar())
+            packet = packet.convert(this->m_caps);
+
+        if (!packet)
+            break;
+
+        packet.setPts(this->m_mixPts);
+        packet.setTimeBase(timeBase);
+        packet.setIndex(0);
+        packet.setId(this->m_id);
+        packets << packet;
+        this->m_mixPts += period;
+    }
+
+    return packets;
+}
+
+#include "moc_audiomixerelement.cpp"
@@ -0,0 +1,98 @@
+/* Webcamoid, webcam capture application.
+ * Copyright (C) 2020  Gonzalo Exequiel Pedone
+ *
+ * Webcamoid is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Webcamoid is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Webcamoid. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Web-Site: http://webcamoid.github.io/
+ */
+
+#ifndef AUDIOMIXERELEMENT_H
+#define AUDIOMIXERELEMENT_H
+
+#include <akelement.h>
+
+class AudioMixerElementPrivate;
+class AkAudioCaps;
+
+// Mix all the audio streams received, each stream is identified by the id of
+// its packets.
+class AudioMixerElement: public AkElement
+{
+    Q_OBJECT
+    Q_PROPERTY(AkAudioCaps caps
+               READ caps
+               WRITE setCaps
+               RESET resetCaps
+               NOTIFY capsChanged)
+    Q_PROPERTY(QList<qint64> inputs
+               READ inputs
+               NOTIFY inputsChanged)
+    // Duration of the mixed packets in milliseconds.
+    Q_PROPERTY(int latency
+               READ latency
+               WRITE setLatency
+               RESET resetLatency
+               NOTIFY latencyChanged)
+    // Maximum time in milliseconds to wait for a late input.
+    Q_PROPERTY(int jitterBuffer
+               READ jitterBuffer
+               WRITE setJitterBuffer
+               RESET resetJitterBuffer
+               NOTIFY jitterBufferChanged)
+    Q_PROPERTY(qreal volume
+               READ volume
+               WRITE setVolume
+               RESET resetVolume
+               NOTIFY volumeChanged)
+
+    public:
+        AudioMixerElement();
+        ~AudioMixerElement();
+
+        Q_INVOKABLE AkAudioCaps caps() const;
+        Q_INVOKABLE QList<qint64> inputs() const;
+        Q_INVOKABLE int latency() const;
+        Q_INVOKABLE int jitterBuffer() const;
+        Q_INVOKABLE qreal volume() const;
+        Q_INVOKABLE qreal gain(qint64 input) const;
+
+    private:
+        AudioMixerElementPrivate *d;
+
+    protected:
+        AkPacket iAudioStream(const AkAudioPacket &packet);
+
+    signals:
+        void capsChanged(const AkAudioCaps &caps);
+        void inputsChanged(const QList<qint64> &inputs);
+        void latencyChanged(int latency);
+        void jitterBufferChanged(int jitterBuffer);
+        void volumeChanged(qreal volume);
+        void gainChanged(qint64 input, qreal gain);
+
+    public slots:
+        void setCaps(const AkAudioCaps &caps);
+        void setLatency(int latency);
+        void setJitterBuffer(int jitterBuffer);
+        void setVolume(qreal volume);
+        void setGain(qint64 input, qreal gain);
+        void resetCaps();
+        void resetLatency();
+        void resetJitterBuffer();
+        void resetVolume();
+        void resetGain(qint64 input);
+        bool setState(AkElement::ElementState state);
+};
+
+#endif // AUDIOMIXERELEMENT_H
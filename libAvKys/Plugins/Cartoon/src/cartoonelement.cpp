@@ -19,15 +19,26 @@
 
 #include <limits>
 #include <QtMath>
-#include <QPainter>
-#include <QDateTime>
 #include <QMutex>
 #include <QQmlContext>
 #include <akpacket.h>
 #include <akvideopacket.h>
+#include <akfrac.h>
 
 #include "cartoonelement.h"
 
+// Number of entries of the RGB565 color space.
+#define N_COLORS16 (1 << 16)
+
+// Time (in milliseconds) that a palette is kept before selecting a new one.
+#define PALETTE_PERIOD 3000
+
+// Number of inverse-palette entries that will be filled for each frame.
+#define LUT_SLICE (N_COLORS16 / 16)
+
+// The histogram is attenuated by 1 / 2^HISTOGRAM_DECAY on each frame.
+#define HISTOGRAM_DECAY 3
+
 class CartoonElementPrivate
 {
     public:
@@ -38,25 +49,38 @@ class CartoonElementPrivate
         int m_thresholdHi {171};
         QRgb m_lineColor {qRgb(0, 0, 0)};
         QSize m_scanSize {320, 240};
+        QVector<quint32> m_histogram;
         QVector<QRgb> m_palette;
+        QVector<QRgb> m_nextPalette;
+        QVector<QRgb> m_colors;
+        QVector<quint8> m_gray;
+        int m_lutPos {-1};
         qint64 m_id {-1};
         qint64 m_lastTime {0};
+        qint64 m_frameCount {0};
         QMutex m_mutex;
 
-        QVector<QRgb> palette(const QImage &img,
-                              int ncolors,
-                              int colorDiff);
+        void updateHistogram(const QImage &img);
+        void selectColors(int ncolors, int colorDiff);
+        void updatePalette(int nentries);
+        const QVector<QRgb> &palette(const QImage &img,
+                                     qint64 time,
+                                     int ncolors,
+                                     int colorDiff);
         QRgb nearestColor(int *index,
                           int *diff,
                           const QVector<QRgb> &palette,
                           QRgb color) const;
-        QImage edges(const QImage &src,
-                     int thLow,
-                     int thHi,
-                     QRgb color) const;
-        int rgb24Torgb16(QRgb color);
-        void rgb16Torgb24(int *r, int *g, int *b, int color);
-        QRgb rgb16Torgb24(int color);
+        void drawEdges(const QImage &src,
+                       QImage &dst,
+                       int thLow,
+                       int thHi,
+                       QRgb color);
+        inline int rgb24Torgb16(QRgb color) const;
+        inline void rgb16Torgb24(int *r, int *g, int *b, int color) const;
+        inline QRgb rgb16Torgb24(int color) const;
+        qint64 frameTime(const AkVideoPacket &packet);
+        void reset();
 };
 
 CartoonElement::CartoonElement(): AkElement()
@@ -104,78 +128,122 @@ QSize CartoonElement::scanSize() const
     return this->d->m_scanSize;
 }
 
-QVector<QRgb> CartoonElementPrivate::palette(const QImage &img,
-                                             int ncolors,
-                                             int colorDiff)
+void CartoonElementPrivate::updateHistogram(const QImage &img)
 {
-    qint64 time = QDateTime::currentMSecsSinceEpoch();
+    if (this->m_histogram.size() != N_COLORS16)
+        this->m_histogram.fill(0, N_COLORS16);
 
-    // This code stabilize the color change between frames.
-    if (this->m_palette.isEmpty() || (time - this->m_lastTime) >= 3 * 1000) {
-        // Create a histogram of 66k colors.
-        QVector<QPair<int, int>> histogram(1 << 16);
+    auto histogram = this->m_histogram.data();
 
-        for (int i = 0; i < histogram.size(); i++)
-            histogram[i].second = i;
+    // Fade out the old samples, this way the palette follows the scene
+    // smoothly instead of jumping from one frame to another.
+    for (int i = 0; i < N_COLORS16; i++)
+        histogram[i] -= (histogram[i] + (1 << HISTOGRAM_DECAY) - 1)
+                        >> HISTOGRAM_DECAY;
 
-        for (int y = 0; y < img.height(); y++) {
-            const QRgb *line = reinterpret_cast<const QRgb *>(img.constScanLine(y));
+    for (int y = 0; y < img.height(); y++) {
+        auto line = reinterpret_cast<const QRgb *>(img.constScanLine(y));
 
-            for (int x = 0; x < img.width(); x++)
-                // Pixels must be converted from 24 bits to 16 bits color depth.
-                histogram[this->rgb24Torgb16(line[x])].first++;
-        }
+        for (int x = 0; x < img.width(); x++)
+            // Pixels must be converted from 24 bits to 16 bits color depth.
+            histogram[this->rgb24Torgb16(line[x])] += 1 << HISTOGRAM_DECAY;
+    }
+}
 
-        // Sort the histogram by weights.
-        std::sort(histogram.begin(), histogram.end());
-        QVector<QRgb> palette;
-
-        if (ncolors < 1)
-            ncolors = 1;
-
-        // Create a palette with n-colors, starting from tail.
-        for (int i = histogram.size() - 1; i >= 0 && palette.size() < ncolors; i--) {
-            int r;
-            int g;
-            int b;
-            this->rgb16Torgb24(&r, &g, &b, histogram[i].second);
-            bool add = true;
-
-            for (const QRgb &color: palette) {
-                int dr = r - qRed(color);
-                int dg = g - qGreen(color);
-                int db = b - qBlue(color);
-                int k = qRound(qSqrt(dr * dr + dg * dg + db * db));
-
-                // The color to add must be different enough for not repeating
-                // similar colors in the palette.
-                if (k < colorDiff) {
-                    add = false;
-
-                    break;
-                }
-            }
+void CartoonElementPrivate::selectColors(int ncolors, int colorDiff)
+{
+    if (ncolors < 1)
+        ncolors = 1;
+
+    // Only the used colors are candidates, and we just need the heaviest
+    // ones, so use a heap and pop colors until the palette is full instead
+    // of sorting the whole histogram.
+    QVector<QPair<quint32, int>> candidates;
+
+    for (int i = 0; i < this->m_histogram.size(); i++)
+        if (this->m_histogram[i] > 0)
+            candidates << QPair<quint32, int>(this->m_histogram[i], i);
 
-            if (add)
-                palette << qRgb(r, g, b);
+    std::make_heap(candidates.begin(), candidates.end());
+    auto end = candidates.end();
+    int colorDiff2 = colorDiff * colorDiff;
+    this->m_colors.clear();
+
+    while (end != candidates.begin() && this->m_colors.size() < ncolors) {
+        std::pop_heap(candidates.begin(), end);
+        end--;
+        int r;
+        int g;
+        int b;
+        this->rgb16Torgb24(&r, &g, &b, end->second);
+        bool add = true;
+
+        for (auto &color: this->m_colors) {
+            int dr = r - qRed(color);
+            int dg = g - qGreen(color);
+            int db = b - qBlue(color);
+
+            // The color to add must be different enough for not repeating
+            // similar colors in the palette.
+            if (dr * dr + dg * dg + db * db < colorDiff2) {
+                add = false;
+
+                break;
+            }
         }
 
-        // Create a look-up table for speed-up the conversion from 16-24 bits
-        // to palettized format.
-        this->m_palette.resize(1 << 16);
+        if (add)
+            this->m_colors << qRgb(r, g, b);
+    }
+}
+
+void CartoonElementPrivate::updatePalette(int nentries)
+{
+    if (this->m_lutPos < 0)
+        return;
+
+    if (this->m_nextPalette.size() != N_COLORS16)
+        this->m_nextPalette.resize(N_COLORS16);
+
+    auto end = qMin(this->m_lutPos + nentries, N_COLORS16);
 
-        for (int i = 0; i < this->m_palette.size(); i++)
-            this->m_palette[i] = this->nearestColor(nullptr,
+    for (int i = this->m_lutPos; i < end; i++)
+        this->m_nextPalette[i] = this->nearestColor(nullptr,
                                                     nullptr,
-                                                    palette,
+                                                    this->m_colors,
                                                     this->rgb16Torgb24(i));
 
+    this->m_lutPos = end;
+
+    if (this->m_lutPos >= N_COLORS16) {
+        std::swap(this->m_palette, this->m_nextPalette);
+        this->m_lutPos = -1;
+    }
+}
+
+const QVector<QRgb> &CartoonElementPrivate::palette(const QImage &img,
+                                                    qint64 time,
+                                                    int ncolors,
+                                                    int colorDiff)
+{
+    this->updateHistogram(img);
+
+    // This code stabilize the color change between frames.
+    if (this->m_lutPos < 0
+        && (this->m_palette.isEmpty()
+            || time < this->m_lastTime
+            || time - this->m_lastTime >= PALETTE_PERIOD)) {
+        this->selectColors(ncolors, colorDiff);
+        this->m_lutPos = 0;
         this->m_lastTime = time;
     }
 
-    QVector<QRgb> palette = this->m_palette;
+    // The look-up table for converting from 16 bits to the palettized format
+    // is built in slices, spreading the cost across several frames. If there
+    // is no palette yet, build it at once.
+    this->updatePalette(this->m_palette.isEmpty()? N_COLORS16: LUT_SLICE);
 
-    return palette;
+    return this->m_palette;
 }
 
 QRgb CartoonElementPrivate::nearestColor(int *index,
@@ -222,70 +290,88 @@ QRgb CartoonElementPrivate::nearestColor(int *index,
     return palette[index_];
 }
 
-QImage CartoonElementPrivate::edges(const QImage &src,
-                                    int thLow,
-                                    int thHi,
-                                    QRgb color) const
+void CartoonElementPrivate::drawEdges(const QImage &src,
+                                      QImage &dst,
+                                      int thLow,
+                                      int thHi,
+                                      QRgb color)
 {
-    QImage dst(src.size(), src.format());
-
     if (thLow > thHi)
         std::swap(thLow, thHi);
 
-    QVector<QRgb> colors(256);
+    int width = src.width();
+    int height = src.height();
+    this->m_gray.resize(width * height);
+    auto gray = this->m_gray.data();
+
+    // Calculate the luma only once per pixel.
+    for (int y = 0; y < height; y++) {
+        auto srcLine = reinterpret_cast<const QRgb *>(src.constScanLine(y));
+        auto grayLine = gray + y * width;
 
-    for (int i = 0; i < colors.size(); i++) {
-        int alpha = i < thLow? 0: i > thHi? 255: i;
-        colors[i] = qRgba(qRed(color), qGreen(color), qBlue(color), alpha);
+        for (int x = 0; x < width; x++)
+            grayLine[x] = quint8(qGray(srcLine[x]));
     }
 
-    for (int y = 0; y < src.height(); y++) {
-        const QRgb *srcLine = reinterpret_cast<const QRgb *>(src.constScanLine(y));
-        QRgb *dstLine = reinterpret_cast<QRgb *>(dst.scanLine(y));
+    int lr = qRed(color);
+    int lg = qGreen(color);
+    int lb = qBlue(color);
 
-        const QRgb *srcLine_m1 = y < 1? srcLine: srcLine - src.width();
-        const QRgb *srcLine_p1 = y >= src.height() - 1? srcLine: srcLine + src.width();
+    for (int y = 0; y < height; y++) {
+        auto grayLine = gray + y * width;
+        auto grayLine_m1 = y < 1? grayLine: grayLine - width;
+        auto grayLine_p1 = y >= height - 1? grayLine: grayLine + width;
+        auto dstLine = reinterpret_cast<QRgb *>(dst.scanLine(y));
 
-        for (int x = 0; x < src.width(); x++) {
+        for (int x = 0; x < width; x++) {
             int x_m1 = x < 1? x: x - 1;
-            int x_p1 = x >= src.width() - 1? x: x + 1;
+            int x_p1 = x >= width - 1? x: x + 1;
 
-            int s_m1_p1 = qGray(srcLine_m1[x_p1]);
-            int s_p1_p1 = qGray(srcLine_p1[x_p1]);
-            int s_m1_m1 = qGray(srcLine_m1[x_m1]);
-            int s_p1_m1 = qGray(srcLine_p1[x_m1]);
+            int s_m1_p1 = grayLine_m1[x_p1];
+            int s_p1_p1 = grayLine_p1[x_p1];
+            int s_m1_m1 = grayLine_m1[x_m1];
+            int s_p1_m1 = grayLine_p1[x_m1];
 
             int gradX = s_m1_p1
-                      + 2 * qGray(srcLine[x_p1])
+                      + 2 * grayLine[x_p1]
                       + s_p1_p1
                       - s_m1_m1
-                      - 2 * qGray(srcLine[x_m1])
+                      - 2 * grayLine[x_m1]
                       - s_p1_m1;
 
             int gradY = s_m1_m1
-                      + 2 * qGray(srcLine_m1[x])
+                      + 2 * grayLine_m1[x]
                       + s_m1_p1
                       - s_p1_m1
-                      - 2 * qGray(srcLine_p1[x])
+                      - 2 * grayLine_p1[x]
                       - s_p1_p1;
 
-            int grad = qAbs(gradX) + qAbs(gradY);
-            grad = qBound(0, grad, 255);
-            dstLine[x] = colors[grad];
+            int grad = qMin(qAbs(gradX) + qAbs(gradY), 255);
+            int alpha = grad < thLow? 0: grad > thHi? 255: grad;
+
+            if (alpha < 1)
+                continue;
+
+            // Blend the line over the palettized pixel.
+            QRgb pixel = dstLine[x];
+            int ialpha = 255 - alpha;
+            int r = (alpha * lr + ialpha * qRed(pixel)) / 255;
+            int g = (alpha * lg + ialpha * qGreen(pixel)) / 255;
+            int b = (alpha * lb + ialpha * qBlue(pixel)) / 255;
+            int a = alpha + ialpha * qAlpha(pixel) / 255;
+            dstLine[x] = qRgba(r, g, b, a);
         }
     }
-
-    return dst;
 }
 
-int CartoonElementPrivate::rgb24Torgb16(QRgb color)
+int CartoonElementPrivate::rgb24Torgb16(QRgb color) const
 {
     return ((qRed(color) >> 3) << 11)
             | ((qGreen(color) >> 2) << 5)
             | (qBlue(color) >> 3);
 }
 
-void CartoonElementPrivate::rgb16Torgb24(int *r, int *g, int *b, int color)
+void CartoonElementPrivate::rgb16Torgb24(int *r, int *g, int *b, int color) const
 {
     *r = (color >> 11) & 0x1f;
     *g = (color >> 5) & 0x3f;
@@ -295,7 +381,7 @@ void CartoonElementPrivate::rgb16Torgb24(int *r, int *g, int *b, int color)
     *b = 0xff * *b / 0x1f;
 }
 
-QRgb CartoonElementPrivate::rgb16Torgb24(int color)
+QRgb CartoonElementPrivate::rgb16Torgb24(int color) const
 {
     int r;
     int g;
@@ -305,6 +391,31 @@ QRgb CartoonElementPrivate::rgb16Torgb24(int color)
     return qRgb(r, g, b);
 }
 
+qint64 CartoonElementPrivate::frameTime(const AkVideoPacket &packet)
+{
+    // Use the stream clock instead of the wall clock, so the palette
+    // refresh rate doesn't depend on how fast the frames are processed.
+    if (packet.timeBase())
+        return qint64(1000 * packet.pts() * packet.timeBase().value());
+
+    auto fps = packet.caps().fps();
+
+    if (!fps || fps.num() < 1)
+        fps = AkFrac(30, 1);
+
+    return qint64(1000 * this->m_frameCount++ / fps.value());
+}
+
+void CartoonElementPrivate::reset()
+{
+    this->m_histogram.clear();
+    this->m_palette.clear();
+    this->m_colors.clear();
+    this->m_lutPos = -1;
+    this->m_lastTime = 0;
+    this->m_frameCount = 0;
+}
+
 QString CartoonElement::controlInterfaceProvide(const QString &controlId) const
 {
     Q_UNUSED(controlId)
@@ -340,36 +451,32 @@ AkPacket CartoonElement::iVideoStream(const AkVideoPacket &packet)
 
     if (this->d->m_id != packet.id()) {
         this->d->m_id = packet.id();
-        this->d->m_palette.clear();
-        this->d->m_lastTime = QDateTime::currentMSecsSinceEpoch();
+        this->d->reset();
     }
 
     // Palettize image.
-    QVector<QRgb> palette =
+    auto &palette =
             this->d->palette(src.scaled(scanSize, Qt::KeepAspectRatio),
+                             this->d->frameTime(packet),
                              this->d->m_ncolors,
                              this->d->m_colorDiff);
+    auto paletteData = palette.constData();
 
     for (int y = 0; y < src.height(); y++) {
         const QRgb *srcLine = reinterpret_cast<const QRgb *>(src.constScanLine(y));
         QRgb *dstLine = reinterpret_cast<QRgb *>(oFrame.scanLine(y));
 
         for (int x = 0; x < src.width(); x++)
-            dstLine[x] = palette[this->d->rgb24Torgb16(srcLine[x])];
+            dstLine[x] = paletteData[this->d->rgb24Torgb16(srcLine[x])];
     }
 
     // Draw the edges.
-    if (this->d->m_showEdges) {
-        QPainter painter;
-        painter.begin(&oFrame);
-        QImage edges =
-                this->d->edges(src,
-                               this->d->m_thresholdLow,
-                               this->d->m_thresholdHi,
-                               this->d->m_lineColor);
-        painter.drawImage(0, 0, edges);
-        painter.end();
-    }
+    if (this->d->m_showEdges)
+        this->d->drawEdges(src,
+                           oFrame,
+                           this->d->m_thresholdLow,
+                           this->d->m_thresholdHi,
+                           this->d->m_lineColor);
 
     auto oPacket = AkVideoPacket::fromImage(oFrame, packet);
     akSend(oPacket)
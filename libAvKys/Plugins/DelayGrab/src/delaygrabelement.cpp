@@ -27,6 +27,7 @@
 #include <QtMath>
 #include <akpacket.h>
 #include <akvideopacket.h>
+#include <akblocktransform.h>
 
 #include "delaygrabelement.h"
 
@@ -55,7 +56,11 @@ class DelayGrabElementPrivate
         QMutex m_mutex;
         QSize m_frameSize;
         QVector<QImage> m_frames;
+        QVector<const quint8 *> m_history;
+        QVector<int> m_frameMap;
         QVector<int> m_delayMap;
+        int m_curFrame {-1};
+        int m_nStoredFrames {0};
 };
 
 DelayGrabElement::DelayGrabElement(): AkElement()
@@ -125,7 +130,6 @@ AkPacket DelayGrabElement::iVideoStream(const AkVideoPacket &packet)
 
     src = src.convertToFormat(QImage::Format_ARGB32);
     QImage oFrame = QImage(src.size(), src.format());
-    QRgb *destBits = reinterpret_cast<QRgb *>(oFrame.bits());
 
     if (src.size() != this->d->m_frameSize) {
         this->updateDelaymap();
@@ -135,50 +139,61 @@ AkPacket DelayGrabElement::iVideoStream(const AkVideoPacket &packet)
     }
 
     int nFrames = this->d->m_nFrames > 0? this->d->m_nFrames: 1;
-    this->d->m_frames << src.copy();
-    int diff = this->d->m_frames.size() - nFrames;
 
-    for (int i = 0; i < diff; i++)
-        this->d->m_frames.removeFirst();
+    // The history is a ring of preallocated frames, the new frame overwrites
+    // the oldest one.
+    if (this->d->m_frames.size() != nFrames) {
+        this->d->m_frames.resize(nFrames);
 
-    if (this->d->m_frames.isEmpty())
-        akSend(packet)
+        for (auto &frame: this->d->m_frames)
+            if (frame.size() != src.size())
+                frame = QImage(src.size(), src.format());
+
+        this->d->m_curFrame = -1;
+        this->d->m_nStoredFrames = 0;
+    }
+
+    this->d->m_curFrame = (this->d->m_curFrame + 1) % nFrames;
+    this->d->m_nStoredFrames = qMin(this->d->m_nStoredFrames + 1, nFrames);
+    auto &curFrame = this->d->m_frames[this->d->m_curFrame];
+    memcpy(curFrame.bits(),
+           src.constBits(),
+           size_t(qMin(src.sizeInBytes(), curFrame.sizeInBytes())));
 
     this->d->m_mutex.lock();
     int blockSize = this->d->m_blockSize > 0? this->d->m_blockSize: 1;
-    int delayMapWidth = src.width() / blockSize;
-    int delayMapHeight = src.height() / blockSize;
     QVector<int> delayMap = this->d->m_delayMap;
     this->d->m_mutex.unlock();
 
-    if (delayMap.isEmpty())
+    if (delayMap.size() < (src.width() / blockSize) * (src.height() / blockSize))
         akSend(packet)
 
-    // Copy image blockwise to screenbuffer
-    for (int i = 0, y = 0; y < delayMapHeight; y++) {
-        for (int x = 0; x < delayMapWidth ; i++, x++) {
-            int curFrame = qAbs(this->d->m_frames.size() - 1 - delayMap[i])
-                           % this->d->m_frames.size();
-            int curFrameWidth = this->d->m_frames[curFrame].width();
-            int xyoff = blockSize * (x + y * curFrameWidth);
-
-            // source
-            auto source = reinterpret_cast<const QRgb *>(this->d->m_frames[curFrame].constBits());
-            source += xyoff;
-
-            // target
-            QRgb *dest = destBits;
-            dest += xyoff;
-
-            // copy block
-            for (int j = 0; j < blockSize; j++) {
-                memcpy(dest, source, size_t(4 * blockSize));
-                source += curFrameWidth;
-                dest += curFrameWidth;
-            }
-        }
+    // Translate the delays to frames in the ring.
+    int nStored = this->d->m_nStoredFrames;
+    this->d->m_history.resize(nStored);
+
+    for (int i = 0; i < nStored; i++) {
+        int frame = (this->d->m_curFrame - i + nFrames) % nFrames;
+        this->d->m_history[i] = this->d->m_frames[frame].constBits();
     }
 
+    this->d->m_frameMap.resize(delayMap.size());
+
+    for (int i = 0; i < delayMap.size(); i++)
+        this->d->m_frameMap[i] =
+                nStored - 1 - qAbs(nStored - 1 - delayMap[i]) % nStored;
+
+    // Copy image blockwise to screenbuffer
+    AkBlockTransform::gatherBlocks(this->d->m_history.constData(),
+                                   nStored,
+                                   src.bytesPerLine(),
+                                   oFrame.bits(),
+                                   oFrame.bytesPerLine(),
+                                   src.width(),
+                                   src.height(),
+                                   blockSize,
+                                   this->d->m_frameMap.constData());
+
     auto oPacket = AkVideoPacket::fromImage(oFrame, packet);
     akSend(oPacket)
 }
@@ -17,15 +17,14 @@
  * Web-Site: http://webcamoid.github.io/
  */
 
-#include <QDateTime>
 #include <QImage>
 #include <QMutex>
-#include <QPainter>
 #include <QQmlContext>
 #include <QRandomGenerator>
 #include <QtMath>
 #include <akpacket.h>
 #include <akvideopacket.h>
+#include <akblocktransform.h>
 
 #include "diceelement.h"
 
@@ -76,52 +75,26 @@ AkPacket DiceElement::iVideoStream(const AkVideoPacket &packet)
     if (src.isNull())
         return AkPacket();
 
-    src = src.convertToFormat(QImage::Format_ARGB32);
-    QImage oFrame = src.copy();
+    QImage oFrame = src.convertToFormat(QImage::Format_ARGB32);
 
-    static int diceSize = this->d->m_diceSize;
+    int diceSize = this->d->m_diceSize;
+    static int lastDiceSize = diceSize;
 
-    if (src.size() != this->d->m_frameSize
-        || this->d->m_diceSize != diceSize) {
-        diceSize = this->d->m_diceSize;
-        this->d->m_frameSize = src.size();
-        this->updateDiceMap();
+    if (oFrame.size() != this->d->m_frameSize
+        || diceSize != lastDiceSize) {
+        lastDiceSize = diceSize;
+        this->d->m_frameSize = oFrame.size();
+        this->updateDiceMap(diceSize);
         emit this->frameSizeChanged(this->d->m_frameSize);
     }
 
-    QTransform rotateLeft;
-    QTransform rotateRight;
-    QTransform rotate180;
-
-    rotateLeft.rotate(90);
-    rotateRight.rotate(-90);
-    rotate180.rotate(180);
-
-    QPainter painter;
-    painter.begin(&oFrame);
-
-    for (int y = 0; y < this->d->m_diceMap.height(); y++) {
-        auto diceLine = reinterpret_cast<const quint8 *>(this->d->m_diceMap.constScanLine(y));
-
-        for (int x = 0; x < this->d->m_diceMap.width(); x++) {
-            int xp = this->d->m_diceSize * x;
-            int yp = this->d->m_diceSize * y;
-            QImage dice = src.copy(xp, yp,
-                                   this->d->m_diceSize, this->d->m_diceSize);
-            quint8 direction = diceLine[x];
-
-            if (direction == 0)
-                dice = dice.transformed(rotateLeft);
-            else if (direction == 1)
-                dice = dice.transformed(rotateRight);
-            else if (direction == 2)
-                dice = dice.transformed(rotate180);
-
-            painter.drawImage(xp, yp, dice);
-        }
-    }
-
-    painter.end();
+    AkBlockTransform::rotateBlocks(oFrame.bits(),
+                                   oFrame.bytesPerLine(),
+                                   oFrame.width(),
+                                   oFrame.height(),
+                                   diceSize,
+                                   this->d->m_diceMap.constBits(),
+                                   this->d->m_diceMap.bytesPerLine());
 
     auto oPacket = AkVideoPacket::fromImage(oFrame, packet);
     akSend(oPacket)
@@ -141,17 +114,17 @@ void DiceElement::resetDiceSize()
     this->setDiceSize(24);
 }
 
-void DiceElement::updateDiceMap()
+void DiceElement::updateDiceMap(int diceSize)
 {
-    int width = qCeil(this->d->m_frameSize.width() / qreal(this->d->m_diceSize));
-    int height = qCeil(this->d->m_frameSize.height() / qreal(this->d->m_diceSize));
+    int width = qCeil(this->d->m_frameSize.width() / qreal(diceSize));
+    int height = qCeil(this->d->m_frameSize.height() / qreal(diceSize));
     QImage diceMap(width, height, QImage::Format_Grayscale8);
 
     for (int y = 0; y < diceMap.height(); y++) {
         auto oLine = reinterpret_cast<quint8 *>(diceMap.scanLine(y));
 
         for (int x = 0; x < diceMap.width(); x++)
-            oLine[x] = quint8(QRandomGenerator::global()->bounded(4));
+            oLine[x] = quint8(QRandomGenerator::global()->bounded(AkBlockTransform::Rotation270 + 1));
     }
 
     this->d->m_diceMap = diceMap;
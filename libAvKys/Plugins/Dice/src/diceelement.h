@@ -57,7 +57,7 @@ class DiceElement: public AkElement
         void resetDiceSize();
 
     private slots:
-        void updateDiceMap();
+        void updateDiceMap(int diceSize);
 };
 
 #endif // DICEELEMENT_H
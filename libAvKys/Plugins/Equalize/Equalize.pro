@@ -38,14 +38,23 @@ INCLUDEPATH += \
 
 LIBS += -L$${OUT_PWD}/../../Lib/$${BIN_DIR} -l$$qtLibraryTarget($${COMMONS_TARGET})
 
-OTHER_FILES += pspec.json
+OTHER_FILES += \
+    pspec.json \
+    $$files(share/qml/*.qml)
 
-QT += qml
+QT += qml concurrent
+
+RESOURCES += \
+    Equalize.qrc
 
 SOURCES = \
     src/equalize.cpp \
     src/equalizeelement.cpp
 
+lupdate_only {
+    SOURCES += $$files(share/qml/*.qml)
+}
+
 DESTDIR = $${OUT_PWD}/$${BIN_DIR}
 android: TARGET = $${COMMONS_TARGET}_lib$${TARGET}
 
@@ -18,24 +18,47 @@
  */
 
 #include <QImage>
-#include <QVector>
+#include <QQmlContext>
+#include <QtConcurrent>
 #include <akpacket.h>
 #include <akvideopacket.h>
 
 #include "equalizeelement.h"
-#include "pixelstructs.h"
 
 class EqualizeElementPrivate
 {
     public:
-        static QVector<quint64> histogram(const QImage &img);
-        static QVector<quint64> cumulativeHistogram(const QVector<quint64> &histogram);
-        static QVector<quint8> equalizationTable(const QImage &img);
+        QVector<quint32> m_lut[4];
+
+        static QVector<qreal> equalizationTable(QVector<quint64> histogram);
+        void applyTable(const QImage &src, QImage &dst);
 };
 
 EqualizeElement::EqualizeElement():
-    AkElement()
+    AkHistogramElement()
+{
+    this->d = new EqualizeElementPrivate;
+}
+
+EqualizeElement::~EqualizeElement()
 {
+    delete this->d;
+}
+
+QString EqualizeElement::controlInterfaceProvide(const QString &controlId) const
+{
+    Q_UNUSED(controlId)
+
+    return QString("qrc:/Equalize/share/qml/main.qml");
+}
+
+void EqualizeElement::controlInterfaceConfigure(QQmlContext *context,
+                                                const QString &controlId) const
+{
+    Q_UNUSED(controlId)
+
+    context->setContextProperty("Equalize", const_cast<QObject *>(qobject_cast<const QObject *>(this)));
+    context->setContextProperty("controlId", this->objectName());
 }
 
 AkPacket EqualizeElement::iVideoStream(const AkVideoPacket &packet)
@@ -47,70 +70,66 @@ AkPacket EqualizeElement::iVideoStream(const AkVideoPacket &packet)
 
     src = src.convertToFormat(QImage::Format_ARGB32);
     QImage oFrame(src.size(), src.format());
-    auto equTable = EqualizeElementPrivate::equalizationTable(src);
-
-    for (int y = 0; y < src.height(); y++) {
-        auto srcLine = reinterpret_cast<const QRgb *>(src.constScanLine(y));
-        auto dstLine = reinterpret_cast<QRgb *>(oFrame.scanLine(y));
 
-        for (int x = 0; x < src.width(); x++){
-            int r = equTable[qRed(srcLine[x])];
-            int g = equTable[qGreen(srcLine[x])];
-            int b = equTable[qBlue(srcLine[x])];
-            int a = equTable[qAlpha(srcLine[x])];
+    if (this->needsUpdate(src)) {
+        auto histogram = this->histogram(src, HistogramChannels_Gray);
+        auto table = this->smoothTable(0,
+                                       this->d->equalizationTable(histogram));
 
-            dstLine[x] = qRgba(r, g, b, a);
-        }
+        // Build a look-up table for each component, with the values already
+        // in place, so each pixel is converted with just 4 reads.
+        for (int c = 0; c < 4; c++)
+            this->makeLut(table, c == 3? 24: 8 * (2 - c), this->d->m_lut[c]);
     }
 
+    this->d->applyTable(src, oFrame);
+
     auto oPacket = AkVideoPacket::fromImage(oFrame, packet);
     akSend(oPacket)
 }
 
-QVector<quint64> EqualizeElementPrivate::histogram(const QImage &img)
+QVector<qreal> EqualizeElementPrivate::equalizationTable(QVector<quint64> histogram)
 {
-    QVector<quint64> histogram(256, 0);
+    // Cumulative histogram.
+    for (int i = 1; i < histogram.size(); i++)
+        histogram[i] += histogram[i - 1];
 
-    for (int y = 0; y < img.height(); y++) {
-        auto srcLine = reinterpret_cast<const QRgb *>(img.constScanLine(y));
+    int maxLevel = histogram.size() - 1;
+    quint64 q = histogram[maxLevel] - histogram[0];
+    QVector<qreal> table(histogram.size());
 
-        for (int x = 0; x < img.width(); x++)
-            histogram[qGray(srcLine[x])]++;
-    }
+    for (int i = 0; i < histogram.size(); i++)
+        if (histogram[i] > histogram[0])
+            table[i] = qreal(maxLevel) * (histogram[i] - histogram[0]) / q;
+        else
+            table[i] = 0;
 
-    return histogram;
+    return table;
 }
 
-QVector<quint64> EqualizeElementPrivate::cumulativeHistogram(const QVector<quint64> &histogram)
+void EqualizeElementPrivate::applyTable(const QImage &src, QImage &dst)
 {
-    QVector<quint64> cumulativeHistogram(histogram.size());
-    quint64 sum = 0;
+    auto lutR = this->m_lut[0].constData();
+    auto lutG = this->m_lut[1].constData();
+    auto lutB = this->m_lut[2].constData();
+    auto lutA = this->m_lut[3].constData();
+    QVector<int> lines(src.height());
 
-    for (int i = 0; i < histogram.size(); i++) {
-        sum += histogram[i];
-        cumulativeHistogram[i] = sum;
-    }
+    for (int y = 0; y < src.height(); y++)
+        lines[y] = y;
 
-    return cumulativeHistogram;
-}
-
-QVector<quint8> EqualizeElementPrivate::equalizationTable(const QImage &img)
-{
-    auto histogram = EqualizeElementPrivate::histogram(img);
-    auto cumHist = EqualizeElementPrivate::cumulativeHistogram(histogram);
-    QVector<quint8> equalizationTable(cumHist.size());
-    int maxLevel = cumHist.size() - 1;
-    quint64 q = cumHist[maxLevel] - cumHist[0];
-
-    for (int i = 0; i < cumHist.size(); i++)
-        if (cumHist[i] > cumHist[0])
-            equalizationTable[i] = quint8(qRound(qreal(maxLevel)
-                                                 * (cumHist[i] - cumHist[0])
-                                                 / q));
-        else
-            equalizationTable[i] = 0;
-
-    return equalizationTable;
+    QtConcurrent::blockingMap(lines, [&] (int &y) {
+        auto srcLine = reinterpret_cast<const QRgb *>(src.constScanLine(y));
+        auto dstLine = reinterpret_cast<QRgb *>(dst.scanLine(y));
+
+        for (int x = 0; x < src.width(); x++) {
+            QRgb pixel = srcLine[x];
+            dstLine[x] = lutR[(pixel >> 16) & 0xff]
+                       | lutG[(pixel >> 8) & 0xff]
+                       | lutB[pixel & 0xff]
+                       | lutA[pixel >> 24];
+        }
+    });
 }
 
 #include "moc_equalizeelement.cpp"
@@ -20,16 +20,25 @@
 #ifndef EQUALIZEELEMENT_H
 #define EQUALIZEELEMENT_H
 
-#include <akelement.h>
+#include <akhistogramelement.h>
 
-class EqualizeElement: public AkElement
+class EqualizeElementPrivate;
+
+class EqualizeElement: public AkHistogramElement
 {
     Q_OBJECT
 
     public:
         EqualizeElement();
+        ~EqualizeElement();
+
+    private:
+        EqualizeElementPrivate *d;
 
     protected:
+        QString controlInterfaceProvide(const QString &controlId) const;
+        void controlInterfaceConfigure(QQmlContext *context,
+                                       const QString &controlId) const;
         AkPacket iVideoStream(const AkVideoPacket &packet);
 };
 
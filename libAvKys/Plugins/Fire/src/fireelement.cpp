@@ -17,13 +17,13 @@
  * Web-Site: http://webcamoid.github.io/
  */
 
-#include <QDateTime>
+#include <QImage>
 #include <QMap>
-#include <QPainter>
 #include <QQmlContext>
 #include <QRandomGenerator>
 #include <QVariant>
 #include <QtMath>
+#include <akframeutils.h>
 #include <akpacket.h>
 #include <akvideopacket.h>
 
@@ -49,6 +49,7 @@ class FireElementPrivate
         FireElement::FireMode m_mode {FireElement::FireModeHard};
         int m_cool {-16};
         qreal m_dissolve {0.01};
+        int m_blur {2};
         qreal m_zoom {0.02};
         int m_threshold {15};
         int m_lumaThreshold {15};
@@ -56,23 +57,27 @@ class FireElementPrivate
         int m_alphaVariation {127};
         int m_nColors {8};
         QSize m_framSize;
-        QImage m_prevFrame;
-        QImage m_fireBuffer;
+        QVector<QRgb> m_prevFrame;
+
+        // The fire is stored as two planes, the blue component, that is used
+        // as an index to the palette, and the alpha component. The current
+        // state is always in m_fireBuffer[0] and m_fireAlpha[0], while
+        // m_fireBuffer[1] and m_fireAlpha[1] are the work buffers.
+        QVector<quint8> m_fireBuffer[2];
+        QVector<quint8> m_fireAlpha[2];
+        QVector<quint32> m_blurSums;
+        QVector<quint32> m_blurColumn;
         QVector<QRgb> m_palette;
-        AkElementPtr m_blurFilter;
-
-        QImage imageDiff(const QImage &img1,
-                         const QImage &img2,
-                         int colors,
-                         int threshold,
-                         int lumaThreshold,
-                         int alphaVariation,
-                         FireElement::FireMode mode);
-        QImage zoomImage(const QImage &src, qreal factor);
-        void coolImage(QImage &src, int colorDiff);
-        void imageAlphaDiff(QImage &src, int alphaDiff);
-        void dissolveImage(QImage &src, qreal amount);
-        QImage burn(const QImage &src, const QVector<QRgb> &palette);
+
+        void imageDiff(const QImage &src,
+                       int colors,
+                       int threshold,
+                       int lumaThreshold,
+                       int alphaVariation,
+                       FireElement::FireMode mode);
+        void zoomCoolImage(qreal factor, int colorDiff, int alphaDiff);
+        void dissolveImage(qreal amount);
+        void burn(const QImage &src, QImage &dst, const QVector<QRgb> &palette);
         QVector<QRgb> createPalette();
 };
 
@@ -80,13 +85,6 @@ FireElement::FireElement(): AkElement()
 {
     this->d = new FireElementPrivate;
     this->d->m_palette = this->d->createPalette();
-    this->d->m_blurFilter = AkElement::create("Blur");
-    this->d->m_blurFilter->setProperty("radius", 2);
-
-    QObject::connect(this->d->m_blurFilter.data(),
-                     SIGNAL(radiusChanged(int)),
-                     this,
-                     SIGNAL(blurChanged(int)));
 }
 
 FireElement::~FireElement()
@@ -111,7 +109,7 @@ qreal FireElement::dissolve() const
 
 int FireElement::blur() const
 {
-    return this->d->m_blurFilter->property("radius").toInt();
+    return this->d->m_blur;
 }
 
 qreal FireElement::zoom() const
@@ -144,133 +142,145 @@ int FireElement::nColors() const
     return this->d->m_nColors;
 }
 
-QImage FireElementPrivate::imageDiff(const QImage &img1,
-                                     const QImage &img2,
-                                     int colors,
-                                     int threshold,
-                                     int lumaThreshold,
-                                     int alphaVariation,
-                                     FireElement::FireMode mode)
+void FireElementPrivate::imageDiff(const QImage &src,
+                                   int colors,
+                                   int threshold,
+                                   int lumaThreshold,
+                                   int alphaVariation,
+                                   FireElement::FireMode mode)
 {
-    int width = qMin(img1.width(), img2.width());
-    int height = qMin(img1.height(), img2.height());
-    QImage diff(width, height, QImage::Format_ARGB32);
+    int width = this->m_framSize.width();
+    auto fireBuffer = this->m_fireBuffer[1].data();
+    auto fireAlpha = this->m_fireAlpha[1].data();
+    int threshold2 = 3 * threshold * threshold;
 
-    for (int y = 0; y < height; y++) {
-        auto iLine1 = reinterpret_cast<const QRgb *>(img1.constScanLine(y));
-        auto iLine2 = reinterpret_cast<const QRgb *>(img2.constScanLine(y));
-        auto oLine = reinterpret_cast<QRgb *>(diff.scanLine(y));
+    for (int y = 0; y < this->m_framSize.height(); y++) {
+        auto iLine1 = this->m_prevFrame.constData() + y * width;
+        auto iLine2 = reinterpret_cast<const QRgb *>(src.constScanLine(y));
+        auto bufferLine = fireBuffer + y * width;
+        auto alphaLine = fireAlpha + y * width;
 
         for (int x = 0; x < width; x++) {
-            int r1 = qRed(iLine1[x]);
-            int g1 = qGreen(iLine1[x]);
-            int b1 = qBlue(iLine1[x]);
-
             int r2 = qRed(iLine2[x]);
             int g2 = qGreen(iLine2[x]);
             int b2 = qBlue(iLine2[x]);
 
-            int dr = r1 - r2;
-            int dg = g1 - g2;
-            int db = b1 - b2;
+            int dr = qRed(iLine1[x]) - r2;
+            int dg = qGreen(iLine1[x]) - g2;
+            int db = qBlue(iLine1[x]) - b2;
 
-            int alpha = dr * dr + dg * dg + db * db;
-            alpha = int(sqrt(alpha / 3.0));
+            int s = dr * dr + dg * dg + db * db;
+            int gray = (11 * r2 + 16 * g2 + 5 * b2) >> 5;
+
+            // Static pixels doesn't add fire, skip them.
+            if (s < threshold2 || s == 0 || gray < lumaThreshold)
+                continue;
+
+            int alpha;
 
             if (mode == FireElement::FireModeSoft)
-                alpha = alpha < threshold? 0: alpha;
+                alpha = int(sqrt(s / 3.0));
             else
-                alpha = alpha < threshold?
-                          0: QRandomGenerator::global()->bounded(255 - alphaVariation, 256);
+                alpha = QRandomGenerator::global()->bounded(255 - alphaVariation, 256);
 
-            int gray = qGray(iLine2[x]);
-            alpha = gray < lumaThreshold? 0: alpha;
             int b = QRandomGenerator::global()->bounded(255 - colors, 256);
-            oLine[x] = qRgba(0, 0, b, alpha);
+
+            // Draw the new fire over the old one.
+            int bufferAlpha = alphaLine[x];
+            int oAlpha = 255 * alpha + (255 - alpha) * bufferAlpha;
+
+            if (oAlpha < 1)
+                continue;
+
+            bufferLine[x] =
+                    quint8((255 * alpha * b
+                            + (255 - alpha) * bufferAlpha * bufferLine[x])
+                           / oAlpha);
+            alphaLine[x] = quint8(oAlpha / 255);
         }
     }
-
-    return diff;
 }
 
-QImage FireElementPrivate::zoomImage(const QImage &src, qreal factor)
+void FireElementPrivate::zoomCoolImage(qreal factor,
+                                       int colorDiff,
+                                       int alphaDiff)
 {
-    QImage scaled = src.scaled(src.width(),
-                               int((1 + factor) * src.height()));
-
-    QPoint p(0, src.height() - scaled.height());
+    int width = this->m_framSize.width();
+    int height = this->m_framSize.height();
 
-    QImage zoom(src.size(), src.format());
-    zoom.fill(qRgba(0, 0, 0, 0));
+    // The fire rises the factor of the height on each frame.
+    int offset = int((1 + factor) * height) - height;
+    auto srcBuffer = this->m_fireBuffer[0].constData();
+    auto srcAlpha = this->m_fireAlpha[0].constData();
+    auto dstBuffer = this->m_fireBuffer[1].data();
+    auto dstAlpha = this->m_fireAlpha[1].data();
 
-    QPainter painter;
-    painter.begin(&zoom);
-    painter.drawImage(p, src);
-    painter.end();
-
-    return zoom;
-}
+    for (int y = 0; y < height; y++) {
+        int ys = y + offset;
+        auto dstBufferLine = dstBuffer + y * width;
+        auto dstAlphaLine = dstAlpha + y * width;
 
-void FireElementPrivate::coolImage(QImage &src, int colorDiff)
-{
-    for (int y = 0; y < src.height(); y++) {
-        auto srcLine = reinterpret_cast<QRgb *>(src.scanLine(y));
+        if (ys < 0 || ys >= height) {
+            memset(dstBufferLine, 0, size_t(width));
+            memset(dstAlphaLine, 0, size_t(width));
 
-        for (int x = 0; x < src.width(); x++) {
-            int b = qBound(0, qBlue(srcLine[x]) + colorDiff, 255);
-            srcLine[x] = qRgba(0, 0, b, qAlpha(srcLine[x]));
+            continue;
         }
-    }
-}
 
-void FireElementPrivate::imageAlphaDiff(QImage &src, int alphaDiff)
-{
-    for (int y = 0; y < src.height(); y++) {
-        auto srcLine = reinterpret_cast<QRgb *>(src.scanLine(y));
+        auto srcBufferLine = srcBuffer + ys * width;
+        auto srcAlphaLine = srcAlpha + ys * width;
 
-        for (int x = 0; x < src.width(); x++) {
-            QRgb pixel = srcLine[x];
-            int b = qBlue(pixel);
-            int a = qBound(0, qAlpha(pixel) + alphaDiff, 255);
-            srcLine[x] = qRgba(0, 0, b, a);
+        for (int x = 0; x < width; x++) {
+            dstBufferLine[x] = quint8(qBound(0, srcBufferLine[x] + colorDiff, 255));
+            dstAlphaLine[x] = quint8(qBound(0, srcAlphaLine[x] + alphaDiff, 255));
         }
     }
 }
 
-void FireElementPrivate::dissolveImage(QImage &src, qreal amount)
+void FireElementPrivate::dissolveImage(qreal amount)
 {
-    qint64 videoArea = src.width() * src.height();
+    int width = this->m_framSize.width();
+    int height = this->m_framSize.height();
+    qint64 videoArea = width * height;
     auto n = qRound64(amount * videoArea);
+    auto fireAlpha = this->m_fireAlpha[1].data();
 
     for (qint64 i = 0; i < n; i++) {
-        int x = QRandomGenerator::global()->bounded(src.width());
-        int y = QRandomGenerator::global()->bounded(src.height());
-        QRgb pixel = src.pixel(x, y);
-        int b = qBlue(pixel);
-        int a = QRandomGenerator::global()->bounded(qAlpha(pixel) + 1);
-        src.setPixel(x, y, qRgba(0, 0, b, a));
+        int x = QRandomGenerator::global()->bounded(width);
+        int y = QRandomGenerator::global()->bounded(height);
+        auto alpha = fireAlpha + x + y * width;
+        *alpha = quint8(QRandomGenerator::global()->bounded(*alpha + 1));
     }
 }
 
-QImage FireElementPrivate::burn(const QImage &src, const QVector<QRgb> &palette)
+void FireElementPrivate::burn(const QImage &src,
+                              QImage &dst,
+                              const QVector<QRgb> &palette)
 {
-    QImage dest(src.size(), src.format());
+    int width = this->m_framSize.width();
+    auto fireBuffer = this->m_fireBuffer[0].constData();
+    auto fireAlpha = this->m_fireAlpha[0].constData();
 
-    for (int y = 0; y < src.height(); y++) {
+    for (int y = 0; y < this->m_framSize.height(); y++) {
         auto srcLine = reinterpret_cast<const QRgb *>(src.constScanLine(y));
-        auto dstLine = reinterpret_cast<QRgb *>(dest.scanLine(y));
+        auto dstLine = reinterpret_cast<QRgb *>(dst.scanLine(y));
+        auto bufferLine = fireBuffer + y * width;
+        auto alphaLine = fireAlpha + y * width;
+
+        for (int x = 0; x < width; x++) {
+            QRgb color = palette[bufferLine[x]];
+            int alpha = alphaLine[x];
+            int ialpha = 255 - alpha;
+            QRgb pixel = srcLine[x];
 
-        for (int x = 0; x < src.width(); x++) {
-            int index = qBlue(srcLine[x]);
-            int r = qRed(palette[index]);
-            int g = qGreen(palette[index]);
-            int b = qBlue(palette[index]);
+            int r = (alpha * qRed(color) + ialpha * qRed(pixel)) / 255;
+            int g = (alpha * qGreen(color) + ialpha * qGreen(pixel)) / 255;
+            int b = (alpha * qBlue(color) + ialpha * qBlue(pixel)) / 255;
+            int a = alpha + ialpha * qAlpha(pixel) / 255;
 
-            dstLine[x] = qRgba(r, g, b, qAlpha(srcLine[x]));
+            dstLine[x] = qRgba(r, g, b, a);
         }
     }
-
-    return dest;
 }
 
 QVector<QRgb> FireElementPrivate::createPalette()
@@ -317,54 +327,58 @@ AkPacket FireElement::iVideoStream(const AkVideoPacket &packet)
     QImage oFrame(src.size(), src.format());
 
     if (src.size() != this->d->m_framSize) {
-        this->d->m_fireBuffer = QImage();
-        this->d->m_prevFrame = QImage();
+        this->d->m_prevFrame.clear();
         this->d->m_framSize = src.size();
     }
 
-    if (this->d->m_prevFrame.isNull()) {
+    if (this->d->m_prevFrame.isEmpty()) {
         oFrame = src;
-        this->d->m_fireBuffer = QImage(src.size(), src.format());
-        this->d->m_fireBuffer.fill(qRgba(0, 0, 0, 0));
+        int area = src.width() * src.height();
+
+        for (int i = 0; i < 2; i++) {
+            this->d->m_fireBuffer[i].fill(0, area);
+            this->d->m_fireAlpha[i].fill(0, area);
+        }
     } else {
-        this->d->m_fireBuffer = this->d->zoomImage(this->d->m_fireBuffer,
-                                                   this->d->m_zoom);
-        this->d->coolImage(this->d->m_fireBuffer, this->d->m_cool);
-        this->d->imageAlphaDiff(this->d->m_fireBuffer, this->d->m_alphaDiff);
-        this->d->dissolveImage(this->d->m_fireBuffer, this->d->m_dissolve);
+        // Move the fire from the current buffer to the work buffer,
+        // and then apply all effects on it.
+        this->d->zoomCoolImage(this->d->m_zoom,
+                               this->d->m_cool,
+                               this->d->m_alphaDiff);
+        this->d->dissolveImage(this->d->m_dissolve);
 
         int nColors = this->d->m_nColors > 0? this->d->m_nColors: 1;
 
         // Compute the difference between previous and current frame,
         // and save it to the buffer.
-        QImage diff =
-                this->d->imageDiff(this->d->m_prevFrame,
-                                   src,
-                                   nColors,
-                                   this->d->m_threshold,
-                                   this->d->m_lumaThreshold,
-                                   this->d->m_alphaVariation,
-                                   this->d->m_mode);
-
-        QPainter painter;
-        painter.begin(&this->d->m_fireBuffer);
-        painter.drawImage(0, 0, diff);
-        painter.end();
-
-        auto firePacket = AkVideoPacket::fromImage(this->d->m_fireBuffer,
-                                                   packet);
-        auto blurPacket = this->d->m_blurFilter->iStream(firePacket);
-        this->d->m_fireBuffer = AkVideoPacket(blurPacket).toImage();
+        this->d->imageDiff(src,
+                           nColors,
+                           this->d->m_threshold,
+                           this->d->m_lumaThreshold,
+                           this->d->m_alphaVariation,
+                           this->d->m_mode);
+
+        // Blur the work buffer back to the current buffer.
+        AkFrameUtils::blurPlane(this->d->m_fireBuffer[1].constData(),
+                                this->d->m_fireBuffer[0].data(),
+                                src.width(),
+                                src.height(),
+                                this->d->m_blur,
+                                this->d->m_blurSums,
+                                this->d->m_blurColumn);
+        AkFrameUtils::blurPlane(this->d->m_fireAlpha[1].constData(),
+                                this->d->m_fireAlpha[0].data(),
+                                src.width(),
+                                src.height(),
+                                this->d->m_blur,
+                                this->d->m_blurSums,
+                                this->d->m_blurColumn);
 
         // Apply buffer.
-        painter.begin(&oFrame);
-        painter.drawImage(0, 0, src);
-        painter.drawImage(0, 0, this->d->burn(this->d->m_fireBuffer,
-                                              this->d->m_palette));
-        painter.end();
+        this->d->burn(src, oFrame, this->d->m_palette);
     }
 
-    this->d->m_prevFrame = src.copy();
+    AkFrameUtils::storeFrame(src, this->d->m_prevFrame);
 
     auto oPacket = AkVideoPacket::fromImage(oFrame, packet);
     akSend(oPacket)
@@ -401,7 +415,11 @@ void FireElement::setDissolve(qreal dissolve)
 
 void FireElement::setBlur(int blur)
 {
-    this->d->m_blurFilter->setProperty("radius", blur);
+    if (this->d->m_blur == blur)
+        return;
+
+    this->d->m_blur = blur;
+    emit this->blurChanged(blur);
 }
 
 void FireElement::setZoom(qreal zoom)
@@ -17,9 +17,10 @@
  * Web-Site: http://webcamoid.github.io/
  */
 
+#include <QImage>
 #include <QQmlContext>
 #include <QtMath>
-#include <QPainter>
+#include <akframeutils.h>
 #include <akpacket.h>
 #include <akvideopacket.h>
 
@@ -29,17 +30,22 @@ class LifeElementPrivate
 {
     public:
         QSize m_frameSize;
-        QImage m_prevFrame;
-        QImage m_lifeBuffer;
+        QVector<QRgb> m_prevFrame;
+        QVector<quint8> m_lifeBuffer[2];
+        int m_curBuffer {0};
         QRgb m_lifeColor {qRgb(255, 255, 255)};
         int m_threshold {15};
         int m_lumaThreshold {15};
 
-        QImage imageDiff(const QImage &img1,
-                         const QImage &img2,
-                         int threshold,
-                         int lumaThreshold);
-        void updateLife();
+        void imageDiff(const QRgb *prevFrame,
+                       const QImage &src,
+                       quint8 *lifeBuffer,
+                       int threshold,
+                       int lumaThreshold);
+        void updateLife(const quint8 *src,
+                        quint8 *dst,
+                        int width,
+                        int height);
 };
 
 LifeElement::LifeElement(): AkElement()
@@ -90,50 +96,63 @@ AkPacket LifeElement::iVideoStream(const AkVideoPacket &packet)
     if (src.isNull())
         return AkPacket();
 
-    src = src.convertToFormat(QImage::Format_ARGB32);
-    QImage oFrame = src;
+    QImage oFrame = src.convertToFormat(QImage::Format_ARGB32);
+    int width = oFrame.width();
+    int height = oFrame.height();
 
-    if (src.size() != this->d->m_frameSize) {
-        this->d->m_lifeBuffer = QImage();
-        this->d->m_prevFrame = QImage();
-        this->d->m_frameSize = src.size();
+    if (oFrame.size() != this->d->m_frameSize) {
+        this->d->m_prevFrame.clear();
+        this->d->m_frameSize = oFrame.size();
     }
 
-    if (this->d->m_prevFrame.isNull()) {
-        this->d->m_lifeBuffer = QImage(src.size(), QImage::Format_Indexed8);
-        this->d->m_lifeBuffer.setColor(0, 0);
-        this->d->m_lifeBuffer.setColor(1, this->d->m_lifeColor);
-        this->d->m_lifeBuffer.fill(0);
-    }
-    else {
-        // Compute the difference between previous and current frame,
-        // and save it to the buffer.
-        auto diff =
-                this->d->imageDiff(this->d->m_prevFrame,
-                                   src,
-                                   this->d->m_threshold,
-                                   this->d->m_lumaThreshold);
+    if (this->d->m_prevFrame.isEmpty()) {
+        for (auto &buffer: this->d->m_lifeBuffer)
+            buffer.fill(0, width * height);
 
-        this->d->m_lifeBuffer.setColor(1, this->d->m_lifeColor);
+        this->d->m_curBuffer = 0;
+        AkFrameUtils::storeFrame(oFrame, this->d->m_prevFrame);
+    } else {
+        auto &lifeBuffer = this->d->m_lifeBuffer[this->d->m_curBuffer];
+        auto &nextLifeBuffer = this->d->m_lifeBuffer[1 - this->d->m_curBuffer];
 
-        for (int y = 0; y < this->d->m_lifeBuffer.height(); y++) {
-            auto diffLine = diff.constScanLine(y);
-            auto lifeBufferLine = this->d->m_lifeBuffer.scanLine(y);
-
-            for (int x = 0; x < this->d->m_lifeBuffer.width(); x++)
-                lifeBufferLine[x] |= diffLine[x];
+        // Compute the difference between previous and current frame,
+        // and save it to the buffer.
+        this->d->imageDiff(this->d->m_prevFrame.constData(),
+                           oFrame,
+                           lifeBuffer.data(),
+                           this->d->m_threshold,
+                           this->d->m_lumaThreshold);
+        AkFrameUtils::storeFrame(oFrame, this->d->m_prevFrame);
+        this->d->updateLife(lifeBuffer.constData(),
+                            nextLifeBuffer.data(),
+                            width,
+                            height);
+        this->d->m_curBuffer = 1 - this->d->m_curBuffer;
+
+        // Draw the living cells.
+        auto lifeColor = this->d->m_lifeColor;
+        int alpha = qAlpha(lifeColor);
+        int ialpha = 255 - alpha;
+        auto cells = nextLifeBuffer.constData();
+
+        for (int y = 0; y < height; y++) {
+            auto oLine = reinterpret_cast<QRgb *>(oFrame.scanLine(y));
+            auto cellsLine = cells + y * width;
+
+            for (int x = 0; x < width; x++) {
+                if (!cellsLine[x])
+                    continue;
+
+                QRgb pixel = oLine[x];
+                int r = (alpha * qRed(lifeColor) + ialpha * qRed(pixel)) / 255;
+                int g = (alpha * qGreen(lifeColor) + ialpha * qGreen(pixel)) / 255;
+                int b = (alpha * qBlue(lifeColor) + ialpha * qBlue(pixel)) / 255;
+                int a = alpha + ialpha * qAlpha(pixel) / 255;
+                oLine[x] = qRgba(r, g, b, a);
+            }
         }
-
-        this->d->updateLife();
-
-        QPainter painter;
-        painter.begin(&oFrame);
-        painter.drawImage(0, 0, this->d->m_lifeBuffer);
-        painter.end();
     }
 
-    this->d->m_prevFrame = src.copy();
-
     auto oPacket = AkVideoPacket::fromImage(oFrame, packet);
     akSend(oPacket)
 }
@@ -180,73 +199,64 @@ void LifeElement::resetLumaThreshold()
     this->setLumaThreshold(15);
 }
 
-QImage LifeElementPrivate::imageDiff(const QImage &img1,
-                                     const QImage &img2,
-                                     int threshold,
-                                     int lumaThreshold)
+void LifeElementPrivate::imageDiff(const QRgb *prevFrame,
+                                   const QImage &src,
+                                   quint8 *lifeBuffer,
+                                   int threshold,
+                                   int lumaThreshold)
 {
-    int width = qMin(img1.width(), img2.width());
-    int height = qMin(img1.height(), img2.height());
-    QImage diff(width, height, QImage::Format_Indexed8);
+    int width = src.width();
+    int threshold2 = 3 * threshold * threshold;
 
-    for (int y = 0; y < height; y++) {
-        auto line1 = reinterpret_cast<const QRgb *>(img1.constScanLine(y));
-        auto line2 = reinterpret_cast<const QRgb *>(img2.constScanLine(y));
-        quint8 *lineDiff = diff.scanLine(y);
+    // sqrt(d / 3) >= threshold is the same as d >= 3 * threshold^2, this way
+    // the loop is just integer arithmetic and can be vectorized.
+    for (int y = 0; y < src.height(); y++) {
+        auto line1 = prevFrame + y * width;
+        auto line2 = reinterpret_cast<const QRgb *>(src.constScanLine(y));
+        auto lifeLine = lifeBuffer + y * width;
 
         for (int x = 0; x < width; x++) {
-            int r1 = qRed(line1[x]);
-            int g1 = qGreen(line1[x]);
-            int b1 = qBlue(line1[x]);
-
             int r2 = qRed(line2[x]);
             int g2 = qGreen(line2[x]);
             int b2 = qBlue(line2[x]);
 
-            int dr = r1 - r2;
-            int dg = g1 - g2;
-            int db = b1 - b2;
+            int dr = qRed(line1[x]) - r2;
+            int dg = qGreen(line1[x]) - g2;
+            int db = qBlue(line1[x]) - b2;
 
             int colorDiff = dr * dr + dg * dg + db * db;
+            int gray = (11 * r2 + 16 * g2 + 5 * b2) >> 5;
 
-            lineDiff[x] = sqrt(colorDiff / 3.0) >= threshold
-                          && qGray(line2[x]) >= lumaThreshold? 1: 0;
+            lifeLine[x] |= quint8(colorDiff >= threshold2
+                                  && gray >= lumaThreshold);
         }
     }
-
-    return diff;
 }
 
-void LifeElementPrivate::updateLife()
+void LifeElementPrivate::updateLife(const quint8 *src,
+                                    quint8 *dst,
+                                    int width,
+                                    int height)
 {
-    QImage lifeBuffer(this->m_lifeBuffer.size(),
-                      this->m_lifeBuffer.format());
-    lifeBuffer.fill(0);
-
-    for (int y = 1; y < lifeBuffer.height() - 1; y++) {
-        auto iLine = this->m_lifeBuffer.constScanLine(y);
-        auto oLine = lifeBuffer.scanLine(y);
-
-        for (int x = 1; x < lifeBuffer.width() - 1; x++) {
-            int count = 0;
-
-            for (int j = -1; j < 2; j++) {
-                auto line = this->m_lifeBuffer.constScanLine(y + j);
-
-                for (int i = -1; i < 2; i++)
-                    count += line[x + i];
-            }
-
-            count -= iLine[x];
-
-            if ((iLine[x] && count == 2) || count == 3)
-                oLine[x] = 1;
+    memset(dst, 0, size_t(width));
+    memset(dst + (height - 1) * width, 0, size_t(width));
+
+    for (int y = 1; y < height - 1; y++) {
+        auto iLine_m1 = src + (y - 1) * width;
+        auto iLine = src + y * width;
+        auto iLine_p1 = src + (y + 1) * width;
+        auto oLine = dst + y * width;
+        oLine[0] = 0;
+        oLine[width - 1] = 0;
+
+        for (int x = 1; x < width - 1; x++) {
+            int count = iLine_m1[x - 1] + iLine_m1[x] + iLine_m1[x + 1]
+                      + iLine[x - 1]                  + iLine[x + 1]
+                      + iLine_p1[x - 1] + iLine_p1[x] + iLine_p1[x + 1];
+
+            oLine[x] = quint8((iLine[x] && count == 2) || count == 3);
         }
     }
-
-    memcpy(this->m_lifeBuffer.bits(),
-           lifeBuffer.constBits(),
-           size_t(lifeBuffer.bytesPerLine()) * size_t(lifeBuffer.height()));
 }
 
 #include "moc_lifeelement.cpp"
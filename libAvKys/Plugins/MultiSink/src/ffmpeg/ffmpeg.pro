@@ -34,7 +34,8 @@ HEADERS = \
     ../mediawriter.h \
     src/abstractstream.h \
     src/videostream.h \
-    src/audiostream.h
+    src/audiostream.h \
+    src/muxoutput.h
 
 INCLUDEPATH += \
     ../../../../Lib/src \
@@ -70,7 +71,8 @@ SOURCES = \
     ../mediawriter.cpp \
     src/abstractstream.cpp \
     src/videostream.cpp \
-    src/audiostream.cpp
+    src/audiostream.cpp \
+    src/muxoutput.cpp
 
 akModule = MultiSink
 DESTDIR = $${OUT_PWD}/../../$${BIN_DIR}/submodules/$${akModule}
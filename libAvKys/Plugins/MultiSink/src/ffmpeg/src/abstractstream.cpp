@@ -105,7 +105,8 @@ AbstractStream::AbstractStream(const AVFormatContext *formatContext,
     this->d->m_codecContext = avcodec_alloc_context3(codec);
 
     // Some formats want stream headers to be separate.
-    if (formatContext->oformat->flags & AVFMT_GLOBALHEADER)
+    if (formatContext->oformat->flags & AVFMT_GLOBALHEADER
+        || configs.value("globalHeader").toBool())
         this->d->m_codecContext->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
 
     this->d->m_codecContext->strict_std_compliance = CODEC_COMPLIANCE;
@@ -127,7 +128,17 @@ AbstractStream::AbstractStream(const AVFormatContext *formatContext,
             options["preset"] = "ultrafast";
     }
 
+    // Options handled by the stream itself rather than the codec.
+    static const QStringList streamOptions {
+        "conversion_threads",
+        "adaptive",
+        "adaptive_max_step",
+    };
+
     for (auto it = options.begin(); it != options.end(); it++) {
+        if (streamOptions.contains(it.key()))
+            continue;
+
         QString value = it.value().toString();
 
         if (!value.isEmpty())
@@ -181,17 +192,18 @@ AVCodecContext *AbstractStream::codecContext() const
     return this->d->m_codecContext;
 }
 
-void AbstractStream::packetEnqueue(const AkPacket &packet)
+bool AbstractStream::packetEnqueue(const AkPacket &packet)
 {
     if (!this->d->m_runConvertLoop)
-        return;
+        return false;
 
     this->d->m_convertMutex.lock();
     bool enqueue = true;
 
     if (this->d->m_packetQueue.size() >= this->m_maxPacketQueueSize)
         enqueue = this->d->m_packetQueueNotFull.wait(&this->d->m_convertMutex,
-                                                     THREAD_WAIT_LIMIT);
+                                                     THREAD_WAIT_LIMIT)
+                  && this->d->m_runConvertLoop;
 
     if (enqueue) {
         this->d->m_packetQueue << packet;
@@ -199,6 +211,22 @@ void AbstractStream::packetEnqueue(const AkPacket &packet)
     }
 
     this->d->m_convertMutex.unlock();
+
+    return enqueue;
+}
+
+QVariantMap AbstractStream::stats() const
+{
+    this->d->m_convertMutex.lock();
+    int packetQueueSize = this->d->m_packetQueue.size();
+    this->d->m_convertMutex.unlock();
+
+    return {
+        {"index"             , this->d->m_index          },
+        {"streamIndex"       , this->d->m_streamIndex    },
+        {"packetQueueSize"   , packetQueueSize           },
+        {"maxPacketQueueSize", this->m_maxPacketQueueSize},
+    };
 }
 
 void AbstractStream::convertPacket(const AkPacket &packet)
@@ -218,6 +246,15 @@ AVFrame *AbstractStream::dequeueFrame()
     return nullptr;
 }
 
+void AbstractStream::interruptDequeue()
+{
+}
+
+bool AbstractStream::isEncoding() const
+{
+    return this->d->m_runEncodeLoop;
+}
+
 void AbstractStream::rescaleTS(AVPacket *pkt, AVRational src, AVRational dst)
 {
     av_packet_rescale_ts(pkt, src, dst);
@@ -225,7 +262,8 @@ void AbstractStream::rescaleTS(AVPacket *pkt, AVRational src, AVRational dst)
 
 void AbstractStream::deleteFrame(AVFrame **frame)
 {
-    if (frame && *frame) {
+    // Reference counted frames are released by av_frame_unref().
+    if (frame && *frame && !(*frame)->buf[0]) {
         av_freep(&((*frame)->data[0]));
         (*frame)->data[0] = nullptr;
     }
@@ -236,21 +274,22 @@ void AbstractStream::deleteFrame(AVFrame **frame)
 
 void AbstractStreamPrivate::convertLoop()
 {
-    while (this->m_runConvertLoop) {
+    // Sleep until there is a packet to convert, and finish converting the
+    // queued packets when stopped.
+    forever {
         this->m_convertMutex.lock();
-        bool gotPacket = true;
 
-        if (this->m_packetQueue.isEmpty())
-            gotPacket = this->m_packetQueueNotEmpty.wait(&this->m_convertMutex,
-                                                         THREAD_WAIT_LIMIT);
+        while (this->m_packetQueue.isEmpty() && this->m_runConvertLoop)
+            this->m_packetQueueNotEmpty.wait(&this->m_convertMutex);
 
-        AkPacket packet;
+        if (this->m_packetQueue.isEmpty()) {
+            this->m_convertMutex.unlock();
 
-        if (gotPacket) {
-            packet = this->m_packetQueue.dequeue();
-            this->m_packetQueueNotFull.wakeAll();
+            break;
         }
 
+        auto packet = this->m_packetQueue.dequeue();
+        this->m_packetQueueNotFull.wakeAll();
         this->m_convertMutex.unlock();
 
         if (packet)
@@ -260,16 +299,21 @@ void AbstractStreamPrivate::convertLoop()
 
 void AbstractStreamPrivate::encodeLoop()
 {
-    while (this->m_runEncodeLoop) {
-        if (auto frame = self->dequeueFrame()) {
+    // dequeueFrame() blocks until there is a frame to encode, and returns
+    // nullptr once the loop is stopped and there are no more frames.
+    forever {
+        auto frame = self->dequeueFrame();
+
+        if (frame) {
             self->encodeData(frame);
             self->deleteFrame(&frame);
+        } else if (!this->m_runEncodeLoop) {
+            break;
         }
     }
 
-    // Flush encoders
-    while (self->encodeData(nullptr) == AVERROR(EAGAIN)) {
-    }
+    // Flush encoders, encodeData() drains all the pending packets.
+    self->encodeData(nullptr);
 }
 
 bool AbstractStream::init()
@@ -302,10 +346,15 @@ bool AbstractStream::init()
 
 void AbstractStream::uninit()
 {
+    this->d->m_convertMutex.lock();
     this->d->m_runConvertLoop = false;
+    this->d->m_packetQueueNotEmpty.wakeAll();
+    this->d->m_packetQueueNotFull.wakeAll();
+    this->d->m_convertMutex.unlock();
     waitLoop(this->d->m_convertLoopResult);
 
     this->d->m_runEncodeLoop = false;
+    this->interruptDequeue();
     waitLoop(this->d->m_encodeLoopResult);
 
     avcodec_close(this->d->m_codecContext);
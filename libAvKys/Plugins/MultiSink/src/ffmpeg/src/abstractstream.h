@@ -58,7 +58,8 @@ class AbstractStream: public QObject
         Q_INVOKABLE AVStream *stream() const;
         Q_INVOKABLE AVFormatContext *formatContext() const;
         Q_INVOKABLE AVCodecContext *codecContext() const;
-        Q_INVOKABLE void packetEnqueue(const AkPacket &packet);
+        Q_INVOKABLE bool packetEnqueue(const AkPacket &packet);
+        Q_INVOKABLE virtual QVariantMap stats() const;
 
     protected:
         int m_maxPacketQueueSize;
@@ -66,6 +67,8 @@ class AbstractStream: public QObject
         virtual void convertPacket(const AkPacket &packet);
         virtual int encodeData(AVFrame *frame);
         virtual AVFrame *dequeueFrame();
+        virtual void interruptDequeue();
+        bool isEncoding() const;
         void rescaleTS(AVPacket *pkt, AVRational src, AVRational dst);
         void deleteFrame(AVFrame **frame);
 
@@ -74,6 +77,7 @@ class AbstractStream: public QObject
 
     signals:
         void packetReady(AVPacket *packet);
+        void encoderAdapted(int index, const QVariantMap &adaptation);
 
     public slots:
         virtual bool init();
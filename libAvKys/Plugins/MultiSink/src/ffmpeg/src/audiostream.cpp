@@ -26,6 +26,7 @@
 #include <akaudiocaps.h>
 #include <akpacket.h>
 #include <akaudiopacket.h>
+#include <akaudiofifo.h>
 
 extern "C"
 {
@@ -35,6 +36,10 @@ extern "C"
 #include "audiostream.h"
 #include "mediawriterffmpeg.h"
 
+// Jumps in the input time stamps shorter than this, in seconds, are
+// considered jitter.
+#define MIN_PTS_GAP 0.01
+
 using SampleFormatsMap = QMap<AkAudioCaps::SampleFormat, AVSampleFormat>;
 using ChannelLayoutsMap = QMap<AkAudioCaps::ChannelLayout, uint64_t>;
 
@@ -42,11 +47,22 @@ class AudioStreamPrivate
 {
     public:
         AkElementPtr m_convert;
-        AVFrame *m_frame {nullptr};
+        AkAudioFifo m_frame;
         QMutex m_frameMutex;
         int64_t m_pts {0};
         QWaitCondition m_frameReady;
 
+        // Time skipped by the silent packets, stored as the number of samples
+        // in the FIFO before the gap and the length of the gap.
+        QList<QPair<int, qint64>> m_gaps;
+
+        // Expected pts of the next input packet, in samples.
+        qint64 m_nextPts {AV_NOPTS_VALUE};
+
+        void updateGaps(const AkAudioPacket &packet,
+                        AVCodecContext *codecContext);
+        void addGap(qint64 gap, AVCodecContext *codecContext);
+
         inline static const SampleFormatsMap &sampleFormats(bool planar)
         {
             static const SampleFormatsMap formats {
@@ -231,6 +247,7 @@ AudioStream::AudioStream(const AVFormatContext *formatContext,
 
     this->d->m_convert = AkElement::create("ACapsConvert");
     this->d->m_convert->setProperty("caps", QVariant::fromValue(audioCaps));
+    this->d->m_frame.setCaps(audioCaps);
 }
 
 AudioStream::~AudioStream()
@@ -245,89 +262,21 @@ void AudioStream::convertPacket(const AkPacket &packet)
         return;
 
     auto codecContext = this->codecContext();
-    auto iPacket = AkAudioPacket(this->d->m_convert->iStream(packet));
+    this->d->updateGaps(packet, codecContext);
 
-    if (!iPacket)
+    if (packet.flags() & AkAudioPacket::PacketFlag_Silence)
         return;
 
-    AVFrame iFrame;
-    memset(&iFrame, 0, sizeof(AVFrame));
-    iFrame.format = codecContext->sample_fmt;
-    iFrame.channel_layout = codecContext->channel_layout;
-    iFrame.sample_rate = codecContext->sample_rate;
-    iFrame.nb_samples = iPacket.caps().samples();
-    iFrame.pts = iPacket.pts();
-    int channels = av_get_channel_layout_nb_channels(iFrame.channel_layout);
-
-    if (av_samples_fill_arrays(iFrame.data,
-                               iFrame.linesize,
-                               reinterpret_cast<const uint8_t *>(iPacket.buffer().constData()),
-                               channels,
-                               iPacket.caps().samples(),
-                               AVSampleFormat(iFrame.format),
-                               1) < 0) {
-        return;
-    }
-
-    this->d->m_frameMutex.lock();
-
-    // Create new buffer.
-    auto oFrame = av_frame_alloc();
-
-    if (av_samples_alloc(oFrame->data,
-                         oFrame->linesize,
-                         channels,
-                         iFrame.nb_samples
-                         + (this->d->m_frame? this->d->m_frame->nb_samples: 0),
-                         AVSampleFormat(iFrame.format),
-                         1) < 0) {
-        this->deleteFrame(&oFrame);
-        this->d->m_frameMutex.unlock();
-
-        return;
-    }
-
-    // Copy old samples to new buffer.
-    if (this->d->m_frame)
-        if (av_samples_copy(oFrame->data,
-                            this->d->m_frame->data,
-                            0,
-                            0,
-                            this->d->m_frame->nb_samples,
-                            channels,
-                            AVSampleFormat(iFrame.format)) < 0) {
-            this->deleteFrame(&oFrame);
-            this->d->m_frameMutex.unlock();
-
-            return;
-        }
-
-    // Copy converted samples to the new buffer.
-    if (av_samples_copy(oFrame->data,
-                        iFrame.data,
-                        this->d->m_frame? this->d->m_frame->nb_samples: 0,
-                        0,
-                        iFrame.nb_samples,
-                        channels,
-                        AVSampleFormat(iFrame.format)) < 0) {
-        this->deleteFrame(&oFrame);
-        this->d->m_frameMutex.unlock();
+    auto iPacket = AkAudioPacket(this->d->m_convert->iStream(packet));
 
+    if (!iPacket)
         return;
-    }
 
-    oFrame->format = codecContext->sample_fmt;
-    oFrame->channel_layout = codecContext->channel_layout;
-    oFrame->sample_rate = codecContext->sample_rate;
-    oFrame->nb_samples = (this->d->m_frame? this->d->m_frame->nb_samples: 0)
-                         + iFrame.nb_samples;
-    oFrame->pts = this->d->m_frame? this->d->m_frame->pts: 0;
-
-    this->deleteFrame(&this->d->m_frame);
-    this->d->m_frame = oFrame;
+    this->d->m_frameMutex.lock();
+    this->d->m_frame.write(iPacket);
 
     if (codecContext->codec->capabilities & AV_CODEC_CAP_VARIABLE_FRAME_SIZE
-        || oFrame->nb_samples >= codecContext->frame_size) {
+        || this->d->m_frame.samples() >= codecContext->frame_size) {
         this->d->m_frameReady.wakeAll();
     }
 
@@ -384,117 +333,75 @@ int AudioStream::encodeData(AVFrame *frame)
 
 AVFrame *AudioStream::dequeueFrame()
 {
-    /* FIXME: Allocating and copying frames when enqueuing/dequeuing is pretty
-     * slow, it can improved creating a fixed size frame, and then playing with
-     * read write pointers.
-     */
-
     auto codecContext = this->codecContext();
+    bool variableFrameSize =
+            codecContext->codec->capabilities & AV_CODEC_CAP_VARIABLE_FRAME_SIZE;
     this->d->m_frameMutex.lock();
 
-    if (!this->d->m_frame
-        || (!(codecContext->codec->capabilities & AV_CODEC_CAP_VARIABLE_FRAME_SIZE)
-            && this->d->m_frame->nb_samples < codecContext->frame_size)) {
-        if (!this->d->m_frameReady.wait(&this->d->m_frameMutex, THREAD_WAIT_LIMIT)) {
-            this->d->m_frameMutex.unlock();
+    while ((this->d->m_frame.samples() < 1
+            || (!variableFrameSize
+                && this->d->m_frame.samples() < codecContext->frame_size))
+           && this->isEncoding())
+        this->d->m_frameReady.wait(&this->d->m_frameMutex);
 
-            return nullptr;
-        }
+    // Skip the time of the silent packets that were not encoded.
+    while (!this->d->m_gaps.isEmpty() && this->d->m_gaps.first().first < 1) {
+        this->d->m_pts += this->d->m_gaps.first().second;
+        this->d->m_gaps.removeFirst();
     }
 
-    if (!this->d->m_frame) {
+    int samples = variableFrameSize?
+                      this->d->m_frame.samples():
+                      codecContext->frame_size;
+
+    // Don't mix the samples from both sides of a gap in the same frame.
+    if (variableFrameSize && !this->d->m_gaps.isEmpty())
+        samples = qMin(samples, this->d->m_gaps.first().first);
+
+    if (samples < 1 || this->d->m_frame.samples() < samples) {
         this->d->m_frameMutex.unlock();
 
         return nullptr;
     }
 
-    AVFrame *oFrame = nullptr;
-
-    if (codecContext->codec->capabilities & AV_CODEC_CAP_VARIABLE_FRAME_SIZE
-        || this->d->m_frame->nb_samples == codecContext->frame_size) {
-        oFrame = this->d->m_frame;
-        this->d->m_frame = nullptr;
-    } else {
-        // Create output buffer.
-        oFrame = av_frame_alloc();
-        oFrame->format = codecContext->sample_fmt;
-        oFrame->channel_layout = codecContext->channel_layout;
-        oFrame->sample_rate = codecContext->sample_rate;
-        oFrame->nb_samples = codecContext->frame_size;
-        oFrame->pts = this->d->m_frame->pts;
-        int channels = av_get_channel_layout_nb_channels(oFrame->channel_layout);
-
-        if (av_samples_alloc(oFrame->data,
-                             oFrame->linesize,
-                             channels,
-                             codecContext->frame_size,
-                             AVSampleFormat(oFrame->format),
-                             1) < 0) {
-            this->deleteFrame(&oFrame);
-            this->d->m_frameMutex.unlock();
-
-            return nullptr;
-        }
+    // Create output buffer.
+    auto oFrame = av_frame_alloc();
+    oFrame->format = codecContext->sample_fmt;
+    oFrame->channel_layout = codecContext->channel_layout;
+    oFrame->sample_rate = codecContext->sample_rate;
+    oFrame->nb_samples = samples;
+    oFrame->pts = this->d->m_frame.pts();
+    int channels = av_get_channel_layout_nb_channels(oFrame->channel_layout);
 
-        // Copy samples to the output buffer.
-        if (av_samples_copy(oFrame->data,
-                            this->d->m_frame->data,
-                            0,
-                            0,
-                            codecContext->frame_size,
-                            channels,
-                            AVSampleFormat(oFrame->format)) < 0) {
-            this->deleteFrame(&oFrame);
-            this->d->m_frameMutex.unlock();
-
-            return nullptr;
-        }
+    if (av_samples_alloc(oFrame->data,
+                         oFrame->linesize,
+                         channels,
+                         samples,
+                         AVSampleFormat(oFrame->format),
+                         1) < 0) {
+        this->deleteFrame(&oFrame);
+        this->d->m_frameMutex.unlock();
 
-        // Create new buffer.
-        auto frame = av_frame_alloc();
-        frame->format = codecContext->sample_fmt;
-        frame->channel_layout = codecContext->channel_layout;
-        frame->sample_rate = codecContext->sample_rate;
-        frame->nb_samples = this->d->m_frame->nb_samples - codecContext->frame_size;
-        frame->pts = this->d->m_frame->pts + codecContext->frame_size;
-
-        if (av_samples_alloc(frame->data,
-                             frame->linesize,
-                             channels,
-                             frame->nb_samples,
-                             AVSampleFormat(frame->format),
-                             1) < 0) {
-            this->deleteFrame(&oFrame);
-            this->deleteFrame(&frame);
-            this->d->m_frameMutex.unlock();
-
-            return nullptr;
-        }
+        return nullptr;
+    }
 
-        // Copy samples to the output buffer.
-        if (av_samples_copy(frame->data,
-                            this->d->m_frame->data,
-                            0,
-                            codecContext->frame_size,
-                            frame->nb_samples,
-                            channels,
-                            AVSampleFormat(frame->format)) < 0) {
-            this->deleteFrame(&oFrame);
-            this->deleteFrame(&frame);
-            this->d->m_frameMutex.unlock();
-
-            return nullptr;
-        }
+    this->d->m_frame.read(oFrame->data, samples);
 
-        this->deleteFrame(&this->d->m_frame);
-        this->d->m_frame = frame;
-    }
+    for (auto &gap: this->d->m_gaps)
+        gap.first -= samples;
 
     this->d->m_frameMutex.unlock();
 
     return oFrame;
 }
 
+void AudioStream::interruptDequeue()
+{
+    this->d->m_frameMutex.lock();
+    this->d->m_frameReady.wakeAll();
+    this->d->m_frameMutex.unlock();
+}
+
 bool AudioStream::init()
 {
     this->d->m_convert->setState(AkElement::ElementStatePlaying);
@@ -510,7 +417,80 @@ void AudioStream::uninit()
 {
     AbstractStream::uninit();
     this->d->m_convert->setState(AkElement::ElementStateNull);
-    this->deleteFrame(&this->d->m_frame);
+    this->d->m_frameMutex.lock();
+    this->d->m_frame.clear();
+    this->d->m_gaps.clear();
+    this->d->m_nextPts = AV_NOPTS_VALUE;
+    this->d->m_frameMutex.unlock();
+}
+
+void AudioStreamPrivate::updateGaps(const AkAudioPacket &packet,
+                                    AVCodecContext *codecContext)
+{
+    auto caps = packet.caps();
+
+    if (caps.rate() < 1)
+        return;
+
+    auto rate = codecContext->sample_rate;
+    qint64 samples = qRound64(qreal(caps.samples()) * rate / caps.rate());
+
+    // The packets dropped upstream, like the silence dropped by the capture,
+    // leave a hole in the time stamps. Skip it as well, so the audio stays
+    // in sync with the video.
+    if (packet.timeBase().den() != 0) {
+        auto pts = qRound64(packet.pts() * packet.timeBase().value() * rate);
+
+        if (this->m_nextPts == AV_NOPTS_VALUE) {
+            this->m_nextPts = pts;
+        } else if (pts - this->m_nextPts > qRound64(MIN_PTS_GAP * rate)) {
+            this->addGap(pts - this->m_nextPts, codecContext);
+            this->m_nextPts = pts;
+        }
+    }
+
+    if (this->m_nextPts != AV_NOPTS_VALUE)
+        this->m_nextPts += samples;
+
+    // The packets marked as silence are not encoded.
+    if (packet.flags() & AkAudioPacket::PacketFlag_Silence)
+        this->addGap(samples, codecContext);
+}
+
+void AudioStreamPrivate::addGap(qint64 gap, AVCodecContext *codecContext)
+{
+    bool variableFrameSize =
+            codecContext->codec->capabilities & AV_CODEC_CAP_VARIABLE_FRAME_SIZE;
+
+    this->m_frameMutex.lock();
+
+    // Complete the last frame with silence, so it can be encoded before the
+    // gap.
+    if (!variableFrameSize && codecContext->frame_size > 0) {
+        int frameSize = codecContext->frame_size;
+        int padding = (frameSize - this->m_frame.samples() % frameSize)
+                      % frameSize;
+
+        if (padding > 0) {
+            AkAudioCaps silenceCaps(this->m_frame.caps());
+            silenceCaps.setSamples(padding);
+            AkAudioPacket silence(silenceCaps);
+            silence.buffer().fill(silenceCaps.format() == AkAudioCaps::SampleFormat_u8?
+                                      char(0x80): char(0));
+            this->m_frame.write(silence);
+            gap = qMax(gap - padding, qint64(0));
+            this->m_frameReady.wakeAll();
+        }
+    }
+
+    int offset = this->m_frame.samples();
+
+    if (!this->m_gaps.isEmpty() && this->m_gaps.last().first == offset)
+        this->m_gaps.last().second += gap;
+    else if (gap > 0)
+        this->m_gaps << qMakePair(offset, gap);
+
+    this->m_frameMutex.unlock();
 }
 
 #include "moc_audiostream.cpp"
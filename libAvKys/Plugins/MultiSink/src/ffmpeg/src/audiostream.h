@@ -44,6 +44,7 @@ class AudioStream: public AbstractStream
         void convertPacket(const AkPacket &packet);
         int encodeData(AVFrame *frame);
         AVFrame *dequeueFrame();
+        void interruptDequeue();
 
     public slots:
         bool init();
@@ -24,7 +24,6 @@
 #include <QSize>
 #include <QVector>
 #include <QLibrary>
-#include <QThreadPool>
 #include <QMutex>
 #include <QtMath>
 #include <akaudiocaps.h>
@@ -36,6 +35,7 @@
 #include "mediawriterffmpeg.h"
 #include "audiostream.h"
 #include "videostream.h"
+#include "muxoutput.h"
 
 extern "C"
 {
@@ -94,21 +94,23 @@ class MediaWriterFFmpegPrivate
         QMap<QString, QVariantMap> m_codecOptions;
         QList<QVariantMap> m_streamConfigs;
         AVFormatContext *m_formatContext {nullptr};
-        QThreadPool m_threadPool;
         qint64 m_maxPacketQueueSize {15 * 1024 * 1024};
         QMutex m_packetMutex;
         QMutex m_audioMutex;
         QMutex m_videoMutex;
         QMutex m_subtitleMutex;
-        QMutex m_writeMutex;
         QMap<int, AbstractStreamPtr> m_streamsMap;
         bool m_isRecording {false};
 
+        QList<MuxOutputPtr> m_outputs;
+
         explicit MediaWriterFFmpegPrivate(MediaWriterFFmpeg *self);
         QString guessFormat();
         QVariantList parseOptions(const AVClass *avClass) const;
-        AVDictionary *formatContextOptions(AVFormatContext *formatContext,
-                                           const QVariantMap &options);
+        MuxOutputPtr createOutput(const QString &location,
+                                  const QString &format,
+                                  const QVariantMap &options,
+                                  bool lossless);
 };
 
 MediaWriterFFmpeg::MediaWriterFFmpeg(QObject *parent):
@@ -245,6 +247,35 @@ QVariantList MediaWriterFFmpeg::formatOptions()
     auto globalFormatOptions = this->d->m_formatOptions.value(outFormat);
     QVariantList formatOptions;
 
+    // Options of the output file, these are not passed to the muxer.
+    if (!(outputFormat->flags & AVFMT_NOFILE)) {
+        auto numberType =
+                mediaWriterFFmpegGlobal->m_codecFFOptionTypeToStr.value(AV_OPT_TYPE_INT64);
+        options << QVariant(QVariantList {
+            "avio_buffer_size",
+            "Size in bytes of the output buffer",
+            numberType,
+            4096,
+            std::numeric_limits<int>::max(),
+            1,
+            DEFAULT_AVIO_BUFFER_SIZE,
+            DEFAULT_AVIO_BUFFER_SIZE,
+            QVariantList()
+        });
+        options << QVariant(QVariantList {
+            "preallocate_size",
+            "Reserve this number of bytes on disk for local files, the "
+            "unused space is released when finished (0 = disabled)",
+            numberType,
+            0,
+            std::numeric_limits<qint64>::max(),
+            1,
+            0,
+            0,
+            QVariantList()
+        });
+    }
+
     for (auto &option: options) {
         auto optionList = option.toList();
         auto key = optionList[0].toString();
@@ -409,6 +440,12 @@ QVariantMap MediaWriterFFmpeg::addStream(int streamIndex,
             gop = defaultCodecParams["defaultGOP"].toInt();
 
         outputParams["gop"] = gop;
+        auto frameRateMode = codecParams.value("frameRateMode").toString();
+
+        if (frameRateMode != "vfr")
+            frameRateMode = "cfr";
+
+        outputParams["frameRateMode"] = frameRateMode;
     }
 
     this->d->m_streamConfigs << outputParams;
@@ -472,6 +509,14 @@ QVariantMap MediaWriterFFmpeg::updateStream(int index,
         streamChanged = true;
     }
 
+    if (streamCaps.mimeType() == "video/x-raw"
+        && codecParams.contains("frameRateMode")) {
+        auto frameRateMode = codecParams["frameRateMode"].toString();
+        this->d->m_streamConfigs[index]["frameRateMode"] =
+                frameRateMode == "vfr"? frameRateMode: QString("cfr");
+        streamChanged = true;
+    }
+
     if (streamChanged)
         emit this->streamsChanged(this->streams());
 
@@ -533,6 +578,51 @@ QVariantList MediaWriterFFmpeg::codecOptions(int index)
         }
     }
 
+    auto streamCaps =
+            this->d->m_streamConfigs.value(index).value("caps").value<AkCaps>();
+
+    // Options handled by the stream itself rather than the codec.
+    if (streamCaps.mimeType() == "video/x-raw") {
+        auto intType =
+                mediaWriterFFmpegGlobal->m_codecFFOptionTypeToStr.value(AV_OPT_TYPE_INT);
+        options << QVariant(QVariantList {
+            "conversion_threads",
+            "Number of threads used for converting the frames to the codec "
+            "format (0 = auto)",
+            intType,
+            0,
+            16,
+            1,
+            0,
+            0,
+            QVariantList()
+        });
+        options << QVariant(QVariantList {
+            "adaptive",
+            "Reduce the frame rate when the encoder can't keep up in real "
+            "time, and restore it when the load goes down",
+            mediaWriterFFmpegGlobal->m_codecFFOptionTypeToStr.value(AV_OPT_TYPE_BOOL),
+            0,
+            1,
+            1,
+            0,
+            0,
+            QVariantList()
+        });
+        options << QVariant(QVariantList {
+            "adaptive_max_step",
+            "In adaptive mode, encode at least one of each this number of "
+            "frames",
+            intType,
+            1,
+            16,
+            1,
+            4,
+            4,
+            QVariantList()
+        });
+    }
+
     for (auto &option: options) {
         auto optionList = option.toList();
         auto key = optionList[0].toString();
@@ -546,6 +636,19 @@ QVariantList MediaWriterFFmpeg::codecOptions(int index)
     return codecOptions;
 }
 
+QVariantList MediaWriterFFmpeg::encoderStats() const
+{
+    QVariantList stats;
+
+    for (auto &stream: this->d->m_streamsMap)
+        stats << stream->stats();
+
+    for (auto &output: this->d->m_outputs)
+        stats << output->stats();
+
+    return stats;
+}
+
 MediaWriterFFmpegPrivate::MediaWriterFFmpegPrivate(MediaWriterFFmpeg *self):
     self(self)
 {
@@ -570,6 +673,26 @@ QString MediaWriterFFmpegPrivate::guessFormat()
     return outputFormat;
 }
 
+MuxOutputPtr MediaWriterFFmpegPrivate::createOutput(const QString &location,
+                                                   const QString &format,
+                                                   const QVariantMap &options,
+                                                   bool lossless)
+{
+    auto output = MuxOutputPtr(new MuxOutput(this->m_formatContext,
+                                             location,
+                                             format,
+                                             options,
+                                             lossless));
+    output->setSegmentDuration(self->segmentDuration());
+    output->setPreRoll(self->preRoll());
+    output->setMaxPacketQueueSize(this->m_maxPacketQueueSize);
+
+    if (!output->init())
+        return {};
+
+    return output;
+}
+
 QVariantList MediaWriterFFmpegPrivate::parseOptions(const AVClass *avClass) const
 {
     if (!avClass)
@@ -764,43 +887,6 @@ QVariantList MediaWriterFFmpegPrivate::parseOptions(const AVClass *avClass) cons
     return options;
 }
 
-AVDictionary *MediaWriterFFmpegPrivate::formatContextOptions(AVFormatContext *formatContext,
-                                                             const QVariantMap &options)
-{
-    auto avClass = formatContext->oformat->priv_class;
-    QStringList flagType;
-
-    if (avClass)
-        for (auto option = avClass->option;
-             option;
-             option = av_opt_next(&avClass, option)) {
-            if (option->type == AV_OPT_TYPE_FLAGS)
-                flagType << option->name;
-        }
-
-    AVDictionary *formatOptions = nullptr;
-
-    for (auto it = options.begin();
-         it != options.end();
-         it++) {
-        QString value;
-
-        if (flagType.contains(it.key())) {
-            auto flags = it.value().toStringList();
-            value = flags.join('+');
-        } else {
-            value = it.value().toString();
-        }
-
-        av_dict_set(&formatOptions,
-                    it.key().toStdString().c_str(),
-                    value.toStdString().c_str(),
-                    0);
-    }
-
-    return formatOptions;
-}
-
 AkVideoCaps MediaWriterFFmpeg::nearestDVCaps(const AkVideoCaps &caps) const
 {
     AkVideoCaps nearestCaps;
@@ -1052,10 +1138,13 @@ void MediaWriterFFmpeg::resetMaxPacketQueueSize()
     this->setMaxPacketQueueSize(15 * 1024 * 1024);
 }
 
-void MediaWriterFFmpeg::enqueuePacket(const AkPacket &packet)
+bool MediaWriterFFmpeg::enqueuePacket(const AkPacket &packet)
 {
-    if (this->d->m_isRecording && this->d->m_streamsMap.contains(packet.index()))
-        this->d->m_streamsMap[packet.index()]->packetEnqueue(packet);
+    if (!this->d->m_isRecording
+        || !this->d->m_streamsMap.contains(packet.index()))
+        return false;
+
+    return this->d->m_streamsMap[packet.index()]->packetEnqueue(packet);
 }
 
 void MediaWriterFFmpeg::clearStreams()
@@ -1104,8 +1193,43 @@ bool MediaWriterFFmpeg::init()
         streamConfigs = mxfConfigs.toVector();
     }
 
+    // Resolve the format of the extra outputs, the encoders must generate
+    // global headers if any of them require it.
+    QList<QPair<QVariantMap, QString>> extraOutputs;
+    bool globalHeader = false;
+
+    for (auto &output: this->m_extraOutputs) {
+        auto config = output.toMap();
+        auto location = config.value("location").toString();
+        auto format = config.value("format").toString();
+
+        if (location.isEmpty())
+            continue;
+
+        auto oformat =
+                av_guess_format(format.isEmpty()?
+                                    nullptr: format.toStdString().c_str(),
+                                location.toStdString().c_str(),
+                                nullptr);
+
+        if (!oformat) {
+            qDebug() << "Can't guess the format of" << location;
+
+            continue;
+        }
+
+        extraOutputs << QPair<QVariantMap, QString>(config, oformat->name);
+
+        if (oformat->flags & AVFMT_GLOBALHEADER)
+            globalHeader = true;
+    }
+
     for (int i = 0; i < streamConfigs.count(); i++) {
         auto configs = streamConfigs[i];
+
+        if (globalHeader)
+            configs["globalHeader"] = true;
+
         auto stream = avformat_new_stream(this->d->m_formatContext, nullptr);
         stream->id = i;
 
@@ -1139,6 +1263,10 @@ bool MediaWriterFFmpeg::init()
                              this,
                              SLOT(writePacket(AVPacket *)),
                              Qt::DirectConnection);
+            QObject::connect(mediaStream.data(),
+                             SIGNAL(encoderAdapted(int, const QVariantMap &)),
+                             this,
+                             SIGNAL(encoderAdapted(int, const QVariantMap &)));
 
             mediaStream->init();
         }
@@ -1150,43 +1278,16 @@ bool MediaWriterFFmpeg::init()
                    this->m_location.toStdString().c_str(),
                    1);
 
-    // Open file.
-    if (!(this->d->m_formatContext->oformat->flags & AVFMT_NOFILE)) {
-        int error = avio_open(&this->d->m_formatContext->pb,
-                              this->m_location.toStdString().c_str(),
-                              AVIO_FLAG_READ_WRITE);
-
-        if (error < 0) {
-            char errorStr[1024];
-            av_strerror(AVERROR(error), errorStr, 1024);
-            qDebug() << "Can't open output file: " << errorStr;
-
-            this->d->m_streamsMap.clear();
-            avformat_free_context(this->d->m_formatContext);
-            this->d->m_formatContext = nullptr;
-
-            return false;
-        }
-    }
-
-    // Set format options.
-    auto formatOptions =
-            this->d->formatContextOptions(this->d->m_formatContext,
-                                          this->d->m_formatOptions.value(outputFormat));
-
-    // Write file header.
-    int error = avformat_write_header(this->d->m_formatContext, &formatOptions);
-    av_dict_free(&formatOptions);
-
-    if (error < 0) {
-        char errorStr[1024];
-        av_strerror(AVERROR(error), errorStr, 1024);
-        qDebug() << "Can't write header: " << errorStr;
-
-        if (!(this->d->m_formatContext->oformat->flags & AVFMT_NOFILE))
-            // Close the output file.
-            avio_close(this->d->m_formatContext->pb);
+    // The streams of this context are only used as reference, the packets
+    // are written to a copy of it by each output, so the streams are encoded
+    // only once.
+    auto output =
+            this->d->createOutput(this->m_location,
+                                  this->d->m_formatContext->oformat->name,
+                                  this->d->m_formatOptions.value(outputFormat),
+                                  true);
 
+    if (!output) {
         this->d->m_streamsMap.clear();
         avformat_free_context(this->d->m_formatContext);
         this->d->m_formatContext = nullptr;
@@ -1194,6 +1295,25 @@ bool MediaWriterFFmpeg::init()
         return false;
     }
 
+    this->d->m_outputs << output;
+
+    // The extra outputs are optional, a failing one doesn't stop the
+    // recording.
+    for (auto &extraOutput: extraOutputs) {
+        auto &config = extraOutput.first;
+        auto location = config.value("location").toString();
+        auto output =
+                this->d->createOutput(location,
+                                      extraOutput.second,
+                                      config.value("options").toMap(),
+                                      false);
+
+        if (output)
+            this->d->m_outputs << output;
+        else
+            qDebug() << "Can't open the output" << location;
+    }
+
     this->d->m_isRecording = true;
 
     return true;
@@ -1207,25 +1327,29 @@ void MediaWriterFFmpeg::uninit()
     this->d->m_isRecording = false;
     this->d->m_streamsMap.clear();
 
-    // Write the trailer, if any. The trailer must be written before you
-    // close the CodecContexts open when you wrote the header; otherwise
-    // av_write_trailer() may try to use memory that was freed on
-    // av_codec_close().
-    av_write_trailer(this->d->m_formatContext);
-
-    if (!(this->d->m_formatContext->oformat->flags & AVFMT_NOFILE))
-        // Close the output file.
-        avio_close(this->d->m_formatContext->pb);
+    // Write the packets still in the queues.
+    for (auto &output: this->d->m_outputs)
+        output->uninit();
 
+    this->d->m_outputs.clear();
     avformat_free_context(this->d->m_formatContext);
     this->d->m_formatContext = nullptr;
 }
 
+void MediaWriterFFmpeg::trigger()
+{
+    for (auto &output: this->d->m_outputs)
+        output->trigger();
+}
+
 void MediaWriterFFmpeg::writePacket(AVPacket *packet)
 {
-    this->d->m_writeMutex.lock();
-    av_interleaved_write_frame(this->d->m_formatContext, packet);
-    this->d->m_writeMutex.unlock();
+    // The extra outputs never block, so the packet is given to them first,
+    // and the main output may wait a bit for the disk.
+    for (int i = this->d->m_outputs.size() - 1; i >= 0; i--)
+        this->d->m_outputs[i]->enqueuePacket(packet);
+
+    av_packet_unref(packet);
 }
 
 MediaWriterFFmpegGlobal::MediaWriterFFmpegGlobal()
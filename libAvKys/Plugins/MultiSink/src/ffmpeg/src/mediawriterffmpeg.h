@@ -61,6 +61,7 @@ class MediaWriterFFmpeg: public MediaWriter
         Q_INVOKABLE QVariantMap updateStream(int index,
                                              const QVariantMap &codecParams);
         Q_INVOKABLE QVariantList codecOptions(int index);
+        Q_INVOKABLE QVariantList encoderStats() const;
 
     private:
         MediaWriterFFmpegPrivate *d;
@@ -81,10 +82,11 @@ class MediaWriterFFmpeg: public MediaWriter
         void resetFormatOptions();
         void resetCodecOptions(int index);
         void resetMaxPacketQueueSize();
-        void enqueuePacket(const AkPacket &packet);
+        bool enqueuePacket(const AkPacket &packet);
         void clearStreams();
         bool init();
         void uninit();
+        void trigger();
 
     private slots:
         void writePacket(AVPacket *packet);
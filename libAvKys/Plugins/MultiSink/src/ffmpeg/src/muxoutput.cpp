@@ -0,0 +1,753 @@
+/* Webcamoid, webcam capture application.
+ * Copyright (C) 2020  Gonzalo Exequiel Pedone
+ *
+ * Webcamoid is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Webcamoid is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Webcamoid. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Web-Site: http://webcamoid.github.io/
+ */
+
+#include <limits>
+#include <QDebug>
+#include <QFile>
+#include <QMutex>
+#include <QQueue>
+#include <QThreadPool>
+#include <QUrl>
+#include <QWaitCondition>
+#include <QtConcurrent>
+
+#include "muxoutput.h"
+#include "abstractstream.h"
+
+#ifdef Q_OS_LINUX
+#include <fcntl.h>
+#endif
+
+extern "C"
+{
+    #include <libavformat/avformat.h>
+    #include <libavutil/opt.h>
+    #include <libavutil/mathematics.h>
+}
+
+#if LIBAVFORMAT_VERSION_MAJOR >= 61
+using AVIOWriteBuffer = const uint8_t;
+#else
+using AVIOWriteBuffer = uint8_t;
+#endif
+
+class MuxOutputPrivate
+{
+    public:
+        MuxOutput *self;
+        const AVFormatContext *m_formatContext {nullptr};
+        QString m_location;
+        QString m_format;
+        QVariantMap m_options;
+        qint64 m_segmentDuration {0};
+        qint64 m_preRoll {0};
+        qint64 m_maxPacketQueueSize {15 * 1024 * 1024};
+        bool m_lossless {true};
+        bool m_hasVideo {false};
+
+        // Packets queue and muxing loop.
+        QQueue<AVPacket *> m_muxQueue;
+        qint64 m_muxQueueBytes {0};
+        qint64 m_droppedPackets {0};
+        QMutex m_muxMutex;
+        QWaitCondition m_muxQueueNotEmpty;
+        QWaitCondition m_muxQueueNotFull;
+        QThreadPool m_threadPool;
+        QFuture<void> m_muxLoopResult;
+        bool m_runMuxLoop {false};
+        bool m_triggered {false};
+        bool m_dropping {false};
+
+        // Output file, segments and pre-roll.
+        AVFormatContext *m_outputContext {nullptr};
+        QList<AVPacket *> m_preRollPackets;
+        QFile m_outputFile;
+        qint64 m_outputSize {0};
+        qint64 m_preallocatedSize {0};
+        int64_t m_segmentStart {AV_NOPTS_VALUE};
+        int m_segmentIndex {0};
+
+        explicit MuxOutputPrivate(MuxOutput *self);
+        bool isNetworkStream() const;
+        void muxLoop();
+        void clearMuxQueue();
+        int64_t packetTime(const AVPacket *packet) const;
+        bool isKeyPacket(const AVPacket *packet) const;
+        void bufferPacket(AVPacket *packet);
+        void muxPacket(AVPacket *packet);
+        QString segmentLocation() const;
+        bool openSegment();
+        void closeSegment();
+        bool openOutput(const QString &url);
+        void closeOutput();
+        AVDictionary *formatContextOptions(AVFormatContext *formatContext) const;
+        static int writeOutput(void *opaque, AVIOWriteBuffer *buffer, int size);
+        static int64_t seekOutput(void *opaque, int64_t offset, int whence);
+};
+
+MuxOutput::MuxOutput(const AVFormatContext *formatContext,
+                     const QString &location,
+                     const QString &format,
+                     const QVariantMap &options,
+                     bool lossless,
+                     QObject *parent):
+    QObject(parent)
+{
+    this->d = new MuxOutputPrivate(this);
+    this->d->m_formatContext = formatContext;
+    this->d->m_location = location;
+    this->d->m_format = format;
+    this->d->m_options = options;
+    this->d->m_lossless = lossless;
+    this->d->m_threadPool.setMaxThreadCount(1);
+
+    for (uint i = 0; i < formatContext->nb_streams; i++)
+        if (formatContext->streams[i]->codecpar->codec_type
+            == AVMEDIA_TYPE_VIDEO)
+            this->d->m_hasVideo = true;
+}
+
+MuxOutput::~MuxOutput()
+{
+    this->uninit();
+    delete this->d;
+}
+
+QString MuxOutput::location() const
+{
+    return this->d->m_location;
+}
+
+QString MuxOutput::format() const
+{
+    return this->d->m_format;
+}
+
+QVariantMap MuxOutput::stats() const
+{
+    this->d->m_muxMutex.lock();
+    QVariantMap stats {
+        {"location"          , this->d->m_location          },
+        {"format"            , this->d->m_format            },
+        {"packetQueueSize"   , this->d->m_muxQueueBytes     },
+        {"maxPacketQueueSize", this->d->m_maxPacketQueueSize},
+        {"droppedPackets"    , this->d->m_droppedPackets    },
+    };
+    this->d->m_muxMutex.unlock();
+
+    return stats;
+}
+
+void MuxOutput::setSegmentDuration(qint64 segmentDuration)
+{
+    this->d->m_segmentDuration = segmentDuration;
+}
+
+void MuxOutput::setPreRoll(qint64 preRoll)
+{
+    this->d->m_preRoll = preRoll;
+}
+
+void MuxOutput::setMaxPacketQueueSize(qint64 maxPacketQueueSize)
+{
+    this->d->m_maxPacketQueueSize = maxPacketQueueSize;
+}
+
+bool MuxOutput::init()
+{
+    this->d->m_segmentIndex = 0;
+    this->d->m_triggered = false;
+    this->d->m_dropping = false;
+    this->d->m_droppedPackets = 0;
+
+    // Open the first file now, unless waiting for a trigger.
+    if (this->d->m_preRoll < 1 && !this->d->openSegment())
+        return false;
+
+    this->d->m_runMuxLoop = true;
+    this->d->m_muxLoopResult =
+            QtConcurrent::run(&this->d->m_threadPool,
+                              this->d,
+                              &MuxOutputPrivate::muxLoop);
+
+    return true;
+}
+
+void MuxOutput::uninit()
+{
+    // Write the packets still in the queue.
+    this->d->m_muxMutex.lock();
+    this->d->m_runMuxLoop = false;
+    this->d->m_muxQueueNotEmpty.wakeAll();
+    this->d->m_muxQueueNotFull.wakeAll();
+    this->d->m_muxMutex.unlock();
+    this->d->m_muxLoopResult.waitForFinished();
+    this->d->clearMuxQueue();
+
+    // The pre-roll is discarded if never triggered.
+    for (auto &packet: this->d->m_preRollPackets)
+        av_packet_free(&packet);
+
+    this->d->m_preRollPackets.clear();
+    this->d->closeSegment();
+}
+
+void MuxOutput::trigger()
+{
+    this->d->m_muxMutex.lock();
+    this->d->m_triggered = true;
+    this->d->m_muxQueueNotEmpty.wakeAll();
+    this->d->m_muxMutex.unlock();
+}
+
+void MuxOutput::enqueuePacket(const AVPacket *packet)
+{
+    auto muxPacket = av_packet_alloc();
+
+    if (!muxPacket)
+        return;
+
+    if (av_packet_ref(muxPacket, packet) < 0) {
+        av_packet_free(&muxPacket);
+
+        return;
+    }
+
+    this->d->m_muxMutex.lock();
+
+    if (!this->d->m_runMuxLoop) {
+        this->d->m_muxMutex.unlock();
+        av_packet_free(&muxPacket);
+
+        return;
+    }
+
+    if (this->d->m_lossless) {
+        // If the queue is full, wait a bit for the disk, but never drop the
+        // packet.
+        if (this->d->m_muxQueueBytes >= this->d->m_maxPacketQueueSize)
+            this->d->m_muxQueueNotFull.wait(&this->d->m_muxMutex,
+                                            THREAD_WAIT_LIMIT);
+    } else {
+        // A slow output drops the packets instead of stalling the encoders,
+        // and continues from the next key frame when the queue has room.
+        bool full = this->d->m_muxQueueBytes >= this->d->m_maxPacketQueueSize;
+
+        if (this->d->m_dropping && !full && this->d->isKeyPacket(muxPacket))
+            this->d->m_dropping = false;
+        else if (full)
+            this->d->m_dropping = true;
+
+        if (this->d->m_dropping) {
+            this->d->m_droppedPackets++;
+            this->d->m_muxMutex.unlock();
+            av_packet_free(&muxPacket);
+
+            return;
+        }
+    }
+
+    this->d->m_muxQueue << muxPacket;
+    this->d->m_muxQueueBytes += muxPacket->size;
+    this->d->m_muxQueueNotEmpty.wakeAll();
+    this->d->m_muxMutex.unlock();
+}
+
+MuxOutputPrivate::MuxOutputPrivate(MuxOutput *self):
+    self(self)
+{
+}
+
+bool MuxOutputPrivate::isNetworkStream() const
+{
+    return this->m_location.contains("://")
+           && !this->m_location.startsWith("file://");
+}
+
+void MuxOutputPrivate::muxLoop()
+{
+    forever {
+        this->m_muxMutex.lock();
+
+        if (this->m_muxQueue.isEmpty() && this->m_runMuxLoop)
+            this->m_muxQueueNotEmpty.wait(&this->m_muxMutex, THREAD_WAIT_LIMIT);
+
+        // Write all pending packets in a batch.
+        auto packets = this->m_muxQueue;
+        this->m_muxQueue.clear();
+        this->m_muxQueueBytes = 0;
+        bool run = this->m_runMuxLoop;
+        bool armed = this->m_preRoll > 0 && !this->m_triggered;
+        this->m_muxQueueNotFull.wakeAll();
+        this->m_muxMutex.unlock();
+
+        if (!armed && !this->m_preRollPackets.isEmpty()) {
+            auto preRollPackets = this->m_preRollPackets;
+            this->m_preRollPackets.clear();
+
+            for (auto &packet: preRollPackets)
+                this->muxPacket(packet);
+        }
+
+        for (auto &packet: packets)
+            if (armed)
+                this->bufferPacket(packet);
+            else
+                this->muxPacket(packet);
+
+        if (!run && packets.isEmpty())
+            break;
+    }
+}
+
+void MuxOutputPrivate::clearMuxQueue()
+{
+    this->m_muxMutex.lock();
+
+    for (auto &packet: this->m_muxQueue)
+        av_packet_free(&packet);
+
+    this->m_muxQueue.clear();
+    this->m_muxQueueBytes = 0;
+    this->m_muxMutex.unlock();
+}
+
+int64_t MuxOutputPrivate::packetTime(const AVPacket *packet) const
+{
+    auto stream = this->m_formatContext->streams[packet->stream_index];
+    auto ts = packet->pts != AV_NOPTS_VALUE? packet->pts: packet->dts;
+
+    if (ts == AV_NOPTS_VALUE)
+        return AV_NOPTS_VALUE;
+
+    return av_rescale_q(ts, stream->time_base, AV_TIME_BASE_Q);
+}
+
+bool MuxOutputPrivate::isKeyPacket(const AVPacket *packet) const
+{
+    if (!(packet->flags & AV_PKT_FLAG_KEY))
+        return false;
+
+    // If there is video, the files are cut in the video key frames.
+    auto stream = this->m_formatContext->streams[packet->stream_index];
+
+    return !this->m_hasVideo
+           || stream->codecpar->codec_type == AVMEDIA_TYPE_VIDEO;
+}
+
+void MuxOutputPrivate::bufferPacket(AVPacket *packet)
+{
+    this->m_preRollPackets << packet;
+    auto time = this->packetTime(packet);
+
+    if (time == AV_NOPTS_VALUE)
+        return;
+
+    // Drop the oldest packets, keeping at least the pre-roll time and
+    // starting always from a key frame.
+    auto limit = time - 1000 * this->m_preRoll;
+
+    forever {
+        int next = -1;
+
+        for (int i = 1; i < this->m_preRollPackets.size(); i++)
+            if (this->isKeyPacket(this->m_preRollPackets[i])) {
+                next = i;
+
+                break;
+            }
+
+        if (next < 0) {
+            // Without a key frame in the buffer nothing can be decoded.
+            if (!this->isKeyPacket(this->m_preRollPackets.first())) {
+                auto first = this->packetTime(this->m_preRollPackets.first());
+
+                if (first != AV_NOPTS_VALUE && first < limit) {
+                    av_packet_free(&this->m_preRollPackets.first());
+                    this->m_preRollPackets.removeFirst();
+
+                    continue;
+                }
+            }
+
+            break;
+        }
+
+        auto nextTime = this->packetTime(this->m_preRollPackets[next]);
+
+        if (nextTime == AV_NOPTS_VALUE || nextTime > limit)
+            break;
+
+        for (int i = 0; i < next; i++)
+            av_packet_free(&this->m_preRollPackets[i]);
+
+        this->m_preRollPackets.erase(this->m_preRollPackets.begin(),
+                                     this->m_preRollPackets.begin() + next);
+    }
+}
+
+void MuxOutputPrivate::muxPacket(AVPacket *packet)
+{
+    auto time = this->packetTime(packet);
+    bool isKey = this->isKeyPacket(packet);
+
+    if (!this->m_outputContext) {
+        // A new file must start with a key frame.
+        if (!isKey || !this->openSegment()) {
+            av_packet_free(&packet);
+
+            return;
+        }
+    } else if (this->m_segmentDuration > 0
+               && isKey
+               && time != AV_NOPTS_VALUE
+               && this->m_segmentStart != AV_NOPTS_VALUE
+               && time - this->m_segmentStart >= 1000 * this->m_segmentDuration) {
+        this->closeSegment();
+
+        if (!this->openSegment()) {
+            av_packet_free(&packet);
+
+            return;
+        }
+    }
+
+    // Each file starts at time 0.
+    if (this->m_segmentStart == AV_NOPTS_VALUE)
+        this->m_segmentStart = time;
+
+    auto iStream = this->m_formatContext->streams[packet->stream_index];
+    auto oStream = this->m_outputContext->streams[packet->stream_index];
+
+    if (this->m_segmentStart != AV_NOPTS_VALUE) {
+        auto offset = av_rescale_q(this->m_segmentStart,
+                                   AV_TIME_BASE_Q,
+                                   iStream->time_base);
+
+        if (packet->pts != AV_NOPTS_VALUE)
+            packet->pts -= offset;
+
+        if (packet->dts != AV_NOPTS_VALUE)
+            packet->dts -= offset;
+    }
+
+    av_packet_rescale_ts(packet, iStream->time_base, oStream->time_base);
+    av_interleaved_write_frame(this->m_outputContext, packet);
+    av_packet_free(&packet);
+}
+
+QString MuxOutputPrivate::segmentLocation() const
+{
+    if (this->m_segmentDuration < 1 || this->isNetworkStream())
+        return this->m_location;
+
+    // Add the segment number before the file extension.
+    auto location = this->m_location;
+    int slash = location.lastIndexOf('/');
+    int dot = location.lastIndexOf('.');
+
+    if (dot <= slash + 1)
+        dot = location.size();
+
+    return location.left(dot)
+           + QString("-%1").arg(this->m_segmentIndex, 5, 10, QChar('0'))
+           + location.mid(dot);
+}
+
+bool MuxOutputPrivate::openSegment()
+{
+    auto location = this->segmentLocation();
+
+    if (avformat_alloc_output_context2(&this->m_outputContext,
+                                       nullptr,
+                                       this->m_format.toStdString().c_str(),
+                                       location.toStdString().c_str()) < 0)
+        return false;
+
+    // The codec tags are specific to each container.
+    bool sameFormat =
+            !strcmp(this->m_outputContext->oformat->name,
+                    this->m_formatContext->oformat->name);
+
+    for (uint i = 0; i < this->m_formatContext->nb_streams; i++) {
+        auto iStream = this->m_formatContext->streams[i];
+        auto oStream = avformat_new_stream(this->m_outputContext, nullptr);
+
+        if (!oStream
+            || avcodec_parameters_copy(oStream->codecpar,
+                                       iStream->codecpar) < 0) {
+            avformat_free_context(this->m_outputContext);
+            this->m_outputContext = nullptr;
+
+            return false;
+        }
+
+        oStream->id = iStream->id;
+        oStream->time_base = iStream->time_base;
+
+        if (!sameFormat)
+            oStream->codecpar->codec_tag = 0;
+    }
+
+    // Open file.
+    if (!(this->m_outputContext->oformat->flags & AVFMT_NOFILE)
+        && !this->openOutput(location)) {
+        avformat_free_context(this->m_outputContext);
+        this->m_outputContext = nullptr;
+
+        return false;
+    }
+
+    // Set format options.
+    auto formatOptions = this->formatContextOptions(this->m_outputContext);
+
+    // Write file header.
+    int error = avformat_write_header(this->m_outputContext, &formatOptions);
+    av_dict_free(&formatOptions);
+
+    if (error < 0) {
+        char errorStr[1024];
+        av_strerror(AVERROR(error), errorStr, 1024);
+        qDebug() << "Can't write header: " << errorStr;
+
+        if (!(this->m_outputContext->oformat->flags & AVFMT_NOFILE))
+            // Close the output file.
+            this->closeOutput();
+
+        avformat_free_context(this->m_outputContext);
+        this->m_outputContext = nullptr;
+
+        return false;
+    }
+
+    this->m_segmentStart = AV_NOPTS_VALUE;
+    this->m_segmentIndex++;
+
+    return true;
+}
+
+void MuxOutputPrivate::closeSegment()
+{
+    if (!this->m_outputContext)
+        return;
+
+    // Write the trailer, if any.
+    av_write_trailer(this->m_outputContext);
+
+    if (!(this->m_outputContext->oformat->flags & AVFMT_NOFILE))
+        // Close the output file.
+        this->closeOutput();
+
+    avformat_free_context(this->m_outputContext);
+    this->m_outputContext = nullptr;
+}
+
+bool MuxOutputPrivate::openOutput(const QString &url)
+{
+    auto location = url;
+
+    // Let FFmpeg handle the network protocols.
+    if (location.contains("://") && !location.startsWith("file://")) {
+        int error = avio_open(&this->m_outputContext->pb,
+                              location.toStdString().c_str(),
+                              AVIO_FLAG_READ_WRITE);
+
+        if (error < 0) {
+            char errorStr[1024];
+            av_strerror(AVERROR(error), errorStr, 1024);
+            qDebug() << "Can't open output file: " << errorStr;
+
+            return false;
+        }
+
+        return true;
+    }
+
+    if (location.startsWith("file://"))
+        location = QUrl(location).toLocalFile();
+
+    this->m_outputFile.setFileName(location);
+
+    if (!this->m_outputFile.open(QIODevice::ReadWrite
+                                 | QIODevice::Truncate)) {
+        qDebug() << "Can't open output file: "
+                 << this->m_outputFile.errorString();
+
+        return false;
+    }
+
+    this->m_outputSize = 0;
+    this->m_preallocatedSize = 0;
+
+#ifdef Q_OS_LINUX
+    auto preallocateSize = this->m_options.value("preallocate_size").toLongLong();
+
+    if (preallocateSize > 0
+        && posix_fallocate(this->m_outputFile.handle(),
+                           0,
+                           off_t(preallocateSize)) == 0)
+        this->m_preallocatedSize = preallocateSize;
+#endif
+
+    int bufferSize = DEFAULT_AVIO_BUFFER_SIZE;
+
+    if (this->m_options.contains("avio_buffer_size"))
+        bufferSize = qBound(4096,
+                            this->m_options.value("avio_buffer_size").toInt(),
+                            std::numeric_limits<int>::max());
+
+    auto buffer = reinterpret_cast<unsigned char *>(av_malloc(size_t(bufferSize)));
+
+    if (buffer)
+        this->m_outputContext->pb =
+                avio_alloc_context(buffer,
+                                   bufferSize,
+                                   1,
+                                   this,
+                                   nullptr,
+                                   MuxOutputPrivate::writeOutput,
+                                   MuxOutputPrivate::seekOutput);
+
+    if (!this->m_outputContext->pb) {
+        av_free(buffer);
+        this->m_outputFile.close();
+        qDebug() << "Can't allocate the output buffer";
+
+        return false;
+    }
+
+    return true;
+}
+
+void MuxOutputPrivate::closeOutput()
+{
+    if (!this->m_outputFile.isOpen()) {
+        avio_closep(&this->m_outputContext->pb);
+
+        return;
+    }
+
+    auto pb = this->m_outputContext->pb;
+
+    if (pb) {
+        avio_flush(pb);
+        av_freep(&pb->buffer);
+#if LIBAVFORMAT_VERSION_INT >= AV_VERSION_INT(57, 80, 100)
+        avio_context_free(&this->m_outputContext->pb);
+#else
+        av_freep(&this->m_outputContext->pb);
+#endif
+    }
+
+    // Release the space reserved and not used.
+    if (this->m_preallocatedSize > this->m_outputSize)
+        this->m_outputFile.resize(this->m_outputSize);
+
+    this->m_outputFile.close();
+}
+
+AVDictionary *MuxOutputPrivate::formatContextOptions(AVFormatContext *formatContext) const
+{
+    auto avClass = formatContext->oformat->priv_class;
+    QStringList flagType;
+
+    if (avClass)
+        for (auto option = avClass->option;
+             option;
+             option = av_opt_next(&avClass, option)) {
+            if (option->type == AV_OPT_TYPE_FLAGS)
+                flagType << option->name;
+        }
+
+    static const QStringList outputOptions {
+        "avio_buffer_size",
+        "preallocate_size",
+    };
+
+    AVDictionary *formatOptions = nullptr;
+
+    for (auto it = this->m_options.begin();
+         it != this->m_options.end();
+         it++) {
+        if (outputOptions.contains(it.key()))
+            continue;
+
+        QString value;
+
+        if (flagType.contains(it.key())) {
+            auto flags = it.value().toStringList();
+            value = flags.join('+');
+        } else {
+            value = it.value().toString();
+        }
+
+        av_dict_set(&formatOptions,
+                    it.key().toStdString().c_str(),
+                    value.toStdString().c_str(),
+                    0);
+    }
+
+    return formatOptions;
+}
+
+int MuxOutputPrivate::writeOutput(void *opaque,
+                                  AVIOWriteBuffer *buffer,
+                                  int size)
+{
+    auto output = reinterpret_cast<MuxOutputPrivate *>(opaque);
+    auto written =
+            output->m_outputFile.write(reinterpret_cast<const char *>(buffer),
+                                       size);
+
+    if (written < 0)
+        return AVERROR(EIO);
+
+    output->m_outputSize = qMax(output->m_outputSize, output->m_outputFile.pos());
+
+    return int(written);
+}
+
+int64_t MuxOutputPrivate::seekOutput(void *opaque,
+                                     int64_t offset,
+                                     int whence)
+{
+    auto output = reinterpret_cast<MuxOutputPrivate *>(opaque);
+
+    switch (whence & ~AVSEEK_FORCE) {
+    case AVSEEK_SIZE:
+        return output->m_outputSize;
+    case SEEK_SET:
+        break;
+    case SEEK_CUR:
+        offset += output->m_outputFile.pos();
+        break;
+    case SEEK_END:
+        offset += output->m_outputSize;
+        break;
+    default:
+        return AVERROR(EINVAL);
+    }
+
+    if (!output->m_outputFile.seek(offset))
+        return AVERROR(EIO);
+
+    return offset;
+}
+
+#include "moc_muxoutput.cpp"
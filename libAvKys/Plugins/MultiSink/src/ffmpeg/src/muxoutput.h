@@ -0,0 +1,69 @@
+/* Webcamoid, webcam capture application.
+ * Copyright (C) 2020  Gonzalo Exequiel Pedone
+ *
+ * Webcamoid is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Webcamoid is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Webcamoid. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Web-Site: http://webcamoid.github.io/
+ */
+
+#ifndef MUXOUTPUT_H
+#define MUXOUTPUT_H
+
+#include <QObject>
+#include <QSharedPointer>
+#include <QVariantMap>
+
+#define DEFAULT_AVIO_BUFFER_SIZE (1024 * 1024)
+
+class MuxOutputPrivate;
+class MuxOutput;
+struct AVFormatContext;
+struct AVPacket;
+
+using MuxOutputPtr = QSharedPointer<MuxOutput>;
+
+// Write the encoded packets to a file or a stream from its own thread. The
+// streams are copied from a reference format context, so several outputs can
+// share the same encoders.
+class MuxOutput: public QObject
+{
+    Q_OBJECT
+
+    public:
+        MuxOutput(const AVFormatContext *formatContext,
+                  const QString &location,
+                  const QString &format,
+                  const QVariantMap &options,
+                  bool lossless,
+                  QObject *parent=nullptr);
+        ~MuxOutput();
+
+        Q_INVOKABLE QString location() const;
+        Q_INVOKABLE QString format() const;
+        Q_INVOKABLE QVariantMap stats() const;
+
+    private:
+        MuxOutputPrivate *d;
+
+    public slots:
+        void setSegmentDuration(qint64 segmentDuration);
+        void setPreRoll(qint64 preRoll);
+        void setMaxPacketQueueSize(qint64 maxPacketQueueSize);
+        bool init();
+        void uninit();
+        void trigger();
+        void enqueuePacket(const AVPacket *packet);
+};
+
+#endif // MUXOUTPUT_H
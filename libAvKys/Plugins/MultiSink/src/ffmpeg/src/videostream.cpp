@@ -18,10 +18,15 @@
  */
 
 #include <QDebug>
-#include <QDateTime>
+#include <QElapsedTimer>
 #include <QImage>
+#include <QMap>
 #include <QMutex>
+#include <QQueue>
+#include <QThread>
+#include <QThreadPool>
 #include <QWaitCondition>
+#include <QtConcurrent>
 #include <QtMath>
 #include <akcaps.h>
 #include <akfrac.h>
@@ -31,39 +36,88 @@
 extern "C"
 {
     #include <libavutil/imgutils.h>
+    #include <libavutil/pixdesc.h>
     #include <libswscale/swscale.h>
 }
 
 #include "videostream.h"
 #include "mediawriterffmpeg.h"
 
-struct XRGB
-{
-    quint8 x;
-    quint8 r;
-    quint8 g;
-    quint8 b;
-};
+#define FRAME_ALIGN 32
+#define MAX_FRAME_QUEUE_SIZE 8
+#define MAX_CONVERSION_THREADS 16
+#define PIXELS_PER_SLICE (1280 * 720)
+#define MAX_FRAME_STEP 16
+#define ADAPT_INTERVAL 1000
 
-struct BGRX
-{
-    quint8 b;
-    quint8 g;
-    quint8 r;
-    quint8 x;
-};
+using PixelFormatsMap = QMap<AkVideoCaps::PixelFormat, AVPixelFormat>;
 
 class VideoStreamPrivate
 {
     public:
-        AVFrame *m_frame {nullptr};
-        SwsContext *m_scaleContext {nullptr};
+        QQueue<AVFrame *> m_frameQueue;
+        AVFrame *m_lastFrame {nullptr};
+        QVector<SwsContext *> m_scaleContexts;
+        QThreadPool m_scalePool;
+        int m_conversionThreads {0};
+        AVBufferPool *m_bufferPool {nullptr};
+        int m_bufferPoolSize {0};
         QMutex m_frameMutex;
+        QWaitCondition m_frameQueueNotEmpty;
+        QWaitCondition m_frameQueueNotFull;
         int64_t m_lastPts {AV_NOPTS_VALUE};
         int64_t m_refPts {AV_NOPTS_VALUE};
-        QWaitCondition m_frameReady;
+        bool m_constantFrameRate {true};
+
+        // Encoder statistics.
+        QAtomicInteger<qint64> m_encodedFrames {0};
+        QAtomicInteger<qint64> m_droppedFrames {0};
+        QAtomicInteger<qint64> m_duplicatedFrames {0};
+        QAtomicInteger<qint64> m_blockedTime {0};
+        QAtomicInteger<qint64> m_skippedFrames {0};
+
+        // Adaptive frame rate, when the encoder can't keep up only one of
+        // each m_frameStep frames is encoded.
+        bool m_adaptive {false};
+        int m_maxFrameStep {1};
+        QAtomicInt m_frameStep {1};
+        int64_t m_nextPts {AV_NOPTS_VALUE};
+        qint64 m_encodeTime {0};
+        qint64 m_lastBlockedTime {0};
+        QElapsedTimer m_adaptTimer;
+
+        // The packed 32 bits RGB formats are stored as native endian words,
+        // as in QImage, the others use the same byte order as FFmpeg.
+        inline static const PixelFormatsMap &nativePixelFormats()
+        {
+            static const PixelFormatsMap formats {
+                {AkVideoCaps::Format_argb, AV_PIX_FMT_RGB32 },
+                {AkVideoCaps::Format_0rgb, AV_PIX_FMT_0RGB32},
+            };
+
+            return formats;
+        }
 
-        QImage swapChannels(const QImage &image) const;
+        static AVPixelFormat pixelFormat(AkVideoCaps::PixelFormat format);
+        bool skipFrame(int64_t pts);
+        static void freeBuffer(void *opaque, uint8_t *data);
+        AVFrame *wrapPacket(const AkVideoPacket &packet,
+                            AVCodecContext *codecContext) const;
+        AVFrame *scalePacket(const AkVideoPacket &packet,
+                             AVPixelFormat iFormat,
+                             AVCodecContext *codecContext);
+        int scaleSlices(AVPixelFormat iFormat,
+                        int iWidth,
+                        int iHeight,
+                        const AVFrame *oFrame) const;
+        bool scaleSlice(int slice,
+                        int slices,
+                        const uint8_t * const *iData,
+                        const int *iLineSize,
+                        AVPixelFormat iFormat,
+                        int iWidth,
+                        int iHeight,
+                        AVFrame *oFrame);
 };
 
 VideoStream::VideoStream(const AVFormatContext *formatContext,
@@ -177,33 +231,41 @@ VideoStream::VideoStream(const AVFormatContext *formatContext,
 
     if (codecContext->gop_size < 1)
         codecContext->gop_size = defaultCodecParams["defaultGOP"].toInt();
+
+    this->d->m_constantFrameRate = configs["frameRateMode"].toString() != "vfr";
+
+    auto optKey = QString("%1/%2/%3").arg(formatContext->oformat->name)
+                                     .arg(streamIndex)
+                                     .arg(codec->name);
+    auto threads = codecOptions.value(optKey).value("conversion_threads");
+    this->d->m_conversionThreads =
+            qBound(0, threads.toInt(), MAX_CONVERSION_THREADS);
+    this->d->m_adaptive =
+            codecOptions.value(optKey).value("adaptive").toBool();
+    this->d->m_maxFrameStep =
+            qBound(1,
+                   codecOptions.value(optKey).value("adaptive_max_step", 4).toInt(),
+                   MAX_FRAME_STEP);
+
+    if (this->d->m_scalePool.maxThreadCount() < MAX_CONVERSION_THREADS)
+        this->d->m_scalePool.setMaxThreadCount(MAX_CONVERSION_THREADS);
 }
 
 VideoStream::~VideoStream()
 {
     this->uninit();
-    this->deleteFrame(&this->d->m_frame);
-    sws_freeContext(this->d->m_scaleContext);
-    delete this->d;
-}
 
-QImage VideoStreamPrivate::swapChannels(const QImage &image) const
-{
-    QImage swapped(image.size(), image.format());
+    for (auto &frame: this->d->m_frameQueue)
+        this->deleteFrame(&frame);
 
-    for (int y = 0; y < image.height(); y++) {
-        const XRGB *src = reinterpret_cast<const XRGB *>(image.constScanLine(y));
-        BGRX *dst = reinterpret_cast<BGRX *>(swapped.scanLine(y));
+    this->deleteFrame(&this->d->m_lastFrame);
+    this->d->m_scalePool.waitForDone();
 
-        for (int x = 0; x < image.width(); x++) {
-            dst[x].x = src[x].x;
-            dst[x].r = src[x].r;
-            dst[x].g = src[x].g;
-            dst[x].b = src[x].b;
-        }
-    }
+    for (auto &context: this->d->m_scaleContexts)
+        sws_freeContext(context);
 
-    return swapped;
+    av_buffer_pool_uninit(&this->d->m_bufferPool);
+    delete this->d;
 }
 
 void VideoStream::convertPacket(const AkPacket &packet)
@@ -211,84 +273,101 @@ void VideoStream::convertPacket(const AkPacket &packet)
     if (!packet)
         return;
 
+    // Time stamps are taken from the source, in the codec time base. If the
+    // packet has no time base, assume the pts is already in the codec one.
     auto codecContext = this->codecContext();
+    AkFrac outTimeBase(codecContext->time_base.num,
+                       codecContext->time_base.den);
+    auto pts = packet.pts();
 
-    auto oFrame = av_frame_alloc();
-    oFrame->format = codecContext->pix_fmt;
-    oFrame->width = codecContext->width;
-    oFrame->height = codecContext->height;
-    oFrame->pts = packet.pts();
+    if (packet.timeBase().den() != 0)
+        pts = qRound64(packet.pts()
+                       * packet.timeBase().value()
+                       / outTimeBase.value());
+
+    // Skip the frame before converting it, if the encoder is overloaded.
+    if (this->d->m_adaptive && this->d->skipFrame(pts)) {
+        this->d->m_skippedFrames++;
 
-    AkVideoPacket videoPacket(packet);
-    auto image = videoPacket.toImage();
-    image = image.convertToFormat(QImage::Format_ARGB32);
-    image = this->d->swapChannels(image);
-    videoPacket = AkVideoPacket::fromImage(image, videoPacket);
-
-    QString format = AkVideoCaps::pixelFormatToString(videoPacket.caps().format());
-    AVPixelFormat iFormat = av_get_pix_fmt(format.toStdString().c_str());
-    int iWidth = videoPacket.caps().width();
-    int iHeight = videoPacket.caps().height();
-
-    this->d->m_scaleContext =
-            sws_getCachedContext(this->d->m_scaleContext,
-                                 iWidth,
-                                 iHeight,
-                                 iFormat,
-                                 oFrame->width,
-                                 oFrame->height,
-                                 AVPixelFormat(oFrame->format),
-                                 SWS_FAST_BILINEAR,
-                                 nullptr,
-                                 nullptr,
-                                 nullptr);
-
-    if (!this->d->m_scaleContext)
         return;
+    }
 
-    AVFrame iFrame;
-    memset(&iFrame, 0, sizeof(AVFrame));
+    AkVideoPacket videoPacket(packet);
+    auto iFormat = VideoStreamPrivate::pixelFormat(videoPacket.caps().format());
 
-    if (av_image_check_size(uint(iWidth),
-                            uint(iHeight),
-                            0,
-                            nullptr) < 0)
-        return;
+    // Formats unknown to FFmpeg are converted to ARGB first.
+    if (iFormat == AV_PIX_FMT_NONE) {
+        auto image = videoPacket.toImage();
 
-    if (av_image_fill_linesizes(iFrame.linesize,
-                                iFormat,
-                                iWidth) < 0)
-        return;
+        if (image.isNull())
+            return;
 
-    if (av_image_fill_pointers(reinterpret_cast<uint8_t **>(iFrame.data),
-                               iFormat,
-                               iHeight,
-                               reinterpret_cast<uint8_t *>(videoPacket.buffer().data()),
-                               iFrame.linesize) < 0) {
-        return;
+        image = image.convertToFormat(QImage::Format_ARGB32);
+        videoPacket = AkVideoPacket::fromImage(image, videoPacket);
+        iFormat = AV_PIX_FMT_RGB32;
     }
 
-    if (av_image_alloc(oFrame->data,
-                       oFrame->linesize,
-                       oFrame->width,
-                       oFrame->height,
-                       AVPixelFormat(oFrame->format),
-                       4) < 0)
+    AVFrame *oFrame = nullptr;
+
+    // If the packet is already in the format of the encoder, send it as is.
+    if (iFormat == codecContext->pix_fmt
+        && videoPacket.caps().width() == codecContext->width
+        && videoPacket.caps().height() == codecContext->height)
+        oFrame = this->d->wrapPacket(videoPacket, codecContext);
+    else
+        oFrame = this->d->scalePacket(videoPacket, iFormat, codecContext);
+
+    if (!oFrame)
         return;
 
-    sws_scale(this->d->m_scaleContext,
-              iFrame.data,
-              iFrame.linesize,
-              0,
-              iHeight,
-              oFrame->data,
-              oFrame->linesize);
+    oFrame->pts = pts;
 
+    // Wait for the encoder if the queue is full, if it is still busy after
+    // that the frame is dropped.
     this->d->m_frameMutex.lock();
-    this->deleteFrame(&this->d->m_frame);
-    this->d->m_frame = oFrame;
-    this->d->m_frameReady.wakeAll();
+    bool enqueue = true;
+
+    if (this->d->m_frameQueue.size() >= MAX_FRAME_QUEUE_SIZE) {
+        QElapsedTimer timer;
+        timer.start();
+        enqueue = this->d->m_frameQueueNotFull.wait(&this->d->m_frameMutex,
+                                                    THREAD_WAIT_LIMIT);
+        this->d->m_blockedTime += timer.elapsed();
+    }
+
+    if (enqueue) {
+        this->d->m_frameQueue << oFrame;
+        this->d->m_frameQueueNotEmpty.wakeAll();
+    }
+
     this->d->m_frameMutex.unlock();
+
+    if (!enqueue) {
+        this->deleteFrame(&oFrame);
+        this->d->m_droppedFrames++;
+    }
+}
+
+QVariantMap VideoStream::stats() const
+{
+    auto stats = AbstractStream::stats();
+    this->d->m_frameMutex.lock();
+    stats["frameQueueSize"] = this->d->m_frameQueue.size();
+    this->d->m_frameMutex.unlock();
+    stats["maxFrameQueueSize"] = MAX_FRAME_QUEUE_SIZE;
+    stats["frameRateMode"] = this->d->m_constantFrameRate? "cfr": "vfr";
+    stats["encodedFrames"] = qint64(this->d->m_encodedFrames);
+    stats["droppedFrames"] = qint64(this->d->m_droppedFrames);
+    stats["duplicatedFrames"] = qint64(this->d->m_duplicatedFrames);
+    stats["blockedTimeMs"] = qint64(this->d->m_blockedTime);
+
+    if (this->d->m_adaptive) {
+        stats["frameStep"] = int(this->d->m_frameStep);
+        stats["skippedFrames"] = qint64(this->d->m_skippedFrames);
+        stats["encodeTimeUs"] = this->d->m_encodeTime;
+    }
+
+    return stats;
 }
 
 int VideoStream::encodeData(AVFrame *frame)
@@ -300,32 +379,78 @@ int VideoStream::encodeData(AVFrame *frame)
         return AVERROR_EOF;
 #endif
 
-    auto codecContext = this->codecContext();
+    if (!frame) {
+        this->d->m_lastPts++;
 
-    AkFrac outTimeBase(codecContext->time_base.num,
-                       codecContext->time_base.den);
+        return this->sendFrame(nullptr);
+    }
 
-    if (frame) {
-        qint64 pts = qRound64(QDateTime::currentMSecsSinceEpoch()
-                              / outTimeBase.value()
-                              / 1000);
+    if (this->d->m_refPts == AV_NOPTS_VALUE) {
+        this->d->m_refPts = frame->pts;
+        this->d->m_lastPts = -1;
+    }
 
-        if (this->d->m_refPts == AV_NOPTS_VALUE)
-            this->d->m_lastPts = this->d->m_refPts = pts;
-        else if (this->d->m_lastPts != pts)
-            this->d->m_lastPts = pts;
-        else
-            return AVERROR(EAGAIN);
+    auto pts = frame->pts - this->d->m_refPts;
 
-        frame->pts = this->d->m_lastPts - this->d->m_refPts;
-    } else {
-        this->d->m_lastPts++;
+    // The encoder needs strictly increasing time stamps, frames falling in
+    // an already used slot are dropped.
+    if (pts <= this->d->m_lastPts) {
+        this->d->m_droppedFrames++;
+
+        return AVERROR(EAGAIN);
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    int frames = 1;
+
+    // In constant frame rate mode the gaps are filled repeating the last
+    // frame, up to one second. The skipped frames are not filled.
+    if (this->d->m_constantFrameRate && this->d->m_lastFrame) {
+        auto codecContext = this->codecContext();
+        int64_t maxGap = codecContext->time_base.num > 0?
+                             codecContext->time_base.den
+                             / codecContext->time_base.num: 0;
+        int step = this->d->m_frameStep;
+        auto fillPts = qMax(this->d->m_lastPts + step, pts - maxGap);
+
+        for (; fillPts < pts; fillPts += step) {
+            auto duplicated = av_frame_clone(this->d->m_lastFrame);
+
+            if (!duplicated)
+                break;
+
+            duplicated->pts = fillPts;
+            this->sendFrame(duplicated);
+            av_frame_free(&duplicated);
+            this->d->m_duplicatedFrames++;
+            frames++;
+        }
+    }
+
+    frame->pts = pts;
+    this->d->m_lastPts = pts;
+    auto result = this->sendFrame(frame);
+    this->d->m_encodedFrames++;
+
+    if (this->d->m_adaptive)
+        this->adapt(timer.nsecsElapsed() / (1000 * frames));
+
+    if (this->d->m_constantFrameRate) {
+        av_frame_free(&this->d->m_lastFrame);
+        this->d->m_lastFrame = av_frame_clone(frame);
     }
 
+    return result;
+}
+
+int VideoStream::sendFrame(AVFrame *frame)
+{
+    auto codecContext = this->codecContext();
     auto stream = this->stream();
 
 #ifdef HAVE_RAWPICTURE
-    if (formatContext->oformat->flags & AVFMT_RAWPICTURE) {
+    if (this->formatContext()->oformat->flags & AVFMT_RAWPICTURE) {
         // Raw video case - directly store the picture in the packet
         AVPacket pkt;
         av_init_packet(&pkt);
@@ -378,23 +503,373 @@ int VideoStream::encodeData(AVFrame *frame)
     return result;
 }
 
+void VideoStream::adapt(qint64 encodeTime)
+{
+    // Moving average of the time spent encoding each frame.
+    if (this->d->m_encodeTime < 1)
+        this->d->m_encodeTime = encodeTime;
+    else
+        this->d->m_encodeTime = (7 * this->d->m_encodeTime + encodeTime) / 8;
+
+    // Check the load from time to time, so the frame rate is stable.
+    if (!this->d->m_adaptTimer.isValid()) {
+        this->d->m_adaptTimer.start();
+
+        return;
+    }
+
+    if (this->d->m_adaptTimer.elapsed() < ADAPT_INTERVAL)
+        return;
+
+    this->d->m_adaptTimer.restart();
+    auto codecContext = this->codecContext();
+
+    if (codecContext->time_base.den < 1)
+        return;
+
+    // Time available for encoding each frame, in microseconds.
+    auto frameTime = 1e6 * codecContext->time_base.num
+                     / codecContext->time_base.den;
+    int step = this->d->m_frameStep;
+    auto load = this->d->m_encodeTime / (step * frameTime);
+    this->d->m_frameMutex.lock();
+    auto queued = this->d->m_frameQueue.size();
+    this->d->m_frameMutex.unlock();
+
+    // The converter waiting for the encoder means that the queue is full.
+    qint64 blockedTime = this->d->m_blockedTime;
+    bool blocked = blockedTime > this->d->m_lastBlockedTime;
+    this->d->m_lastBlockedTime = blockedTime;
+    int newStep = step;
+
+    if (step < this->d->m_maxFrameStep
+        && (blocked || load > 0.9 || 2 * queued > MAX_FRAME_QUEUE_SIZE))
+        newStep++;
+    else if (step > 1
+             && !blocked
+             && queued < 2
+             && this->d->m_encodeTime < 0.7 * (step - 1) * frameTime)
+        newStep--;
+
+    if (newStep == step)
+        return;
+
+    this->d->m_frameStep = newStep;
+    auto fps = 1e6 / frameTime;
+
+    emit this->encoderAdapted(this->streamIndex(), {
+        {"frameStep"   , newStep                 },
+        {"maxFrameStep", this->d->m_maxFrameStep },
+        {"frameRate"   , fps / newStep           },
+        {"encodeTimeUs", this->d->m_encodeTime   },
+        {"load"        , load                    },
+    });
+}
+
 AVFrame *VideoStream::dequeueFrame()
 {
     this->d->m_frameMutex.lock();
 
-    if (!this->d->m_frame)
-        if (!this->d->m_frameReady.wait(&this->d->m_frameMutex,
-                                        THREAD_WAIT_LIMIT)) {
-            this->d->m_frameMutex.unlock();
+    while (this->d->m_frameQueue.isEmpty() && this->isEncoding())
+        this->d->m_frameQueueNotEmpty.wait(&this->d->m_frameMutex);
 
-            return nullptr;
-        }
+    AVFrame *frame = nullptr;
+
+    if (!this->d->m_frameQueue.isEmpty()) {
+        frame = this->d->m_frameQueue.dequeue();
+        this->d->m_frameQueueNotFull.wakeAll();
+    }
 
-    auto frame = this->d->m_frame;
-    this->d->m_frame = nullptr;
     this->d->m_frameMutex.unlock();
 
     return frame;
 }
 
+void VideoStream::interruptDequeue()
+{
+    this->d->m_frameMutex.lock();
+    this->d->m_frameQueueNotEmpty.wakeAll();
+    this->d->m_frameQueueNotFull.wakeAll();
+    this->d->m_frameMutex.unlock();
+}
+
+AVPixelFormat VideoStreamPrivate::pixelFormat(AkVideoCaps::PixelFormat format)
+{
+    auto &formats = nativePixelFormats();
+
+    if (formats.contains(format))
+        return formats[format];
+
+    auto name = AkVideoCaps::pixelFormatToString(format);
+
+    return av_get_pix_fmt(name.toStdString().c_str());
+}
+
+bool VideoStreamPrivate::skipFrame(int64_t pts)
+{
+    int step = this->m_frameStep;
+
+    // Keep one frame of each step, restarting if the time goes back.
+    if (this->m_nextPts != AV_NOPTS_VALUE
+        && pts < this->m_nextPts
+        && pts > this->m_nextPts - 2 * step)
+        return true;
+
+    this->m_nextPts = pts + step;
+
+    return false;
+}
+
+void VideoStreamPrivate::freeBuffer(void *opaque, uint8_t *data)
+{
+    Q_UNUSED(data)
+
+    delete reinterpret_cast<QByteArray *>(opaque);
+}
+
+AVFrame *VideoStreamPrivate::wrapPacket(const AkVideoPacket &packet,
+                                        AVCodecContext *codecContext) const
+{
+    // The frame keeps a reference to the packet data until the encoder
+    // releases it.
+    auto buffer = new QByteArray(packet.buffer());
+    auto data = reinterpret_cast<uint8_t *>(const_cast<char *>(buffer->constData()));
+    auto frameBuffer = av_buffer_create(data,
+                                        buffer->size(),
+                                        VideoStreamPrivate::freeBuffer,
+                                        buffer,
+                                        AV_BUFFER_FLAG_READONLY);
+
+    if (!frameBuffer) {
+        delete buffer;
+
+        return nullptr;
+    }
+
+    auto oFrame = av_frame_alloc();
+    oFrame->format = codecContext->pix_fmt;
+    oFrame->width = codecContext->width;
+    oFrame->height = codecContext->height;
+    oFrame->buf[0] = frameBuffer;
+    auto caps = packet.caps();
+
+    for (int plane = 0; plane < qMin(caps.planes(), AV_NUM_DATA_POINTERS); plane++) {
+        oFrame->data[plane] = data + caps.planeOffset(plane);
+        oFrame->linesize[plane] = int(caps.bytesPerLine(plane));
+    }
+
+    return oFrame;
+}
+
+AVFrame *VideoStreamPrivate::scalePacket(const AkVideoPacket &packet,
+                                         AVPixelFormat iFormat,
+                                         AVCodecContext *codecContext)
+{
+    auto caps = packet.caps();
+    int iWidth = caps.width();
+    int iHeight = caps.height();
+
+    if (av_image_check_size(uint(iWidth), uint(iHeight), 0, nullptr) < 0)
+        return nullptr;
+
+    // The output frames are taken from a pool instead of allocating a new
+    // buffer each time.
+    int bufferSize = av_image_get_buffer_size(codecContext->pix_fmt,
+                                              codecContext->width,
+                                              codecContext->height,
+                                              FRAME_ALIGN);
+
+    if (bufferSize < 1)
+        return nullptr;
+
+    if (!this->m_bufferPool || this->m_bufferPoolSize != bufferSize) {
+        av_buffer_pool_uninit(&this->m_bufferPool);
+        this->m_bufferPool = av_buffer_pool_init(bufferSize, nullptr);
+        this->m_bufferPoolSize = bufferSize;
+    }
+
+    auto frameBuffer = av_buffer_pool_get(this->m_bufferPool);
+
+    if (!frameBuffer)
+        return nullptr;
+
+    auto oFrame = av_frame_alloc();
+    oFrame->format = codecContext->pix_fmt;
+    oFrame->width = codecContext->width;
+    oFrame->height = codecContext->height;
+    oFrame->buf[0] = frameBuffer;
+
+    if (av_image_fill_arrays(oFrame->data,
+                             oFrame->linesize,
+                             frameBuffer->data,
+                             codecContext->pix_fmt,
+                             codecContext->width,
+                             codecContext->height,
+                             FRAME_ALIGN) < 0) {
+        av_frame_free(&oFrame);
+
+        return nullptr;
+    }
+
+    const uint8_t *iData[AV_NUM_DATA_POINTERS];
+    int iLineSize[AV_NUM_DATA_POINTERS];
+    memset(iData, 0, sizeof(iData));
+    memset(iLineSize, 0, sizeof(iLineSize));
+
+    for (int plane = 0; plane < qMin(caps.planes(), AV_NUM_DATA_POINTERS); plane++) {
+        iData[plane] = packet.constLine(plane, 0);
+        iLineSize[plane] = int(caps.bytesPerLine(plane));
+    }
+
+    // Big frames are converted by horizontal slices in parallel, each slice
+    // with its own context, as long as the height is not changed.
+    int slices = this->scaleSlices(iFormat, iWidth, iHeight, oFrame);
+
+    if (this->m_scaleContexts.size() != slices) {
+        for (auto &context: this->m_scaleContexts)
+            sws_freeContext(context);
+
+        this->m_scaleContexts = QVector<SwsContext *>(slices, nullptr);
+    }
+
+    QVector<QFuture<bool>> results;
+
+    for (int slice = 1; slice < slices; slice++)
+        results << QtConcurrent::run(&this->m_scalePool,
+                                     [=, &iData, &iLineSize] () {
+            return this->scaleSlice(slice,
+                                    slices,
+                                    iData,
+                                    iLineSize,
+                                    iFormat,
+                                    iWidth,
+                                    iHeight,
+                                    oFrame);
+        });
+
+    bool ok = this->scaleSlice(0,
+                               slices,
+                               iData,
+                               iLineSize,
+                               iFormat,
+                               iWidth,
+                               iHeight,
+                               oFrame);
+
+    for (auto &result: results)
+        ok &= result.result();
+
+    if (!ok)
+        av_frame_free(&oFrame);
+
+    return oFrame;
+}
+
+int VideoStreamPrivate::scaleSlices(AVPixelFormat iFormat,
+                                    int iWidth,
+                                    int iHeight,
+                                    const AVFrame *oFrame) const
+{
+    auto iDesc = av_pix_fmt_desc_get(iFormat);
+    auto oDesc = av_pix_fmt_desc_get(AVPixelFormat(oFrame->format));
+
+    if (!iDesc || !oDesc
+        || iDesc->flags & AV_PIX_FMT_FLAG_PAL
+        || oDesc->flags & AV_PIX_FMT_FLAG_PAL)
+        return 1;
+
+    // The slices don't share lines with their neighbours, scaling them
+    // vertically would leave seams between them.
+    if (iHeight != oFrame->height)
+        return 1;
+
+    int slices = this->m_conversionThreads;
+
+    if (slices < 1)
+        slices = qMin(QThread::idealThreadCount(),
+                      qMax(iWidth * iHeight, oFrame->width * oFrame->height)
+                      / PIXELS_PER_SLICE);
+
+    // Every slice must have at least a few lines in both ends, and start in
+    // a line with chroma samples.
+    int align = 1 << qMax(iDesc->log2_chroma_h, oDesc->log2_chroma_h);
+    int maxSlices = qMin(iHeight, oFrame->height) / (8 * align);
+
+    return qBound(1, qMin(slices, maxSlices), MAX_CONVERSION_THREADS);
+}
+
+bool VideoStreamPrivate::scaleSlice(int slice,
+                                    int slices,
+                                    const uint8_t * const *iData,
+                                    const int *iLineSize,
+                                    AVPixelFormat iFormat,
+                                    int iWidth,
+                                    int iHeight,
+                                    AVFrame *oFrame)
+{
+    auto iDesc = av_pix_fmt_desc_get(iFormat);
+    auto oDesc = av_pix_fmt_desc_get(AVPixelFormat(oFrame->format));
+    int align = 1 << qMax(iDesc->log2_chroma_h, oDesc->log2_chroma_h);
+    int oHeight = oFrame->height;
+
+    // Output lines of the slice, and the input lines mapped to them.
+    auto alignLine = [align] (qint64 line) {
+        return int(line / align * align);
+    };
+    int oY0 = alignLine(qint64(oHeight) * slice / slices);
+    int oY1 = slice + 1 < slices?
+                  alignLine(qint64(oHeight) * (slice + 1) / slices): oHeight;
+    int iY0 = slice > 0? alignLine(qint64(oY0) * iHeight / oHeight): 0;
+    int iY1 = slice + 1 < slices?
+                  alignLine(qint64(oY1) * iHeight / oHeight): iHeight;
+
+    auto context = sws_getCachedContext(this->m_scaleContexts[slice],
+                                        iWidth,
+                                        iY1 - iY0,
+                                        iFormat,
+                                        oFrame->width,
+                                        oY1 - oY0,
+                                        AVPixelFormat(oFrame->format),
+                                        SWS_FAST_BILINEAR,
+                                        nullptr,
+                                        nullptr,
+                                        nullptr);
+    this->m_scaleContexts[slice] = context;
+
+    if (!context)
+        return false;
+
+    auto planeShift = [] (const AVPixFmtDescriptor *desc, int plane) {
+        return plane > 0
+               && (plane == desc->comp[1].plane
+                   || plane == desc->comp[2].plane)?
+                    desc->log2_chroma_h: 0;
+    };
+
+    const uint8_t *iSlice[AV_NUM_DATA_POINTERS];
+    uint8_t *oSlice[AV_NUM_DATA_POINTERS];
+    memset(iSlice, 0, sizeof(iSlice));
+    memset(oSlice, 0, sizeof(oSlice));
+
+    for (int plane = 0; plane < AV_NUM_DATA_POINTERS; plane++) {
+        if (iData[plane])
+            iSlice[plane] = iData[plane]
+                          + (iY0 >> planeShift(iDesc, plane)) * iLineSize[plane];
+
+        if (oFrame->data[plane])
+            oSlice[plane] = oFrame->data[plane]
+                          + (oY0 >> planeShift(oDesc, plane)) * oFrame->linesize[plane];
+    }
+
+    sws_scale(context,
+              iSlice,
+              iLineSize,
+              0,
+              iY1 - iY0,
+              oSlice,
+              oFrame->linesize);
+
+    return true;
+}
+
 #include "moc_videostream.cpp"
@@ -37,13 +37,19 @@ class VideoStream: public AbstractStream
                     QObject *parent=nullptr);
         ~VideoStream();
 
+        Q_INVOKABLE QVariantMap stats() const;
+
     private:
         VideoStreamPrivate *d;
 
+        int sendFrame(AVFrame *frame);
+        void adapt(qint64 encodeTime);
+
     protected:
         void convertPacket(const AkPacket &packet);
         int encodeData(AVFrame *frame);
         AVFrame *dequeueFrame();
+        void interruptDequeue();
 };
 
 #endif // VIDEOSTREAM_H
@@ -1360,10 +1360,10 @@ void MediaWriterGStreamer::resetCodecOptions(int index)
     emit this->codecOptionsChanged(optKey, QVariantMap());
 }
 
-void MediaWriterGStreamer::enqueuePacket(const AkPacket &packet)
+bool MediaWriterGStreamer::enqueuePacket(const AkPacket &packet)
 {
     if (!this->d->m_isRecording)
-        return;
+        return false;
 
     if (packet.caps().mimeType() == "audio/x-raw") {
         this->writeAudioPacket(AkAudioPacket(packet));
@@ -1371,7 +1371,11 @@ void MediaWriterGStreamer::enqueuePacket(const AkPacket &packet)
         this->writeVideoPacket(AkVideoPacket(packet));
     } else if (packet.caps().mimeType() == "text/x-raw") {
         this->writeSubtitlePacket(packet);
+    } else {
+        return false;
     }
+
+    return true;
 }
 
 void MediaWriterGStreamer::clearStreams()
@@ -69,7 +69,7 @@ class MediaWriterGStreamer: public MediaWriter
         void resetOutputFormat();
         void resetFormatOptions();
         void resetCodecOptions(int index);
-        void enqueuePacket(const AkPacket &packet);
+        bool enqueuePacket(const AkPacket &packet);
         void clearStreams();
         bool init();
         void uninit();
@@ -63,6 +63,21 @@ QStringList MediaWriter::codecsBlackList() const
     return this->m_codecsBlackList;
 }
 
+qint64 MediaWriter::segmentDuration() const
+{
+    return this->m_segmentDuration;
+}
+
+qint64 MediaWriter::preRoll() const
+{
+    return this->m_preRoll;
+}
+
+QVariantList MediaWriter::extraOutputs() const
+{
+    return this->m_extraOutputs;
+}
+
 QStringList MediaWriter::supportedFormats()
 {
     return {};
@@ -173,6 +188,11 @@ QVariantList MediaWriter::codecOptions(int index)
     return {};
 }
 
+QVariantList MediaWriter::encoderStats() const
+{
+    return {};
+}
+
 void MediaWriter::setLocation(const QString &location)
 {
     if (this->m_location == location)
@@ -221,6 +241,33 @@ void MediaWriter::setCodecsBlackList(const QStringList &codecsBlackList)
     emit this->codecsBlackListChanged(codecsBlackList);
 }
 
+void MediaWriter::setSegmentDuration(qint64 segmentDuration)
+{
+    if (this->m_segmentDuration == segmentDuration)
+        return;
+
+    this->m_segmentDuration = segmentDuration;
+    emit this->segmentDurationChanged(segmentDuration);
+}
+
+void MediaWriter::setPreRoll(qint64 preRoll)
+{
+    if (this->m_preRoll == preRoll)
+        return;
+
+    this->m_preRoll = preRoll;
+    emit this->preRollChanged(preRoll);
+}
+
+void MediaWriter::setExtraOutputs(const QVariantList &extraOutputs)
+{
+    if (this->m_extraOutputs == extraOutputs)
+        return;
+
+    this->m_extraOutputs = extraOutputs;
+    emit this->extraOutputsChanged(extraOutputs);
+}
+
 void MediaWriter::resetLocation()
 {
     this->setLocation("");
@@ -253,9 +300,30 @@ void MediaWriter::resetCodecsBlackList()
     this->setCodecsBlackList({});
 }
 
-void MediaWriter::enqueuePacket(const AkPacket &packet)
+void MediaWriter::resetSegmentDuration()
+{
+    this->setSegmentDuration(0);
+}
+
+void MediaWriter::resetPreRoll()
+{
+    this->setPreRoll(0);
+}
+
+void MediaWriter::resetExtraOutputs()
+{
+    this->setExtraOutputs({});
+}
+
+void MediaWriter::trigger()
+{
+}
+
+bool MediaWriter::enqueuePacket(const AkPacket &packet)
 {
     Q_UNUSED(packet)
+
+    return false;
 }
 
 void MediaWriter::clearStreams()
@@ -59,6 +59,21 @@ class MediaWriter: public QObject
                WRITE setCodecsBlackList
                RESET resetCodecsBlackList
                NOTIFY codecsBlackListChanged)
+    Q_PROPERTY(qint64 segmentDuration
+               READ segmentDuration
+               WRITE setSegmentDuration
+               RESET resetSegmentDuration
+               NOTIFY segmentDurationChanged)
+    Q_PROPERTY(qint64 preRoll
+               READ preRoll
+               WRITE setPreRoll
+               RESET resetPreRoll
+               NOTIFY preRollChanged)
+    Q_PROPERTY(QVariantList extraOutputs
+               READ extraOutputs
+               WRITE setExtraOutputs
+               RESET resetExtraOutputs
+               NOTIFY extraOutputsChanged)
 
     public:
         MediaWriter(QObject *parent=nullptr);
@@ -71,6 +86,9 @@ class MediaWriter: public QObject
         Q_INVOKABLE virtual qint64 maxPacketQueueSize() const;
         Q_INVOKABLE virtual QStringList formatsBlackList() const;
         Q_INVOKABLE virtual QStringList codecsBlackList() const;
+        Q_INVOKABLE virtual qint64 segmentDuration() const;
+        Q_INVOKABLE virtual qint64 preRoll() const;
+        Q_INVOKABLE virtual QVariantList extraOutputs() const;
 
         Q_INVOKABLE virtual QStringList supportedFormats();
         Q_INVOKABLE virtual QStringList fileExtensions(const QString &format);
@@ -93,11 +111,15 @@ class MediaWriter: public QObject
         Q_INVOKABLE virtual QVariantMap updateStream(int index,
                                                      const QVariantMap &codecParams);
         Q_INVOKABLE virtual QVariantList codecOptions(int index);
+        Q_INVOKABLE virtual QVariantList encoderStats() const;
 
     protected:
         QString m_location;
         QStringList m_formatsBlackList;
         QStringList m_codecsBlackList;
+        qint64 m_segmentDuration {0};
+        qint64 m_preRoll {0};
+        QVariantList m_extraOutputs;
 
     signals:
         void locationChanged(const QString &location);
@@ -110,6 +132,10 @@ class MediaWriter: public QObject
         void maxPacketQueueSizeChanged(qint64 maxPacketQueueSize);
         void formatsBlackListChanged(const QStringList &formatsBlackList);
         void codecsBlackListChanged(const QStringList &codecsBlackList);
+        void segmentDurationChanged(qint64 segmentDuration);
+        void preRollChanged(qint64 preRoll);
+        void extraOutputsChanged(const QVariantList &extraOutputs);
+        void encoderAdapted(int index, const QVariantMap &adaptation);
 
     public slots:
         virtual void setLocation(const QString &location);
@@ -119,6 +145,9 @@ class MediaWriter: public QObject
         virtual void setMaxPacketQueueSize(qint64 maxPacketQueueSize);
         virtual void setFormatsBlackList(const QStringList &formatsBlackList);
         virtual void setCodecsBlackList(const QStringList &codecsBlackList);
+        virtual void setSegmentDuration(qint64 segmentDuration);
+        virtual void setPreRoll(qint64 preRoll);
+        virtual void setExtraOutputs(const QVariantList &extraOutputs);
         virtual void resetLocation();
         virtual void resetOutputFormat();
         virtual void resetFormatOptions();
@@ -126,7 +155,11 @@ class MediaWriter: public QObject
         virtual void resetMaxPacketQueueSize();
         virtual void resetFormatsBlackList();
         virtual void resetCodecsBlackList();
-        virtual void enqueuePacket(const AkPacket &packet);
+        virtual void resetSegmentDuration();
+        virtual void resetPreRoll();
+        virtual void resetExtraOutputs();
+        virtual void trigger();
+        virtual bool enqueuePacket(const AkPacket &packet);
         virtual void clearStreams();
         virtual bool init();
         virtual void uninit();
@@ -20,6 +20,7 @@
 #include <QSharedPointer>
 #include <QQmlContext>
 #include <akpacket.h>
+#include <akaudiopacket.h>
 
 #include "multisinkelement.h"
 #include "multisinkelementsettings.h"
@@ -43,6 +44,10 @@ class MultiSinkElementPrivate
         MediaWriterPtr m_mediaWriter;
         MultiSinkUtils m_utils;
         QList<int> m_inputStreams;
+        qint64 m_segmentDuration {0};
+        qint64 m_preRoll {0};
+        QVariantList m_extraOutputs;
+        bool m_skipSilence {false};
 
         // Formats and codecs info cache.
         QStringList m_supportedFormats;
@@ -126,6 +131,26 @@ QStringList MultiSinkElement::codecsBlackList() const
     return this->d->m_mediaWriter->codecsBlackList();
 }
 
+bool MultiSinkElement::skipSilence() const
+{
+    return this->d->m_skipSilence;
+}
+
+qint64 MultiSinkElement::segmentDuration() const
+{
+    return this->d->m_segmentDuration;
+}
+
+qint64 MultiSinkElement::preRoll() const
+{
+    return this->d->m_preRoll;
+}
+
+QVariantList MultiSinkElement::extraOutputs() const
+{
+    return this->d->m_extraOutputs;
+}
+
 QStringList MultiSinkElement::fileExtensions(const QString &format) const
 {
     return this->d->m_fileExtensions.value(format);
@@ -212,6 +237,14 @@ QVariantList MultiSinkElement::codecOptions(int index)
     return this->d->m_mediaWriter->codecOptions(index);
 }
 
+QVariantList MultiSinkElement::encoderStats() const
+{
+    if (!this->d->m_mediaWriter)
+        return {};
+
+    return this->d->m_mediaWriter->encoderStats();
+}
+
 void MultiSinkElement::setLocation(const QString &location)
 {
     if (this->d->m_location == location)
@@ -252,6 +285,42 @@ void MultiSinkElement::setCodecsBlackList(const QStringList &codecsBlackList)
         this->d->m_mediaWriter->setCodecsBlackList(codecsBlackList);
 }
 
+void MultiSinkElement::setSkipSilence(bool skipSilence)
+{
+    if (this->d->m_skipSilence == skipSilence)
+        return;
+
+    this->d->m_skipSilence = skipSilence;
+    emit this->skipSilenceChanged(skipSilence);
+}
+
+void MultiSinkElement::setSegmentDuration(qint64 segmentDuration)
+{
+    if (this->d->m_segmentDuration == segmentDuration)
+        return;
+
+    this->d->m_segmentDuration = segmentDuration;
+    emit this->segmentDurationChanged(segmentDuration);
+}
+
+void MultiSinkElement::setPreRoll(qint64 preRoll)
+{
+    if (this->d->m_preRoll == preRoll)
+        return;
+
+    this->d->m_preRoll = preRoll;
+    emit this->preRollChanged(preRoll);
+}
+
+void MultiSinkElement::setExtraOutputs(const QVariantList &extraOutputs)
+{
+    if (this->d->m_extraOutputs == extraOutputs)
+        return;
+
+    this->d->m_extraOutputs = extraOutputs;
+    emit this->extraOutputsChanged(extraOutputs);
+}
+
 void MultiSinkElement::resetLocation()
 {
     this->setLocation("");
@@ -287,6 +356,26 @@ void MultiSinkElement::resetCodecsBlackList()
         this->d->m_mediaWriter->resetCodecsBlackList();
 }
 
+void MultiSinkElement::resetSkipSilence()
+{
+    this->setSkipSilence(false);
+}
+
+void MultiSinkElement::resetSegmentDuration()
+{
+    this->setSegmentDuration(0);
+}
+
+void MultiSinkElement::resetPreRoll()
+{
+    this->setPreRoll(0);
+}
+
+void MultiSinkElement::resetExtraOutputs()
+{
+    this->setExtraOutputs({});
+}
+
 void MultiSinkElement::clearStreams()
 {
     if (this->d->m_mediaWriter)
@@ -295,13 +384,31 @@ void MultiSinkElement::clearStreams()
     this->d->m_inputStreams.clear();
 }
 
+void MultiSinkElement::trigger()
+{
+    if (this->d->m_mediaWriter)
+        this->d->m_mediaWriter->trigger();
+}
+
 AkPacket MultiSinkElement::iStream(const AkPacket &packet)
 {
     if (this->state() != ElementStatePlaying)
         return AkPacket();
 
-    if (this->d->m_mediaWriter && this->d->m_inputStreams.contains(packet.index()))
-        this->d->m_mediaWriter->enqueuePacket(packet);
+    auto enterTime = this->statsEnter(packet);
+    auto iPacket = packet;
+
+    // The writers skip the packets marked as silence, unless disabled.
+    if (!this->d->m_skipSilence
+        && packet.flags() & AkAudioPacket::PacketFlag_Silence)
+        iPacket.setFlags(packet.flags() & ~AkAudioPacket::PacketFlag_Silence);
+
+    if (this->d->m_mediaWriter
+        && this->d->m_inputStreams.contains(iPacket.index())
+        && !this->d->m_mediaWriter->enqueuePacket(iPacket))
+        this->statsDrop();
+
+    this->statsLeave(enterTime);
 
     return AkPacket();
 }
@@ -408,6 +515,10 @@ void MultiSinkElementPrivate::codecLibUpdated(const QString &codecLib)
                      &MediaWriter::codecsBlackListChanged,
                      self,
                      &MultiSinkElement::formatsBlackListChanged);
+    QObject::connect(this->m_mediaWriter.data(),
+                     &MediaWriter::encoderAdapted,
+                     self,
+                     &MultiSinkElement::encoderAdapted);
     QObject::connect(self,
                      &MultiSinkElement::locationChanged,
                      this->m_mediaWriter.data(),
@@ -416,8 +527,23 @@ void MultiSinkElementPrivate::codecLibUpdated(const QString &codecLib)
                      &MultiSinkElement::formatOptionsChanged,
                      this->m_mediaWriter.data(),
                      &MediaWriter::setFormatOptions);
+    QObject::connect(self,
+                     &MultiSinkElement::segmentDurationChanged,
+                     this->m_mediaWriter.data(),
+                     &MediaWriter::setSegmentDuration);
+    QObject::connect(self,
+                     &MultiSinkElement::preRollChanged,
+                     this->m_mediaWriter.data(),
+                     &MediaWriter::setPreRoll);
+    QObject::connect(self,
+                     &MultiSinkElement::extraOutputsChanged,
+                     this->m_mediaWriter.data(),
+                     &MediaWriter::setExtraOutputs);
 
     this->m_mediaWriter->setLocation(location);
+    this->m_mediaWriter->setSegmentDuration(this->m_segmentDuration);
+    this->m_mediaWriter->setPreRoll(this->m_preRoll);
+    this->m_mediaWriter->setExtraOutputs(this->m_extraOutputs);
     emit self->supportedFormatsChanged(self->supportedFormats());
 
     self->setState(state);
@@ -58,6 +58,36 @@ class MultiSinkElement: public AkElement
                WRITE setCodecsBlackList
                RESET resetCodecsBlackList
                NOTIFY codecsBlackListChanged)
+    // Don't encode the audio packets marked as silence, the time they span
+    // is skipped in the output as in discontinuous transmission. Only
+    // supported by the FFmpeg backend, the others encode them normally.
+    Q_PROPERTY(bool skipSilence
+               READ skipSilence
+               WRITE setSkipSilence
+               RESET resetSkipSilence
+               NOTIFY skipSilenceChanged)
+    // Split the recording in files of this duration in milliseconds, 0 to
+    // write a single file. The files are cut at key frames.
+    Q_PROPERTY(qint64 segmentDuration
+               READ segmentDuration
+               WRITE setSegmentDuration
+               RESET resetSegmentDuration
+               NOTIFY segmentDurationChanged)
+    // Keep the last milliseconds of encoded packets in memory, and don't
+    // write anything until trigger() is called. 0 to write from the start.
+    Q_PROPERTY(qint64 preRoll
+               READ preRoll
+               WRITE setPreRoll
+               RESET resetPreRoll
+               NOTIFY preRollChanged)
+    // Write the same encoded streams to more files or network streams. Each
+    // output is a map with a "location" and optionally a "format" and format
+    // "options". Only supported by the FFmpeg backend.
+    Q_PROPERTY(QVariantList extraOutputs
+               READ extraOutputs
+               WRITE setExtraOutputs
+               RESET resetExtraOutputs
+               NOTIFY extraOutputsChanged)
 
     public:
         MultiSinkElement();
@@ -70,6 +100,10 @@ class MultiSinkElement: public AkElement
         Q_INVOKABLE QVariantList streams();
         Q_INVOKABLE QStringList formatsBlackList() const;
         Q_INVOKABLE QStringList codecsBlackList() const;
+        Q_INVOKABLE bool skipSilence() const;
+        Q_INVOKABLE qint64 segmentDuration() const;
+        Q_INVOKABLE qint64 preRoll() const;
+        Q_INVOKABLE QVariantList extraOutputs() const;
         Q_INVOKABLE QStringList fileExtensions(const QString &format) const;
         Q_INVOKABLE QString formatDescription(const QString &format) const;
         Q_INVOKABLE QVariantList formatOptions() const;
@@ -86,6 +120,7 @@ class MultiSinkElement: public AkElement
         Q_INVOKABLE QVariantMap updateStream(int index,
                                              const QVariantMap &codecParams=QVariantMap());
         Q_INVOKABLE QVariantList codecOptions(int index);
+        Q_INVOKABLE QVariantList encoderStats() const;
 
     private:
         MultiSinkElementPrivate *d;
@@ -101,6 +136,13 @@ class MultiSinkElement: public AkElement
         void streamsChanged(const QVariantList &streams);
         void formatsBlackListChanged(const QStringList &formatsBlackList);
         void codecsBlackListChanged(const QStringList &codecsBlackList);
+        void skipSilenceChanged(bool skipSilence);
+        void segmentDurationChanged(qint64 segmentDuration);
+        void preRollChanged(qint64 preRoll);
+        void extraOutputsChanged(const QVariantList &extraOutputs);
+
+        // Emitted when an encoder in adaptive mode changes its frame rate.
+        void encoderAdapted(int index, const QVariantMap &adaptation);
 
     public slots:
         void setLocation(const QString &location);
@@ -109,13 +151,22 @@ class MultiSinkElement: public AkElement
         void setCodecOptions(int index, const QVariantMap &codecOptions);
         void setFormatsBlackList(const QStringList &formatsBlackList);
         void setCodecsBlackList(const QStringList &codecsBlackList);
+        void setSkipSilence(bool skipSilence);
+        void setSegmentDuration(qint64 segmentDuration);
+        void setPreRoll(qint64 preRoll);
+        void setExtraOutputs(const QVariantList &extraOutputs);
         void resetLocation();
         void resetOutputFormat();
         void resetFormatOptions();
         void resetCodecOptions(int index);
         void resetFormatsBlackList();
         void resetCodecsBlackList();
+        void resetSkipSilence();
+        void resetSegmentDuration();
+        void resetPreRoll();
+        void resetExtraOutputs();
         void clearStreams();
+        void trigger();
 
         AkPacket iStream(const AkPacket &packet);
         bool setState(AkElement::ElementState state);
@@ -175,17 +175,18 @@ AMediaFormat *AbstractStream::mediaFormat() const
     return this->d->m_mediaFormat;
 }
 
-void AbstractStream::packetEnqueue(const AkPacket &packet)
+bool AbstractStream::packetEnqueue(const AkPacket &packet)
 {
     if (!this->d->m_runConvertLoop)
-        return;
+        return false;
 
     this->d->m_convertMutex.lock();
     bool enqueue = true;
 
     if (this->d->m_packetQueue.size() >= this->m_maxPacketQueueSize)
         enqueue = this->d->m_packetQueueNotFull.wait(&this->d->m_convertMutex,
-                                                     THREAD_WAIT_LIMIT);
+                                                     THREAD_WAIT_LIMIT)
+                  && this->d->m_runConvertLoop;
 
     if (enqueue) {
         this->d->m_packetQueue << packet;
@@ -193,6 +194,8 @@ void AbstractStream::packetEnqueue(const AkPacket &packet)
     }
 
     this->d->m_convertMutex.unlock();
+
+    return enqueue;
 }
 
 bool AbstractStream::ready() const
@@ -212,6 +215,15 @@ AkPacket AbstractStream::avPacketDequeue(size_t bufferSize)
     return {};
 }
 
+void AbstractStream::interruptDequeue()
+{
+}
+
+bool AbstractStream::isEncoding() const
+{
+    return this->d->m_runEqueueLoop;
+}
+
 AbstractStreamPrivate::AbstractStreamPrivate(AbstractStream *self):
     self(self)
 {
@@ -219,21 +231,22 @@ AbstractStreamPrivate::AbstractStreamPrivate(AbstractStream *self):
 
 void AbstractStreamPrivate::convertLoop()
 {
-    while (this->m_runConvertLoop) {
+    // Sleep until there is a packet to convert, and finish converting the
+    // queued packets when stopped.
+    forever {
         this->m_convertMutex.lock();
-        bool gotPacket = true;
 
-        if (this->m_packetQueue.isEmpty())
-            gotPacket = this->m_packetQueueNotEmpty.wait(&this->m_convertMutex,
-                                                         THREAD_WAIT_LIMIT);
+        while (this->m_packetQueue.isEmpty() && this->m_runConvertLoop)
+            this->m_packetQueueNotEmpty.wait(&this->m_convertMutex);
 
-        AkPacket packet;
+        if (this->m_packetQueue.isEmpty()) {
+            this->m_convertMutex.unlock();
 
-        if (gotPacket) {
-            packet = this->m_packetQueue.dequeue();
-            this->m_packetQueueNotFull.wakeAll();
+            break;
         }
 
+        auto packet = this->m_packetQueue.dequeue();
+        this->m_packetQueueNotFull.wakeAll();
         this->m_convertMutex.unlock();
 
         if (packet)
@@ -243,7 +256,7 @@ void AbstractStreamPrivate::convertLoop()
 
 void AbstractStreamPrivate::equeueLoop()
 {
-    const ssize_t timeOut = 5000;
+    const ssize_t timeOut = 1000 * THREAD_WAIT_LIMIT;
     bool eosSent = false;
     qint64 pts = 0;
     qint64 ptsDiff = 0;
@@ -261,6 +274,8 @@ void AbstractStreamPrivate::equeueLoop()
                                                  &bufferSize);
         AkPacket packet;
 
+        // avPacketDequeue() blocks until there is data available or the loop
+        // is stopped.
         do {
             packet = self->avPacketDequeue(bufferSize);
         } while (!packet && this->m_runEqueueLoop);
@@ -309,7 +324,7 @@ void AbstractStreamPrivate::equeueLoop()
 
 void AbstractStreamPrivate::dequeueLoop()
 {
-    const ssize_t timeOut = 5000;
+    const ssize_t timeOut = 1000 * THREAD_WAIT_LIMIT;
     bool eos = false;
 
     while (!eos) {
@@ -319,8 +334,15 @@ void AbstractStreamPrivate::dequeueLoop()
                                                            &info,
                                                            timeOut);
 
-        if (bufferIndex < 0)
+        if (bufferIndex < 0) {
+            // Don't wait forever for the end of stream if the codec stopped
+            // sending buffers.
+            if (bufferIndex == AMEDIACODEC_INFO_TRY_AGAIN_LATER
+                && !this->m_runDequeueLoop)
+                break;
+
             continue;
+        }
 
         if (info.flags & AMEDIACODEC_BUFFER_FLAG_CODEC_CONFIG)
             continue;
@@ -416,10 +438,15 @@ bool AbstractStream::init()
 
 void AbstractStream::uninit()
 {
+    this->d->m_convertMutex.lock();
     this->d->m_runConvertLoop = false;
+    this->d->m_packetQueueNotEmpty.wakeAll();
+    this->d->m_packetQueueNotFull.wakeAll();
+    this->d->m_convertMutex.unlock();
     waitLoop(this->d->m_convertLoopResult);
 
     this->d->m_runEqueueLoop = false;
+    this->interruptDequeue();
     waitLoop(this->d->m_equeueLoopResult);
 
     this->d->m_runDequeueLoop = false;
@@ -53,7 +53,7 @@ class AbstractStream: public QObject
         Q_INVOKABLE QString mimeType() const;
         Q_INVOKABLE AMediaCodec *codec() const;
         Q_INVOKABLE AMediaFormat *mediaFormat() const;
-        Q_INVOKABLE void packetEnqueue(const AkPacket &packet);
+        Q_INVOKABLE bool packetEnqueue(const AkPacket &packet);
         Q_INVOKABLE bool ready() const;
 
     protected:
@@ -61,6 +61,8 @@ class AbstractStream: public QObject
 
         virtual void convertPacket(const AkPacket &packet);
         virtual AkPacket avPacketDequeue(size_t bufferSize);
+        virtual void interruptDequeue();
+        bool isEncoding() const;
 
     private:
         AbstractStreamPrivate *d;
@@ -27,6 +27,7 @@
 #include <akaudiocaps.h>
 #include <akpacket.h>
 #include <akaudiopacket.h>
+#include <akaudiofifo.h>
 #include <media/NdkMediaCodec.h>
 
 #include "audiostream.h"
@@ -76,7 +77,7 @@ class AudioStreamPrivate
     public:
         AudioStream *self;
         AkElementPtr m_convert;
-        AkAudioPacket m_frame;
+        AkAudioFifo m_frame;
         QMutex m_frameMutex;
         int64_t m_pts {0};
         QWaitCondition m_frameReady;
@@ -119,6 +120,7 @@ AudioStream::AudioStream(AMediaMuxer *mediaMuxer,
 
     this->d->m_convert = AkElement::create("ACapsConvert");
     this->d->m_convert->setProperty("caps", QVariant::fromValue(this->d->m_caps));
+    this->d->m_frame.setCaps(this->d->m_caps);
 }
 
 AudioStream::~AudioStream()
@@ -160,11 +162,7 @@ void AudioStream::convertPacket(const AkPacket &packet)
 
     this->d->m_frameMutex.lock();
 
-    if (this->d->m_frame)
-        this->d->m_frame += iPacket;
-    else
-        this->d->m_frame = iPacket;
-
+    this->d->m_frame.write(iPacket);
     this->d->m_frameReady.wakeAll();
     this->d->m_frameMutex.unlock();
 }
@@ -179,25 +177,28 @@ AkPacket AudioStream::avPacketDequeue(size_t bufferSize)
                   / (this->d->m_caps.bps()
                      * this->d->m_caps.channels());
 
-    if (this->d->m_frame.caps().samples() < samples) {
-        if (!this->d->m_frameReady.wait(&this->d->m_frameMutex,
-                                        THREAD_WAIT_LIMIT)) {
-            this->d->m_frameMutex.unlock();
+    while (this->d->m_frame.samples() < samples && this->isEncoding())
+        this->d->m_frameReady.wait(&this->d->m_frameMutex);
 
-            return {};
-        } else if (this->d->m_frame.caps().samples() < samples) {
-            this->d->m_frameMutex.unlock();
+    if (this->d->m_frame.samples() < samples) {
+        this->d->m_frameMutex.unlock();
 
-            return {};
-        }
+        return {};
     }
 
-    auto frame = this->d->m_frame.pop(samples);
+    auto frame = this->d->m_frame.read(samples);
     this->d->m_frameMutex.unlock();
 
     return frame;
 }
 
+void AudioStream::interruptDequeue()
+{
+    this->d->m_frameMutex.lock();
+    this->d->m_frameReady.wakeAll();
+    this->d->m_frameMutex.unlock();
+}
+
 bool AudioStream::init()
 {
     this->d->m_convert->setState(AkElement::ElementStatePlaying);
@@ -213,6 +214,9 @@ void AudioStream::uninit()
 {
     AbstractStream::uninit();
     this->d->m_convert->setState(AkElement::ElementStateNull);
+    this->d->m_frameMutex.lock();
+    this->d->m_frame.clear();
+    this->d->m_frameMutex.unlock();
 }
 
 AudioStreamPrivate::AudioStreamPrivate(AudioStream *self):
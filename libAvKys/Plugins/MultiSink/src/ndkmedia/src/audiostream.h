@@ -47,6 +47,7 @@ class AudioStream: public AbstractStream
     protected:
         void convertPacket(const AkPacket &packet);
         AkPacket avPacketDequeue(size_t bufferSize);
+        void interruptDequeue();
 
     public slots:
         bool init();
@@ -1176,10 +1176,13 @@ void MediaWriterNDKMedia::resetMaxPacketQueueSize()
     this->setMaxPacketQueueSize(15 * 1024 * 1024);
 }
 
-void MediaWriterNDKMedia::enqueuePacket(const AkPacket &packet)
+bool MediaWriterNDKMedia::enqueuePacket(const AkPacket &packet)
 {
-    if (this->d->m_isRecording && this->d->m_streamsMap.contains(packet.index()))
-        this->d->m_streamsMap[packet.index()]->packetEnqueue(packet);
+    if (!this->d->m_isRecording
+        || !this->d->m_streamsMap.contains(packet.index()))
+        return false;
+
+    return this->d->m_streamsMap[packet.index()]->packetEnqueue(packet);
 }
 
 void MediaWriterNDKMedia::clearStreams()
@@ -74,7 +74,7 @@ class MediaWriterNDKMedia: public MediaWriter
         void resetFormatOptions();
         void resetCodecOptions(int index);
         void resetMaxPacketQueueSize();
-        void enqueuePacket(const AkPacket &packet);
+        bool enqueuePacket(const AkPacket &packet);
         void clearStreams();
         bool init();
         void uninit();
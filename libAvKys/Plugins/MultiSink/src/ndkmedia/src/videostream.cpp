@@ -259,13 +259,8 @@ AkPacket VideoStream::avPacketDequeue(size_t bufferSize)
 
     this->d->m_frameMutex.lock();
 
-    if (!this->d->m_frame)
-        if (!this->d->m_frameReady.wait(&this->d->m_frameMutex,
-                                        THREAD_WAIT_LIMIT)) {
-            this->d->m_frameMutex.unlock();
-
-            return nullptr;
-        }
+    while (!this->d->m_frame && this->isEncoding())
+        this->d->m_frameReady.wait(&this->d->m_frameMutex);
 
     auto frame = this->d->m_frame;
     this->d->m_frame = AkVideoPacket();
@@ -274,6 +269,13 @@ AkPacket VideoStream::avPacketDequeue(size_t bufferSize)
     return frame;
 }
 
+void VideoStream::interruptDequeue()
+{
+    this->d->m_frameMutex.lock();
+    this->d->m_frameReady.wakeAll();
+    this->d->m_frameMutex.unlock();
+}
+
 VideoStreamPrivate::VideoStreamPrivate(VideoStream *self):
     self(self)
 {
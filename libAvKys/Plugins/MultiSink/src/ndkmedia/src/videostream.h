@@ -47,6 +47,7 @@ class VideoStream: public AbstractStream
     protected:
         void convertPacket(const AkPacket &packet);
         AkPacket avPacketDequeue(size_t bufferSize);
+        void interruptDequeue();
 };
 
 #endif // VIDEOSTREAM_H
@@ -0,0 +1,867 @@
+/* Webcamoid, webcam capture application.
+ * Copyright (C) 2020  Gonzalo Exequiel Pedone
+ *
+ * Webcamoid is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Webcamoid is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Webcamoid. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Web-Site: http://webcamoid.github.io/
+ */
+
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutex>
+#include <QQueue>
+#include <QThreadPool>
+#include <QVariantMap>
+#include <QVector>
+#include <QWaitCondition>
+#include <QtConcurrent>
+#include <QtEndian>
+#include <cstddef>
+#include <limits>
+#include <akaudiocaps.h>
+#include <akaudiopacket.h>
+#include <akcaps.h>
+#include <akfrac.h>
+#include <akpacket.h>
+#include <akvideocaps.h>
+#include <akvideopacket.h>
+
+#ifdef Q_OS_LINUX
+#include <fcntl.h>
+#endif
+
+#include "mediawriterraw.h"
+
+#define RAW_FORMAT "akraw"
+#define RAW_FORMAT_VERSION 1
+#define RAW_PAGE_SIZE 4096
+#define RAW_DATA_ALIGN 64
+#define RAW_TIME_BASE 1000000
+#define DEFAULT_PREALLOCATE_SIZE (256 * 1024 * 1024)
+
+// The file starts with this header followed by a JSON document describing the
+// streams. The packets are stored one after the other starting at dataOffset,
+// and the index is appended when the file is closed. All integers are stored
+// in little endian.
+struct RawHeader
+{
+    char magic[8];
+    quint32 version;
+    quint32 dataOffset;
+    quint64 indexOffset;
+    quint64 indexSize;
+    quint32 descriptionSize;
+    quint32 reserved;
+};
+
+struct RawIndexEntry
+{
+    qint64 pts;
+    quint64 offset;
+    quint64 size;
+    qint32 stream;
+    qint32 samples;
+};
+
+static const char rawMagic[8] {'A', 'K', 'R', 'A', 'W', 'C', 'A', 'P'};
+
+struct RawStream
+{
+    AkCaps caps;
+    int index;
+    int inputIndex;
+    qint64 packets {0};
+    qint64 bytes {0};
+};
+
+class MediaWriterRawPrivate
+{
+    public:
+        MediaWriterRaw *self;
+        QString m_outputFormat;
+        QList<QVariantMap> m_streamConfigs;
+        QMap<QString, QVariantMap> m_formatOptions;
+        qint64 m_maxPacketQueueSize {15 * 1024 * 1024};
+        QVector<RawStream> m_streams;
+        QMap<int, int> m_streamsMap;
+        QVector<RawIndexEntry> m_index;
+        QFile m_outputFile;
+        uchar *m_map {nullptr};
+        qint64 m_mapOffset {0};
+        qint64 m_mapSize {0};
+        qint64 m_fileSize {0};
+        qint64 m_writeOffset {0};
+        qint64 m_preallocateSize {DEFAULT_PREALLOCATE_SIZE};
+        QQueue<AkPacket> m_packetQueue;
+        qint64 m_packetQueueSize {0};
+        QMutex m_packetMutex;
+        QWaitCondition m_packetQueueNotEmpty;
+        QWaitCondition m_packetQueueNotFull;
+        QThreadPool m_threadPool;
+        bool m_isRecording {false};
+
+        explicit MediaWriterRawPrivate(MediaWriterRaw *self);
+        QString guessFormat();
+        QJsonObject capsDescription(const AkCaps &caps) const;
+        QByteArray streamsDescription() const;
+        AkPacket normalizePacket(const RawStream &stream,
+                                 const AkPacket &packet) const;
+        bool reserve(qint64 size);
+        bool mapRegion(qint64 offset, qint64 size);
+        void unmapRegion();
+        void writeLoop();
+        void writePacket(const AkPacket &packet);
+        bool writeIndex();
+
+        inline static qint64 alignUp(qint64 value, qint64 align)
+        {
+            return (value + align - 1) & ~(align - 1);
+        }
+};
+
+MediaWriterRaw::MediaWriterRaw(QObject *parent):
+    MediaWriter(parent)
+{
+    this->d = new MediaWriterRawPrivate(this);
+    this->d->m_threadPool.setMaxThreadCount(1);
+}
+
+MediaWriterRaw::~MediaWriterRaw()
+{
+    this->uninit();
+    delete this->d;
+}
+
+QString MediaWriterRaw::defaultFormat()
+{
+    return QStringLiteral(RAW_FORMAT);
+}
+
+QString MediaWriterRaw::outputFormat() const
+{
+    return this->d->m_outputFormat;
+}
+
+QVariantList MediaWriterRaw::streams() const
+{
+    QVariantList streams;
+
+    for (auto &stream: this->d->m_streamConfigs)
+        streams << stream;
+
+    return streams;
+}
+
+qint64 MediaWriterRaw::maxPacketQueueSize() const
+{
+    return this->d->m_maxPacketQueueSize;
+}
+
+QStringList MediaWriterRaw::supportedFormats()
+{
+    if (this->m_formatsBlackList.contains(RAW_FORMAT))
+        return {};
+
+    return {QStringLiteral(RAW_FORMAT)};
+}
+
+QStringList MediaWriterRaw::fileExtensions(const QString &format)
+{
+    if (format != RAW_FORMAT)
+        return {};
+
+    return {QStringLiteral(RAW_FORMAT)};
+}
+
+QString MediaWriterRaw::formatDescription(const QString &format)
+{
+    if (format != RAW_FORMAT)
+        return {};
+
+    return QStringLiteral("Uncompressed audio and video");
+}
+
+QVariantList MediaWriterRaw::formatOptions()
+{
+    auto outputFormat = this->d->guessFormat();
+
+    if (outputFormat.isEmpty())
+        return {};
+
+    auto globalFormatOptions = this->d->m_formatOptions.value(outputFormat);
+    QVariantList options;
+    options << QVariant(QVariantList {
+        "preallocate_size",
+        "Grow the file in blocks of this number of bytes, the unused space "
+        "is released when finished",
+        "number",
+        RAW_PAGE_SIZE,
+        std::numeric_limits<qint64>::max(),
+        RAW_PAGE_SIZE,
+        DEFAULT_PREALLOCATE_SIZE,
+        DEFAULT_PREALLOCATE_SIZE,
+        QVariantList()
+    });
+    QVariantList formatOptions;
+
+    for (auto &option: options) {
+        auto optionList = option.toList();
+        auto key = optionList[0].toString();
+
+        if (globalFormatOptions.contains(key))
+            optionList[7] = globalFormatOptions[key];
+
+        formatOptions << QVariant(optionList);
+    }
+
+    return formatOptions;
+}
+
+QStringList MediaWriterRaw::supportedCodecs(const QString &format)
+{
+    return this->supportedCodecs(format, "");
+}
+
+QStringList MediaWriterRaw::supportedCodecs(const QString &format,
+                                            const QString &type)
+{
+    if (format != RAW_FORMAT)
+        return {};
+
+    QStringList supportedCodecs;
+
+    if ((type.isEmpty() || type == "audio/x-raw")
+        && !this->m_codecsBlackList.contains("rawaudio"))
+        supportedCodecs << "rawaudio";
+
+    if ((type.isEmpty() || type == "video/x-raw")
+        && !this->m_codecsBlackList.contains("rawvideo"))
+        supportedCodecs << "rawvideo";
+
+    return supportedCodecs;
+}
+
+QString MediaWriterRaw::defaultCodec(const QString &format,
+                                     const QString &type)
+{
+    auto codecs = this->supportedCodecs(format, type);
+
+    if (codecs.isEmpty())
+        return {};
+
+    return codecs.first();
+}
+
+QString MediaWriterRaw::codecDescription(const QString &codec)
+{
+    if (codec == "rawaudio")
+        return QStringLiteral("Uncompressed audio");
+
+    if (codec == "rawvideo")
+        return QStringLiteral("Uncompressed video");
+
+    return {};
+}
+
+QString MediaWriterRaw::codecType(const QString &codec)
+{
+    if (codec == "rawaudio")
+        return QStringLiteral("audio/x-raw");
+
+    if (codec == "rawvideo")
+        return QStringLiteral("video/x-raw");
+
+    return {};
+}
+
+QVariantMap MediaWriterRaw::defaultCodecParams(const QString &codec)
+{
+    QVariantMap codecParams;
+
+    // Any input format is accepted, the packets are stored as they come.
+    if (codec == "rawaudio") {
+        codecParams["supportedSampleFormats"] = QStringList();
+        codecParams["supportedSampleRates"] = QVariantList();
+        codecParams["supportedChannelLayouts"] = QVariantList();
+        codecParams["defaultBitRate"] = 0;
+    } else if (codec == "rawvideo") {
+        codecParams["supportedPixelFormats"] = QStringList();
+        codecParams["supportedFrameRates"] = QVariantList();
+        codecParams["defaultGOP"] = 1;
+        codecParams["defaultBitRate"] = 0;
+    }
+
+    return codecParams;
+}
+
+QVariantMap MediaWriterRaw::addStream(int streamIndex,
+                                      const AkCaps &streamCaps)
+{
+    return this->addStream(streamIndex, streamCaps, {});
+}
+
+QVariantMap MediaWriterRaw::addStream(int streamIndex,
+                                      const AkCaps &streamCaps,
+                                      const QVariantMap &codecParams)
+{
+    Q_UNUSED(codecParams)
+
+    auto outputFormat = this->d->guessFormat();
+
+    if (outputFormat.isEmpty())
+        return {};
+
+    auto codec = this->defaultCodec(outputFormat, streamCaps.mimeType());
+
+    if (codec.isEmpty())
+        return {};
+
+    QVariantMap outputParams {
+        {"index", streamIndex                   },
+        {"codec", codec                         },
+        {"caps" , QVariant::fromValue(streamCaps)},
+    };
+
+    this->d->m_streamConfigs << outputParams;
+    emit this->streamsChanged(this->streams());
+
+    return outputParams;
+}
+
+QVariantMap MediaWriterRaw::updateStream(int index)
+{
+    return this->updateStream(index, {});
+}
+
+QVariantMap MediaWriterRaw::updateStream(int index,
+                                         const QVariantMap &codecParams)
+{
+    if (index < 0 || index >= this->d->m_streamConfigs.size())
+        return {};
+
+    auto &streamConfigs = this->d->m_streamConfigs[index];
+    auto streamCaps = streamConfigs["caps"].value<AkCaps>();
+
+    if (codecParams.contains("caps")
+        && codecParams.value("caps").value<AkCaps>().mimeType() == streamCaps.mimeType()
+        && streamConfigs["caps"] != codecParams.value("caps")) {
+        streamConfigs["caps"] = codecParams.value("caps");
+        emit this->streamsChanged(this->streams());
+    }
+
+    return streamConfigs;
+}
+
+QVariantList MediaWriterRaw::codecOptions(int index)
+{
+    Q_UNUSED(index)
+
+    return {};
+}
+
+QVariantList MediaWriterRaw::encoderStats() const
+{
+    QVariantList stats;
+    this->d->m_packetMutex.lock();
+
+    for (auto &stream: this->d->m_streams)
+        stats << QVariantMap {
+            {"index"             , stream.index                    },
+            {"streamIndex"       , stream.inputIndex               },
+            {"packets"           , stream.packets                  },
+            {"bytes"             , stream.bytes                    },
+            {"packetQueueSize"   , this->d->m_packetQueueSize      },
+            {"maxPacketQueueSize", this->d->m_maxPacketQueueSize   },
+        };
+
+    this->d->m_packetMutex.unlock();
+
+    return stats;
+}
+
+void MediaWriterRaw::setOutputFormat(const QString &outputFormat)
+{
+    if (this->d->m_outputFormat == outputFormat)
+        return;
+
+    this->d->m_outputFormat = outputFormat;
+    emit this->outputFormatChanged(outputFormat);
+}
+
+void MediaWriterRaw::setFormatOptions(const QVariantMap &formatOptions)
+{
+    auto outputFormat = this->d->guessFormat();
+
+    if (outputFormat.isEmpty())
+        return;
+
+    bool modified = false;
+
+    for (auto it = formatOptions.begin();
+         it != formatOptions.end();
+         it++)
+        if (it.value() != this->d->m_formatOptions.value(outputFormat).value(it.key())) {
+            this->d->m_formatOptions[outputFormat][it.key()] = it.value();
+            modified = true;
+        }
+
+    if (modified)
+        emit this->formatOptionsChanged(this->d->m_formatOptions.value(outputFormat));
+}
+
+void MediaWriterRaw::setMaxPacketQueueSize(qint64 maxPacketQueueSize)
+{
+    if (this->d->m_maxPacketQueueSize == maxPacketQueueSize)
+        return;
+
+    this->d->m_maxPacketQueueSize = maxPacketQueueSize;
+    emit this->maxPacketQueueSizeChanged(maxPacketQueueSize);
+}
+
+void MediaWriterRaw::resetOutputFormat()
+{
+    this->setOutputFormat("");
+}
+
+void MediaWriterRaw::resetFormatOptions()
+{
+    auto outputFormat = this->d->guessFormat();
+
+    if (this->d->m_formatOptions.value(outputFormat).isEmpty())
+        return;
+
+    this->d->m_formatOptions.remove(outputFormat);
+    emit this->formatOptionsChanged(QVariantMap());
+}
+
+void MediaWriterRaw::resetMaxPacketQueueSize()
+{
+    this->setMaxPacketQueueSize(15 * 1024 * 1024);
+}
+
+bool MediaWriterRaw::enqueuePacket(const AkPacket &packet)
+{
+    this->d->m_packetMutex.lock();
+
+    if (!this->d->m_isRecording
+        || !this->d->m_streamsMap.contains(packet.index())) {
+        this->d->m_packetMutex.unlock();
+
+        return false;
+    }
+
+    // Block the producer instead of dropping frames, a raw capture must be
+    // complete.
+    while (this->d->m_isRecording
+           && !this->d->m_packetQueue.isEmpty()
+           && this->d->m_packetQueueSize >= this->d->m_maxPacketQueueSize)
+        this->d->m_packetQueueNotFull.wait(&this->d->m_packetMutex);
+
+    if (!this->d->m_isRecording) {
+        this->d->m_packetMutex.unlock();
+
+        return false;
+    }
+
+    // The buffer is shared, not copied.
+    this->d->m_packetQueue << packet;
+    this->d->m_packetQueueSize += packet.buffer().size();
+    this->d->m_packetQueueNotEmpty.wakeAll();
+    this->d->m_packetMutex.unlock();
+
+    return true;
+}
+
+void MediaWriterRaw::clearStreams()
+{
+    this->d->m_streamConfigs.clear();
+    emit this->streamsChanged(this->streams());
+}
+
+bool MediaWriterRaw::init()
+{
+    if (this->d->guessFormat().isEmpty())
+        return false;
+
+    this->d->m_streams.clear();
+    this->d->m_streamsMap.clear();
+    this->d->m_index.clear();
+
+    for (auto &configs: this->d->m_streamConfigs) {
+        RawStream stream;
+        stream.caps = configs["caps"].value<AkCaps>();
+        stream.index = this->d->m_streams.size();
+        stream.inputIndex = configs["index"].toInt();
+
+        if (stream.caps.mimeType() != "audio/x-raw"
+            && stream.caps.mimeType() != "video/x-raw")
+            continue;
+
+        this->d->m_streamsMap[stream.inputIndex] = stream.index;
+        this->d->m_streams << stream;
+    }
+
+    if (this->d->m_streams.isEmpty())
+        return false;
+
+    auto options =
+            this->d->m_formatOptions.value(this->d->guessFormat());
+    this->d->m_preallocateSize =
+            MediaWriterRawPrivate::alignUp(qMax<qint64>(options.value("preallocate_size",
+                                                                      DEFAULT_PREALLOCATE_SIZE).toLongLong(),
+                                                        RAW_PAGE_SIZE),
+                                           RAW_PAGE_SIZE);
+    this->d->m_outputFile.setFileName(this->m_location);
+
+    if (!this->d->m_outputFile.open(QIODevice::ReadWrite
+                                    | QIODevice::Truncate)) {
+        qDebug() << "Can't open the output file:"
+                 << this->d->m_outputFile.errorString();
+
+        return false;
+    }
+
+    auto description = this->d->streamsDescription();
+    RawHeader header;
+    memset(&header, 0, sizeof(RawHeader));
+    memcpy(header.magic, rawMagic, sizeof(rawMagic));
+    auto dataOffset =
+            MediaWriterRawPrivate::alignUp(qint64(sizeof(RawHeader))
+                                           + description.size(),
+                                           RAW_PAGE_SIZE);
+    qToLittleEndian<quint32>(RAW_FORMAT_VERSION, &header.version);
+    qToLittleEndian<quint32>(quint32(dataOffset), &header.dataOffset);
+    qToLittleEndian<quint32>(quint32(description.size()),
+                             &header.descriptionSize);
+
+    if (this->d->m_outputFile.write(reinterpret_cast<const char *>(&header),
+                                    sizeof(RawHeader)) != sizeof(RawHeader)
+        || this->d->m_outputFile.write(description) != description.size()) {
+        this->d->m_outputFile.close();
+
+        return false;
+    }
+
+    this->d->m_fileSize = this->d->m_outputFile.size();
+    this->d->m_writeOffset = dataOffset;
+    this->d->m_packetQueueSize = 0;
+    this->d->m_isRecording = true;
+    QtConcurrent::run(&this->d->m_threadPool,
+                      this->d,
+                      &MediaWriterRawPrivate::writeLoop);
+
+    return true;
+}
+
+void MediaWriterRaw::uninit()
+{
+    this->d->m_packetMutex.lock();
+
+    if (!this->d->m_isRecording) {
+        this->d->m_packetMutex.unlock();
+
+        return;
+    }
+
+    // The queued packets are still written before closing the file.
+    this->d->m_isRecording = false;
+    this->d->m_packetQueueNotEmpty.wakeAll();
+    this->d->m_packetQueueNotFull.wakeAll();
+    this->d->m_packetMutex.unlock();
+    this->d->m_threadPool.waitForDone();
+
+    this->d->unmapRegion();
+
+    if (!this->d->writeIndex())
+        qDebug() << "Can't write the index of" << this->m_location;
+
+    this->d->m_outputFile.close();
+    this->d->m_index.clear();
+}
+
+MediaWriterRawPrivate::MediaWriterRawPrivate(MediaWriterRaw *self):
+    self(self)
+{
+}
+
+QString MediaWriterRawPrivate::guessFormat()
+{
+    if (self->supportedFormats().contains(this->m_outputFormat))
+        return this->m_outputFormat;
+
+    auto extension = QFileInfo(self->location()).suffix();
+
+    if (self->supportedFormats().contains(extension))
+        return extension;
+
+    return {};
+}
+
+QJsonObject MediaWriterRawPrivate::capsDescription(const AkCaps &caps) const
+{
+    if (caps.mimeType() == "audio/x-raw") {
+        AkAudioCaps audioCaps(caps);
+
+        return QJsonObject {
+            {"mimeType", caps.mimeType()                                       },
+            {"format"  , AkAudioCaps::sampleFormatToString(audioCaps.format()) },
+            {"layout"  , AkAudioCaps::channelLayoutToString(audioCaps.layout())},
+            {"rate"    , audioCaps.rate()                                      },
+            {"planar"  , audioCaps.planar()                                    },
+        };
+    }
+
+    AkVideoCaps videoCaps(caps);
+
+    return QJsonObject {
+        {"mimeType", caps.mimeType()                                     },
+        {"format"  , AkVideoCaps::pixelFormatToString(videoCaps.format())},
+        {"width"   , videoCaps.width()                                   },
+        {"height"  , videoCaps.height()                                  },
+        {"fps"     , videoCaps.fps().toString()                          },
+        {"align"   , videoCaps.align()                                   },
+    };
+}
+
+QByteArray MediaWriterRawPrivate::streamsDescription() const
+{
+    QJsonArray streams;
+
+    for (auto &stream: this->m_streams)
+        streams << QJsonObject {
+            {"index", stream.inputIndex                },
+            {"caps" , this->capsDescription(stream.caps)},
+        };
+
+    QJsonObject description {
+        {"timeBase", AkFrac(1, RAW_TIME_BASE).toString()},
+        {"streams" , streams                            },
+    };
+
+    return QJsonDocument(description).toJson(QJsonDocument::Compact);
+}
+
+AkPacket MediaWriterRawPrivate::normalizePacket(const RawStream &stream,
+                                                const AkPacket &packet) const
+{
+    // Only convert the packets that do not match the description of the
+    // stream, the others are written untouched.
+    if (stream.caps.mimeType() == "audio/x-raw") {
+        AkAudioCaps caps(stream.caps);
+        AkAudioPacket audioPacket(packet);
+
+        if (audioPacket.caps().rate() != caps.rate())
+            return {};
+
+        if (audioPacket.caps().format() != caps.format()
+            || audioPacket.caps().layout() != caps.layout()
+            || audioPacket.caps().planar() != caps.planar())
+            audioPacket = audioPacket.convert(caps);
+
+        if (!audioPacket)
+            return {};
+
+        // The reader rebuilds the audio caps assuming no padding.
+        return audioPacket.realign(1);
+    }
+
+    AkVideoCaps caps(stream.caps);
+    AkVideoPacket videoPacket(packet);
+
+    if (videoPacket.caps().format() != caps.format())
+        videoPacket = videoPacket.convert(caps.format(), caps.align());
+
+    if (videoPacket
+        && (videoPacket.caps().width() != caps.width()
+            || videoPacket.caps().height() != caps.height()))
+        videoPacket = videoPacket.scaled(caps.width(), caps.height());
+
+    if (videoPacket && videoPacket.caps().align() != caps.align())
+        videoPacket = videoPacket.realign(caps.align());
+
+    return videoPacket;
+}
+
+bool MediaWriterRawPrivate::reserve(qint64 size)
+{
+    if (size <= this->m_fileSize)
+        return true;
+
+    auto fileSize = alignUp(qMax(size,
+                                 this->m_fileSize + this->m_preallocateSize),
+                            RAW_PAGE_SIZE);
+
+#ifdef Q_OS_LINUX
+    // Allocate the blocks in advance, so writing to the mapped memory does
+    // not fail on a full disk.
+    if (posix_fallocate(this->m_outputFile.handle(),
+                        off_t(this->m_fileSize),
+                        off_t(fileSize - this->m_fileSize)) != 0)
+        return false;
+#else
+    if (!this->m_outputFile.resize(fileSize))
+        return false;
+#endif
+
+    this->m_fileSize = fileSize;
+
+    return true;
+}
+
+bool MediaWriterRawPrivate::mapRegion(qint64 offset, qint64 size)
+{
+    this->unmapRegion();
+    auto mapOffset = offset & ~qint64(RAW_PAGE_SIZE - 1);
+    auto mapSize = alignUp(qMax(offset + size - mapOffset,
+                                this->m_preallocateSize),
+                           RAW_PAGE_SIZE);
+
+    if (!this->reserve(mapOffset + mapSize))
+        return false;
+
+    this->m_map = this->m_outputFile.map(mapOffset, mapSize);
+
+    if (!this->m_map)
+        return false;
+
+    this->m_mapOffset = mapOffset;
+    this->m_mapSize = mapSize;
+
+    return true;
+}
+
+void MediaWriterRawPrivate::unmapRegion()
+{
+    if (!this->m_map)
+        return;
+
+    this->m_outputFile.unmap(this->m_map);
+    this->m_map = nullptr;
+    this->m_mapOffset = 0;
+    this->m_mapSize = 0;
+}
+
+void MediaWriterRawPrivate::writeLoop()
+{
+    forever {
+        this->m_packetMutex.lock();
+
+        while (this->m_isRecording && this->m_packetQueue.isEmpty())
+            this->m_packetQueueNotEmpty.wait(&this->m_packetMutex);
+
+        if (this->m_packetQueue.isEmpty()) {
+            this->m_packetMutex.unlock();
+
+            break;
+        }
+
+        auto packet = this->m_packetQueue.dequeue();
+        this->m_packetQueueSize -= packet.buffer().size();
+        this->m_packetQueueNotFull.wakeAll();
+        this->m_packetMutex.unlock();
+
+        this->writePacket(packet);
+    }
+}
+
+void MediaWriterRawPrivate::writePacket(const AkPacket &packet)
+{
+    auto streamIndex = this->m_streamsMap.value(packet.index(), -1);
+
+    if (streamIndex < 0)
+        return;
+
+    auto &stream = this->m_streams[streamIndex];
+    auto oPacket = this->normalizePacket(stream, packet);
+
+    if (!oPacket)
+        return;
+
+    auto size = qint64(oPacket.buffer().size());
+    auto offset = alignUp(this->m_writeOffset, RAW_DATA_ALIGN);
+
+    if (!this->m_map
+        || offset < this->m_mapOffset
+        || offset + size > this->m_mapOffset + this->m_mapSize)
+        if (!this->mapRegion(offset, size)) {
+            qDebug() << "Can't map the output file:"
+                     << this->m_outputFile.errorString();
+
+            return;
+        }
+
+    memcpy(this->m_map + (offset - this->m_mapOffset),
+           oPacket.buffer().constData(),
+           size_t(size));
+
+    RawIndexEntry entry;
+    entry.pts = qRound64(qreal(oPacket.pts())
+                         * oPacket.timeBase().value()
+                         * RAW_TIME_BASE);
+    entry.offset = quint64(offset);
+    entry.size = quint64(size);
+    entry.stream = qint32(streamIndex);
+    entry.samples = stream.caps.mimeType() == "audio/x-raw"?
+                        qint32(AkAudioPacket(oPacket).caps().samples()): 0;
+    this->m_index << entry;
+    this->m_writeOffset = offset + size;
+
+    this->m_packetMutex.lock();
+    stream.packets++;
+    stream.bytes += size;
+    this->m_packetMutex.unlock();
+}
+
+bool MediaWriterRawPrivate::writeIndex()
+{
+    auto indexOffset = alignUp(this->m_writeOffset, RAW_DATA_ALIGN);
+    QVector<RawIndexEntry> index(this->m_index.size());
+
+    for (int i = 0; i < this->m_index.size(); i++) {
+        auto &entry = this->m_index[i];
+        qToLittleEndian<qint64>(entry.pts, &index[i].pts);
+        qToLittleEndian<quint64>(entry.offset, &index[i].offset);
+        qToLittleEndian<quint64>(entry.size, &index[i].size);
+        qToLittleEndian<qint32>(entry.stream, &index[i].stream);
+        qToLittleEndian<qint32>(entry.samples, &index[i].samples);
+    }
+
+    auto indexSize = qint64(index.size()) * qint64(sizeof(RawIndexEntry));
+
+    if (!this->m_outputFile.seek(indexOffset)
+        || this->m_outputFile.write(reinterpret_cast<const char *>(index.constData()),
+                                    indexSize) != indexSize)
+        return false;
+
+    // Release the preallocated space that was not used.
+    if (!this->m_outputFile.resize(indexOffset + indexSize))
+        return false;
+
+    quint64 headerIndex[2];
+    qToLittleEndian<quint64>(quint64(indexOffset), &headerIndex[0]);
+    qToLittleEndian<quint64>(quint64(index.size()), &headerIndex[1]);
+
+    // The index is marked as valid only after it was written completely.
+    if (!this->m_outputFile.seek(offsetof(RawHeader, indexOffset))
+        || this->m_outputFile.write(reinterpret_cast<const char *>(headerIndex),
+                                    sizeof(headerIndex)) != sizeof(headerIndex))
+        return false;
+
+    return this->m_outputFile.flush();
+}
+
+#include "moc_mediawriterraw.cpp"
@@ -20,7 +20,7 @@ TEMPLATE = subdirs
 
 CONFIG(debug, debug|release): CONFIG += ordered
 
-SUBDIRS = src
+SUBDIRS = src src/raw
 CONFIG(config_ffmpeg): SUBDIRS += src/ffmpeg
 CONFIG(config_gstreamer): SUBDIRS += src/gstreamer
 CONFIG(config_ndk_media): SUBDIRS += src/ndkmedia
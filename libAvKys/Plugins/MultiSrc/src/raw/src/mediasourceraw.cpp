@@ -0,0 +1,792 @@
+/* Webcamoid, webcam capture application.
+ * Copyright (C) 2020  Gonzalo Exequiel Pedone
+ *
+ * Webcamoid is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Webcamoid is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Webcamoid. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Web-Site: http://webcamoid.github.io/
+ */
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutex>
+#include <QSharedPointer>
+#include <QThreadPool>
+#include <QVector>
+#include <QWaitCondition>
+#include <QtConcurrent>
+#include <QtEndian>
+#include <limits>
+#include <ak.h>
+#include <akaudiocaps.h>
+#include <akcaps.h>
+#include <akfrac.h>
+#include <akpacket.h>
+#include <akvideocaps.h>
+
+#include "mediasourceraw.h"
+
+#define RAW_FORMAT_VERSION 1
+
+// Must match the layout written by the raw submodule of MultiSink.
+struct RawHeader
+{
+    char magic[8];
+    quint32 version;
+    quint32 dataOffset;
+    quint64 indexOffset;
+    quint64 indexSize;
+    quint32 descriptionSize;
+    quint32 reserved;
+};
+
+struct RawIndexEntry
+{
+    qint64 pts;
+    quint64 offset;
+    quint64 size;
+    qint32 stream;
+    qint32 samples;
+};
+
+static const char rawMagic[8] {'A', 'K', 'R', 'A', 'W', 'C', 'A', 'P'};
+
+class RawMapping;
+using RawMappingPtr = QSharedPointer<RawMapping>;
+
+// The packets point to the mapped file, so the mapping is kept alive until
+// all the packet buffers are released, even after the media is closed.
+class RawMapping
+{
+    public:
+        QFile m_file;
+        uchar *m_map {nullptr};
+        QMutex m_mutex;
+        QList<QByteArray> m_buffers;
+
+        ~RawMapping();
+        QByteArray buffer(quint64 offset, int size);
+        bool isUsed();
+        static void release(const RawMappingPtr &mapping);
+};
+
+class MediaSourceRawPrivate
+{
+    public:
+        MediaSourceRaw *self;
+        QString m_media;
+        QList<int> m_streams;
+        QList<int> m_activeStreams;
+        qint64 m_maxPacketQueueSize {15 * 1024 * 1024};
+        RawMappingPtr m_mapping;
+        uchar *m_map {nullptr};
+        QVector<AkCaps> m_streamInfo;
+        QVector<qint64> m_ids;
+        QVector<RawIndexEntry> m_index;
+        AkFrac m_timeBase;
+        qint64 m_startPts {0};
+        qint64 m_duration {0};
+        QThreadPool m_threadPool;
+        QMutex m_dataMutex;
+        QWaitCondition m_dataChanged;
+        QElapsedTimer m_clock;
+        qreal m_clockBase {0.0};
+        int m_position {0};
+        AkElement::ElementState m_state {AkElement::ElementStateNull};
+        bool m_loop {false};
+        bool m_sync {true};
+        bool m_run {false};
+        bool m_paused {false};
+        bool m_showLog {false};
+
+        explicit MediaSourceRawPrivate(MediaSourceRaw *self);
+        bool openMedia();
+        void closeMedia();
+        static AkCaps capsFromDescription(const QJsonObject &caps);
+        qreal clock() const;
+        qreal packetTime(const RawIndexEntry &entry) const;
+        AkPacket readPacket(const RawIndexEntry &entry) const;
+        void readPackets();
+        void stop();
+};
+
+MediaSourceRaw::MediaSourceRaw(QObject *parent):
+    MediaSource(parent)
+{
+    this->d = new MediaSourceRawPrivate(this);
+    this->d->m_threadPool.setMaxThreadCount(1);
+}
+
+MediaSourceRaw::~MediaSourceRaw()
+{
+    this->setState(AkElement::ElementStateNull);
+    this->d->closeMedia();
+    delete this->d;
+}
+
+QStringList MediaSourceRaw::medias() const
+{
+    QStringList medias;
+
+    if (!this->d->m_media.isEmpty())
+        medias << this->d->m_media;
+
+    return medias;
+}
+
+QString MediaSourceRaw::media() const
+{
+    return this->d->m_media;
+}
+
+QList<int> MediaSourceRaw::streams() const
+{
+    return this->d->m_streams;
+}
+
+QList<int> MediaSourceRaw::listTracks(const QString &mimeType)
+{
+    QList<int> tracks;
+
+    for (int i = 0; i < this->d->m_streamInfo.size(); i++)
+        if (mimeType.isEmpty()
+            || this->d->m_streamInfo[i].mimeType() == mimeType)
+            tracks << i;
+
+    return tracks;
+}
+
+QString MediaSourceRaw::streamLanguage(int stream)
+{
+    Q_UNUSED(stream)
+
+    return {};
+}
+
+bool MediaSourceRaw::loop() const
+{
+    return this->d->m_loop;
+}
+
+bool MediaSourceRaw::sync() const
+{
+    return this->d->m_sync;
+}
+
+int MediaSourceRaw::defaultStream(const QString &mimeType)
+{
+    for (int i = 0; i < this->d->m_streamInfo.size(); i++)
+        if (this->d->m_streamInfo[i].mimeType() == mimeType)
+            return i;
+
+    return -1;
+}
+
+QString MediaSourceRaw::description(const QString &media) const
+{
+    if (this->d->m_media != media)
+        return {};
+
+    return QFileInfo(media).baseName();
+}
+
+AkCaps MediaSourceRaw::caps(int stream)
+{
+    return this->d->m_streamInfo.value(stream);
+}
+
+qint64 MediaSourceRaw::durationMSecs()
+{
+    return qRound64(1e3
+                    * qreal(this->d->m_duration)
+                    * this->d->m_timeBase.value());
+}
+
+qint64 MediaSourceRaw::currentTimeMSecs()
+{
+    this->d->m_dataMutex.lock();
+    auto clock = this->d->clock();
+    this->d->m_dataMutex.unlock();
+
+    return qRound64(1e3 * clock);
+}
+
+qint64 MediaSourceRaw::maxPacketQueueSize() const
+{
+    return this->d->m_maxPacketQueueSize;
+}
+
+bool MediaSourceRaw::showLog() const
+{
+    return this->d->m_showLog;
+}
+
+AkElement::ElementState MediaSourceRaw::state() const
+{
+    return this->d->m_state;
+}
+
+void MediaSourceRaw::seek(qint64 mSecs,
+                          MultiSrcElement::SeekPosition position)
+{
+    if (this->d->m_state == AkElement::ElementStateNull)
+        return;
+
+    qint64 pts = mSecs;
+
+    switch (position) {
+    case MultiSrcElement::SeekCur:
+        pts += this->currentTimeMSecs();
+
+        break;
+
+    case MultiSrcElement::SeekEnd:
+        pts += this->durationMSecs();
+
+        break;
+
+    default:
+        break;
+    }
+
+    auto time = qreal(qBound<qint64>(0, pts, this->durationMSecs())) / 1e3;
+
+    // Every packet is a key frame, so the playback can continue from any
+    // point of the index.
+    this->d->m_dataMutex.lock();
+    this->d->m_position = this->d->m_index.size();
+
+    for (int i = 0; i < this->d->m_index.size(); i++)
+        if (this->d->packetTime(this->d->m_index[i]) >= time) {
+            this->d->m_position = i;
+
+            break;
+        }
+
+    this->d->m_clockBase = time;
+    this->d->m_clock.restart();
+    this->d->m_dataChanged.wakeAll();
+    this->d->m_dataMutex.unlock();
+}
+
+void MediaSourceRaw::setMedia(const QString &media)
+{
+    if (media == this->d->m_media)
+        return;
+
+    auto state = this->d->m_state;
+    this->setState(AkElement::ElementStateNull);
+    this->d->closeMedia();
+    this->d->m_media = media;
+
+    if (!this->d->m_media.isEmpty()) {
+        if (this->d->openMedia())
+            this->setState(state);
+        else
+            emit this->error(QString("Can't read %1").arg(media));
+    }
+
+    emit this->mediaChanged(media);
+    emit this->mediasChanged(this->medias());
+    emit this->durationMSecsChanged(this->durationMSecs());
+}
+
+void MediaSourceRaw::setStreams(const QList<int> &streams)
+{
+    if (this->d->m_streams == streams)
+        return;
+
+    this->d->m_streams = streams;
+    emit this->streamsChanged(streams);
+}
+
+void MediaSourceRaw::setMaxPacketQueueSize(qint64 maxPacketQueueSize)
+{
+    if (this->d->m_maxPacketQueueSize == maxPacketQueueSize)
+        return;
+
+    this->d->m_maxPacketQueueSize = maxPacketQueueSize;
+    emit this->maxPacketQueueSizeChanged(maxPacketQueueSize);
+}
+
+void MediaSourceRaw::setShowLog(bool showLog)
+{
+    if (this->d->m_showLog == showLog)
+        return;
+
+    this->d->m_showLog = showLog;
+    emit this->showLogChanged(showLog);
+}
+
+void MediaSourceRaw::setLoop(bool loop)
+{
+    if (this->d->m_loop == loop)
+        return;
+
+    this->d->m_loop = loop;
+    emit this->loopChanged(loop);
+}
+
+void MediaSourceRaw::setSync(bool sync)
+{
+    if (this->d->m_sync == sync)
+        return;
+
+    this->d->m_sync = sync;
+    emit this->syncChanged(sync);
+}
+
+void MediaSourceRaw::resetMedia()
+{
+    this->setMedia("");
+}
+
+void MediaSourceRaw::resetStreams()
+{
+    if  (this->d->m_streams.isEmpty())
+        return;
+
+    this->d->m_streams.clear();
+    emit this->streamsChanged(this->d->m_streams);
+}
+
+void MediaSourceRaw::resetMaxPacketQueueSize()
+{
+    this->setMaxPacketQueueSize(15 * 1024 * 1024);
+}
+
+void MediaSourceRaw::resetShowLog()
+{
+    this->setShowLog(false);
+}
+
+void MediaSourceRaw::resetLoop()
+{
+    this->setLoop(false);
+}
+
+void MediaSourceRaw::resetSync()
+{
+    this->setSync(true);
+}
+
+bool MediaSourceRaw::setState(AkElement::ElementState state)
+{
+    switch (this->d->m_state) {
+    case AkElement::ElementStateNull: {
+        if (state == AkElement::ElementStatePaused
+            || state == AkElement::ElementStatePlaying) {
+            if (!this->d->openMedia())
+                return false;
+
+            this->d->m_activeStreams.clear();
+
+            if (this->d->m_streams.isEmpty()) {
+                for (auto &mimeType: {"audio/x-raw", "video/x-raw"}) {
+                    auto stream = this->defaultStream(mimeType);
+
+                    if (stream >= 0)
+                        this->d->m_activeStreams << stream;
+                }
+            } else {
+                this->d->m_activeStreams = this->d->m_streams;
+            }
+
+            this->d->m_position = 0;
+            this->d->m_clockBase = 0.0;
+            this->d->m_clock.start();
+            this->d->m_run = true;
+            this->d->m_paused = state == AkElement::ElementStatePaused;
+            QtConcurrent::run(&this->d->m_threadPool,
+                              this->d,
+                              &MediaSourceRawPrivate::readPackets);
+            this->d->m_state = state;
+            emit this->stateChanged(state);
+
+            return true;
+        }
+
+        break;
+    }
+    case AkElement::ElementStatePaused: {
+        switch (state) {
+        case AkElement::ElementStateNull:
+            this->d->stop();
+            this->d->m_state = state;
+            emit this->stateChanged(state);
+
+            return true;
+        case AkElement::ElementStatePlaying:
+            this->d->m_dataMutex.lock();
+            this->d->m_clock.restart();
+            this->d->m_paused = false;
+            this->d->m_dataChanged.wakeAll();
+            this->d->m_dataMutex.unlock();
+            this->d->m_state = state;
+            emit this->stateChanged(state);
+
+            return true;
+        case AkElement::ElementStatePaused:
+            break;
+        }
+
+        break;
+    }
+    case AkElement::ElementStatePlaying: {
+        switch (state) {
+        case AkElement::ElementStateNull:
+            this->d->stop();
+            this->d->m_state = state;
+            emit this->stateChanged(state);
+
+            return true;
+        case AkElement::ElementStatePaused:
+            this->d->m_dataMutex.lock();
+            this->d->m_clockBase = this->d->clock();
+            this->d->m_paused = true;
+            this->d->m_dataChanged.wakeAll();
+            this->d->m_dataMutex.unlock();
+            this->d->m_state = state;
+            emit this->stateChanged(state);
+
+            return true;
+        case AkElement::ElementStatePlaying:
+            break;
+        }
+
+        break;
+    }
+    }
+
+    return false;
+}
+
+void MediaSourceRaw::doLoop()
+{
+    this->setState(AkElement::ElementStateNull);
+
+    if (this->d->m_loop)
+        this->setState(AkElement::ElementStatePlaying);
+}
+
+MediaSourceRawPrivate::MediaSourceRawPrivate(MediaSourceRaw *self):
+    self(self)
+{
+
+}
+
+bool MediaSourceRawPrivate::openMedia()
+{
+    if (this->m_map)
+        return true;
+
+    if (this->m_media.isEmpty())
+        return false;
+
+    auto mapping = RawMappingPtr::create();
+    mapping->m_file.setFileName(this->m_media);
+
+    if (!mapping->m_file.open(QIODevice::ReadOnly))
+        return false;
+
+    auto fileSize = mapping->m_file.size();
+
+    if (fileSize < qint64(sizeof(RawHeader)))
+        return false;
+
+    mapping->m_map = mapping->m_file.map(0, fileSize);
+
+    if (!mapping->m_map)
+        return false;
+
+    this->m_mapping = mapping;
+    this->m_map = mapping->m_map;
+
+    auto header = reinterpret_cast<const RawHeader *>(this->m_map);
+    auto descriptionSize = qFromLittleEndian(header->descriptionSize);
+    auto indexOffset = qFromLittleEndian(header->indexOffset);
+    auto indexSize = qFromLittleEndian(header->indexSize);
+
+    // A zero index offset means the file was not closed properly.
+    if (memcmp(header->magic, rawMagic, sizeof(rawMagic)) != 0
+        || qFromLittleEndian(header->version) != RAW_FORMAT_VERSION
+        || sizeof(RawHeader) + descriptionSize > quint64(fileSize)
+        || indexOffset < sizeof(RawHeader)
+        || indexSize > (quint64(fileSize) - indexOffset) / sizeof(RawIndexEntry)) {
+        this->closeMedia();
+
+        return false;
+    }
+
+    auto description =
+            QByteArray::fromRawData(reinterpret_cast<const char *>(this->m_map)
+                                    + sizeof(RawHeader),
+                                    int(descriptionSize));
+    auto descriptionObj = QJsonDocument::fromJson(description).object();
+    this->m_timeBase = AkFrac(descriptionObj.value("timeBase").toString());
+
+    for (auto stream: descriptionObj.value("streams").toArray()) {
+        this->m_streamInfo
+                << capsFromDescription(stream.toObject().value("caps").toObject());
+        this->m_ids << Ak::id();
+    }
+
+    auto index =
+            reinterpret_cast<const RawIndexEntry *>(this->m_map + indexOffset);
+    this->m_index.resize(int(indexSize));
+
+    for (int i = 0; i < this->m_index.size(); i++) {
+        auto &entry = this->m_index[i];
+        entry.pts = qFromLittleEndian(index[i].pts);
+        entry.offset = qFromLittleEndian(index[i].offset);
+        entry.size = qFromLittleEndian(index[i].size);
+        entry.stream = qFromLittleEndian(index[i].stream);
+        entry.samples = qFromLittleEndian(index[i].samples);
+
+        if (entry.stream < 0
+            || entry.stream >= this->m_streamInfo.size()
+            || entry.offset > indexOffset
+            || entry.size > indexOffset - entry.offset
+            || entry.size > quint64(std::numeric_limits<int>::max())) {
+            this->closeMedia();
+
+            return false;
+        }
+
+        if (i == 0 || entry.pts < this->m_startPts)
+            this->m_startPts = entry.pts;
+
+        if (i == 0 || entry.pts - this->m_startPts > this->m_duration)
+            this->m_duration = entry.pts - this->m_startPts;
+    }
+
+    return true;
+}
+
+void MediaSourceRawPrivate::closeMedia()
+{
+    if (this->m_mapping) {
+        RawMapping::release(this->m_mapping);
+        this->m_mapping.clear();
+    }
+
+    this->m_map = nullptr;
+    this->m_streamInfo.clear();
+    this->m_ids.clear();
+    this->m_index.clear();
+    this->m_timeBase = AkFrac();
+    this->m_startPts = 0;
+    this->m_duration = 0;
+}
+
+AkCaps MediaSourceRawPrivate::capsFromDescription(const QJsonObject &caps)
+{
+    auto mimeType = caps.value("mimeType").toString();
+
+    if (mimeType == "audio/x-raw") {
+        auto format =
+                AkAudioCaps::sampleFormatFromString(caps.value("format").toString());
+        auto layout =
+                AkAudioCaps::channelLayoutFromString(caps.value("layout").toString());
+
+        return AkAudioCaps(format,
+                           layout,
+                           caps.value("rate").toInt(),
+                           0,
+                           caps.value("planar").toBool());
+    }
+
+    if (mimeType == "video/x-raw") {
+        auto format =
+                AkVideoCaps::pixelFormatFromString(caps.value("format").toString());
+
+        return AkVideoCaps(format,
+                           caps.value("width").toInt(),
+                           caps.value("height").toInt(),
+                           AkFrac(caps.value("fps").toString()),
+                           qMax(caps.value("align").toInt(), 1));
+    }
+
+    return {};
+}
+
+qreal MediaSourceRawPrivate::clock() const
+{
+    if (this->m_paused)
+        return this->m_clockBase;
+
+    return this->m_clockBase + qreal(this->m_clock.nsecsElapsed()) / 1e9;
+}
+
+qreal MediaSourceRawPrivate::packetTime(const RawIndexEntry &entry) const
+{
+    return qreal(entry.pts - this->m_startPts) * this->m_timeBase.value();
+}
+
+AkPacket MediaSourceRawPrivate::readPacket(const RawIndexEntry &entry) const
+{
+    auto caps = this->m_streamInfo[entry.stream];
+
+    // The number of samples changes from packet to packet.
+    if (caps.mimeType() == "audio/x-raw") {
+        AkAudioCaps audioCaps(caps);
+        caps = AkAudioCaps(audioCaps.format(),
+                           audioCaps.layout(),
+                           audioCaps.rate(),
+                           entry.samples,
+                           audioCaps.planar());
+    }
+
+    AkPacket packet(caps);
+    packet.setBuffer(this->m_mapping->buffer(entry.offset, int(entry.size)));
+    packet.setPts(entry.pts - this->m_startPts);
+    packet.setTimeBase(this->m_timeBase);
+    packet.setIndex(entry.stream);
+    packet.setId(this->m_ids[entry.stream]);
+
+    return packet;
+}
+
+void MediaSourceRawPrivate::readPackets()
+{
+    forever {
+        this->m_dataMutex.lock();
+
+        while (this->m_run && this->m_paused)
+            this->m_dataChanged.wait(&this->m_dataMutex);
+
+        if (!this->m_run) {
+            this->m_dataMutex.unlock();
+
+            break;
+        }
+
+        if (this->m_position >= this->m_index.size()) {
+            this->m_dataMutex.unlock();
+            QMetaObject::invokeMethod(self, "doLoop", Qt::QueuedConnection);
+
+            break;
+        }
+
+        auto entry = this->m_index[this->m_position];
+
+        // Wait until it's time to show the packet, the wait is interrupted
+        // when seeking, pausing or stopping.
+        if (this->m_sync) {
+            auto diff = this->packetTime(entry) - this->clock();
+
+            if (diff > 0) {
+                this->m_dataChanged.wait(&this->m_dataMutex,
+                                         ulong(qMax(qRound(1e3 * diff), 1)));
+                this->m_dataMutex.unlock();
+
+                continue;
+            }
+        }
+
+        this->m_position++;
+
+        if (!this->m_activeStreams.contains(entry.stream)) {
+            this->m_dataMutex.unlock();
+
+            continue;
+        }
+
+        auto packet = this->readPacket(entry);
+        this->m_dataMutex.unlock();
+
+        if (this->m_showLog)
+            qDebug() << "Stream" << entry.stream
+                     << "time" << this->packetTime(entry);
+
+        emit self->oStream(packet);
+    }
+}
+
+void MediaSourceRawPrivate::stop()
+{
+    this->m_dataMutex.lock();
+    this->m_run = false;
+    this->m_dataChanged.wakeAll();
+    this->m_dataMutex.unlock();
+    this->m_threadPool.waitForDone();
+}
+
+RawMapping::~RawMapping()
+{
+    if (this->m_map)
+        this->m_file.unmap(this->m_map);
+
+    this->m_file.close();
+}
+
+QByteArray RawMapping::buffer(quint64 offset, int size)
+{
+    // No copy is made, the buffer wraps the mapped pages.
+    auto buffer =
+            QByteArray::fromRawData(reinterpret_cast<const char *>(this->m_map
+                                                                   + offset),
+                                    size);
+
+    this->m_mutex.lock();
+    this->isUsed();
+    this->m_buffers << buffer;
+    this->m_mutex.unlock();
+
+    return buffer;
+}
+
+bool RawMapping::isUsed()
+{
+    // A buffer that is not shared is only referenced from here.
+    for (auto it = this->m_buffers.begin(); it != this->m_buffers.end();)
+        if (it->isDetached())
+            it = this->m_buffers.erase(it);
+        else
+            ++it;
+
+    return !this->m_buffers.isEmpty();
+}
+
+void RawMapping::release(const RawMappingPtr &mapping)
+{
+    static QMutex mutex;
+    static QList<RawMappingPtr> usedMappings;
+
+    mutex.lock();
+
+    for (auto it = usedMappings.begin(); it != usedMappings.end();) {
+        (*it)->m_mutex.lock();
+        bool used = (*it)->isUsed();
+        (*it)->m_mutex.unlock();
+
+        if (used)
+            ++it;
+        else
+            it = usedMappings.erase(it);
+    }
+
+    mapping->m_mutex.lock();
+
+    if (mapping->isUsed())
+        usedMappings << mapping;
+
+    mapping->m_mutex.unlock();
+    mutex.unlock();
+}
+
+#include "moc_mediasourceraw.cpp"
@@ -18,14 +18,50 @@
  */
 
 #include <QImage>
+#include <QQmlContext>
+#include <QtConcurrent>
 #include <akpacket.h>
 #include <akvideopacket.h>
 
 #include "normalizeelement.h"
 #include "pixelstructs.h"
 
-NormalizeElement::NormalizeElement(): AkElement()
+class NormalizeElementPrivate
 {
+    public:
+        QVector<quint32> m_lut[3];
+
+        static void limits(const QVector<quint64> &histogram,
+                           int samples,
+                           int *lows,
+                           int *highs);
+        void applyMap(QImage &img);
+};
+
+NormalizeElement::NormalizeElement(): AkHistogramElement()
+{
+    this->d = new NormalizeElementPrivate;
+}
+
+NormalizeElement::~NormalizeElement()
+{
+    delete this->d;
+}
+
+QString NormalizeElement::controlInterfaceProvide(const QString &controlId) const
+{
+    Q_UNUSED(controlId)
+
+    return QString("qrc:/Normalize/share/qml/main.qml");
+}
+
+void NormalizeElement::controlInterfaceConfigure(QQmlContext *context,
+                                                 const QString &controlId) const
+{
+    Q_UNUSED(controlId)
+
+    context->setContextProperty("Normalize", const_cast<QObject *>(qobject_cast<const QObject *>(this)));
+    context->setContextProperty("controlId", this->objectName());
 }
 
 AkPacket NormalizeElement::iVideoStream(const AkVideoPacket &packet)
@@ -37,28 +73,56 @@ AkPacket NormalizeElement::iVideoStream(const AkVideoPacket &packet)
 
     auto oFrame = src.convertToFormat(QImage::Format_ARGB32);
 
-    // form histogram
-    QVector<HistogramListItem> histogram(256, HistogramListItem());
-
-    for (int y = 0; y < oFrame.height(); y++) {
-        const QRgb *dstLine = reinterpret_cast<const QRgb *>(oFrame.constScanLine(y));
-
-        for (int x = 0; x < oFrame.width(); x++) {
-            auto pixel = dstLine[x];
-            histogram[qRed(pixel)].r++;
-            histogram[qGreen(pixel)].g++;
-            histogram[qBlue(pixel)].b++;
-            histogram[qAlpha(pixel)].a++;
+    if (this->needsUpdate(oFrame)) {
+        auto histogram = this->histogram(oFrame, HistogramChannels_RGB);
+        int decimation = qMax(this->decimation(), 1);
+        int samples = ((oFrame.width() + decimation - 1) / decimation)
+                    * ((oFrame.height() + decimation - 1) / decimation);
+        int lows[3];
+        int highs[3];
+        NormalizeElementPrivate::limits(histogram, samples, lows, highs);
+
+        // stretch the histogram to create the normalized image mapping.
+        for (int c = 0; c < 3; c++) {
+            QVector<qreal> map(256);
+
+            for (int i = 0; i < 256; i++)
+                if (lows[c] == highs[c])
+                    map[i] = i;
+                else if (i < lows[c])
+                    map[i] = 0;
+                else if (i > highs[c])
+                    map[i] = 255;
+                else
+                    map[i] = (255 * (i - lows[c])) / (highs[c] - lows[c]);
+
+            this->makeLut(this->smoothTable(c, map),
+                          8 * (2 - c),
+                          this->d->m_lut[c]);
         }
     }
 
+    this->d->applyMap(oFrame);
+
+    auto oPacket = AkVideoPacket::fromImage(oFrame, packet);
+    akSend(oPacket)
+}
+
+void NormalizeElementPrivate::limits(const QVector<quint64> &histogram,
+                                     int samples,
+                                     int *lows,
+                                     int *highs)
+{
     // find the histogram boundaries by locating the .01 percent levels.
+    auto histogramR = histogram.constData();
+    auto histogramG = histogramR + 256;
+    auto histogramB = histogramG + 256;
     ShortPixel high, low;
-    auto thresholdIntensity = qint32(oFrame.width() * oFrame.height() / 1e3);
+    auto thresholdIntensity = qint32(samples / 1e3);
     IntegerPixel intensity;
 
     for (low.r = 0; low.r < 256; low.r++) {
-        intensity.r += histogram[low.r].r;
+        intensity.r += qint32(histogramR[low.r]);
 
         if (intensity.r > thresholdIntensity)
             break;
@@ -67,7 +131,7 @@ AkPacket NormalizeElement::iVideoStream(const AkVideoPacket &packet)
     intensity.clear();
 
     for (high.r = 255; high.r > 0; high.r--) {
-        intensity.r += histogram[high.r].r;
+        intensity.r += qint32(histogramR[high.r]);
 
         if (intensity.r > thresholdIntensity)
             break;
@@ -76,7 +140,7 @@ AkPacket NormalizeElement::iVideoStream(const AkVideoPacket &packet)
     intensity.clear();
 
     for (low.g = low.r; low.g < high.r; low.g++) {
-        intensity.g += histogram[low.g].g;
+        intensity.g += qint32(histogramG[low.g]);
 
         if (intensity.g > thresholdIntensity)
             break;
@@ -85,7 +149,7 @@ AkPacket NormalizeElement::iVideoStream(const AkVideoPacket &packet)
     intensity.clear();
 
     for (high.g = high.r; high.g != low.r; high.g--) {
-        intensity.g += histogram[high.g].g;
+        intensity.g += qint32(histogramG[high.g]);
 
         if (intensity.g > thresholdIntensity)
             break;
@@ -94,7 +158,7 @@ AkPacket NormalizeElement::iVideoStream(const AkVideoPacket &packet)
     intensity.clear();
 
     for (low.b = low.g; low.b < high.g; low.b++) {
-        intensity.b += histogram[low.b].b;
+        intensity.b += qint32(histogramB[low.b]);
 
         if (intensity.b > thresholdIntensity)
             break;
@@ -103,69 +167,44 @@ AkPacket NormalizeElement::iVideoStream(const AkVideoPacket &packet)
     intensity.clear();
 
     for (high.b = high.g; high.b != low.g; high.b--) {
-        intensity.b += histogram[high.b].b;
+        intensity.b += qint32(histogramB[high.b]);
 
         if (intensity.b > thresholdIntensity)
             break;
     }
 
-    // stretch the histogram to create the normalized image mapping.
-    QVector<IntegerPixel> normalizeMap(256);
-
-    for (int i = 0; i < 256; i++) {
-        if(i < low.r)
-            normalizeMap[i].r = 0;
-        else {
-            if (i > high.r)
-                normalizeMap[i].r = 255;
-            else if (low.r != high.r)
-                normalizeMap[i].r = (255 * (i - low.r)) /
-                    (high.r - low.r);
-        }
-
-        if (i < low.g)
-            normalizeMap[i].g = 0;
-        else {
-            if(i > high.g)
-                normalizeMap[i].g = 255;
-            else if(low.g != high.g)
-                normalizeMap[i].g = (255 * (i - low.g)) /
-                    (high.g - low.g);
-        }
-
-        if (i < low.b)
-            normalizeMap[i].b = 0;
-        else {
-            if (i > high.b)
-                normalizeMap[i].b = 255;
-            else if (low.b != high.b)
-                normalizeMap[i].b = (255*(i-low.b)) /
-                    (high.b - low.b);
-        }
-    }
-
-    // write
-    for (int y = 0; y < oFrame.height(); y++) {
-        auto oLine = reinterpret_cast<QRgb *>(oFrame.scanLine(y));
+    lows[0] = low.r;
+    lows[1] = low.g;
+    lows[2] = low.b;
+    highs[0] = high.r;
+    highs[1] = high.g;
+    highs[2] = high.b;
+}
 
-        for (int x = 0; x < oFrame.width(); x++) {
-            auto pixel = oLine[x];
+void NormalizeElementPrivate::applyMap(QImage &img)
+{
+    auto lutR = this->m_lut[0].constData();
+    auto lutG = this->m_lut[1].constData();
+    auto lutB = this->m_lut[2].constData();
+    QVector<int> lines(img.height());
 
-            int r = (low.r != high.r)? normalizeMap[qRed(pixel)].r:
-                    qRed(pixel);
+    for (int y = 0; y < img.height(); y++)
+        lines[y] = y;
 
-            int g = (low.g != high.g)? normalizeMap[qGreen(pixel)].g:
-                        qGreen(pixel);
+    // Make sure the image is detached before writing from many threads.
+    img.bits();
 
-            int b = (low.b != high.b)?  normalizeMap[qBlue(pixel)].b:
-                        qBlue(pixel);
+    QtConcurrent::blockingMap(lines, [&] (int &y) {
+        auto oLine = reinterpret_cast<QRgb *>(img.scanLine(y));
 
-            oLine[x] = qRgba(r, g, b, qAlpha(pixel));
+        for (int x = 0; x < img.width(); x++) {
+            auto pixel = oLine[x];
+            oLine[x] = lutR[(pixel >> 16) & 0xff]
+                     | lutG[(pixel >> 8) & 0xff]
+                     | lutB[pixel & 0xff]
+                     | (pixel & 0xff000000);
         }
-    }
-
-    auto oPacket = AkVideoPacket::fromImage(oFrame, packet);
-    akSend(oPacket)
+    });
 }
 
 #include "moc_normalizeelement.cpp"
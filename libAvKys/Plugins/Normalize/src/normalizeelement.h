@@ -20,16 +20,25 @@
 #ifndef NORMALIZEELEMENT_H
 #define NORMALIZEELEMENT_H
 
-#include <akelement.h>
+#include <akhistogramelement.h>
 
-class NormalizeElement: public AkElement
+class NormalizeElementPrivate;
+
+class NormalizeElement: public AkHistogramElement
 {
     Q_OBJECT
 
     public:
         NormalizeElement();
+        ~NormalizeElement();
+
+    private:
+        NormalizeElementPrivate *d;
 
     protected:
+        QString controlInterfaceProvide(const QString &controlId) const;
+        void controlInterfaceConfigure(QQmlContext *context,
+                                       const QString &controlId) const;
         AkPacket iVideoStream(const AkVideoPacket &packet);
 };
 
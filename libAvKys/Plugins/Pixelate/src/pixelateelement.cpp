@@ -21,6 +21,7 @@
 #include <QQmlContext>
 #include <akpacket.h>
 #include <akvideopacket.h>
+#include <akblocktransform.h>
 
 #include "pixelateelement.h"
 
@@ -79,18 +80,15 @@ AkPacket PixelateElement::iVideoStream(const AkVideoPacket &packet)
         return AkPacket();
 
     QImage oFrame = src.convertToFormat(QImage::Format_ARGB32);
-
-    qreal sw = 1.0 / blockSize.width();
-    qreal sh = 1.0 / blockSize.height();
-
-    oFrame = oFrame.scaled(int(sw * oFrame.width()),
-                           int(sh * oFrame.height()),
-                           Qt::IgnoreAspectRatio,
-                           Qt::FastTransformation)
-                   .scaled(oFrame.width(),
-                           oFrame.height(),
-                           Qt::IgnoreAspectRatio,
-                           Qt::FastTransformation);
+    auto bits = oFrame.bits();
+    AkBlockTransform::blockMean(bits,
+                                oFrame.bytesPerLine(),
+                                bits,
+                                oFrame.bytesPerLine(),
+                                oFrame.width(),
+                                oFrame.height(),
+                                blockSize.width(),
+                                blockSize.height());
 
     auto oPacket = AkVideoPacket::fromImage(oFrame, packet);
     akSend(oPacket)
@@ -25,6 +25,7 @@ SUBDIRS += \
     ACapsConvert \
     AudioDevice \
     AudioGen \
+    AudioMixer \
     DesktopCapture \
     Multiplex \
     MultiSink \
@@ -18,8 +18,9 @@
  */
 
 #include <QtMath>
-#include <QPainter>
+#include <QImage>
 #include <QQmlContext>
+#include <akframeutils.h>
 #include <akpacket.h>
 #include <akvideopacket.h>
 
@@ -45,9 +46,17 @@ class RadioactiveElementPrivate
 {
     public:
         QSize m_frameSize;
-        QImage m_prevFrame;
-        QImage m_blurZoomBuffer;
-        AkElementPtr m_blurFilter;
+        QVector<QRgb> m_prevFrame;
+
+        // The radiation is stored as 4 planes, red, green, blue and alpha.
+        // m_blurZoomBuffer[0] holds the current state, and
+        // m_blurZoomBuffer[1] is the work buffer.
+        QVector<quint8> m_blurZoomBuffer[2][4];
+        QVector<quint32> m_blurSums;
+        QVector<quint32> m_blurColumn;
+        QVector<int> m_zoomX;
+        QVector<int> m_zoomY;
+        int m_blur {2};
         qreal m_zoom {1.1};
         RadioactiveElement::RadiationMode m_mode {RadioactiveElement::RadiationModeSoftNormal};
         int m_threshold {31};
@@ -55,25 +64,18 @@ class RadioactiveElementPrivate
         int m_alphaDiff {-8};
         QRgb m_radColor {qRgb(0, 255, 0)};
 
-        QImage imageDiff(const QImage &img1,
-                         const QImage &img2,
-                         int threshold,
-                         int lumaThreshold,
-                         QRgb radColor,
-                         RadioactiveElement::RadiationMode mode);
-        QImage imageAlphaDiff(const QImage &src, int alphaDiff);
+        void imageDiff(const QImage &src,
+                       int threshold,
+                       int lumaThreshold,
+                       QRgb radColor,
+                       RadioactiveElement::RadiationMode mode);
+        void updateZoomMap(qreal zoom);
+        void zoomAlphaDiff(const QImage &src, QImage &dst, int alphaDiff);
 };
 
 RadioactiveElement::RadioactiveElement(): AkElement()
 {
     this->d = new RadioactiveElementPrivate;
-    this->d->m_blurFilter = AkElement::create("Blur");
-    this->d->m_blurFilter->setProperty("radius", 2);
-
-    QObject::connect(this->d->m_blurFilter.data(),
-                     SIGNAL(radiusChanged(int)),
-                     this,
-                     SIGNAL(blurChanged(int)));
 }
 
 RadioactiveElement::~RadioactiveElement()
@@ -88,7 +90,7 @@ QString RadioactiveElement::mode() const
 
 int RadioactiveElement::blur() const
 {
-    return this->d->m_blurFilter->property("radius").toInt();
+    return this->d->m_blur;
 }
 
 qreal RadioactiveElement::zoom() const
@@ -116,90 +118,153 @@ QRgb RadioactiveElement::radColor() const
     return this->d->m_radColor;
 }
 
-QImage RadioactiveElementPrivate::imageDiff(const QImage &img1,
-                                            const QImage &img2,
-                                            int threshold,
-                                            int lumaThreshold,
-                                            QRgb radColor,
-                                            RadioactiveElement::RadiationMode mode)
+void RadioactiveElementPrivate::imageDiff(const QImage &src,
+                                          int threshold,
+                                          int lumaThreshold,
+                                          QRgb radColor,
+                                          RadioactiveElement::RadiationMode mode)
 {
-    int width = qMin(img1.width(), img2.width());
-    int height = qMin(img1.height(), img2.height());
-    QImage diff(width, height, img1.format());
-
-    for (int y = 0; y < height; y++) {
-        const QRgb *iLine1 = reinterpret_cast<const QRgb *>(img1.constScanLine(y));
-        const QRgb *iLine2 = reinterpret_cast<const QRgb *>(img2.constScanLine(y));
-        QRgb *oLine = reinterpret_cast<QRgb *>(diff.scanLine(y));
+    int width = this->m_frameSize.width();
+    int threshold2 = 3 * threshold * threshold;
+    auto &planes = this->m_blurZoomBuffer[0];
+    bool soft = mode == RadioactiveElement::RadiationModeSoftNormal
+                || mode == RadioactiveElement::RadiationModeSoftColor;
+    bool normal = mode == RadioactiveElement::RadiationModeHardNormal
+                  || mode == RadioactiveElement::RadiationModeSoftNormal;
+
+    for (int y = 0; y < this->m_frameSize.height(); y++) {
+        auto iLine1 = this->m_prevFrame.constData() + y * width;
+        auto iLine2 = reinterpret_cast<const QRgb *>(src.constScanLine(y));
+        size_t offset = size_t(y * width);
+        auto rLine = planes[0].data() + offset;
+        auto gLine = planes[1].data() + offset;
+        auto bLine = planes[2].data() + offset;
+        auto aLine = planes[3].data() + offset;
 
         for (int x = 0; x < width; x++) {
-            int r1 = qRed(iLine1[x]);
-            int g1 = qGreen(iLine1[x]);
-            int b1 = qBlue(iLine1[x]);
-
             int r2 = qRed(iLine2[x]);
             int g2 = qGreen(iLine2[x]);
             int b2 = qBlue(iLine2[x]);
 
-            int dr = r1 - r2;
-            int dg = g1 - g2;
-            int db = b1 - b2;
-
-            int alpha = dr * dr + dg * dg + db * db;
-            alpha = int(sqrt(alpha / 3.0));
+            int dr = qRed(iLine1[x]) - r2;
+            int dg = qGreen(iLine1[x]) - g2;
+            int db = qBlue(iLine1[x]) - b2;
 
-            if (mode == RadioactiveElement::RadiationModeSoftNormal
-                || mode == RadioactiveElement::RadiationModeSoftColor)
-                alpha = alpha < threshold? 0: alpha;
-            else
-                alpha = alpha < threshold? 0: 255;
+            int s = dr * dr + dg * dg + db * db;
+            int gray = (11 * r2 + 16 * g2 + 5 * b2) >> 5;
 
-            int gray = qGray(iLine2[x]);
+            // Static pixels doesn't add radiation, skip them.
+            if (s < threshold2 || s == 0 || gray < lumaThreshold)
+                continue;
 
-            alpha = gray < lumaThreshold? 0: alpha;
+            int alpha = soft? int(sqrt(s / 3.0)): 255;
+            int r = normal? r2: qRed(radColor);
+            int g = normal? g2: qGreen(radColor);
+            int b = normal? b2: qBlue(radColor);
 
-            int r;
-            int g;
-            int b;
+            // Draw the radiation over the buffer.
+            int bufferAlpha = aLine[x];
+            int bufferWeight = (255 - alpha) * bufferAlpha;
+            int oAlpha = 255 * alpha + bufferWeight;
 
-            if (mode == RadioactiveElement::RadiationModeHardNormal
-                || mode == RadioactiveElement::RadiationModeSoftNormal) {
-                r = r2;
-                g = g2;
-                b = b2;
-            } else {
-                r = qRed(radColor);
-                g = qGreen(radColor);
-                b = qBlue(radColor);
-            }
+            if (oAlpha < 1)
+                continue;
 
-            oLine[x] = qRgba(r, g, b, alpha);
+            rLine[x] = quint8((255 * alpha * r + bufferWeight * rLine[x]) / oAlpha);
+            gLine[x] = quint8((255 * alpha * g + bufferWeight * gLine[x]) / oAlpha);
+            bLine[x] = quint8((255 * alpha * b + bufferWeight * bLine[x]) / oAlpha);
+            aLine[x] = quint8(oAlpha / 255);
         }
     }
+}
+
+void RadioactiveElementPrivate::updateZoomMap(qreal zoom)
+{
+    int width = this->m_frameSize.width();
+    int height = this->m_frameSize.height();
+    int scaledWidth = qMax(qRound(zoom * width), 1);
+    int scaledHeight = qMax(qRound(zoom * height), 1);
+
+    // The zoomed image is centered in the frame.
+    int xp = (width - scaledWidth) >> 1;
+    int yp = (height - scaledHeight) >> 1;
+
+    this->m_zoomX.resize(width);
+    this->m_zoomY.resize(height);
+
+    for (int x = 0; x < width; x++) {
+        int xs = x - xp;
+        this->m_zoomX[x] = xs < 0 || xs >= scaledWidth?
+                               -1: xs * width / scaledWidth;
+    }
 
-    return diff;
+    for (int y = 0; y < height; y++) {
+        int ys = y - yp;
+        this->m_zoomY[y] = ys < 0 || ys >= scaledHeight?
+                               -1: ys * height / scaledHeight;
+    }
 }
 
-QImage RadioactiveElementPrivate::imageAlphaDiff(const QImage &src,
-                                                 int alphaDiff)
+void RadioactiveElementPrivate::zoomAlphaDiff(const QImage &src,
+                                              QImage &dst,
+                                              int alphaDiff)
 {
-    QImage dest(src.size(), src.format());
+    int width = this->m_frameSize.width();
+    auto &iPlanes = this->m_blurZoomBuffer[1];
+    auto &oPlanes = this->m_blurZoomBuffer[0];
+
+    // Zoom the blurred buffer, reduce it's alpha, and draw it over the
+    // source frame, all in a single pass.
+    for (int y = 0; y < this->m_frameSize.height(); y++) {
+        auto srcLine = reinterpret_cast<const QRgb *>(src.constScanLine(y));
+        auto dstLine = reinterpret_cast<QRgb *>(dst.scanLine(y));
+        size_t offset = size_t(y * width);
+        auto rLine = oPlanes[0].data() + offset;
+        auto gLine = oPlanes[1].data() + offset;
+        auto bLine = oPlanes[2].data() + offset;
+        auto aLine = oPlanes[3].data() + offset;
+        int ys = this->m_zoomY[y];
+
+        if (ys < 0) {
+            memset(aLine, 0, size_t(width));
+            memcpy(dstLine, srcLine, size_t(width) * sizeof(QRgb));
+
+            continue;
+        }
+
+        size_t iOffset = size_t(ys * width);
+        auto irLine = iPlanes[0].constData() + iOffset;
+        auto igLine = iPlanes[1].constData() + iOffset;
+        auto ibLine = iPlanes[2].constData() + iOffset;
+        auto iaLine = iPlanes[3].constData() + iOffset;
+
+        for (int x = 0; x < width; x++) {
+            int xs = this->m_zoomX[x];
+
+            if (xs < 0) {
+                aLine[x] = 0;
+                dstLine[x] = srcLine[x];
 
-    for (int y = 0; y < src.height(); y++) {
-        const QRgb *srcLine = reinterpret_cast<const QRgb *>(src.constScanLine(y));
-        QRgb *dstLine = reinterpret_cast<QRgb *>(dest.scanLine(y));
+                continue;
+            }
+
+            int r = irLine[xs];
+            int g = igLine[xs];
+            int b = ibLine[xs];
+            int alpha = qBound(0, iaLine[xs] + alphaDiff, 255);
+            rLine[x] = quint8(r);
+            gLine[x] = quint8(g);
+            bLine[x] = quint8(b);
+            aLine[x] = quint8(alpha);
 
-        for (int x = 0; x < src.width(); x++) {
             QRgb pixel = srcLine[x];
-            int r = qRed(pixel);
-            int g = qGreen(pixel);
-            int b = qBlue(pixel);
-            int a = qBound(0, qAlpha(pixel) + alphaDiff, 255);
-            dstLine[x] = qRgba(r, g, b, a);
+            int ialpha = 255 - alpha;
+            dstLine[x] = qRgba((alpha * r + ialpha * qRed(pixel)) / 255,
+                               (alpha * g + ialpha * qGreen(pixel)) / 255,
+                               (alpha * b + ialpha * qBlue(pixel)) / 255,
+                               alpha + ialpha * qAlpha(pixel) / 255);
         }
     }
-
-    return dest;
 }
 
 QString RadioactiveElement::controlInterfaceProvide(const QString &controlId) const
@@ -229,62 +294,42 @@ AkPacket RadioactiveElement::iVideoStream(const AkVideoPacket &packet)
     QImage oFrame(src.size(), src.format());
 
     if (src.size() != this->d->m_frameSize) {
-        this->d->m_blurZoomBuffer = QImage();
-        this->d->m_prevFrame = QImage();
+        this->d->m_prevFrame.clear();
         this->d->m_frameSize = src.size();
     }
 
-    if (this->d->m_prevFrame.isNull()) {
+    if (this->d->m_prevFrame.isEmpty()) {
         oFrame = src;
-        this->d->m_blurZoomBuffer = QImage(src.size(), src.format());
-        this->d->m_blurZoomBuffer.fill(qRgba(0, 0, 0, 0));
+        int area = src.width() * src.height();
+
+        for (auto &buffer: this->d->m_blurZoomBuffer)
+            for (auto &plane: buffer)
+                plane.fill(0, area);
     } else {
         // Compute the difference between previous and current frame,
         // and save it to the buffer.
-        QImage diff =
-                this->d->imageDiff(this->d->m_prevFrame,
-                                   src,
-                                   this->d->m_threshold,
-                                   this->d->m_lumaThreshold,
-                                   this->d->m_radColor,
-                                   this->d->m_mode);
-
-        QPainter painter;
-        painter.begin(&this->d->m_blurZoomBuffer);
-        painter.drawImage(0, 0, diff);
-        painter.end();
+        this->d->imageDiff(src,
+                           this->d->m_threshold,
+                           this->d->m_lumaThreshold,
+                           this->d->m_radColor,
+                           this->d->m_mode);
 
         // Blur buffer.
-        auto blurZoomPacket =
-                AkVideoPacket::fromImage(this->d->m_blurZoomBuffer, packet);
-        auto blurPacket = this->d->m_blurFilter->iStream(blurZoomPacket);
-        auto blur = AkVideoPacket(blurPacket).toImage();
-
-        // Zoom buffer.
-        QImage blurScaled = blur.scaled(this->d->m_zoom * blur.size());
-        QSize diffSize = blur.size() - blurScaled.size();
-        QPoint p(diffSize.width() >> 1,
-                 diffSize.height() >> 1);
-
-        QImage zoom(blur.size(), blur.format());
-        zoom.fill(qRgba(0, 0, 0, 0));
-
-        painter.begin(&zoom);
-        painter.drawImage(p, blurScaled);
-        painter.end();
-
-        // Reduce alpha.
-        QImage alphaDiff = this->d->imageAlphaDiff(zoom, this->d->m_alphaDiff);
-        this->d->m_blurZoomBuffer = alphaDiff;
-
-        // Apply buffer.
-        painter.begin(&oFrame);
-        painter.drawImage(0, 0, src);
-        painter.drawImage(0, 0, this->d->m_blurZoomBuffer);
-        painter.end();
+        for (int i = 0; i < 4; i++)
+            AkFrameUtils::blurPlane(this->d->m_blurZoomBuffer[0][i].constData(),
+                                    this->d->m_blurZoomBuffer[1][i].data(),
+                                    src.width(),
+                                    src.height(),
+                                    this->d->m_blur,
+                                    this->d->m_blurSums,
+                                    this->d->m_blurColumn);
+
+        // Zoom buffer, reduce alpha and apply it.
+        this->d->updateZoomMap(this->d->m_zoom);
+        this->d->zoomAlphaDiff(src, oFrame, this->d->m_alphaDiff);
     }
 
-    this->d->m_prevFrame = src.copy();
+    AkFrameUtils::storeFrame(src, this->d->m_prevFrame);
 
     auto oPacket = AkVideoPacket::fromImage(oFrame, packet);
     akSend(oPacket)
@@ -304,7 +349,11 @@ void RadioactiveElement::setMode(const QString &mode)
 
 void RadioactiveElement::setBlur(int blur)
 {
-    this->d->m_blurFilter->setProperty("radius", blur);
+    if (this->d->m_blur == blur)
+        return;
+
+    this->d->m_blur = blur;
+    emit this->blurChanged(blur);
 }
 
 void RadioactiveElement::setZoom(qreal zoom)
@@ -22,6 +22,7 @@
 #include <QRandomGenerator>
 #include <QtMath>
 #include <akcaps.h>
+#include <akframeutils.h>
 #include <akpacket.h>
 #include <akvideopacket.h>
 
@@ -50,8 +51,9 @@ class RippleElementPrivate
         int m_threshold {15};
         int m_lumaThreshold {15};
         AkCaps m_caps;
-        QImage m_prevFrame;
-        QVector<QImage> m_rippleBuffer;
+        QVector<QRgb> m_prevFrame;
+        QVector<int> m_rippleBuffer[2];
+        QVector<int> m_tmpBuffer;
         int m_curRippleBuffer {0};
         int m_period {0};
         int m_rainStat {0};
@@ -61,15 +63,15 @@ class RippleElementPrivate
         int m_dropsPerFrame {0};
         int m_dropPower {0};
 
-        QImage imageDiff(const QImage &img1,
-                         const QImage &img2,
-                         int threshold,
-                         int lumaThreshold, int strength);
-        void addDrops(const QImage &buffer, const QImage &drops);
-        void ripple(const QImage &buffer1, const QImage &buffer2, int decay);
-        QImage applyWater(const QImage &src, const QImage &buffer);
-        QImage rainDrop(int width, int height, int strength);
-        QImage drop(int width, int height, int power);
+        void addDiff(const QRgb *prevFrame,
+                     const QImage &src,
+                     int threshold,
+                     int lumaThreshold,
+                     int strength);
+        void ripple(int width, int height, int decay);
+        void applyWater(const QImage &src, QImage &dst, const int *buffer);
+        void rainDrop(int width, int height, int strength);
+        void drop(int width, int height, int power);
 };
 
 RippleElement::RippleElement(): AkElement()
@@ -107,100 +109,90 @@ int RippleElement::lumaThreshold() const
     return this->d->m_lumaThreshold;
 }
 
-QImage RippleElementPrivate::imageDiff(const QImage &img1,
-                                       const QImage &img2,
-                                       int threshold,
-                                       int lumaThreshold,
-                                       int strength)
+void RippleElementPrivate::addDiff(const QRgb *prevFrame,
+                                   const QImage &src,
+                                   int threshold,
+                                   int lumaThreshold,
+                                   int strength)
 {
-    int width = qMin(img1.width(), img2.width());
-    int height = qMin(img1.height(), img2.height());
-    QImage diff(width, height, QImage::Format_ARGB32);
-
+    int width = src.width();
+    int height = src.height();
+    auto buffer1 = this->m_rippleBuffer[0].data();
+    auto buffer2 = this->m_rippleBuffer[1].data();
+    int threshold2 = 3 * threshold * threshold;
+
+    // The difference is added straight to both simulation buffers, there
+    // is no need to store it in an intermediate frame.
     for (int y = 0; y < height; y++) {
-        const QRgb *img1Line = reinterpret_cast<const QRgb *>(img1.constScanLine(y));
-        const QRgb *img2Line = reinterpret_cast<const QRgb *>(img2.constScanLine(y));
-        int *diffLine = reinterpret_cast<int *>(diff.scanLine(y));
+        auto prevLine = prevFrame + y * width;
+        auto srcLine = reinterpret_cast<const QRgb *>(src.constScanLine(y));
+        auto buffer1Line = buffer1 + y * width;
+        auto buffer2Line = buffer2 + y * width;
 
         for (int x = 0; x < width; x++) {
-            QRgb pixel1 = img1Line[x];
-            int r1 = qRed(pixel1);
-            int g1 = qGreen(pixel1);
-            int b1 = qBlue(pixel1);
-
-            QRgb pixel2 = img2Line[x];
-            int r2 = qRed(pixel2);
-            int g2 = qGreen(pixel2);
-            int b2 = qBlue(pixel2);
+            int r2 = qRed(srcLine[x]);
+            int g2 = qGreen(srcLine[x]);
+            int b2 = qBlue(srcLine[x]);
 
-            int dr = r1 - r2;
-            int dg = g1 - g2;
-            int db = b1 - b2;
+            int dr = qRed(prevLine[x]) - r2;
+            int dg = qGreen(prevLine[x]) - g2;
+            int db = qBlue(prevLine[x]) - b2;
 
             int s = dr * dr + dg * dg + db * db;
-            s = int(sqrt(s / 3.0));
-            s = s < threshold? 0: s;
+            int gray = (11 * r2 + 16 * g2 + 5 * b2) >> 5;
 
-            int gray = qGray(img2Line[x]);
-            s = gray < lumaThreshold? 0: s;
+            // Most of the pixels doesn't change, avoid the square root
+            // for them.
+            if (s < threshold2 || s == 0 || gray < lumaThreshold)
+                continue;
 
-            diffLine[x] = (strength * s) >> 8;
+            int drop = (strength * int(sqrt(s / 3.0))) >> 8;
+            buffer1Line[x] += drop;
+            buffer2Line[x] += drop;
         }
     }
-
-    return diff;
-}
-
-void RippleElementPrivate::addDrops(const QImage &buffer, const QImage &drops)
-{
-    for (int y = 0; y < buffer.height(); y++) {
-        const int *dropsLine = reinterpret_cast<const int *>(drops.constScanLine(y));
-        int *bufferLine = const_cast<int *>(reinterpret_cast<const int *>(buffer.scanLine(y)));
-
-        for (int x = 0; x < buffer.width(); x++)
-            bufferLine[x] += dropsLine[x];
-    }
 }
 
-void RippleElementPrivate::ripple(const QImage &buffer1,
-                                  const QImage &buffer2,
-                                  int decay)
+void RippleElementPrivate::ripple(int width, int height, int decay)
 {
-    QImage buffer3(buffer1.size(), buffer1.format());
-    const int *buffer1Bits = reinterpret_cast<const int *>(buffer1.constBits());
-    int *buffer2Bits = const_cast<int *>(reinterpret_cast<const int *>(buffer2.bits()));
-    int *buffer3Bits = const_cast<int *>(reinterpret_cast<const int *>(buffer3.bits()));
-    int widthM1 = buffer1.width() - 1;
-    int widthP1 = buffer1.width() + 1;
-    int height = buffer1.height() - 1;
-
-    memset(buffer2Bits, 0, size_t(buffer1.bytesPerLine()));
-    memset(buffer2Bits + height * buffer1.width(), 0, size_t(buffer1.bytesPerLine()));
-    memset(buffer3Bits, 0, size_t(buffer1.bytesPerLine()));
-    memset(buffer3Bits + height * buffer1.width(), 0, size_t(buffer1.bytesPerLine()));
-
-    for (int y = 1; y < height; y++) {
-        buffer2Bits[y * buffer1.width()] = 0;
-        buffer2Bits[widthM1 + y * buffer1.width()] = 0;
-        buffer3Bits[y * buffer1.width()] = 0;
-        buffer3Bits[widthM1 + y * buffer1.width()] = 0;
+    // The current buffer holds the current wave heights, the other buffer
+    // holds the previous heights and receives the new ones.
+    auto buffer1Bits = this->m_rippleBuffer[this->m_curRippleBuffer].constData();
+    auto buffer2Bits = this->m_rippleBuffer[1 - this->m_curRippleBuffer].data();
+    this->m_tmpBuffer.resize(width * height);
+    auto buffer3Bits = this->m_tmpBuffer.data();
+    int widthM1 = width - 1;
+    int widthP1 = width + 1;
+    int heightM1 = height - 1;
+    auto lineSize = size_t(width) * sizeof(int);
+
+    memset(buffer2Bits, 0, lineSize);
+    memset(buffer2Bits + heightM1 * width, 0, lineSize);
+    memset(buffer3Bits, 0, lineSize);
+    memset(buffer3Bits + heightM1 * width, 0, lineSize);
+
+    for (int y = 1; y < heightM1; y++) {
+        buffer2Bits[y * width] = 0;
+        buffer2Bits[widthM1 + y * width] = 0;
+        buffer3Bits[y * width] = 0;
+        buffer3Bits[widthM1 + y * width] = 0;
     }
 
     // Wave simulation.
-    for (int y = 1; y < height; y++) {
-        int xOfftset = y * buffer1.width();
+    for (int y = 1; y < heightM1; y++) {
+        int xOfftset = y * width;
 
         for (int x = 1; x < widthM1; x++) {
             int xp = x + xOfftset;
             int h = 0;
 
             h += buffer1Bits[xp - widthP1];
-            h += buffer1Bits[xp - buffer1.width()];
+            h += buffer1Bits[xp - width];
             h += buffer1Bits[xp - widthM1];
             h += buffer1Bits[xp - 1];
             h += buffer1Bits[xp + 1];
             h += buffer1Bits[xp + widthM1];
-            h += buffer1Bits[xp + buffer1.width()];
+            h += buffer1Bits[xp + width];
             h += buffer1Bits[xp + widthP1];
             h -= 9 * buffer1Bits[xp];
             h >>= 3;
@@ -212,8 +204,8 @@ void RippleElementPrivate::ripple(const QImage &buffer1,
     }
 
     // Low pass filter.
-    for (int y = 1; y < height; y++) {
-        int xOfftset = y * buffer1.width();
+    for (int y = 1; y < heightM1; y++) {
+        int xOfftset = y * width;
 
         for (int x = 1; x < widthM1; x++) {
             int xp = x + xOfftset;
@@ -222,8 +214,8 @@ void RippleElementPrivate::ripple(const QImage &buffer1,
 
             h += buffer3Bits[xp - 1];
             h += buffer3Bits[xp + 1];
-            h += buffer3Bits[xp - buffer3.width()];
-            h += buffer3Bits[xp + buffer3.width()];
+            h += buffer3Bits[xp - width];
+            h += buffer3Bits[xp + width];
             h += 60 * buffer3Bits[xp];
 
             buffer2Bits[xp] = h >> 6;
@@ -231,54 +223,57 @@ void RippleElementPrivate::ripple(const QImage &buffer1,
     }
 }
 
-QImage RippleElementPrivate::applyWater(const QImage &src, const QImage &buffer)
+void RippleElementPrivate::applyWater(const QImage &src,
+                                      QImage &dst,
+                                      const int *buffer)
 {
-    QImage dest(src.size(), src.format());
-    const QRgb *srcBits = reinterpret_cast<const QRgb *>(src.constBits());
-    const int *bufferBits = reinterpret_cast<const int *>(buffer.bits());
-    QRgb *destBits = reinterpret_cast<QRgb *>(dest.bits());
+    int width = src.width();
+    int height = src.height();
 
-    for (int y = 0; y < src.height(); y++) {
-        int xOfftset = y * src.width();
-
-        for (int x = 0; x < src.width(); x++) {
-            int xp = x + xOfftset;
+    for (int y = 0; y < height; y++) {
+        auto bufferLine = buffer + y * width;
+        auto dstLine = reinterpret_cast<QRgb *>(dst.scanLine(y));
 
+        for (int x = 0; x < width; x++) {
             int xOff = 0;
 
             if (x > 1
-                && x < src.width() - 1) {
-                xOff += bufferBits[xp - 1];
-                xOff -= bufferBits[xp + 1];
+                && x < width - 1) {
+                xOff += bufferLine[x - 1];
+                xOff -= bufferLine[x + 1];
             }
 
             int yOff = 0;
 
             if (y > 1
-                && y < src.height() - 1) {
-                yOff += bufferBits[xp - buffer.width()];
-                yOff -= bufferBits[xp + buffer.width()];
+                && y < height - 1) {
+                yOff += bufferLine[x - width];
+                yOff -= bufferLine[x + width];
             }
 
-            QColor color;
-            int xq = qBound(0, x + xOff, src.width() - 1);
-            int yq = qBound(0, y + yOff, src.height() - 1);
+            int xq = qBound(0, x + xOff, width - 1);
+            int yq = qBound(0, y + yOff, height - 1);
+            auto pixel = reinterpret_cast<const QRgb *>(src.constScanLine(yq))[xq];
 
-            color.setRgba(srcBits[xq + yq * src.width()]);
+            if (xOff == 0) {
+                dstLine[x] = pixel | 0xff000000;
+
+                continue;
+            }
 
             // Shading
+            QColor color;
+            color.setRgba(pixel);
             int lightness = color.lightness() + xOff;
             lightness = qBound(0, lightness, 255);
             color.setHsl(color.hue(), color.saturation(), lightness);
 
-            destBits[xp] = color.rgb();
+            dstLine[x] = color.rgb();
         }
     }
-
-    return dest;
 }
 
-QImage RippleElementPrivate::rainDrop(int width, int height, int strength)
+void RippleElementPrivate::rainDrop(int width, int height, int strength)
 {
     if (this->m_period == 0) {
         switch (this->m_rainStat) {
@@ -331,41 +326,27 @@ QImage RippleElementPrivate::rainDrop(int width, int height, int strength)
         }
     }
 
-    QImage rain;
-
     if (this->m_rainStat == 1
         || this->m_rainStat == 5) {
 
         if ((QRandomGenerator::global()->generate() >> 8) < this->m_dropProb)
-            rain = this->drop(width, height, this->m_dropPower);
+            this->drop(width, height, this->m_dropPower);
 
         this->m_dropProb += uint(this->m_dropProbIncrement);
     } else if (this->m_rainStat == 2
                || this->m_rainStat == 3
                || this->m_rainStat == 4) {
         for  (int i = this->m_dropsPerFrame / 16; i > 0; i--)
-            rain = this->drop(width, height, this->m_dropPower);
+            this->drop(width, height, this->m_dropPower);
 
         this->m_dropsPerFrame += this->m_dropProbIncrement;
     }
 
     this->m_period--;
-
-    if (rain.isNull()) {
-        rain = QImage(width, height, QImage::Format_ARGB32);
-        rain.fill(qRgba(0, 0, 0, 0));
-    }
-
-    return rain;
 }
 
-QImage RippleElementPrivate::drop(int width, int height, int power)
+void RippleElementPrivate::drop(int width, int height, int power)
 {
-    QImage drops(width, height, QImage::Format_ARGB32);
-    auto dropsBits = reinterpret_cast<int *>(drops.bits());
-
-    drops.fill(qRgba(0, 0, 0, 0));
-
     int widthM1 = width - 1;
     int widthP1 = width + 1;
 
@@ -374,17 +355,20 @@ QImage RippleElementPrivate::drop(int width, int height, int power)
 
     int offset = x + y * width;
 
-    dropsBits[offset - widthP1] = power >> 2;
-    dropsBits[offset - width] = power >> 1;
-    dropsBits[offset - widthM1] = power >> 2;
-    dropsBits[offset - 1] = power >> 1;
-    dropsBits[offset] = power;
-    dropsBits[offset + 1] = power >> 1;
-    dropsBits[offset + widthM1] = power >> 2;
-    dropsBits[offset + width] = power >> 1;
-    dropsBits[offset + widthP1] = power >> 2;
-
-    return drops;
+    // Drop the water directly on both simulation buffers.
+    for (auto &buffer: this->m_rippleBuffer) {
+        auto bufferBits = buffer.data();
+
+        bufferBits[offset - widthP1] += power >> 2;
+        bufferBits[offset - width] += power >> 1;
+        bufferBits[offset - widthM1] += power >> 2;
+        bufferBits[offset - 1] += power >> 1;
+        bufferBits[offset] += power;
+        bufferBits[offset + 1] += power >> 1;
+        bufferBits[offset + widthM1] += power >> 2;
+        bufferBits[offset + width] += power >> 1;
+        bufferBits[offset + widthP1] += power >> 2;
+    }
 }
 
 QString RippleElement::controlInterfaceProvide(const QString &controlId) const
@@ -412,9 +396,11 @@ AkPacket RippleElement::iVideoStream(const AkVideoPacket &packet)
 
     src = src.convertToFormat(QImage::Format_ARGB32);
     QImage oFrame(src.size(), src.format());
+    int width = src.width();
+    int height = src.height();
 
     if (packet.caps() != this->d->m_caps) {
-        this->d->m_prevFrame = QImage();
+        this->d->m_prevFrame.clear();
         this->d->m_period = 0;
         this->d->m_rainStat = 0;
         this->d->m_dropProb = 0;
@@ -425,44 +411,35 @@ AkPacket RippleElement::iVideoStream(const AkVideoPacket &packet)
         this->d->m_caps = packet.caps();
     }
 
-    if (this->d->m_prevFrame.isNull()) {
+    if (this->d->m_prevFrame.isEmpty()) {
         oFrame = src;
-        this->d->m_rippleBuffer.clear();
-        this->d->m_rippleBuffer << QImage(src.size(), src.format());
-        this->d->m_rippleBuffer[0].fill(qRgba(0, 0, 0, 0));
-        this->d->m_rippleBuffer << QImage(src.size(), src.format());
-        this->d->m_rippleBuffer[1].fill(qRgba(0, 0, 0, 0));
+
+        for (auto &buffer: this->d->m_rippleBuffer)
+            buffer.fill(0, width * height);
+
         this->d->m_curRippleBuffer = 0;
     } else {
-        QImage drops;
-
         if (this->d->m_mode == RippleModeMotionDetect)
             // Compute the difference between previous and current frame,
             // and save it to the buffer.
-            drops = this->d->imageDiff(this->d->m_prevFrame,
-                                       src,
-                                       this->d->m_threshold,
-                                       this->d->m_lumaThreshold,
-                                       this->d->m_amplitude);
+            this->d->addDiff(this->d->m_prevFrame.constData(),
+                             src,
+                             this->d->m_threshold,
+                             this->d->m_lumaThreshold,
+                             this->d->m_amplitude);
         else
-            drops = this->d->rainDrop(src.width(),
-                                      src.height(),
-                                      this->d->m_amplitude);
-
-        this->d->addDrops(this->d->m_rippleBuffer[this->d->m_curRippleBuffer], drops);
-        this->d->addDrops(this->d->m_rippleBuffer[1 - this->d->m_curRippleBuffer], drops);
+            this->d->rainDrop(width, height, this->d->m_amplitude);
 
-        this->d->ripple(this->d->m_rippleBuffer[this->d->m_curRippleBuffer],
-                        this->d->m_rippleBuffer[1 - this->d->m_curRippleBuffer],
-                        this->d->m_decay);
+        this->d->ripple(width, height, this->d->m_decay);
 
         // Apply buffer.
-        oFrame = this->d->applyWater(src,
-                                     this->d->m_rippleBuffer[this->d->m_curRippleBuffer]);
+        this->d->applyWater(src,
+                            oFrame,
+                            this->d->m_rippleBuffer[this->d->m_curRippleBuffer].constData());
         this->d->m_curRippleBuffer = 1 - this->d->m_curRippleBuffer;
     }
 
-    this->d->m_prevFrame = src.copy();
+    AkFrameUtils::storeFrame(src, this->d->m_prevFrame);
     auto oPacket = AkVideoPacket::fromImage(oFrame, packet);
     akSend(oPacket)
 }
@@ -17,7 +17,7 @@
  * Web-Site: http://webcamoid.github.io/
  */
 
-#include <QPainter>
+#include <QImage>
 #include <QQmlContext>
 #include <QRandomGenerator>
 #include <QTime>
@@ -34,7 +34,7 @@ class ScrollElementPrivate
         qreal m_offset {0.0};
         QSize m_curSize;
 
-        QImage generateNoise(const QSize &size, qreal persent) const;
+        void applyNoise(QImage &frame, qreal persent) const;
 };
 
 ScrollElement::ScrollElement(): AkElement()
@@ -98,11 +98,7 @@ AkPacket ScrollElement::iVideoStream(const AkVideoPacket &packet)
            src.constScanLine(0),
            size_t(src.bytesPerLine() * (src.height() - offset)));
 
-    QPainter painter;
-    painter.begin(&oFrame);
-    QImage noise = this->d->generateNoise(oFrame.size(), this->d->m_noise);
-    painter.drawImage(0, 0, noise);
-    painter.end();
+    this->d->applyNoise(oFrame, this->d->m_noise);
 
     this->d->m_offset += this->d->m_speed * oFrame.height();
 
@@ -143,22 +139,25 @@ void ScrollElement::resetNoise()
     this->setNoise(0.1);
 }
 
-QImage ScrollElementPrivate::generateNoise(const QSize &size, qreal persent) const
+void ScrollElementPrivate::applyNoise(QImage &frame, qreal persent) const
 {
-    QImage noise(size, QImage::Format_ARGB32);
-    noise.fill(0);
-
-    auto peper = qRound(persent * size.width() * size.height());
+    auto peper = qRound(persent * frame.width() * frame.height());
 
+    // Blend the noise directly into the frame, there is no need for an
+    // intermediate full frame image.
     for (int i = 0; i < peper; i++) {
         int gray = QRandomGenerator::global()->bounded(256);
         int alpha = QRandomGenerator::global()->bounded(256);
-        int x = QRandomGenerator::global()->bounded(noise.width());
-        int y = QRandomGenerator::global()->bounded(noise.height());
-        noise.setPixel(x, y, qRgba(gray, gray, gray, alpha));
+        int x = QRandomGenerator::global()->bounded(frame.width());
+        int y = QRandomGenerator::global()->bounded(frame.height());
+        auto pixel = reinterpret_cast<QRgb *>(frame.scanLine(y)) + x;
+        int ialpha = 255 - alpha;
+        int r = (alpha * gray + ialpha * qRed(*pixel)) / 255;
+        int g = (alpha * gray + ialpha * qGreen(*pixel)) / 255;
+        int b = (alpha * gray + ialpha * qBlue(*pixel)) / 255;
+        int a = alpha + ialpha * qAlpha(*pixel) / 255;
+        *pixel = qRgba(r, g, b, a);
     }
-
-    return noise;
 }
 
 #include "moc_scrollelement.cpp"
@@ -97,6 +97,8 @@ SUBDIRS += \
     Lib \
     Plugins
 
+!isEmpty(BUILDBENCHMARKS):!isEqual(BUILDBENCHMARKS, 0): SUBDIRS += Benchmarks
+
 # Install rules
 
 !android {